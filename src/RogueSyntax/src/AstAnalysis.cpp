@@ -0,0 +1,190 @@
+#include "AstAnalysis.h"
+#include <pch.h>
+
+std::vector<const INode*> AstAnalysis::Children(const INode* node)
+{
+	std::vector<const INode*> children;
+	auto add = [&children](const INode* child)
+	{
+		if (child != nullptr)
+		{
+			children.push_back(child);
+		}
+	};
+
+	if (node->IsThisA<Program>())
+	{
+		for (auto* stmt : dynamic_cast<const Program*>(node)->Statements)
+		{
+			add(stmt);
+		}
+	}
+	else if (node->IsThisA<BlockStatement>())
+	{
+		for (auto* stmt : dynamic_cast<const BlockStatement*>(node)->Statements)
+		{
+			add(stmt);
+		}
+	}
+	else if (node->IsThisA<ExpressionStatement>())
+	{
+		add(dynamic_cast<const ExpressionStatement*>(node)->Expression);
+	}
+	else if (node->IsThisA<ReturnStatement>())
+	{
+		add(dynamic_cast<const ReturnStatement*>(node)->ReturnValue);
+	}
+	else if (node->IsThisA<LetStatement>())
+	{
+		auto* let = dynamic_cast<const LetStatement*>(node);
+		add(let->Name);
+		add(let->Value);
+	}
+	else if (node->IsThisA<PrefixExpression>())
+	{
+		add(dynamic_cast<const PrefixExpression*>(node)->Right);
+	}
+	else if (node->IsThisA<InfixExpression>())
+	{
+		auto* infix = dynamic_cast<const InfixExpression*>(node);
+		add(infix->Left);
+		add(infix->Right);
+	}
+	else if (node->IsThisA<IfStatement>())
+	{
+		auto* ifStmt = dynamic_cast<const IfStatement*>(node);
+		add(ifStmt->Condition);
+		add(ifStmt->Consequence);
+		add(ifStmt->Alternative);
+	}
+	else if (node->IsThisA<FunctionLiteral>())
+	{
+		auto* function = dynamic_cast<const FunctionLiteral*>(node);
+		for (auto* param : function->Parameters)
+		{
+			add(param);
+		}
+		add(function->Body);
+	}
+	else if (node->IsThisA<CallExpression>())
+	{
+		auto* call = dynamic_cast<const CallExpression*>(node);
+		add(call->Function);
+		for (auto* arg : call->Arguments)
+		{
+			add(arg);
+		}
+	}
+	else if (node->IsThisA<WhileStatement>())
+	{
+		auto* whileStmt = dynamic_cast<const WhileStatement*>(node);
+		add(whileStmt->Condition);
+		add(whileStmt->Action);
+	}
+	else if (node->IsThisA<ForStatement>())
+	{
+		auto* forStmt = dynamic_cast<const ForStatement*>(node);
+		add(forStmt->Init);
+		add(forStmt->Condition);
+		add(forStmt->Post);
+		add(forStmt->Action);
+	}
+	else if (node->IsThisA<ForInStatement>())
+	{
+		auto* forIn = dynamic_cast<const ForInStatement*>(node);
+		add(forIn->Name);
+		add(forIn->Iterable);
+		add(forIn->Action);
+	}
+	else if (node->IsThisA<YieldExpression>())
+	{
+		add(dynamic_cast<const YieldExpression*>(node)->Value);
+	}
+	else if (node->IsThisA<ArrayLiteral>())
+	{
+		for (auto* elem : dynamic_cast<const ArrayLiteral*>(node)->Elements)
+		{
+			add(elem);
+		}
+	}
+	else if (node->IsThisA<HashLiteral>())
+	{
+		for (auto& [key, value] : dynamic_cast<const HashLiteral*>(node)->Elements)
+		{
+			add(key);
+			add(value);
+		}
+	}
+	else if (node->IsThisA<IndexExpression>())
+	{
+		auto* index = dynamic_cast<const IndexExpression*>(node);
+		add(index->Left);
+		add(index->Index);
+	}
+	return children;
+}
+
+void AstAnalysis::Walk(const INode* node, const std::function<void(const INode*)>& visit)
+{
+	if (node == nullptr)
+	{
+		return;
+	}
+
+	visit(node);
+	for (auto* child : Children(node))
+	{
+		Walk(child, visit);
+	}
+}
+
+uint32_t AstAnalysis::NodeCount(const INode* node)
+{
+	uint32_t count = 0;
+	Walk(node, [&count](const INode*) { count++; });
+	return count;
+}
+
+std::unordered_map<std::string, uint32_t> AstAnalysis::AssignmentCounts(const INode* root)
+{
+	std::unordered_map<std::string, uint32_t> counts;
+	Walk(root, [&counts](const INode* node)
+	{
+		if (node->IsThisA<LetStatement>())
+		{
+			auto* let = dynamic_cast<const LetStatement*>(node);
+			if (let->Name->IsThisA<Identifier>())
+			{
+				counts[dynamic_cast<const Identifier*>(let->Name)->Value]++;
+			}
+			else if (let->Name->IsThisA<IndexExpression>())
+			{
+				auto* index = dynamic_cast<const IndexExpression*>(let->Name);
+				if (index->Left->IsThisA<Identifier>())
+				{
+					counts[dynamic_cast<const Identifier*>(index->Left)->Value]++;
+				}
+			}
+		}
+		else if (node->IsThisA<ForInStatement>())
+		{
+			//the loop variable is bound again on every iteration
+			auto* forIn = dynamic_cast<const ForInStatement*>(node);
+			if (forIn->Name->IsThisA<Identifier>())
+			{
+				counts[dynamic_cast<const Identifier*>(forIn->Name)->Value] += 2;
+			}
+		}
+		else if (node->IsThisA<FunctionLiteral>())
+		{
+			for (auto* param : dynamic_cast<const FunctionLiteral*>(node)->Parameters)
+			{
+				if (param->IsThisA<Identifier>())
+				{
+					counts[dynamic_cast<const Identifier*>(param)->Value]++;
+				}
+			}
+		}
+	});
+	return counts;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <StandardLib.h>
+#include <AstNode.h>
+
+class AstAnalysis
+{
+public:
+	//direct children of a node, in source order
+	static std::vector<const INode*> Children(const INode* node);
+
+	//pre-order walk of the node and all of its descendants, including nested function bodies
+	static void Walk(const INode* node, const std::function<void(const INode*)>& visit);
+
+	static uint32_t NodeCount(const INode* node);
+
+	//number of times each name is bound by a let, an index assignment or a function parameter
+	static std::unordered_map<std::string, uint32_t> AssignmentCounts(const INode* root);
+};
@@ -189,7 +189,7 @@ void BooleanLiteral::Compile(Compiler* compiler) const
 	compiler->NodeCompile(this);
 }
 
-HashLiteral::HashLiteral(const RSToken& token, const std::map<IExpression*, IExpression*>& pairs) : IExpression(token), Elements(pairs)
+HashLiteral::HashLiteral(const RSToken& token, const std::vector<std::pair<IExpression*, IExpression*>>& pairs) : IExpression(token), Elements(pairs)
 {
 	SetUniqueId(this);
 }
@@ -346,6 +346,10 @@ std::string FunctionLiteral::ToString() const
 {
 	std::string result;
 	result.append(TokenLiteral());
+	if (IsGenerator)
+	{
+		result.append("*");
+	}
 	result.append("(");
 	std::for_each(Parameters.begin(), Parameters.end(), [&result](const auto& param)
 	{
@@ -353,9 +357,12 @@ std::string FunctionLiteral::ToString() const
 		result.append(", ");
 	});
 
-	//remove the last comma
-	result.pop_back();
-	result.pop_back();
+	if (Parameters.size() > 0)
+	{
+		//remove the last comma
+		result.pop_back();
+		result.pop_back();
+	}
 
 	result.append(")");
 	result.append(Body->ToString());
@@ -505,6 +512,56 @@ void ForStatement::Compile(Compiler* compiler) const
 	compiler->NodeCompile(this);
 }
 
+ForInStatement::ForInStatement(const RSToken& token, const IExpression* name, const IExpression* iterable, const IStatement* action) : IStatement(token), Name(name), Iterable(iterable), Action(action)
+{
+	SetUniqueId(this);
+}
+
+std::string ForInStatement::ToString() const
+{
+	std::string result;
+	result.append("for (");
+	result.append(Name->ToString());
+	result.append(" in ");
+	result.append(Iterable->ToString());
+	result.append(") ");
+	result.append(Action->ToString());
+	return result;
+}
+
+void ForInStatement::Eval(Evaluator* evaluator) const
+{
+	evaluator->NodeEval(this);
+}
+
+void ForInStatement::Compile(Compiler* compiler) const
+{
+	compiler->NodeCompile(this);
+}
+
+YieldExpression::YieldExpression(const RSToken& token, const IExpression* value) : IExpression(token), Value(value)
+{
+	SetUniqueId(this);
+}
+
+std::string YieldExpression::ToString() const
+{
+	std::string result;
+	result.append("yield ");
+	result.append(Value->ToString());
+	return result;
+}
+
+void YieldExpression::Eval(Evaluator* evaluator) const
+{
+	evaluator->NodeEval(this);
+}
+
+void YieldExpression::Compile(Compiler* compiler) const
+{
+	compiler->NodeCompile(this);
+}
+
 StringLiteral::StringLiteral(const RSToken& token, const std::string& value) : IExpression(token), Value(value)
 {
 	SetUniqueId(this);
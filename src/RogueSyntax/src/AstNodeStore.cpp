@@ -58,7 +58,7 @@ BooleanLiteral* AstNodeStore::New_BooleanLiteral(const RSToken& token, const boo
 	return node.get();
 }
 
-HashLiteral* AstNodeStore::New_HashLiteral(const RSToken& token, const std::map<IExpression*, IExpression*>& pairs)
+HashLiteral* AstNodeStore::New_HashLiteral(const RSToken& token, const std::vector<std::pair<IExpression*, IExpression*>>& pairs)
 {
 	auto node = std::make_shared<HashLiteral>(token, pairs);
 	_store.push_back(node);
@@ -135,6 +135,20 @@ ForStatement* AstNodeStore::New_ForStatement(const RSToken& token, const IStatem
 	return node.get();
 }
 
+ForInStatement* AstNodeStore::New_ForInStatement(const RSToken& token, const IExpression* name, const IExpression* iterable, const IStatement* action)
+{
+	auto node = std::make_shared<ForInStatement>(token, name, iterable, action);
+	_store.push_back(node);
+	return node.get();
+}
+
+YieldExpression* AstNodeStore::New_YieldExpression(const RSToken& token, const IExpression* value)
+{
+	auto node = std::make_shared<YieldExpression>(token, value);
+	_store.push_back(node);
+	return node.get();
+}
+
 StringLiteral* AstNodeStore::New_StringLiteral(const RSToken& token, const std::string& value)
 {
 	auto node = std::make_shared<StringLiteral>(token, value);
@@ -0,0 +1,165 @@
+#include "BoundsCheckElimination.h"
+#include "TypeInference.h"
+#include <pch.h>
+
+bool BoundsCheckEliminationPass::Run(IrFunction& function)
+{
+	auto loops = function.Loops();
+	if (loops.empty())
+	{
+		return false;
+	}
+
+	_nestedWrites = function.NestedGlobalWrites();
+	auto types = TypeInferencePass().Infer(function);
+	auto idom = function.Dominators();
+	auto changed = false;
+	for (auto& loop : loops)
+	{
+		auto guard = GuardOf(function, loop);
+		if (!guard.has_value())
+		{
+			continue;
+		}
+
+		for (auto id : loop.Blocks)
+		{
+			//only code the condition let through
+			if (!IrFunction::Dominates(idom, guard->Body, id))
+			{
+				continue;
+			}
+			auto& instrs = function.Blocks[id].Instrs;
+			for (uint32_t i = 0; i < instrs.size(); i++)
+			{
+				auto& instr = instrs[i];
+				if (instr.Dead || instr.Op != OpCode::Constants::OP_INDEX)
+				{
+					continue;
+				}
+				auto* array = function.DefOf(instr.Args[0]);
+				auto* index = function.DefOf(instr.Args[1]);
+				if (array == nullptr || array->Op != OpCode::Constants::OP_GET || array->Operands[0] != guard->Array ||
+					index == nullptr || index->Op != OpCode::Constants::OP_GET || index->Operands[0] != guard->Index ||
+					!TypeInferencePass::IsNatural(types[instr.Args[1]]))
+				{
+					continue;
+				}
+				if (Unchanged(function, loop, guard->Index, id, i) && Unchanged(function, loop, guard->Array, id, i))
+				{
+					instr.Op = OpCode::Constants::OP_INDEX_NOCHECK;
+					changed = true;
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+std::optional<BoundsCheckEliminationPass::Guard> BoundsCheckEliminationPass::GuardOf(const IrFunction& function, const IrLoop& loop) const
+{
+	//the loop runs while the condition holds, falling through into its body
+	auto& header = function.Blocks[loop.Header];
+	auto* last = header.Last();
+	if (last == nullptr || last->Op != OpCode::Constants::OP_JUMPIFZ || header.Next == IrNoBlock || !loop.Blocks.contains(header.Next) ||
+		loop.Blocks.contains(header.Target) || function.Blocks[header.Next].Preds.size() != 1)
+	{
+		return std::nullopt;
+	}
+
+	auto* condition = function.DefOf(last->Args[0]);
+	if (condition == nullptr || (condition->Op != OpCode::Constants::OP_LT && condition->Op != OpCode::Constants::OP_LT_II))
+	{
+		return std::nullopt;
+	}
+	auto* index = function.DefOf(condition->Args[0]);
+	auto* call = function.DefOf(condition->Args[1]);
+	if (index == nullptr || index->Op != OpCode::Constants::OP_GET || !function.TracksSlot(index->Operands[0], _nestedWrites, true) ||
+		call == nullptr || call->Op != OpCode::Constants::OP_CALL || call->Operands[0] != 1)
+	{
+		return std::nullopt;
+	}
+	auto* callee = function.DefOf(call->Args[0]);
+	auto* array = function.DefOf(call->Args[1]);
+	if (callee == nullptr || callee->Op != OpCode::Constants::OP_GET || GetTypeFromIdx(callee->Operands[0]) != ScopeType::SCOPE_EXTERN ||
+		array == nullptr || array->Op != OpCode::Constants::OP_GET || !function.TracksSlot(array->Operands[0], _nestedWrites, true))
+	{
+		return std::nullopt;
+	}
+	auto idx = static_cast<size_t>(AdjustIdx(callee->Operands[0]));
+	if (idx >= function.LengthExterns.size() || !function.LengthExterns[idx])
+	{
+		return std::nullopt;
+	}
+
+	//a store in the header itself could come after the check
+	Guard guard{ index->Operands[0], array->Operands[0], header.Next };
+	for (auto& instr : header.Instrs)
+	{
+		if (!instr.Dead && (Stores(instr, guard.Index) || Stores(instr, guard.Array)))
+		{
+			return std::nullopt;
+		}
+	}
+	return guard;
+}
+
+bool BoundsCheckEliminationPass::Unchanged(const IrFunction& function, const IrLoop& loop, uint32_t slot, uint32_t block, uint32_t index) const
+{
+	if (GetTypeFromIdx(slot) == ScopeType::SCOPE_FREE)
+	{
+		return true;
+	}
+
+	auto& instrs = function.Blocks[block].Instrs;
+	for (uint32_t i = 0; i < index; i++)
+	{
+		if (!instrs[i].Dead && Stores(instrs[i], slot))
+		{
+			return false;
+		}
+	}
+
+	//a store anywhere else in the loop counts when the block can run after it before the condition is checked again
+	for (auto id : loop.Blocks)
+	{
+		if (id == loop.Header || !std::ranges::any_of(function.Blocks[id].Instrs, [slot](const IrInstr& instr) { return !instr.Dead && Stores(instr, slot); }))
+		{
+			continue;
+		}
+		if (Reaches(function, loop, id, block))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool BoundsCheckEliminationPass::Reaches(const IrFunction& function, const IrLoop& loop, uint32_t from, uint32_t block)
+{
+	std::set<uint32_t> visited;
+	std::vector<uint32_t> pending = function.Blocks[from].Succs();
+	while (!pending.empty())
+	{
+		auto id = pending.back();
+		pending.pop_back();
+		if (id == block)
+		{
+			return true;
+		}
+		if (id == loop.Header || !loop.Blocks.contains(id) || !visited.insert(id).second)
+		{
+			continue;
+		}
+		for (auto succ : function.Blocks[id].Succs())
+		{
+			pending.push_back(succ);
+		}
+	}
+	return false;
+}
+
+bool BoundsCheckEliminationPass::Stores(const IrInstr& instr, uint32_t slot)
+{
+	return (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN) && instr.Operands[0] == slot;
+}
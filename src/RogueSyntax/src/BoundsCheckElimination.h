@@ -0,0 +1,31 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//an `arr[j]` in the body of a `while (j < len(arr))` loop is in bounds when j is never negative and nothing stores to
+//j or arr between the condition and the index, those indexes become OP_INDEX_NOCHECK
+class BoundsCheckEliminationPass : public IrPass
+{
+public:
+	std::string Name() const override { return "bounds check elimination"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	//the slots a loop condition compares, and the block it falls through to while the index is below the length
+	struct Guard
+	{
+		uint32_t Index;
+		uint32_t Array;
+		uint32_t Body;
+	};
+
+	std::optional<Guard> GuardOf(const IrFunction& function, const IrLoop& loop) const;
+	//no store to the slot runs between the check in the header and the instruction
+	bool Unchanged(const IrFunction& function, const IrLoop& loop, uint32_t slot, uint32_t block, uint32_t index) const;
+	//the block runs again after `from` without going back through the header
+	static bool Reaches(const IrFunction& function, const IrLoop& loop, uint32_t from, uint32_t block);
+	static bool Stores(const IrInstr& instr, uint32_t slot);
+
+	//IrFunction::NestedGlobalWrites of the function being optimized
+	std::unordered_map<uint32_t, uint32_t> _nestedWrites;
+};
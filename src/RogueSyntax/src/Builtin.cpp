@@ -1,36 +1,85 @@
 #include "pch.h"
+#include "TypedArrays.h"
 #include <iostream>
+#include <numeric>
 
-BuiltIn::BuiltIn(const std::shared_ptr<ObjectFactory> factory) : _factory(factory)
+BuiltIn::BuiltIn(const std::shared_ptr<ObjectFactory> factory) : _builtins(std::make_shared<FunctionTable>()), _factory(factory)
 {
-	RegisterBuiltIn("len", std::bind(&BuiltIn::Len, this, std::placeholders::_1, std::placeholders::_2));
-	RegisterBuiltIn("first", std::bind(&BuiltIn::First, this, std::placeholders::_1, std::placeholders::_2));
-	RegisterBuiltIn("last", std::bind(&BuiltIn::Last, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("len", std::bind(&BuiltIn::Len, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("first", std::bind(&BuiltIn::First, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("last", std::bind(&BuiltIn::Last, this, std::placeholders::_1, std::placeholders::_2), true);
 	RegisterBuiltIn("rest", std::bind(&BuiltIn::Rest, this, std::placeholders::_1, std::placeholders::_2));
 	RegisterBuiltIn("push", std::bind(&BuiltIn::Push, this, std::placeholders::_1, std::placeholders::_2));
 	RegisterBuiltIn("printLine", std::bind(&BuiltIn::PrintLine, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("yield", std::bind(&BuiltIn::Yield, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("wait", std::bind(&BuiltIn::Wait, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("pmap", std::bind(&BuiltIn::PMap, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("pfilter", std::bind(&BuiltIn::PFilter, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("preduce", std::bind(&BuiltIn::PReduce, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("spawn", std::bind(&BuiltIn::Spawn, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("await", std::bind(&BuiltIn::Await, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("channel", std::bind(&BuiltIn::MakeChannel, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("send", std::bind(&BuiltIn::Send, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("recv", std::bind(&BuiltIn::Recv, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("close", std::bind(&BuiltIn::Close, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("range", std::bind(&BuiltIn::Range, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("intArray", std::bind(&BuiltIn::IntArray, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("decimalArray", std::bind(&BuiltIn::DecimalArray, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("toArray", std::bind(&BuiltIn::ToArray, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("sum", std::bind(&BuiltIn::Sum, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("min", std::bind(&BuiltIn::Min, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("max", std::bind(&BuiltIn::Max, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("dot", std::bind(&BuiltIn::Dot, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("scale", std::bind(&BuiltIn::Scale, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("sort", std::bind(&BuiltIn::Sort, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("map", std::bind(&BuiltIn::Map, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("filter", std::bind(&BuiltIn::Filter, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("reduce", std::bind(&BuiltIn::Reduce, this, std::placeholders::_1, std::placeholders::_2));
+	RegisterBuiltIn("indexOf", std::bind(&BuiltIn::IndexOf, this, std::placeholders::_1, std::placeholders::_2), true);
+	RegisterBuiltIn("reverse", std::bind(&BuiltIn::Reverse, this, std::placeholders::_1, std::placeholders::_2));
+
+	//results the compiler can type without running the call
+	_returnTypes[BuiltInIdx("len")] = typeid(IntegerObj).hash_code();
+	_returnTypes[BuiltInIdx("indexOf")] = typeid(IntegerObj).hash_code();
+	_length[BuiltInIdx("len")] = true;
+
+	//arguments the call is done with when it returns, callbacks only ever see the elements
+	for (auto& [name, count] : std::initializer_list<std::pair<std::string, std::size_t>>{ { "len", 1 }, { "first", 1 }, { "last", 1 }, { "rest", 1 },
+		{ "reverse", 1 }, { "indexOf", 2 }, { "map", 2 }, { "filter", 2 }, { "sort", 2 }, { "reduce", 2 }, { "printLine", std::numeric_limits<std::size_t>::max() } })
+	{
+		_borrowedArgs[BuiltInIdx(name)] = count;
+	}
 }
 
 std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::GetBuiltInFunction(const std::string& name)
 {
-	auto it = std::find(_builtinNames.begin(), _builtinNames.end(), name);
-	if (it != _builtinNames.end())
+	return GetBuiltInFunction(BuiltInIdx(name));
+}
+
+std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::GetBuiltInFunction(const int idx)
+{
+	auto builtins = Functions();
+	if (idx < 0 || idx >= builtins->size())
 	{
-		auto idx = std::distance(_builtinNames.begin(), it);
-		auto function = _builtins[idx];
-		return Caller(function);
+		return nullptr;
 	}
-	return nullptr;
+	return Caller((*builtins)[idx]);
 }
 
-std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::GetBuiltInFunction(const int idx)
+std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::GetBuiltInFunction(const int idx, const ObjectFactory* factory)
 {
-	if (idx < 0 || idx >= _builtins.size())
+	auto builtins = Functions();
+	if (idx < 0 || idx >= builtins->size())
 	{
 		return nullptr;
 	}
-	auto function = _builtins[idx];
-	return Caller(function);
+	return std::bind((*builtins)[idx], factory, std::placeholders::_1);
+}
+
+std::shared_ptr<const BuiltIn::FunctionTable> BuiltIn::Functions() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _builtins;
 }
 
 std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::Caller(std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func)
@@ -39,23 +88,82 @@ std::function<IObject* (const std::vector<const IObject*>& args)> BuiltIn::Calle
 	return std::bind(func, _factory.get(), std::placeholders::_1);
 }
 
-void BuiltIn::RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func)
+void BuiltIn::RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func, bool pure)
 {
-	if (GetBuiltInFunction(name) != nullptr)
+	std::lock_guard<std::mutex> lock(_lock);
+
+	//copy on write - callers holding the previous table keep using it undisturbed
+	auto builtins = std::make_shared<FunctionTable>(*_builtins);
+	auto it = std::find(_builtinNames.begin(), _builtinNames.end(), name);
+	if (it != _builtinNames.end())
 	{
 		//override
-		auto it = std::find(_builtinNames.begin(), _builtinNames.end(), name);
 		auto idx = std::distance(_builtinNames.begin(), it);
-		_builtins[idx] = func;
+		(*builtins)[idx] = func;
+		_pure[idx] = pure;
+		_returnTypes[idx] = 0;
+		_borrowedArgs[idx] = 0;
+		_length[idx] = false;
 	}
 	else
 	{
 		_builtinNames.push_back(name);
-		_builtins.push_back(func);
+		_pure.push_back(pure);
+		_returnTypes.push_back(0);
+		_borrowedArgs.push_back(0);
+		_length.push_back(false);
+		builtins->push_back(func);
 	}
+	_builtins = builtins;
 
 	//sanity check
-	assert((_builtinNames.size() == _builtins.size()));
+	assert((_builtinNames.size() == _builtins->size()));
+}
+
+bool BuiltIn::IsBuiltIn(const std::string& name) const
+{
+	return BuiltInIdx(name) != -1;
+}
+
+int BuiltIn::BuiltInIdx(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	auto it = std::find(_builtinNames.begin(), _builtinNames.end(), name);
+	if (it != _builtinNames.end())
+	{
+		return std::distance(_builtinNames.begin(), it);
+	}
+	return -1;
+}
+
+std::vector<std::string> BuiltIn::GetBuiltInNames() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _builtinNames;
+}
+
+bool BuiltIn::IsLength(const int idx) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return idx >= 0 && idx < static_cast<int>(_length.size()) && _length[idx];
+}
+
+bool BuiltIn::IsPure(const int idx) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return idx >= 0 && idx < static_cast<int>(_pure.size()) && _pure[idx];
+}
+
+std::size_t BuiltIn::ReturnType(const int idx) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return idx >= 0 && idx < static_cast<int>(_returnTypes.size()) ? _returnTypes[idx] : 0;
+}
+
+std::size_t BuiltIn::BorrowedArgs(const int idx) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return idx >= 0 && idx < static_cast<int>(_borrowedArgs.size()) ? _borrowedArgs[idx] : 0;
 }
 
 IObject* BuiltIn::Len(const ObjectFactory* factory, const std::vector<const IObject*>& args)
@@ -82,6 +190,17 @@ IObject* BuiltIn::Len(const ObjectFactory* factory, const std::vector<const IObj
 		auto hash = dynamic_cast<const HashObj*>(args[0]);
 		return factory->New<IntegerObj>(hash->Elements.size());
 	}
+
+	if (args[0]->IsThisA<RangeObj>())
+	{
+		auto range = dynamic_cast<const RangeObj*>(args[0]);
+		return factory->New<IntegerObj>(static_cast<int>(range->Count()));
+	}
+
+	if (TypedArrays::IsTypedArray(args[0]))
+	{
+		return factory->New<IntegerObj>(static_cast<int>(TypedArrays::Size(args[0])));
+	}
 	throw std::runtime_error(std::format("argument to `len` not supported, got {}", args[0]->TypeName()));
 }
 
@@ -183,3 +302,678 @@ IObject* BuiltIn::PrintLine(const ObjectFactory* factory, const std::vector<cons
 	return VoidObj::VOID_OBJ_REF;
 }
 
+IObject* BuiltIn::Yield(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 0)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 0));
+	}
+	return factory->New<YieldObj>(0);
+}
+
+IObject* BuiltIn::Wait(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+
+	if (!args[0]->IsThisA<IntegerObj>() || dynamic_cast<const IntegerObj*>(args[0])->Value < 0)
+	{
+		throw std::runtime_error("argument to `wait` must be a non-negative INTEGER");
+	}
+	return factory->New<YieldObj>(dynamic_cast<const IntegerObj*>(args[0])->Value);
+}
+
+IObject* BuiltIn::Range(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() < 1 || args.size() > 3)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted=1..3", args.size()));
+	}
+
+	std::vector<int> bounds;
+	for (auto* arg : args)
+	{
+		if (!arg->IsThisA<IntegerObj>())
+		{
+			throw std::runtime_error(std::format("argument to `range` must be INTEGER, got {}", arg->TypeName()));
+		}
+		bounds.push_back(dynamic_cast<const IntegerObj*>(arg)->Value);
+	}
+
+	auto start = bounds.size() > 1 ? bounds[0] : 0;
+	auto end = bounds.size() > 1 ? bounds[1] : bounds[0];
+	auto step = bounds.size() > 2 ? bounds[2] : 1;
+	if (step == 0)
+	{
+		throw std::runtime_error("range step must not be zero");
+	}
+	return factory->New<RangeObj>(start, end, step);
+}
+
+IObject* BuiltIn::IntArray(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+	return TypedArrays::MakeInt(factory, args[0]);
+}
+
+IObject* BuiltIn::DecimalArray(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+	return TypedArrays::MakeDecimal(factory, args[0]);
+}
+
+static void TypedArrayArgs(const std::string& name, const std::vector<const IObject*>& args, size_t wanted)
+{
+	if (args.size() != wanted)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), wanted));
+	}
+
+	if (!TypedArrays::IsTypedArray(args[0]))
+	{
+		throw std::runtime_error(std::format("argument to `{}` must be a typed array, got {}", name, args[0]->TypeName()));
+	}
+}
+
+IObject* BuiltIn::ToArray(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	TypedArrayArgs("toArray", args, 1);
+
+	auto size = TypedArrays::Size(args[0]);
+	std::vector<const IObject*> elements;
+	elements.reserve(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		elements.push_back(TypedArrays::At(factory, args[0], i));
+	}
+	return factory->New<ArrayObj>(elements);
+}
+
+IObject* BuiltIn::Sum(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	TypedArrayArgs("sum", args, 1);
+
+	auto& kernels = SimdKernels::Table();
+	if (args[0]->IsThisA<IntArrayObj>())
+	{
+		auto& values = dynamic_cast<const IntArrayObj*>(args[0])->Values;
+		return factory->New<IntegerObj>(kernels.SumInt(values.data(), values.size()));
+	}
+	auto& values = dynamic_cast<const DecimalArrayObj*>(args[0])->Values;
+	return factory->New<DecimalObj>(kernels.SumDecimal(values.data(), values.size()));
+}
+
+static IObject* Extreme(const ObjectFactory* factory, const std::string& name, const std::vector<const IObject*>& args, bool isMin)
+{
+	TypedArrayArgs(name, args, 1);
+	if (TypedArrays::Size(args[0]) == 0)
+	{
+		throw std::runtime_error(std::format("argument to `{}` must not be empty", name));
+	}
+
+	auto& kernels = SimdKernels::Table();
+	if (args[0]->IsThisA<IntArrayObj>())
+	{
+		auto& values = dynamic_cast<const IntArrayObj*>(args[0])->Values;
+		return factory->New<IntegerObj>((isMin ? kernels.MinInt : kernels.MaxInt)(values.data(), values.size()));
+	}
+	auto& values = dynamic_cast<const DecimalArrayObj*>(args[0])->Values;
+	return factory->New<DecimalObj>((isMin ? kernels.MinDecimal : kernels.MaxDecimal)(values.data(), values.size()));
+}
+
+IObject* BuiltIn::Min(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	return Extreme(factory, "min", args, true);
+}
+
+IObject* BuiltIn::Max(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	return Extreme(factory, "max", args, false);
+}
+
+IObject* BuiltIn::Dot(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	TypedArrayArgs("dot", args, 2);
+	if (args[0]->Type() != args[1]->Type())
+	{
+		throw std::runtime_error(std::format("arguments to `dot` must be the same kind of typed array, got {} {}", args[0]->TypeName(), args[1]->TypeName()));
+	}
+	if (TypedArrays::Size(args[0]) != TypedArrays::Size(args[1]))
+	{
+		throw std::runtime_error(std::format("typed array lengths differ. got={} and {}", TypedArrays::Size(args[0]), TypedArrays::Size(args[1])));
+	}
+
+	auto& kernels = SimdKernels::Table();
+	if (args[0]->IsThisA<IntArrayObj>())
+	{
+		auto& a = dynamic_cast<const IntArrayObj*>(args[0])->Values;
+		auto& b = dynamic_cast<const IntArrayObj*>(args[1])->Values;
+		return factory->New<IntegerObj>(kernels.DotInt(a.data(), b.data(), a.size()));
+	}
+	auto& a = dynamic_cast<const DecimalArrayObj*>(args[0])->Values;
+	auto& b = dynamic_cast<const DecimalArrayObj*>(args[1])->Values;
+	return factory->New<DecimalObj>(kernels.DotDecimal(a.data(), b.data(), a.size()));
+}
+
+IObject* BuiltIn::Scale(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	TypedArrayArgs("scale", args, 2);
+	return TypedArrays::Arithmetic(factory, VectorOp::Mul, args[0], args[1]);
+}
+
+static RogueVM* ParallelArgs(const std::string& name, const std::vector<const IObject*>& args, size_t minArgs, size_t maxArgs)
+{
+	if (args.size() < minArgs || args.size() > maxArgs)
+	{
+		auto wanted = minArgs == maxArgs ? std::to_string(minArgs) : std::format("{}..{}", minArgs, maxArgs);
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), wanted));
+	}
+
+	if (!args[0]->IsThisA<ArrayObj>())
+	{
+		throw std::runtime_error(std::format("argument to `{}` must be ARRAY, got {}", name, args[0]->TypeName()));
+	}
+
+	if (!args[1]->IsThisA<ClosureObj>() && !args[1]->IsThisA<BuiltInObj>())
+	{
+		throw std::runtime_error(std::format("second argument to `{}` must be a function, got {}", name, args[1]->TypeName()));
+	}
+
+	auto vm = RogueVM::Active();
+	if (vm == nullptr)
+	{
+		throw std::runtime_error(std::format("`{}` can only be called from the vm", name));
+	}
+	return vm;
+}
+
+//inputs are {array, function, initial} - read them again after every call, a collection can move them
+static const IObject* Element(const std::vector<const IObject*>& inputs, size_t idx)
+{
+	return dynamic_cast<const ArrayObj*>(inputs[0])->Elements[idx];
+}
+
+IObject* BuiltIn::PMap(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto vm = ParallelArgs("pmap", args, 2, 2);
+	auto count = dynamic_cast<const ArrayObj*>(args[0])->Elements.size();
+	auto results = vm->ParallelChunks(args, count, [](RogueVM& worker, const std::vector<const IObject*>& inputs, size_t begin, size_t end, std::vector<const IObject*>& output)
+	{
+		output.reserve(end - begin);
+		for (size_t i = begin; i < end; i++)
+		{
+			output.push_back(worker.Call(inputs[1], { Element(inputs, i) }));
+		}
+	});
+	return factory->New<ArrayObj>(results);
+}
+
+IObject* BuiltIn::PFilter(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto vm = ParallelArgs("pfilter", args, 2, 2);
+	auto count = dynamic_cast<const ArrayObj*>(args[0])->Elements.size();
+	auto results = vm->ParallelChunks(args, count, [](RogueVM& worker, const std::vector<const IObject*>& inputs, size_t begin, size_t end, std::vector<const IObject*>& output)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (worker.IsTruthy(worker.Call(inputs[1], { Element(inputs, i) })))
+			{
+				output.push_back(Element(inputs, i));
+			}
+		}
+	});
+	return factory->New<ArrayObj>(results);
+}
+
+IObject* BuiltIn::PReduce(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto vm = ParallelArgs("preduce", args, 2, 3);
+	auto count = dynamic_cast<const ArrayObj*>(args[0])->Elements.size();
+	auto result = vm->ParallelChunks(args, count, [](RogueVM& worker, const std::vector<const IObject*>& inputs, size_t begin, size_t end, std::vector<const IObject*>& output)
+	{
+		output.push_back(Element(inputs, begin));
+		for (size_t i = begin + 1; i < end; i++)
+		{
+			output[0] = worker.Call(inputs[1], { output[0], Element(inputs, i) });
+		}
+	},
+	[](RogueVM& caller, const std::vector<const IObject*>& inputs, std::vector<const IObject*>& partials)
+	{
+		//fold the chunk results in order, the initial value goes first
+		if (inputs.size() == 3)
+		{
+			partials.insert(partials.begin(), inputs[2]);
+		}
+		for (size_t i = 1; i < partials.size(); i++)
+		{
+			partials[0] = caller.Call(inputs[1], { partials[0], partials[i] });
+		}
+		partials.resize(std::min<size_t>(partials.size(), 1));
+	});
+	return result.empty() ? NullObj::NULL_OBJ_REF : const_cast<IObject*>(result[0]);
+}
+
+static RogueVM* ActiveVm(const std::string& name)
+{
+	auto vm = RogueVM::Active();
+	if (vm == nullptr)
+	{
+		throw std::runtime_error(std::format("`{}` can only be called from the vm", name));
+	}
+	return vm;
+}
+
+static std::shared_ptr<Channel> ChannelArg(const std::string& name, const std::vector<const IObject*>& args, size_t wanted)
+{
+	if (args.size() != wanted)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), wanted));
+	}
+
+	if (!args[0]->IsThisA<ChannelObj>())
+	{
+		throw std::runtime_error(std::format("argument to `{}` must be CHANNEL, got {}", name, args[0]->TypeName()));
+	}
+	return dynamic_cast<const ChannelObj*>(args[0])->Value;
+}
+
+IObject* BuiltIn::Spawn(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() < 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+
+	if (!args[0]->IsThisA<ClosureObj>())
+	{
+		throw std::runtime_error(std::format("first argument to `spawn` must be a function, got {}", args[0]->TypeName()));
+	}
+
+	auto vm = ActiveVm("spawn");
+	//spawning collects the nursery, args must not be read after this
+	auto task = vm->Spawn(dynamic_cast<const ClosureObj*>(args[0]), std::vector<const IObject*>(args.begin() + 1, args.end()));
+	return factory->New<TaskObj>(task);
+}
+
+IObject* BuiltIn::Await(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+
+	if (!args[0]->IsThisA<TaskObj>())
+	{
+		throw std::runtime_error(std::format("argument to `await` must be TASK, got {}", args[0]->TypeName()));
+	}
+
+	auto vm = ActiveVm("await");
+	auto task = dynamic_cast<const TaskObj*>(args[0])->Task;
+	if (!task->Join(vm->CurrentTask()))
+	{
+		return factory->New<YieldObj>(0, true);
+	}
+
+	if (task->Result() == nullptr)
+	{
+		throw std::runtime_error(std::format("awaited task failed: {}", task->Error()));
+	}
+	vm->Adopt(task->ResultStore());
+	return const_cast<IObject*>(task->Result());
+}
+
+IObject* BuiltIn::MakeChannel(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() > 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+
+	size_t capacity = CHANNEL_CAPACITY;
+	if (args.size() == 1)
+	{
+		if (!args[0]->IsThisA<IntegerObj>() || dynamic_cast<const IntegerObj*>(args[0])->Value < 1)
+		{
+			throw std::runtime_error("argument to `channel` must be a positive INTEGER");
+		}
+		capacity = dynamic_cast<const IntegerObj*>(args[0])->Value;
+	}
+	return factory->New<ChannelObj>(std::make_shared<Channel>(capacity));
+}
+
+IObject* BuiltIn::Send(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto channel = ChannelArg("send", args, 2);
+	auto vm = ActiveVm("send");
+	if (!channel->Send(args[1], vm->CurrentTask()))
+	{
+		return factory->New<YieldObj>(0, true);
+	}
+	return VoidObj::VOID_OBJ_REF;
+}
+
+IObject* BuiltIn::Recv(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto channel = ChannelArg("recv", args, 1);
+	auto vm = ActiveVm("recv");
+	const IObject* value = nullptr;
+	if (!channel->Receive(value, vm->CurrentTask()))
+	{
+		return factory->New<YieldObj>(0, true);
+	}
+	vm->Adopt(channel->Store());
+	return const_cast<IObject*>(value);
+}
+
+IObject* BuiltIn::Close(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto channel = ChannelArg("close", args, 1);
+	channel->Close();
+	return VoidObj::VOID_OBJ_REF;
+}
+
+//roots the vectors on the active vm while a builtin calls back into the script
+//a callback can trigger a collection, read objects from the rooted vectors again after every call
+class CallbackScope
+{
+public:
+	CallbackScope(const std::string& name, std::initializer_list<std::vector<const IObject*>*> roots) : _vm(ActiveVm(name)), _count(roots.size())
+	{
+		for (auto* root : roots)
+		{
+			_vm->PushRoots(root);
+		}
+	}
+
+	~CallbackScope()
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			_vm->PopRoots();
+		}
+	}
+
+	const IObject* Call(const IObject* callable, const std::vector<const IObject*>& args) { return _vm->Call(callable, args); }
+	bool IsTruthy(const IObject* obj) { return _vm->IsTruthy(obj); }
+
+private:
+	RogueVM* _vm;
+	size_t _count;
+};
+
+static const ArrayObj* CollectionArgs(const std::string& name, const std::vector<const IObject*>& args, size_t minArgs, size_t maxArgs, bool callback = true)
+{
+	if (args.size() < minArgs || args.size() > maxArgs)
+	{
+		auto wanted = minArgs == maxArgs ? std::to_string(minArgs) : std::format("{}..{}", minArgs, maxArgs);
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), wanted));
+	}
+
+	if (!args[0]->IsThisA<ArrayObj>())
+	{
+		throw std::runtime_error(std::format("argument to `{}` must be ARRAY, got {}", name, args[0]->TypeName()));
+	}
+
+	if (callback && args.size() > 1 && !args[1]->IsThisA<ClosureObj>() && !args[1]->IsThisA<BuiltInObj>())
+	{
+		throw std::runtime_error(std::format("second argument to `{}` must be a function, got {}", name, args[1]->TypeName()));
+	}
+	return dynamic_cast<const ArrayObj*>(args[0]);
+}
+
+//stable bottom-up merge sort over positions, a script comparator that is not a strict weak order only gives an odd order
+template <typename Less>
+static void MergeSort(std::vector<size_t>& order, Less less)
+{
+	std::vector<size_t> merged(order.size());
+	for (size_t width = 1; width < order.size(); width *= 2)
+	{
+		for (size_t lo = 0; lo < order.size(); lo += 2 * width)
+		{
+			auto mid = std::min(lo + width, order.size());
+			auto hi = std::min(lo + 2 * width, order.size());
+			auto i = lo;
+			auto j = mid;
+			auto k = lo;
+			while (i < mid && j < hi)
+			{
+				merged[k++] = less(order[j], order[i]) ? order[j++] : order[i++];
+			}
+			while (i < mid)
+			{
+				merged[k++] = order[i++];
+			}
+			while (j < hi)
+			{
+				merged[k++] = order[j++];
+			}
+		}
+		order.swap(merged);
+	}
+}
+
+//elements in natural order with std::sort, the keys are pulled out once so comparisons never touch the objects
+static std::vector<const IObject*> SortNatural(const std::vector<const IObject*>& elements)
+{
+	auto all = [&elements](auto&& pred) { return std::all_of(elements.begin(), elements.end(), pred); };
+
+	if (all([](const IObject* obj) { return obj->IsThisA<IntegerObj>(); }))
+	{
+		std::vector<std::pair<int32_t, const IObject*>> keyed;
+		keyed.reserve(elements.size());
+		for (auto* obj : elements)
+		{
+			keyed.emplace_back(static_cast<const IntegerObj*>(obj)->Value, obj);
+		}
+		std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		std::vector<const IObject*> sorted;
+		sorted.reserve(keyed.size());
+		std::transform(keyed.begin(), keyed.end(), std::back_inserter(sorted), [](const auto& entry) { return entry.second; });
+		return sorted;
+	}
+
+	if (all([](const IObject* obj) { return obj->IsThisA<IntegerObj>() || obj->IsThisA<DecimalObj>(); }))
+	{
+		std::vector<std::pair<double, const IObject*>> keyed;
+		keyed.reserve(elements.size());
+		for (auto* obj : elements)
+		{
+			auto key = obj->IsThisA<IntegerObj>() ? static_cast<double>(static_cast<const IntegerObj*>(obj)->Value) : static_cast<const DecimalObj*>(obj)->Value;
+			keyed.emplace_back(key, obj);
+		}
+		//nan sorts last, std::sort needs a strict weak order
+		std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return std::isnan(b.first) ? !std::isnan(a.first) : a.first < b.first; });
+
+		std::vector<const IObject*> sorted;
+		sorted.reserve(keyed.size());
+		std::transform(keyed.begin(), keyed.end(), std::back_inserter(sorted), [](const auto& entry) { return entry.second; });
+		return sorted;
+	}
+
+	if (all([](const IObject* obj) { return obj->IsThisA<StringObj>(); }))
+	{
+		auto sorted = elements;
+		std::sort(sorted.begin(), sorted.end(), [](const IObject* a, const IObject* b) { return static_cast<const StringObj*>(a)->Value < static_cast<const StringObj*>(b)->Value; });
+		return sorted;
+	}
+
+	auto odd = std::find_if(elements.begin(), elements.end(), [&elements](const IObject* obj) { return obj->Type() != elements[0]->Type(); });
+	auto* culprit = odd != elements.end() ? *odd : elements[0];
+	throw std::runtime_error(std::format("`sort` without a comparator needs numbers or strings, got {}", culprit->TypeName()));
+}
+
+IObject* BuiltIn::Sort(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() == 1 && TypedArrays::IsTypedArray(args[0]))
+	{
+		if (args[0]->IsThisA<IntArrayObj>())
+		{
+			auto values = dynamic_cast<const IntArrayObj*>(args[0])->Values;
+			std::sort(values.begin(), values.end());
+			return factory->New<IntArrayObj>(std::move(values));
+		}
+		auto values = dynamic_cast<const DecimalArrayObj*>(args[0])->Values;
+		std::sort(values.begin(), values.end(), [](float a, float b) { return std::isnan(b) ? !std::isnan(a) : a < b; });
+		return factory->New<DecimalArrayObj>(std::move(values));
+	}
+
+	auto arr = CollectionArgs("sort", args, 1, 2);
+	if (args.size() == 1 || arr->Elements.size() < 2)
+	{
+		return factory->New<ArrayObj>(args.size() == 1 ? SortNatural(arr->Elements) : arr->Elements);
+	}
+
+	//the comparator returns true or a negative integer when its first argument goes first
+	std::vector<const IObject*> items = arr->Elements;
+	std::vector<const IObject*> callable{ args[1] };
+	CallbackScope scope("sort", { &items, &callable });
+
+	std::vector<size_t> order(items.size());
+	std::iota(order.begin(), order.end(), 0);
+	MergeSort(order, [&](size_t a, size_t b)
+	{
+		auto result = scope.Call(callable[0], { items[a], items[b] });
+		if (result->IsThisA<IntegerObj>())
+		{
+			return dynamic_cast<const IntegerObj*>(result)->Value < 0;
+		}
+		return scope.IsTruthy(result);
+	});
+
+	std::vector<const IObject*> sorted;
+	sorted.reserve(order.size());
+	for (auto idx : order)
+	{
+		sorted.push_back(items[idx]);
+	}
+	return factory->New<ArrayObj>(sorted);
+}
+
+IObject* BuiltIn::Map(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto arr = CollectionArgs("map", args, 2, 2);
+	std::vector<const IObject*> items = arr->Elements;
+	std::vector<const IObject*> callable{ args[1] };
+	std::vector<const IObject*> results;
+	results.reserve(items.size());
+	CallbackScope scope("map", { &items, &callable, &results });
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		results.push_back(scope.Call(callable[0], { items[i] }));
+	}
+	return factory->New<ArrayObj>(results);
+}
+
+IObject* BuiltIn::Filter(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto arr = CollectionArgs("filter", args, 2, 2);
+	std::vector<const IObject*> items = arr->Elements;
+	std::vector<const IObject*> callable{ args[1] };
+	std::vector<const IObject*> results;
+	CallbackScope scope("filter", { &items, &callable, &results });
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (scope.IsTruthy(scope.Call(callable[0], { items[i] })))
+		{
+			results.push_back(items[i]);
+		}
+	}
+	return factory->New<ArrayObj>(results);
+}
+
+IObject* BuiltIn::Reduce(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto arr = CollectionArgs("reduce", args, 2, 3);
+	std::vector<const IObject*> items = arr->Elements;
+	std::vector<const IObject*> callable{ args[1] };
+	//without an initial value the first element starts the fold, an empty array reduces to null
+	std::vector<const IObject*> acc;
+	if (args.size() == 3)
+	{
+		acc.push_back(args[2]);
+	}
+	else if (!items.empty())
+	{
+		acc.push_back(items[0]);
+	}
+	else
+	{
+		return NullObj::NULL_OBJ_REF;
+	}
+	CallbackScope scope("reduce", { &items, &callable, &acc });
+
+	for (size_t i = args.size() == 3 ? 0 : 1; i < items.size(); i++)
+	{
+		acc[0] = scope.Call(callable[0], { acc[0], items[i] });
+	}
+	return const_cast<IObject*>(acc[0]);
+}
+
+IObject* BuiltIn::IndexOf(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	auto arr = CollectionArgs("indexOf", args, 2, 2, false);
+
+	//equal like a hash key, same type and same printed value
+	auto* value = args[1];
+	auto printed = value->Inspect();
+	for (size_t i = 0; i < arr->Elements.size(); i++)
+	{
+		auto* element = arr->Elements[i];
+		if (element == value)
+		{
+			return factory->New<IntegerObj>(static_cast<int>(i));
+		}
+		if (element->Type() != value->Type())
+		{
+			continue;
+		}
+		auto equal = element->IsThisA<IntegerObj>()
+			? static_cast<const IntegerObj*>(element)->Value == static_cast<const IntegerObj*>(value)->Value
+			: element->Inspect() == printed;
+		if (equal)
+		{
+			return factory->New<IntegerObj>(static_cast<int>(i));
+		}
+	}
+	return factory->New<IntegerObj>(-1);
+}
+
+IObject* BuiltIn::Reverse(const ObjectFactory* factory, const std::vector<const IObject*>& args)
+{
+	if (args.size() != 1)
+	{
+		throw std::runtime_error(std::format("wrong number of arguments. got={}, wanted={}", args.size(), 1));
+	}
+
+	if (args[0]->IsThisA<IntArrayObj>())
+	{
+		auto& values = dynamic_cast<const IntArrayObj*>(args[0])->Values;
+		return factory->New<IntArrayObj>(std::vector<int32_t>(values.rbegin(), values.rend()));
+	}
+
+	if (args[0]->IsThisA<DecimalArrayObj>())
+	{
+		auto& values = dynamic_cast<const DecimalArrayObj*>(args[0])->Values;
+		return factory->New<DecimalArrayObj>(std::vector<float>(values.rbegin(), values.rend()));
+	}
+
+	if (args[0]->IsThisA<StringObj>())
+	{
+		auto& value = dynamic_cast<const StringObj*>(args[0])->Value;
+		return factory->New<StringObj>(std::string(value.rbegin(), value.rend()));
+	}
+
+	auto arr = CollectionArgs("reverse", args, 1, 1);
+	return factory->New<ArrayObj>(std::vector<const IObject*>(arr->Elements.rbegin(), arr->Elements.rend()));
+}
@@ -0,0 +1,254 @@
+#include "CommonSubexpressionElimination.h"
+#include <pch.h>
+
+bool CommonSubexpressionEliminationPass::Run(IrFunction& function)
+{
+	_nestedWrites = function.NestedGlobalWrites();
+
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		while (EliminateLargest(function, id))
+		{
+			function.BuildSsa();
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool CommonSubexpressionEliminationPass::EliminateLargest(IrFunction& function, uint32_t id)
+{
+	std::unordered_map<uint32_t, std::string> keys;
+	std::unordered_map<uint32_t, uint32_t> sizes;
+	std::unordered_map<uint32_t, uint32_t> writes;
+	std::unordered_map<std::string, std::vector<uint32_t>> occurrences;
+	uint32_t epoch = 0;
+	for (auto& instr : function.Blocks[id].Instrs)
+	{
+		if (instr.Dead)
+		{
+			continue;
+		}
+		if (instr.Result != IrNoValue)
+		{
+			auto key = KeyOf(function, instr, keys, writes, epoch);
+			if (!key.empty())
+			{
+				uint32_t size = 1;
+				for (auto arg : instr.Args)
+				{
+					size += sizes[arg];
+				}
+				sizes[instr.Result] = size;
+				occurrences[key].push_back(instr.Result);
+				keys[instr.Result] = std::move(key);
+			}
+		}
+		if (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN)
+		{
+			writes[instr.Operands[0]]++;
+		}
+		if (RunsCode(function, instr))
+		{
+			epoch++;
+		}
+	}
+
+	//the whole expression is reused at once, not each of its operands
+	const std::vector<uint32_t>* largest = nullptr;
+	for (auto& [key, values] : occurrences)
+	{
+		auto size = sizes[values.front()];
+		if (values.size() < 2 || size < 3)
+		{
+			continue;
+		}
+		//storing a row of a nested array copies the whole row, indexing it again is cheaper
+		auto& uses = function.Value(values.front()).Uses;
+		auto& first = function.Blocks[id].Instrs[function.Value(values.front()).Index];
+		if (IsIndex(first.Op) && uses.size() == 1 && !uses[0].IsPhi)
+		{
+			auto& user = function.Blocks[uses[0].Block].Instrs[uses[0].Index];
+			if (IsIndex(user.Op) && user.Args[0] == values.front())
+			{
+				continue;
+			}
+		}
+		if (largest == nullptr || size > sizes[largest->front()] || (size == sizes[largest->front()] && values.front() < largest->front()))
+		{
+			largest = &values;
+		}
+	}
+	if (largest == nullptr)
+	{
+		return false;
+	}
+
+	Eliminate(function, id, *largest);
+	return true;
+}
+
+void CommonSubexpressionEliminationPass::Eliminate(IrFunction& function, uint32_t id, const std::vector<uint32_t>& occurrences)
+{
+	auto first = function.Value(occurrences.front()).Index;
+	auto last = function.Value(occurrences.back()).Index;
+
+	//`let t = arr[j]` followed by more `arr[j]` loads t, anything else stores the first result in a new slot
+	std::optional<uint32_t> slot;
+	auto& uses = function.Value(occurrences.front()).Uses;
+	if (uses.size() == 1 && !uses[0].IsPhi && uses[0].Index < function.Value(occurrences[1]).Index)
+	{
+		auto& user = function.Blocks[id].Instrs[uses[0].Index];
+		if (user.Op == OpCode::Constants::OP_SET && Holds(function, id, user.Operands[0], uses[0].Index, last))
+		{
+			slot = user.Operands[0];
+		}
+	}
+	auto store = !slot.has_value();
+	if (store)
+	{
+		slot = function.AddSlot();
+	}
+
+	for (auto it = occurrences.begin() + 1; it != occurrences.end(); ++it)
+	{
+		auto& instr = function.Blocks[id].Instrs[function.Value(*it).Index];
+		for (auto arg : instr.Args)
+		{
+			Remove(function, arg);
+		}
+		instr.Op = OpCode::Constants::OP_GET;
+		instr.Operands = { *slot };
+		instr.Data.clear();
+	}
+
+	if (store)
+	{
+		IrInstr set;
+		set.Op = OpCode::Constants::OP_SET;
+		set.Operands = { *slot };
+		IrInstr get;
+		get.Op = OpCode::Constants::OP_GET;
+		get.Operands = { *slot };
+		auto& instrs = function.Blocks[id].Instrs;
+		instrs.insert(instrs.begin() + first + 1, { set, get });
+	}
+}
+
+std::string CommonSubexpressionEliminationPass::KeyOf(const IrFunction& function, const IrInstr& instr, const std::unordered_map<uint32_t, std::string>& keys,
+	const std::unordered_map<uint32_t, uint32_t>& writes, uint32_t epoch) const
+{
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	case OpCode::Constants::OP_LDECIMAL:
+	case OpCode::Constants::OP_LSTRING:
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+	case OpCode::Constants::OP_NULL:
+		return std::format("{} {} {}", static_cast<int>(instr.Op), instr.Operands.empty() ? 0 : instr.Operands[0], std::string(instr.Data.begin(), instr.Data.end()));
+	case OpCode::Constants::OP_GET:
+	{
+		auto slot = instr.Operands[0];
+		auto it = writes.find(slot);
+		auto stores = it != writes.end() ? it->second : 0;
+		if (function.TracksSlot(slot, _nestedWrites, false))
+		{
+			return std::format("get {} #{}", slot, stores);
+		}
+		if (GetTypeFromIdx(slot) == ScopeType::SCOPE_GLOBAL)
+		{
+			return std::format("get {} #{} @{}", slot, stores, epoch);
+		}
+		//builtins and captured values never change while the frame runs
+		return std::format("get {}", slot);
+	}
+	case OpCode::Constants::OP_CALL:
+		if (!PureCall(function, instr))
+		{
+			return {};
+		}
+		break;
+	case OpCode::Constants::OP_INDEX:
+	case OpCode::Constants::OP_INDEX_NOCHECK:
+	case OpCode::Constants::OP_ADD_II:
+	case OpCode::Constants::OP_LT_II:
+	case OpCode::Constants::OP_CONCAT_SS:
+		break;
+	default:
+		if (instr.Op < OpCode::Constants::OP_ADD || instr.Op > OpCode::Constants::OP_BNOT)
+		{
+			return {};
+		}
+		break;
+	}
+
+	auto key = std::format("{}(", static_cast<int>(instr.Op));
+	for (auto arg : instr.Args)
+	{
+		auto it = keys.find(arg);
+		if (it == keys.end())
+		{
+			return {};
+		}
+		key += it->second + ",";
+	}
+	return key + ")";
+}
+
+bool CommonSubexpressionEliminationPass::PureCall(const IrFunction& function, const IrInstr& call)
+{
+	auto* callee = function.DefOf(call.Args[0]);
+	if (callee == nullptr || callee->Op != OpCode::Constants::OP_GET || GetTypeFromIdx(callee->Operands[0]) != ScopeType::SCOPE_EXTERN)
+	{
+		return false;
+	}
+	auto idx = static_cast<size_t>(AdjustIdx(callee->Operands[0]));
+	return idx < function.PureExterns.size() && function.PureExterns[idx];
+}
+
+bool CommonSubexpressionEliminationPass::RunsCode(const IrFunction& function, const IrInstr& instr)
+{
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_CALL:
+		return !PureCall(function, instr);
+	case OpCode::Constants::OP_YIELD:
+	case OpCode::Constants::OP_ITER_NEXT:
+	case OpCode::Constants::OP_FOR_RANGE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool CommonSubexpressionEliminationPass::Holds(const IrFunction& function, uint32_t id, uint32_t slot, uint32_t from, uint32_t to) const
+{
+	if (!function.TracksSlot(slot, _nestedWrites, false))
+	{
+		return false;
+	}
+
+	auto& instrs = function.Blocks[id].Instrs;
+	for (auto i = from + 1; i < to; i++)
+	{
+		auto& instr = instrs[i];
+		if (!instr.Dead && (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN) && instr.Operands[0] == slot)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void CommonSubexpressionEliminationPass::Remove(IrFunction& function, uint32_t value)
+{
+	auto& def = function.Value(value);
+	auto& instr = function.Blocks[def.Block].Instrs[def.Index];
+	instr.Dead = true;
+	for (auto arg : instr.Args)
+	{
+		Remove(function, arg);
+	}
+}
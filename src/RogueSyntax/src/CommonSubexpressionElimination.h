@@ -0,0 +1,32 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//computes an expression a block repeats with the same operands, like the `arr[j + 1]` of a swap, only once:
+//its first result is stored in a temporary slot (or the variable it was stored to) and the repeats load it
+class CommonSubexpressionEliminationPass : public IrPass
+{
+public:
+	std::string Name() const override { return "common subexpression elimination"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	//rewrites the largest repeated expression of the block, the repeats of its operands go with it
+	bool EliminateLargest(IrFunction& function, uint32_t id);
+	void Eliminate(IrFunction& function, uint32_t id, const std::vector<uint32_t>& occurrences);
+
+	//equal for two values of the block that always compute the same thing, empty when the value is not a candidate,
+	//loads include how often their slot was stored to before them and globals how often code ran that could store to them
+	std::string KeyOf(const IrFunction& function, const IrInstr& instr, const std::unordered_map<uint32_t, std::string>& keys,
+		const std::unordered_map<uint32_t, uint32_t>& writes, uint32_t epoch) const;
+	//a builtin marked pure, user functions can do anything
+	static bool PureCall(const IrFunction& function, const IrInstr& call);
+	static bool RunsCode(const IrFunction& function, const IrInstr& instr);
+	//the variable the first result is stored to holds it until the last repeat
+	bool Holds(const IrFunction& function, uint32_t id, uint32_t slot, uint32_t from, uint32_t to) const;
+	static void Remove(IrFunction& function, uint32_t value);
+	static bool IsIndex(OpCode::Constants opcode) { return opcode == OpCode::Constants::OP_INDEX || opcode == OpCode::Constants::OP_INDEX_NOCHECK; }
+
+	//IrFunction::NestedGlobalWrites of the function being optimized
+	std::unordered_map<uint32_t, uint32_t> _nestedWrites;
+};
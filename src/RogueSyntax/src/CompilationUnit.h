@@ -19,11 +19,15 @@ struct CompilationUnit
 	{
 	}
 
+	//context the unit was entered with, names the function in ir dumps
+	std::string Name;
 	RSInstructions UnitInstructions;
 	RSInstructions LastInstruction;
 	RSInstructions PreviousLastInstruction;
 
 	std::stack<LoopJump> LoopJumps;
+	//body of a fn*, returns finish the generator instead of returning a value
+	bool IsGenerator = false;
 
 	void SetLastInstruction(const RSInstructions& instruction);
 	int AddInstruction(RSInstructions instructions);
@@ -1,7 +1,13 @@
 #include "Compiler.h"
+#include "AstAnalysis.h"
+#include "PeepholeOptimizer.h"
 #include <pch.h>
 
-Compiler::Compiler(const std::shared_ptr<ObjectFactory> factory) : _factory(factory)
+Compiler::Compiler(const std::shared_ptr<ObjectFactory> factory) : _factory(factory), _passes(IrPassManager::Default(_options))
+{
+}
+
+Compiler::Compiler(const std::shared_ptr<ObjectFactory> factory, const CompilerOptions& options) : _factory(factory), _options(options), _passes(IrPassManager::Default(options))
 {
 }
 
@@ -15,14 +21,97 @@ ObjectCode Compiler::Compile(const std::shared_ptr<Program>&program, const std::
 	_constants.reserve(128);
 	_externals = externs;
 
-	auto& builtins = _externals->GetBuiltInNames();
+	auto builtins = _externals->GetBuiltInNames();
+	_pureExterns.assign(builtins.size(), false);
+	_externTypes.assign(builtins.size(), 0);
+	_borrowedArgs.assign(builtins.size(), 0);
+	_lengthExterns.assign(builtins.size(), false);
 	for (auto& name : builtins)
 	{
-		_symbolTable.DefineExternal(name, _externals->BuiltInIdx(name));
+		auto idx = _externals->BuiltInIdx(name);
+		_symbolTable.DefineExternal(name, idx);
+		_pureExterns[idx] = _externals->IsPure(idx);
+		_externTypes[idx] = _externals->ReturnType(idx);
+		_borrowedArgs[idx] = _externals->BorrowedArgs(idx);
+		_lengthExterns[idx] = _externals->IsLength(idx);
+	}
+
+	_inlineCandidates.clear();
+	if (_options.EnableInlining)
+	{
+		_assignmentCounts = AstAnalysis::AssignmentCounts(program.get());
 	}
 
 	Compile(program.get());
-	return ObjectCode{ _CompilationUnits.top().UnitInstructions, _symbolTable.GetSymbols(), _CompilationUnits.top().DebugSymbols};
+
+	//frame layout so the vm can size its globals and stack instead of reserving the worst case
+	uint32_t numGlobals = 0;
+	for (auto& symbol : _symbolTable.GetSymbols())
+	{
+		if (symbol.Type == ScopeType::SCOPE_GLOBAL)
+		{
+			numGlobals = std::max(numGlobals, static_cast<uint32_t>(symbol.Index + 1));
+		}
+	}
+	if (!HasErrors())
+	{
+		numGlobals = OptimizeUnit(_CompilationUnits.top(), true, numGlobals);
+	}
+	auto code = ObjectCode{ _CompilationUnits.top().UnitInstructions, _symbolTable.GetSymbols(), _CompilationUnits.top().DebugSymbols};
+	if (_options.EnablePeephole && !HasErrors())
+	{
+		PeepholeOptimizer::Run(code);
+	}
+	code.NumGlobals = numGlobals;
+	code.MaxStackDepth = MeasureStackDepth(code.Instructions, 0, code.Instructions.size(), code.Functions);
+	std::sort(code.Functions.begin(), code.Functions.end(), [](const FunctionLayout& a, const FunctionLayout& b) { return a.Offset < b.Offset; });
+	return code;
+}
+
+uint32_t Compiler::MeasureStackDepth(const RSInstructions& instructions, size_t begin, size_t end, std::vector<FunctionLayout>& functions)
+{
+	//jump targets are relative to the start of the function, first visit of an offset decides its depth
+	std::unordered_set<size_t> visited;
+	std::vector<std::pair<size_t, int>> pending{ { begin, 0 } };
+	int maxDepth = 0;
+
+	while (!pending.empty())
+	{
+		auto [offset, depth] = pending.back();
+		pending.pop_back();
+
+		while (offset < end && !visited.contains(offset))
+		{
+			visited.insert(offset);
+			auto [opcode, operands, next] = OpCode::ReadOperand(instructions, offset);
+
+			if (opcode == OpCode::Constants::OP_LSTRING)
+			{
+				next += operands[0];
+			}
+			else if (opcode == OpCode::Constants::OP_LFUN)
+			{
+				auto bodyEnd = next + operands[2];
+				auto bodyDepth = MeasureStackDepth(instructions, next, bodyEnd, functions);
+				functions.push_back(FunctionLayout{ next, operands[0], bodyDepth });
+				next = bodyEnd;
+			}
+
+			depth = std::max(0, depth + OpCode::StackEffect(opcode, operands));
+			maxDepth = std::max(maxDepth, depth);
+
+			if (opcode == OpCode::Constants::OP_JUMP)
+			{
+				next = begin + operands[0];
+			}
+			else if (opcode == OpCode::Constants::OP_JUMPIFZ || opcode == OpCode::Constants::OP_ITER_NEXT || opcode == OpCode::Constants::OP_FOR_RANGE)
+			{
+				pending.push_back({ begin + operands[0], depth });
+			}
+			offset = next;
+		}
+	}
+	return static_cast<uint32_t>(maxDepth);
 }
 
 CompilerError Compiler::Compile(INode* node)
@@ -39,7 +128,8 @@ int Compiler::EnterUnit(const std::string& context)
 {
 	_symbolTable.PushStackContext();
 	EnterScope(context);
-	_CompilationUnits.push(CompilationUnit());	
+	_CompilationUnits.push(CompilationUnit());
+	_CompilationUnits.top().Name = context;
 	return _CompilationUnits.size() - 1;
 }
 
@@ -52,6 +142,26 @@ CompilationUnit Compiler::ExitUnit()
 	return unit;
 }
 
+uint32_t Compiler::OptimizeUnit(CompilationUnit& unit, bool isProgram, uint32_t numSlots, uint32_t numParams)
+{
+	if (!_options.EnableIrPasses)
+	{
+		return numSlots;
+	}
+
+	auto function = IrFunction::Lift(unit.Name, unit.UnitInstructions, unit.DebugSymbols);
+	function.IsProgram = isProgram;
+	function.NumSlots = numSlots;
+	function.NumParams = numParams;
+	function.PureExterns = _pureExterns;
+	function.ExternTypes = _externTypes;
+	function.BorrowedArgs = _borrowedArgs;
+	function.LengthExterns = _lengthExterns;
+	_passes.Run(function);
+	function.Lower(unit.UnitInstructions, unit.DebugSymbols);
+	return function.NumSlots;
+}
+
 void Compiler::EnterScope(const std::string& scope)
 {
 	_symbolTable.PushScopeContext(scope);
@@ -109,6 +219,164 @@ void Compiler::EmitDebugSymbol(const INode* node, const Symbol* sym)
 	_CompilationUnits.top().AddDebugSymbol(node->BaseToken, sym, node->ToString());
 }
 
+void Compiler::RegisterInlineCandidate(const IStatement* stmt)
+{
+	//only top level lets are candidates, they are bound before any call that follows them
+	if (!_options.EnableInlining || !stmt->IsThisA<LetStatement>())
+	{
+		return;
+	}
+
+	auto* let = dynamic_cast<const LetStatement*>(stmt);
+	if (!let->Name->IsThisA<Identifier>() || !let->Value->IsThisA<FunctionLiteral>())
+	{
+		return;
+	}
+
+	auto& name = dynamic_cast<const Identifier*>(let->Name)->Value;
+	auto* function = dynamic_cast<const FunctionLiteral*>(let->Value);
+	if (_assignmentCounts[name] != 1 || function->IsGenerator)
+	{
+		return;
+	}
+
+	auto* block = dynamic_cast<const BlockStatement*>(function->Body);
+	if (block == nullptr || block->Statements.size() != 1)
+	{
+		return;
+	}
+
+	const IExpression* body = nullptr;
+	auto* stmtBody = block->Statements[0];
+	if (stmtBody->IsThisA<ExpressionStatement>())
+	{
+		body = dynamic_cast<const ExpressionStatement*>(stmtBody)->Expression;
+	}
+	else if (stmtBody->IsThisA<ReturnStatement>())
+	{
+		body = dynamic_cast<const ReturnStatement*>(stmtBody)->ReturnValue;
+	}
+
+	if (body == nullptr || AstAnalysis::NodeCount(body) > _options.InlineThreshold)
+	{
+		return;
+	}
+
+	std::set<std::string> params;
+	for (auto* param : function->Parameters)
+	{
+		//a parameter that shares a name with another binding rebinds it, so keep the call
+		auto* ident = dynamic_cast<const Identifier*>(param);
+		if (ident == nullptr || _assignmentCounts[ident->Value] != 1 || !params.insert(ident->Value).second)
+		{
+			return;
+		}
+	}
+
+	if (!IsInlineable(body, params))
+	{
+		return;
+	}
+
+	_inlineCandidates[name] = InlineCandidate{ function, body, _symbolTable.Resolve(name) };
+}
+
+bool Compiler::IsInlineable(const IExpression* expr, const std::set<std::string>& params) const
+{
+	//no free variables, no closures and no calls other than to builtins that are never rebound
+	if (expr->IsThisA<Identifier>())
+	{
+		auto& name = dynamic_cast<const Identifier*>(expr)->Value;
+		if (params.contains(name))
+		{
+			return true;
+		}
+		auto count = _assignmentCounts.find(name);
+		return _externals->IsBuiltIn(name) && (count == _assignmentCounts.end() || count->second == 0);
+	}
+
+	if (expr->IsThisA<CallExpression>())
+	{
+		auto* call = dynamic_cast<const CallExpression*>(expr);
+		if (!call->Function->IsThisA<Identifier>() || params.contains(dynamic_cast<const Identifier*>(call->Function)->Value))
+		{
+			return false;
+		}
+	}
+	else if (!(expr->IsThisA<IntegerLiteral>() || expr->IsThisA<DecimalLiteral>() || expr->IsThisA<StringLiteral>()
+		|| expr->IsThisA<BooleanLiteral>() || expr->IsThisA<NullLiteral>() || expr->IsThisA<PrefixExpression>()
+		|| expr->IsThisA<InfixExpression>() || expr->IsThisA<IndexExpression>() || expr->IsThisA<ArrayLiteral>()
+		|| expr->IsThisA<HashLiteral>()))
+	{
+		return false;
+	}
+
+	for (auto* child : AstAnalysis::Children(expr))
+	{
+		if (!IsInlineable(dynamic_cast<const IExpression*>(child), params))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Compiler::TryInline(const CallExpression* call)
+{
+	if (!_options.EnableInlining || !call->Function->IsThisA<Identifier>())
+	{
+		return false;
+	}
+
+	auto& name = dynamic_cast<const Identifier*>(call->Function)->Value;
+	auto candidate = _inlineCandidates.find(name);
+	if (candidate == _inlineCandidates.end())
+	{
+		return false;
+	}
+
+	auto& inlined = candidate->second;
+	if (inlined.Function->Parameters.size() != call->Arguments.size())
+	{
+		return false;
+	}
+
+	auto resolved = _symbolTable.Resolve(name);
+	if (resolved.MangledName != inlined.FunctionSymbol.MangledName)
+	{
+		return false;
+	}
+
+	//arguments are evaluated left to right before the body, just like a call
+	for (auto& arg : call->Arguments)
+	{
+		arg->Compile(this);
+		if (HasErrors())
+		{
+			return true;
+		}
+	}
+
+	auto hostContext = _symbolTable.CurrentScopeContext();
+	EnterScope(std::format("{}@inline{}", name, _inlineSites++));
+
+	std::vector<Symbol> params;
+	for (auto* param : inlined.Function->Parameters)
+	{
+		params.push_back(_symbolTable.DefineInlined(dynamic_cast<const Identifier*>(param)->Value, hostContext));
+	}
+
+	for (auto it = params.rbegin(); it != params.rend(); ++it)
+	{
+		EmitSet(*it);
+	}
+
+	EmitDebugSymbol(call, nullptr);
+	inlined.Body->Compile(this);
+	ExitScope();
+	return true;
+}
+
 void Compiler::NodeCompile(const Program* program, const std::string& unitName)
 {
 	EnterUnit(unitName); // enter global unit
@@ -119,6 +387,7 @@ void Compiler::NodeCompile(const Program* program, const std::string& unitName)
 		{
 			return;
 		}
+		RegisterInlineCandidate(stmt);
 	}
 }
 
@@ -154,6 +423,13 @@ void Compiler::NodeCompile(const ReturnStatement* ret)
 		return;
 	}
 	EmitDebugSymbol(ret, nullptr);
+	if (_CompilationUnits.top().IsGenerator)
+	{
+		//the value is evaluated for its side effects, a finished generator has nothing more to hand out
+		Emit(OpCode::Constants::OP_POP, {});
+		Emit(OpCode::Constants::OP_GEN_RETURN, {});
+		return;
+	}
 	Emit(OpCode::Constants::OP_RET_VAL, {});
 }
 
@@ -421,7 +697,7 @@ void Compiler::NodeCompile(const IfStatement* ifExpr)
 
 void Compiler::NodeCompile(const FunctionLiteral* function)
 {
-	EnterUnit(function->Name);
+	EnterUnit(std::format("{}#{}", function->Name, _functionUnits++));
 	Symbol symbol;
 	auto stackContext = _symbolTable.CurrentStackContext();
 
@@ -441,6 +717,13 @@ void Compiler::NodeCompile(const FunctionLiteral* function)
 		auto paramSymbol = _symbolTable.Define(ident->Value);
 	}
 
+	if (function->IsGenerator)
+	{
+		//a call only captures the arguments, the body runs once the generator is iterated
+		_CompilationUnits.top().IsGenerator = true;
+		Emit(OpCode::Constants::OP_GENERATOR, {});
+	}
+
 	function->Body->Compile(this);
 	if (HasErrors())
 	{
@@ -454,23 +737,29 @@ void Compiler::NodeCompile(const FunctionLiteral* function)
 		EmitGet(sym);
 	}
 	
-	if (unit.LastInstructionIs(OpCode::Constants::OP_POP))
+	if (unit.IsGenerator)
+	{
+		unit.AddInstruction(OpCode::Make(OpCode::Constants::OP_GEN_RETURN, {}));
+	}
+	else if (unit.LastInstructionIs(OpCode::Constants::OP_POP))
 	{
 		unit.RemoveLastPop();
 		unit.AddInstruction(OpCode::Make(OpCode::Constants::OP_RET_VAL, {}));
 	}
 
-	if (!unit.LastInstructionIs(OpCode::Constants::OP_RET_VAL))
+	if (!unit.LastInstructionIs(OpCode::Constants::OP_RET_VAL) && !unit.LastInstructionIs(OpCode::Constants::OP_GEN_RETURN))
 	{
 		unit.AddInstruction(OpCode::Make(OpCode::Constants::OP_RETURN, {}));
 	}
+	//passes can add temporaries to the frame and let locals share slots
+	auto numLocals = OptimizeUnit(unit, false, static_cast<uint32_t>(_symbolTable.NumberOfSymbolsInContext(stackContext)), static_cast<uint32_t>(function->Parameters.size()));
 	//auto obj = _factory->New<FunctionCompiledObj>(unit.UnitInstructions, _symbolTable.NumberOfSymbolsInContext(stackContext), static_cast<int>(function->Parameters.size()));
 	//auto index = AddConstant(obj);
 
 	auto currentOffest = _CompilationUnits.top().UnitInstructions.size();
 	
 	//EmitDebugSymbol(function, &symbol);
-	Emit(OpCode::Constants::OP_LFUN, { static_cast<uint32_t>(_symbolTable.NumberOfSymbolsInContext(stackContext)), static_cast<uint32_t>(function->Parameters.size()), static_cast<uint32_t>(unit.UnitInstructions.size()) }, unit.UnitInstructions);
+	Emit(OpCode::Constants::OP_LFUN, { numLocals, static_cast<uint32_t>(function->Parameters.size()), static_cast<uint32_t>(unit.UnitInstructions.size()) }, unit.UnitInstructions);
 
 	auto afterFunctionPos = _CompilationUnits.top().UnitInstructions.size();
 
@@ -487,6 +776,11 @@ void Compiler::NodeCompile(const FunctionLiteral* function)
 
 void Compiler::NodeCompile(const CallExpression* call)
 {
+	if (TryInline(call))
+	{
+		return;
+	}
+
 	call->Function->Compile(this);
 	if (HasErrors())
 	{
@@ -651,6 +945,92 @@ void Compiler::NodeCompile(const ForStatement* forExp)
 	}
 }
 
+void Compiler::NodeCompile(const ForInStatement* forIn)
+{
+	auto* ident = dynamic_cast<const Identifier*>(forIn->Name);
+	if (ident == nullptr)
+	{
+		_errorStack.push(CompilerErrorInfo::New(CompilerError::UnknownError, "Expected identifier"));
+		return;
+	}
+
+	forIn->Iterable->Compile(this);
+	if (HasErrors())
+	{
+		return;
+	}
+
+	//the iterator stays on the stack for the whole loop
+	EmitDebugSymbol(forIn, nullptr);
+	Emit(OpCode::Constants::OP_ITER, {});
+	auto symbol = _symbolTable.Define(ident->Value);
+	auto outerJumps = _CompilationUnits.top().LoopJumps.size();
+
+	auto nextPos = Emit(IsRangeCall(forIn->Iterable) ? OpCode::Constants::OP_FOR_RANGE : OpCode::Constants::OP_ITER_NEXT, { 9999 });
+	EmitSet(symbol);
+	forIn->Action->Compile(this);
+	if (HasErrors())
+	{
+		return;
+	}
+	Emit(OpCode::Constants::OP_JUMP, { static_cast<uint32_t>(nextPos) });
+
+	//break leaves the iterator behind, an exhausted iterator is already popped
+	auto breakPos = _CompilationUnits.top().UnitInstructions.size();
+	Emit(OpCode::Constants::OP_POP, {});
+	auto afterLoopPos = _CompilationUnits.top().UnitInstructions.size();
+	_CompilationUnits.top().ChangeOperand(nextPos, afterLoopPos);
+
+	//only the jumps out of this loop, an enclosing loop patches its own
+	while (_CompilationUnits.top().LoopJumps.size() > outerJumps)
+	{
+		auto jump = _CompilationUnits.top().LoopJumps.top();
+		_CompilationUnits.top().LoopJumps.pop();
+		if (jump.Type == LoopJumpType::LOOP_JUMP_CONTINUE)
+		{
+			_CompilationUnits.top().ChangeOperand(jump.Instruction, nextPos);
+		}
+
+		if (jump.Type == LoopJumpType::LOOP_JUMP_BREAK)
+		{
+			_CompilationUnits.top().ChangeOperand(jump.Instruction, breakPos);
+		}
+	}
+}
+
+bool Compiler::IsRangeCall(const IExpression* iterable)
+{
+	auto* call = dynamic_cast<const CallExpression*>(iterable);
+	if (call == nullptr)
+	{
+		return false;
+	}
+	auto* fn = dynamic_cast<const Identifier*>(call->Function);
+	if (fn == nullptr || fn->Value != "range" || _externals == nullptr || !_externals->IsBuiltIn(fn->Value))
+	{
+		return false;
+	}
+	return _symbolTable.Resolve(fn->Value).Type == ScopeType::SCOPE_EXTERN;
+}
+
+void Compiler::NodeCompile(const YieldExpression* yield)
+{
+	if (!_CompilationUnits.top().IsGenerator)
+	{
+		_errorStack.push(CompilerErrorInfo::New(CompilerError::UnknownError, "yield outside of a generator"));
+		return;
+	}
+
+	yield->Value->Compile(this);
+	if (HasErrors())
+	{
+		return;
+	}
+
+	EmitDebugSymbol(yield, nullptr);
+	Emit(OpCode::Constants::OP_YIELD, {});
+}
+
 void Compiler::NodeCompile(const ContinueStatement* cont)
 {
 	EmitDebugSymbol(cont, nullptr);
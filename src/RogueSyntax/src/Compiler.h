@@ -3,8 +3,10 @@
 #include <AstNode.h>
 #include <IObject.h>
 #include <OpCode.h>
+#include <CompilerOptions.h>
 #include "CompilationUnit.h"
 #include "SymbolTable.h"
+#include "IrPassManager.h"
 
 enum class CompilerError
 {
@@ -24,14 +26,24 @@ struct CompilerErrorInfo
 	}
 };
 
+struct InlineCandidate
+{
+	const FunctionLiteral* Function;
+	const IExpression* Body;
+	Symbol FunctionSymbol;
+};
+
 class Compiler
 {
 public:
 	Compiler(const std::shared_ptr<ObjectFactory> factory);
+	Compiler(const std::shared_ptr<ObjectFactory> factory, const CompilerOptions& options);
 	~Compiler();
 	ObjectCode Compile(const std::shared_ptr<Program>& program, const std::shared_ptr<BuiltIn>& externs, const std::string& unitName);
 	inline bool HasErrors() const { return !_errors.empty(); };
 	std::vector<std::string> GetErrors() const { return _errors; };
+	//ir of every unit compiled so far, empty unless CompilerOptions::DumpIr is set
+	const std::string& IrDump() const { return _passes.Dump(); }
 
 	void NodeCompile(const Program* program, const std::string& unitName);
 	void NodeCompile(const BlockStatement* block);
@@ -54,6 +66,8 @@ public:
 	void NodeCompile(const NullLiteral* null);
 	void NodeCompile(const WhileStatement* whileExp);
 	void NodeCompile(const ForStatement* forExp);
+	void NodeCompile(const ForInStatement* forIn);
+	void NodeCompile(const YieldExpression* yield);
 	void NodeCompile(const ContinueStatement* cont);
 	void NodeCompile(const BreakStatement* brk);
 
@@ -73,17 +87,40 @@ protected:
 	int EmitSet(Symbol symbol);
 
 	void EmitDebugSymbol(const  INode* node, const Symbol* sym);
+	//round trip a finished unit through the ir and the pass pipeline
+	//returns the number of slots the unit uses once the passes have added their temporaries and shared the rest
+	uint32_t OptimizeUnit(CompilationUnit& unit, bool isProgram, uint32_t numSlots, uint32_t numParams = 0);
+
+	static uint32_t MeasureStackDepth(const RSInstructions& instructions, size_t begin, size_t end, std::vector<FunctionLayout>& functions);
+
+	void RegisterInlineCandidate(const IStatement* stmt);
+	bool IsInlineable(const IExpression* expr, const std::set<std::string>& params) const;
+	bool TryInline(const CallExpression* call);
+	//a call of the range builtin that is not shadowed by a script symbol
+	bool IsRangeCall(const IExpression* iterable);
 
 private:
 	SymbolTable _symbolTable;
 	std::stack<CompilationUnit> _CompilationUnits;
 
 	std::shared_ptr<BuiltIn> _externals;
+	std::vector<bool> _pureExterns;
+	std::vector<std::size_t> _externTypes;
+	std::vector<std::size_t> _borrowedArgs;
+	std::vector<bool> _lengthExterns;
 	std::vector<const IObject*> _constants;
 
 	std::vector<std::string> _errors;
 	std::stack<CompilerErrorInfo> _errorStack;
 	std::shared_ptr<ObjectFactory> _factory;
+
+	CompilerOptions _options;
+	IrPassManager _passes;
+	std::unordered_map<std::string, uint32_t> _assignmentCounts;
+	std::unordered_map<std::string, InlineCandidate> _inlineCandidates;
+	uint32_t _inlineSites = 0;
+	//every function gets its own symbol context, two lambdas (or two functions bound to the same name) would otherwise continue each other's local numbering
+	uint32_t _functionUnits = 0;
 };
 
 
@@ -0,0 +1,452 @@
+#include "ConstantFolding.h"
+#include <pch.h>
+
+namespace
+{
+	bool IsArithmetic(OpCode::Constants opcode)
+	{
+		return opcode >= OpCode::Constants::OP_ADD && opcode <= OpCode::Constants::OP_BRSHIFT;
+	}
+
+	bool IsComparison(OpCode::Constants opcode)
+	{
+		return opcode >= OpCode::Constants::OP_EQ && opcode <= OpCode::Constants::OP_OR;
+	}
+
+	bool IsPrefix(OpCode::Constants opcode)
+	{
+		return opcode >= OpCode::Constants::OP_NEGATE && opcode <= OpCode::Constants::OP_BNOT;
+	}
+
+	const IObject* Bool(bool value)
+	{
+		return value ? BooleanObj::TRUE_OBJ_REF : BooleanObj::FALSE_OBJ_REF;
+	}
+
+	//int results are only folded when the vm's int32 math is well defined
+	std::optional<int32_t> Narrow(int64_t value)
+	{
+		if (value < INT32_MIN || value > INT32_MAX)
+		{
+			return std::nullopt;
+		}
+		return static_cast<int32_t>(value);
+	}
+}
+
+ConstantFoldingPass::ConstantFoldingPass()
+{
+	_store = std::make_shared<ObjectStore>();
+	_factory = _store->Factory();
+	_coercer = std::make_unique<TypeCoercer>(_factory);
+}
+
+bool ConstantFoldingPass::Run(IrFunction& function)
+{
+	FindSlotWrites(function);
+	_idom = function.Dominators();
+
+	//a folded let can make the next expression constant, sweep until nothing changes
+	auto changed = false;
+	while (Sweep(function))
+	{
+		changed = true;
+		function.BuildSsa();
+	}
+	return changed;
+}
+
+void ConstantFoldingPass::FindSlotWrites(const IrFunction& function)
+{
+	_writes.clear();
+	std::unordered_map<uint32_t, uint32_t> reads;
+	std::unordered_map<uint32_t, uint32_t> nested;
+	for (auto id : function.Layout)
+	{
+		auto& block = function.Blocks[id];
+		for (uint32_t index = 0; index < block.Instrs.size(); index++)
+		{
+			auto& instr = block.Instrs[index];
+			if (instr.Dead)
+			{
+				continue;
+			}
+			if (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN)
+			{
+				auto& write = _writes[instr.Operands[0]];
+				write.Count++;
+				write.Block = instr.Op == OpCode::Constants::OP_SET ? id : IrNoBlock;
+				write.Index = index;
+			}
+			else if (instr.Op == OpCode::Constants::OP_LFUN)
+			{
+				IrFunction::CountGlobalAccesses(instr.Data, reads, nested);
+			}
+		}
+	}
+
+	//a global written by a closure can change under any call
+	for (auto [slot, count] : nested)
+	{
+		_writes[slot].Count += count;
+	}
+}
+
+const IObject* ConstantFoldingPass::ConstantOf(const IrFunction& function, uint32_t value) const
+{
+	auto& def = function.Value(value);
+	auto* instr = function.DefOf(value);
+	if (instr == nullptr)
+	{
+		return nullptr;
+	}
+	if (instr->Op != OpCode::Constants::OP_GET)
+	{
+		return LiteralOf(*instr);
+	}
+
+	auto write = _writes.find(instr->Operands[0]);
+	if (write == _writes.end() || write->second.Count != 1 || write->second.Block == IrNoBlock)
+	{
+		return nullptr;
+	}
+
+	//the one write has to run before every read, in the same block that means earlier in it
+	auto [block, index] = std::pair{ write->second.Block, write->second.Index };
+	auto before = block == def.Block ? index < def.Index : IrFunction::Dominates(_idom, block, def.Block);
+	if (!before)
+	{
+		return nullptr;
+	}
+
+	auto& set = function.Blocks[block].Instrs[index];
+	if (set.Args.empty())
+	{
+		return nullptr;
+	}
+	return ConstantOf(function, set.Args[0]);
+}
+
+bool ConstantFoldingPass::Sweep(IrFunction& function)
+{
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		auto& block = function.Blocks[id];
+		if (!block.Reachable)
+		{
+			continue;
+		}
+
+		for (auto& instr : block.Instrs)
+		{
+			if (instr.Dead || !(IsArithmetic(instr.Op) || IsComparison(instr.Op) || IsPrefix(instr.Op)))
+			{
+				continue;
+			}
+
+			std::vector<const IObject*> args;
+			for (auto arg : instr.Args)
+			{
+				auto* constant = ConstantOf(function, arg);
+				if (constant == nullptr)
+				{
+					break;
+				}
+				args.push_back(constant);
+			}
+			if (args.size() != instr.Args.size())
+			{
+				continue;
+			}
+
+			auto literal = MakeLiteral(Evaluate(instr.Op, args));
+			if (!literal.has_value())
+			{
+				continue;
+			}
+
+			//the operands were pushed for this instruction alone
+			for (auto arg : instr.Args)
+			{
+				auto& def = function.Value(arg);
+				function.Blocks[def.Block].Instrs[def.Index].Dead = true;
+			}
+			instr.Op = literal->Op;
+			instr.Operands = literal->Operands;
+			instr.Data = literal->Data;
+			instr.Args.clear();
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+const IObject* ConstantFoldingPass::LiteralOf(const IrInstr& instr) const
+{
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	{
+		auto raw = instr.Operands[0];
+		return _factory->New<IntegerObj>(reinterpret_cast<int32_t&>(raw));
+	}
+	case OpCode::Constants::OP_LDECIMAL:
+	{
+		auto raw = instr.Operands[0];
+		return _factory->New<DecimalObj>(reinterpret_cast<float&>(raw));
+	}
+	case OpCode::Constants::OP_LSTRING:
+		return _factory->New<StringObj>(std::string(instr.Data.begin(), instr.Data.end()));
+	case OpCode::Constants::OP_TRUE:
+		return BooleanObj::TRUE_OBJ_REF;
+	case OpCode::Constants::OP_FALSE:
+		return BooleanObj::FALSE_OBJ_REF;
+	case OpCode::Constants::OP_NULL:
+		return NullObj::NULL_OBJ_REF;
+	default:
+		return nullptr;
+	}
+}
+
+std::optional<IrInstr> ConstantFoldingPass::MakeLiteral(const IObject* value)
+{
+	if (value == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	IrInstr instr{};
+	if (value->IsThisA<IntegerObj>())
+	{
+		auto number = dynamic_cast<const IntegerObj*>(value)->Value;
+		instr.Op = OpCode::Constants::OP_LINT;
+		instr.Operands = { reinterpret_cast<uint32_t&>(number) };
+	}
+	else if (value->IsThisA<DecimalObj>())
+	{
+		auto number = dynamic_cast<const DecimalObj*>(value)->Value;
+		instr.Op = OpCode::Constants::OP_LDECIMAL;
+		instr.Operands = { reinterpret_cast<uint32_t&>(number) };
+	}
+	else if (value->IsThisA<StringObj>())
+	{
+		auto& str = dynamic_cast<const StringObj*>(value)->Value;
+		instr.Op = OpCode::Constants::OP_LSTRING;
+		instr.Operands = { static_cast<uint32_t>(str.size()) };
+		instr.Data.assign(str.begin(), str.end());
+	}
+	else if (value->IsThisA<BooleanObj>())
+	{
+		instr.Op = dynamic_cast<const BooleanObj*>(value)->Value ? OpCode::Constants::OP_TRUE : OpCode::Constants::OP_FALSE;
+	}
+	else if (value->IsThisA<NullObj>())
+	{
+		instr.Op = OpCode::Constants::OP_NULL;
+	}
+	else
+	{
+		return std::nullopt;
+	}
+	return instr;
+}
+
+const IObject* ConstantFoldingPass::Evaluate(OpCode::Constants opcode, const std::vector<const IObject*>& args) const
+{
+	try
+	{
+		if (IsPrefix(opcode) && args.size() == 1)
+		{
+			return Prefix(opcode, args[0]);
+		}
+		if (IsArithmetic(opcode) && args.size() == 2)
+		{
+			return Arithmetic(opcode, args[0], args[1], false);
+		}
+		if (IsComparison(opcode) && args.size() == 2)
+		{
+			return Comparison(opcode, args[0], args[1]);
+		}
+	}
+	catch (const std::exception&)
+	{
+		//whatever fails here fails at runtime too, with the vm's error and location
+	}
+	return nullptr;
+}
+
+const IObject* ConstantFoldingPass::Arithmetic(OpCode::Constants opcode, const IObject* left, const IObject* right, bool coerced) const
+{
+	if (left->Type() != right->Type())
+	{
+		if (coerced || !_coercer->CanCoerceTypes(left, right))
+		{
+			return nullptr;
+		}
+		auto [leftC, rightC] = _coercer->CoerceTypes(left, right);
+		if (leftC == nullptr || rightC == nullptr)
+		{
+			return nullptr;
+		}
+		return Arithmetic(opcode, leftC, rightC, true);
+	}
+
+	if (left->IsThisA<IntegerObj>())
+	{
+		int64_t l = dynamic_cast<const IntegerObj*>(left)->Value;
+		int64_t r = dynamic_cast<const IntegerObj*>(right)->Value;
+		std::optional<int32_t> result;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_ADD: result = Narrow(l + r); break;
+		case OpCode::Constants::OP_SUB: result = Narrow(l - r); break;
+		case OpCode::Constants::OP_MUL: result = Narrow(l * r); break;
+		case OpCode::Constants::OP_DIV: result = r == 0 ? std::nullopt : Narrow(l / r); break;
+		case OpCode::Constants::OP_MOD: result = r == 0 || (l == INT32_MIN && r == -1) ? std::nullopt : Narrow(l % r); break;
+		case OpCode::Constants::OP_BOR: result = static_cast<int32_t>(l | r); break;
+		case OpCode::Constants::OP_BAND: result = static_cast<int32_t>(l & r); break;
+		case OpCode::Constants::OP_BXOR: result = static_cast<int32_t>(l ^ r); break;
+		case OpCode::Constants::OP_BLSHIFT:
+			if (r >= 0 && r < 32)
+			{
+				result = static_cast<int32_t>(static_cast<int32_t>(l) << r);
+			}
+			break;
+		case OpCode::Constants::OP_BRSHIFT:
+			if (r >= 0 && r < 32)
+			{
+				result = static_cast<int32_t>(static_cast<int32_t>(l) >> r);
+			}
+			break;
+		default:
+			break;
+		}
+		return result.has_value() ? _factory->New<IntegerObj>(*result) : nullptr;
+	}
+	if (left->IsThisA<DecimalObj>())
+	{
+		auto l = dynamic_cast<const DecimalObj*>(left)->Value;
+		auto r = dynamic_cast<const DecimalObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_ADD: return _factory->New<DecimalObj>(l + r);
+		case OpCode::Constants::OP_SUB: return _factory->New<DecimalObj>(l - r);
+		case OpCode::Constants::OP_MUL: return _factory->New<DecimalObj>(l * r);
+		case OpCode::Constants::OP_DIV: return _factory->New<DecimalObj>(l / r);
+		case OpCode::Constants::OP_MOD: return _factory->New<DecimalObj>(std::fmod(l, r));
+		default: return nullptr;
+		}
+	}
+	if (left->IsThisA<StringObj>() && opcode == OpCode::Constants::OP_ADD)
+	{
+		return _factory->New<StringObj>(dynamic_cast<const StringObj*>(left)->Value + dynamic_cast<const StringObj*>(right)->Value);
+	}
+	return nullptr;
+}
+
+const IObject* ConstantFoldingPass::Comparison(OpCode::Constants opcode, const IObject* left, const IObject* right) const
+{
+	if (left->Type() != right->Type())
+	{
+		return nullptr;
+	}
+
+	if (left->IsThisA<IntegerObj>())
+	{
+		auto l = dynamic_cast<const IntegerObj*>(left)->Value;
+		auto r = dynamic_cast<const IntegerObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_EQ: return Bool(l == r);
+		case OpCode::Constants::OP_NEQ: return Bool(l != r);
+		case OpCode::Constants::OP_GT: return Bool(l > r);
+		case OpCode::Constants::OP_GTE: return Bool(l >= r);
+		case OpCode::Constants::OP_LT: return Bool(l < r);
+		case OpCode::Constants::OP_LTE: return Bool(l <= r);
+		default: return nullptr;
+		}
+	}
+	if (left->IsThisA<DecimalObj>())
+	{
+		auto l = dynamic_cast<const DecimalObj*>(left)->Value;
+		auto r = dynamic_cast<const DecimalObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_EQ: return Bool(std::abs(l - r) <= FLT_EPSILON);
+		case OpCode::Constants::OP_NEQ: return Bool(std::abs(l - r) > FLT_EPSILON);
+		case OpCode::Constants::OP_GT: return Bool(l > r);
+		case OpCode::Constants::OP_GTE: return Bool(l >= r);
+		case OpCode::Constants::OP_LT: return Bool(l < r);
+		case OpCode::Constants::OP_LTE: return Bool(l <= r);
+		default: return nullptr;
+		}
+	}
+	if (left->IsThisA<StringObj>())
+	{
+		auto& l = dynamic_cast<const StringObj*>(left)->Value;
+		auto& r = dynamic_cast<const StringObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_EQ: return Bool(l == r);
+		case OpCode::Constants::OP_NEQ: return Bool(l != r);
+		default: return nullptr;
+		}
+	}
+	if (left->IsThisA<BooleanObj>())
+	{
+		auto l = dynamic_cast<const BooleanObj*>(left)->Value;
+		auto r = dynamic_cast<const BooleanObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_EQ: return Bool(l == r);
+		case OpCode::Constants::OP_NEQ: return Bool(l != r);
+		case OpCode::Constants::OP_AND: return Bool(l && r);
+		case OpCode::Constants::OP_OR: return Bool(l || r);
+		default: return nullptr;
+		}
+	}
+	if (left->IsThisA<NullObj>())
+	{
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_EQ: return Bool(true);
+		case OpCode::Constants::OP_NEQ: return Bool(false);
+		default: return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+const IObject* ConstantFoldingPass::Prefix(OpCode::Constants opcode, const IObject* right) const
+{
+	if (right->IsThisA<IntegerObj>())
+	{
+		auto value = dynamic_cast<const IntegerObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_NEGATE: return value == INT32_MIN ? nullptr : _factory->New<IntegerObj>(-value);
+		case OpCode::Constants::OP_NOT: return Bool(value == 0);
+		case OpCode::Constants::OP_BNOT: return _factory->New<IntegerObj>(~value);
+		default: return nullptr;
+		}
+	}
+	if (right->IsThisA<DecimalObj>())
+	{
+		auto value = dynamic_cast<const DecimalObj*>(right)->Value;
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_NEGATE: return _factory->New<DecimalObj>(-value);
+		case OpCode::Constants::OP_NOT: return Bool(std::abs(value) < FLT_EPSILON);
+		default: return nullptr;
+		}
+	}
+	if (right->IsThisA<BooleanObj>())
+	{
+		return opcode == OpCode::Constants::OP_NOT ? Bool(!dynamic_cast<const BooleanObj*>(right)->Value) : nullptr;
+	}
+	if (right->IsThisA<NullObj>())
+	{
+		return opcode == OpCode::Constants::OP_NOT ? Bool(true) : nullptr;
+	}
+	return nullptr;
+}
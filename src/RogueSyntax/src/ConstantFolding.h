@@ -0,0 +1,48 @@
+#pragma once
+#include <StandardLib.h>
+#include <IObject.h>
+#include <ObjectStore.h>
+#include <TypeCoercer.h>
+#include "IrPassManager.h"
+
+//evaluates operators whose operands are literals, or variables that are set once to a literal before every read,
+//the operators follow the vm (and its TypeCoercer) exactly and anything that would fail at runtime is left alone
+class ConstantFoldingPass : public IrPass
+{
+public:
+	ConstantFoldingPass();
+
+	std::string Name() const override { return "constant folding"; }
+	bool Run(IrFunction& function) override;
+
+	//the literal an instruction pushes, nullptr for anything else
+	const IObject* LiteralOf(const IrInstr& instr) const;
+	//operator applied to constants, nullptr when the vm would throw or the result has no literal form
+	const IObject* Evaluate(OpCode::Constants opcode, const std::vector<const IObject*>& args) const;
+	static std::optional<IrInstr> MakeLiteral(const IObject* value);
+
+private:
+	struct SlotWrite
+	{
+		uint32_t Count = 0;
+		uint32_t Block = IrNoBlock;
+		uint32_t Index = 0;
+	};
+
+	bool Sweep(IrFunction& function);
+	void FindSlotWrites(const IrFunction& function);
+	//the constant held by a value, looks through loads of slots that are set once
+	const IObject* ConstantOf(const IrFunction& function, uint32_t value) const;
+
+	const IObject* Arithmetic(OpCode::Constants opcode, const IObject* left, const IObject* right, bool coerced) const;
+	const IObject* Comparison(OpCode::Constants opcode, const IObject* left, const IObject* right) const;
+	const IObject* Prefix(OpCode::Constants opcode, const IObject* right) const;
+
+	//objects made while folding live in the pass, never in the program's store
+	std::shared_ptr<ObjectStore> _store;
+	std::shared_ptr<ObjectFactory> _factory;
+	std::unique_ptr<TypeCoercer> _coercer;
+
+	std::unordered_map<uint32_t, SlotWrite> _writes;
+	std::vector<uint32_t> _idom;
+};
@@ -0,0 +1,252 @@
+#include "DeadCodeElimination.h"
+#include <pch.h>
+
+bool DeadCodeEliminationPass::Run(IrFunction& function)
+{
+	//each step can expose work for the others, a pruned branch leaves an unreachable arm and so on
+	auto changed = false;
+	auto progress = true;
+	while (progress)
+	{
+		progress = false;
+		for (auto step : { &DeadCodeEliminationPass::PruneConstantBranches, &DeadCodeEliminationPass::RemoveUnreachableBlocks,
+			&DeadCodeEliminationPass::RemoveJumpsToNext, &DeadCodeEliminationPass::RemoveUnusedStores, &DeadCodeEliminationPass::RemoveUnusedValues })
+		{
+			if ((this->*step)(function))
+			{
+				function.BuildSsa();
+				progress = true;
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+bool DeadCodeEliminationPass::PruneConstantBranches(IrFunction& function) const
+{
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		auto& block = function.Blocks[id];
+		auto* last = block.Last();
+		if (!block.Reachable || last == nullptr || last->Op != OpCode::Constants::OP_JUMPIFZ)
+		{
+			continue;
+		}
+
+		auto* condition = function.DefOf(last->Args[0]);
+		if (condition == nullptr || (condition->Op != OpCode::Constants::OP_TRUE && condition->Op != OpCode::Constants::OP_FALSE))
+		{
+			continue;
+		}
+
+		auto taken = condition->Op == OpCode::Constants::OP_FALSE;
+		if (PopsLater(function, id, static_cast<uint32_t>(last - block.Instrs.data())))
+		{
+			Remove(function, last->Args[0]);
+			last->Dead = true;
+		}
+		else
+		{
+			//the condition is the last value the program pops
+			last->Op = OpCode::Constants::OP_POP;
+			last->Operands.clear();
+		}
+
+		//the arm that is never taken is left unreachable
+		if (taken)
+		{
+			block.Next = block.Target;
+		}
+		block.Target = IrNoBlock;
+		changed = true;
+	}
+	return changed;
+}
+
+bool DeadCodeEliminationPass::RemoveUnreachableBlocks(IrFunction& function) const
+{
+	//only unreachable blocks lead into unreachable blocks, so no edge is left dangling
+	auto size = function.Layout.size();
+	std::erase_if(function.Layout, [&function](uint32_t id) { return !function.Blocks[id].Reachable; });
+	return function.Layout.size() != size;
+}
+
+bool DeadCodeEliminationPass::RemoveJumpsToNext(IrFunction& function) const
+{
+	auto changed = false;
+	for (size_t i = 0; i + 1 < function.Layout.size(); i++)
+	{
+		auto& block = function.Blocks[function.Layout[i]];
+		auto* last = block.Last();
+		if (last != nullptr && last->Op == OpCode::Constants::OP_JUMP && block.Target == function.Layout[i + 1])
+		{
+			last->Dead = true;
+			block.Next = block.Target;
+			block.Target = IrNoBlock;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool DeadCodeEliminationPass::RemoveUnusedStores(IrFunction& function) const
+{
+	//a global can be loaded by any function in the program, they are only all in view from the top level
+	std::unordered_map<uint32_t, uint32_t> reads;
+	std::unordered_map<uint32_t, uint32_t> writes;
+	for (auto id : function.Layout)
+	{
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			if (instr.Dead)
+			{
+				continue;
+			}
+			if (instr.Op == OpCode::Constants::OP_GET || instr.Op == OpCode::Constants::OP_SET_ASSIGN)
+			{
+				reads[instr.Operands[0]]++;
+			}
+			else if (instr.Op == OpCode::Constants::OP_LFUN)
+			{
+				IrFunction::CountGlobalAccesses(instr.Data, reads, writes);
+			}
+		}
+	}
+
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		auto& block = function.Blocks[id];
+		for (uint32_t index = 0; index < block.Instrs.size(); index++)
+		{
+			auto& instr = block.Instrs[index];
+			if (instr.Dead || instr.Op != OpCode::Constants::OP_SET || reads.contains(instr.Operands[0]))
+			{
+				continue;
+			}
+			auto scope = GetTypeFromIdx(instr.Operands[0]);
+			if (scope != ScopeType::SCOPE_LOCAL && !(scope == ScopeType::SCOPE_GLOBAL && function.IsProgram))
+			{
+				continue;
+			}
+
+			if (Removable(function, instr.Args[0]) && PopsLater(function, id, index))
+			{
+				Remove(function, instr.Args[0]);
+				instr.Dead = true;
+			}
+			else
+			{
+				//the value is still computed for its side effects, but not copied into the slot
+				instr.Op = OpCode::Constants::OP_POP;
+				instr.Operands.clear();
+			}
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool DeadCodeEliminationPass::RemoveUnusedValues(IrFunction& function) const
+{
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		auto& block = function.Blocks[id];
+		for (uint32_t index = 0; index < block.Instrs.size(); index++)
+		{
+			auto& instr = block.Instrs[index];
+			if (instr.Dead || instr.Op != OpCode::Constants::OP_POP || !Removable(function, instr.Args[0]) || !PopsLater(function, id, index))
+			{
+				continue;
+			}
+			Remove(function, instr.Args[0]);
+			instr.Dead = true;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool DeadCodeEliminationPass::Removable(const IrFunction& function, uint32_t value)
+{
+	auto* def = function.DefOf(value);
+	if (def == nullptr || !IrFunction::IsPure(def->Op))
+	{
+		return false;
+	}
+	return std::ranges::all_of(def->Args, [&function](uint32_t arg) { return Removable(function, arg); });
+}
+
+void DeadCodeEliminationPass::Remove(IrFunction& function, uint32_t value)
+{
+	auto& def = function.Value(value);
+	auto& instr = function.Blocks[def.Block].Instrs[def.Index];
+	instr.Dead = true;
+	for (auto arg : instr.Args)
+	{
+		Remove(function, arg);
+	}
+}
+
+bool DeadCodeEliminationPass::PopsLater(const IrFunction& function, uint32_t block, uint32_t index)
+{
+	std::set<uint32_t> visited;
+	return PopsFrom(function, block, index + 1, visited);
+}
+
+bool DeadCodeEliminationPass::PopsFrom(const IrFunction& function, uint32_t block, uint32_t first, std::set<uint32_t>& visited)
+{
+	auto& instrs = function.Blocks[block].Instrs;
+	for (auto i = first; i < instrs.size(); i++)
+	{
+		if (!instrs[i].Dead && SetsLastPopped(instrs[i]))
+		{
+			return true;
+		}
+	}
+
+	//every way out of the block has to pop, a path that loops back is judged by the paths leaving the loop
+	auto succs = function.Blocks[block].Succs();
+	if (succs.empty())
+	{
+		return false;
+	}
+	for (auto succ : succs)
+	{
+		if (visited.insert(succ).second && !PopsFrom(function, succ, 0, visited))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DeadCodeEliminationPass::SetsLastPopped(const IrInstr& instr)
+{
+	//calls and iterators move the stack pointer directly, only count what goes through RogueVM::Pop
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_POP:
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_SET_ASSIGN:
+	case OpCode::Constants::OP_JUMPIFZ:
+	case OpCode::Constants::OP_RETURN:
+	case OpCode::Constants::OP_RET_VAL:
+	case OpCode::Constants::OP_INDEX:
+	case OpCode::Constants::OP_INDEX_NOCHECK:
+	case OpCode::Constants::OP_ADD_II:
+	case OpCode::Constants::OP_LT_II:
+	case OpCode::Constants::OP_CONCAT_SS:
+		return true;
+	case OpCode::Constants::OP_ARRAY:
+	case OpCode::Constants::OP_HASH:
+	case OpCode::Constants::OP_ARRAY_SCRATCH:
+	case OpCode::Constants::OP_HASH_SCRATCH:
+		return instr.Operands[0] > 0;
+	default:
+		return (instr.Op >= OpCode::Constants::OP_ADD && instr.Op <= OpCode::Constants::OP_BNOT);
+	}
+}
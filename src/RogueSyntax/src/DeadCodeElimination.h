@@ -0,0 +1,29 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//removes code that never runs or whose result is never used:
+//branches on a literal condition, blocks no path reaches, jumps to the next block,
+//stores to variables nothing loads and pure values that are only popped
+class DeadCodeEliminationPass : public IrPass
+{
+public:
+	std::string Name() const override { return "dead code elimination"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	bool PruneConstantBranches(IrFunction& function) const;
+	bool RemoveUnreachableBlocks(IrFunction& function) const;
+	bool RemoveJumpsToNext(IrFunction& function) const;
+	bool RemoveUnusedStores(IrFunction& function) const;
+	bool RemoveUnusedValues(IrFunction& function) const;
+
+	//a pure value whose operands are pure too, computed only to be consumed by its single use
+	static bool Removable(const IrFunction& function, uint32_t value);
+	static void Remove(IrFunction& function, uint32_t value);
+	//dropping a pop changes the vm's last popped value (the result of a program),
+	//only safe when every path from the instruction pops something else
+	static bool PopsLater(const IrFunction& function, uint32_t block, uint32_t index);
+	static bool PopsFrom(const IrFunction& function, uint32_t block, uint32_t first, std::set<uint32_t>& visited);
+	static bool SetsLastPopped(const IrInstr& instr);
+};
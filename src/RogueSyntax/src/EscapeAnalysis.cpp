@@ -0,0 +1,132 @@
+#include "EscapeAnalysis.h"
+#include <pch.h>
+
+bool EscapeAnalysisPass::Run(IrFunction& function)
+{
+	//the main frame only returns when the program ends, and a generator's frame outlives the call that made it
+	auto* first = function.Blocks[function.Layout.front()].Instrs.empty() ? nullptr : &function.Blocks[function.Layout.front()].Instrs.front();
+	if (function.IsProgram || (first != nullptr && first->Op == OpCode::Constants::OP_GENERATOR))
+	{
+		return false;
+	}
+
+	//every iteration would hold on to its object until the frame returns, the nursery reclaims those sooner
+	std::set<uint32_t> inLoop;
+	for (auto& loop : function.Loops())
+	{
+		inLoop.insert(loop.Blocks.begin(), loop.Blocks.end());
+	}
+
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		if (inLoop.contains(id))
+		{
+			continue;
+		}
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			auto scratch = ScratchOf(instr.Op);
+			if (instr.Dead || scratch == instr.Op || Escapes(function, instr))
+			{
+				continue;
+			}
+			instr.Op = scratch;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool EscapeAnalysisPass::Escapes(const IrFunction& function, const IrInstr& allocation)
+{
+	for (auto& use : function.Value(allocation.Result).Uses)
+	{
+		if (use.IsPhi)
+		{
+			return true;
+		}
+		auto& user = function.Blocks[use.Block].Instrs[use.Index];
+		auto position = std::distance(user.Args.begin(), std::ranges::find(user.Args, allocation.Result));
+		if (!Borrows(function, allocation, user, position))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool EscapeAnalysisPass::Borrows(const IrFunction& function, const IrInstr& allocation, const IrInstr& user, size_t position)
+{
+	switch (user.Op)
+	{
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_POP:
+	case OpCode::Constants::OP_JUMPIFZ:
+	case OpCode::Constants::OP_INDEX:
+	case OpCode::Constants::OP_INDEX_NOCHECK:
+	case OpCode::Constants::OP_EQ:
+	case OpCode::Constants::OP_NEQ:
+		return true;
+	case OpCode::Constants::OP_ITER:
+		//the iterator is only ever on this frame's stack
+		return allocation.Op == OpCode::Constants::OP_ARRAY;
+	case OpCode::Constants::OP_CALL:
+	{
+		auto* callee = function.DefOf(user.Args[0]);
+		if (position == 0 || callee == nullptr || callee->Op != OpCode::Constants::OP_GET || GetTypeFromIdx(callee->Operands[0]) != ScopeType::SCOPE_EXTERN)
+		{
+			return false;
+		}
+		auto idx = static_cast<size_t>(AdjustIdx(callee->Operands[0]));
+		if (idx >= function.BorrowedArgs.size() || position > function.BorrowedArgs[idx])
+		{
+			return false;
+		}
+		return allocation.Op != OpCode::Constants::OP_CLOSURE || !ReachesItself(function, allocation);
+	}
+	default:
+		return false;
+	}
+}
+
+bool EscapeAnalysisPass::ReachesItself(const IrFunction& function, const IrInstr& closure)
+{
+	auto* fn = function.DefOf(closure.Args.back());
+	if (fn == nullptr || fn->Op != OpCode::Constants::OP_LFUN)
+	{
+		return true;
+	}
+
+	//nested bodies are scanned in place too, that only errs towards keeping the closure on the heap
+	size_t offset = 0;
+	while (offset < fn->Data.size())
+	{
+		auto [opcode, operands, next] = OpCode::ReadOperand(fn->Data, offset);
+		if (opcode == OpCode::Constants::OP_GENERATOR || opcode == OpCode::Constants::OP_CUR_CLOSURE)
+		{
+			return true;
+		}
+		if (opcode == OpCode::Constants::OP_LSTRING)
+		{
+			next += operands[0];
+		}
+		offset = next;
+	}
+	return false;
+}
+
+OpCode::Constants EscapeAnalysisPass::ScratchOf(OpCode::Constants opcode)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_ARRAY:
+		return OpCode::Constants::OP_ARRAY_SCRATCH;
+	case OpCode::Constants::OP_HASH:
+		return OpCode::Constants::OP_HASH_SCRATCH;
+	case OpCode::Constants::OP_CLOSURE:
+		return OpCode::Constants::OP_CLOSURE_SCRATCH;
+	default:
+		return opcode;
+	}
+}
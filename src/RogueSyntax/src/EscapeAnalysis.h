@@ -0,0 +1,23 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//finds the array, hash and closure literals no reference outlives the frame of, like a temporary `[x, y]` that is indexed
+//or a lambda passed straight to map, and allocates them in the vm's scratch region that the frame releases when it returns
+class EscapeAnalysisPass : public IrPass
+{
+public:
+	std::string Name() const override { return "escape analysis"; }
+	bool Run(IrFunction& function) override;
+
+	//some use of the allocation can keep it past the return of the frame
+	static bool Escapes(const IrFunction& function, const IrInstr& allocation);
+
+private:
+	//stores copy the value, indexing, comparing and branching only read it, builtins say which arguments they are done with
+	static bool Borrows(const IrFunction& function, const IrInstr& allocation, const IrInstr& user, size_t position);
+	//a closure that can get hold of itself while it runs, a generator keeps it and OP_CUR_CLOSURE pushes it
+	static bool ReachesItself(const IrFunction& function, const IrInstr& closure);
+	//the scratch opcode for an allocation, the opcode itself for anything else
+	static OpCode::Constants ScratchOf(OpCode::Constants opcode);
+};
@@ -1,4 +1,5 @@
 #include "pch.h"
+#include "TypedArrays.h"
 
 #include "RecursiveEvaluator.h"
 #include "StackEvaluator.h"
@@ -109,6 +110,10 @@ const IObject* Evaluator::EvalInfixExpression(const uint32_t env, const RSToken&
 	{
 		result = EvalNullInfixExpression(env, optor, left, right);
 	}
+	else if (TypedArrays::IsOperand(left, right))
+	{
+		result = EvalTypedArrayInfixExpression(env, optor, left, right);
+	}
 	else if (left->Type() != right->Type())
 	{
 		if (_coercer.CanCoerceTypes(left, right))
@@ -161,6 +166,31 @@ const IObject* Evaluator::EvalIndexExpression(const uint32_t env, const RSToken&
 			result = arr->Elements[idx->Value];
 		}
 	}
+	else if (operand->IsThisA<RangeObj>() && index->IsThisA<IntegerObj>())
+	{
+		auto range = dynamic_cast<const RangeObj*>(operand);
+		auto idx = dynamic_cast<const IntegerObj*>(index);
+		if (idx->Value < 0 || idx->Value >= range->Count())
+		{
+			result = NullObj::NULL_OBJ_REF;
+		}
+		else
+		{
+			result = EvalFactory->New<IntegerObj>(range->At(idx->Value));
+		}
+	}
+	else if (TypedArrays::IsTypedArray(operand) && index->IsThisA<IntegerObj>())
+	{
+		auto idx = dynamic_cast<const IntegerObj*>(index);
+		if (idx->Value < 0 || idx->Value >= TypedArrays::Size(operand))
+		{
+			result = NullObj::NULL_OBJ_REF;
+		}
+		else
+		{
+			result = TypedArrays::At(EvalFactory.get(), operand, idx->Value);
+		}
+	}
 	else if (operand->IsThisA<StringObj>() && index->IsThisA<IntegerObj>())
 	{
 		auto str = dynamic_cast<const StringObj*>(operand);
@@ -197,6 +227,24 @@ const IObject* Evaluator::EvalIndexExpression(const uint32_t env, const RSToken&
 	return result;
 }
 
+size_t Evaluator::IterationCount(const IObject* iterable) const
+{
+	if (iterable->IsThisA<RangeObj>())
+	{
+		return dynamic_cast<const RangeObj*>(iterable)->Count();
+	}
+	return dynamic_cast<const ArrayObj*>(iterable)->Elements.size();
+}
+
+const IObject* Evaluator::IterationElement(const IObject* iterable, size_t idx) const
+{
+	if (iterable->IsThisA<RangeObj>())
+	{
+		return EvalFactory->New<IntegerObj>(dynamic_cast<const RangeObj*>(iterable)->At(idx));
+	}
+	return dynamic_cast<const ArrayObj*>(iterable)->Elements[idx];
+}
+
 const IObject* Evaluator::EvalNullInfixExpression(const uint32_t env, const RSToken& op, const IObject* const left, const IObject* const right) const
 {
 	//check what side the null is on
@@ -434,6 +482,34 @@ const IObject* Evaluator::EvalStringInfixExpression(const uint32_t env, const RS
 	return result;
 }
 
+const IObject* Evaluator::EvalTypedArrayInfixExpression(const uint32_t env, const RSToken& optor, const IObject* const left, const IObject* const right) const
+{
+	static const std::map<TokenType, VectorOp> arithmetic = {
+		{ TokenType::TOKEN_PLUS, VectorOp::Add }, { TokenType::TOKEN_MINUS, VectorOp::Sub },
+		{ TokenType::TOKEN_ASTERISK, VectorOp::Mul }, { TokenType::TOKEN_SLASH, VectorOp::Div } };
+	static const std::map<TokenType, CompareOp> comparison = {
+		{ TokenType::TOKEN_EQ, CompareOp::Eq }, { TokenType::TOKEN_NOT_EQ, CompareOp::Neq },
+		{ TokenType::TOKEN_LT, CompareOp::Lt }, { TokenType::TOKEN_LT_EQ, CompareOp::Lte },
+		{ TokenType::TOKEN_GT, CompareOp::Gt }, { TokenType::TOKEN_GT_EQ, CompareOp::Gte } };
+
+	try
+	{
+		if (auto op = arithmetic.find(optor.Type); op != arithmetic.end())
+		{
+			return TypedArrays::Arithmetic(EvalFactory.get(), op->second, left, right);
+		}
+		if (auto op = comparison.find(optor.Type); op != comparison.end())
+		{
+			return TypedArrays::Compare(EvalFactory.get(), op->second, left, right);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		return MakeError(env, e.what(), optor);
+	}
+	return MakeError(env, std::format("unknown operator: {} {} {}", left->TypeName(), optor.Literal, right->TypeName()), optor);
+}
+
 const IObject* Evaluator::EvalAsBoolean(const uint32_t env, const RSToken& context, const IObject* const obj) const
 {
 	try
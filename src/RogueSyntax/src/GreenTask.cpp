@@ -0,0 +1,379 @@
+#include "pch.h"
+
+//blocks the calling thread until done, a pool worker runs queued work meanwhile - what it waits for may be queued behind it
+template <typename Pred>
+static void BlockUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& changed, Pred done)
+{
+	auto& pool = WorkStealingPool::Shared();
+	if (!pool.IsWorkerThread())
+	{
+		changed.wait(lock, done);
+		return;
+	}
+	while (!done())
+	{
+		lock.unlock();
+		pool.HelpUntil([&lock, &done]() { std::lock_guard<std::mutex> check(*lock.mutex()); return done(); });
+		lock.lock();
+	}
+}
+
+void TaskGroup::Add(const std::shared_ptr<GreenTask>& task)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_live.emplace(task.get(), task);
+}
+
+void TaskGroup::Remove(GreenTask* task)
+{
+	std::shared_ptr<GreenTask> removed;
+	std::lock_guard<std::mutex> lock(_lock);
+	auto it = _live.find(task);
+	if (it != _live.end())
+	{
+		//released after the lock, it may be the last reference
+		removed = std::move(it->second);
+		_live.erase(it);
+	}
+}
+
+void TaskGroup::Cancel()
+{
+	_cancelled = true;
+	while (true)
+	{
+		//tasks spawned while cancelling stop at their first slice
+		std::unordered_map<GreenTask*, std::shared_ptr<GreenTask>> live;
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			live.swap(_live);
+		}
+		if (live.empty())
+		{
+			return;
+		}
+		//parked tasks have to run once more to notice
+		for (auto& [ptr, task] : live)
+		{
+			task->Wake();
+		}
+		for (auto& [ptr, task] : live)
+		{
+			task->Join(nullptr);
+		}
+	}
+}
+
+GreenTask::GreenTask(const std::shared_ptr<RogueVM>& vm, const std::shared_ptr<TaskGroup>& group) : _vm(vm), _group(group)
+{
+}
+
+GreenTask::~GreenTask()
+{
+}
+
+void GreenTask::Schedule()
+{
+	WorkStealingPool::Shared().Submit([task = shared_from_this()]() { RunSlice(task); });
+}
+
+void GreenTask::Wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (_state == State::Running)
+		{
+			_notified = true;
+			return;
+		}
+		if (_state != State::Parked)
+		{
+			return;
+		}
+		_state = State::Queued;
+	}
+	Schedule();
+}
+
+bool GreenTask::Join(const std::shared_ptr<GreenTask>& waiter)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	if (_state == State::Done)
+	{
+		return true;
+	}
+	if (waiter != nullptr)
+	{
+		_joiners.push_back(waiter);
+		return false;
+	}
+	BlockUntil(lock, _finished, [this]() { return _state == State::Done; });
+	return true;
+}
+
+GreenTask::State GreenTask::GetState() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _state;
+}
+
+void GreenTask::RunSlice(const std::shared_ptr<GreenTask>& task)
+{
+	auto& vm = task->_vm;
+	auto cancelled = [&task]() { return task->_group->Cancelled(); };
+	{
+		std::lock_guard<std::mutex> lock(task->_lock);
+		if (task->_state == State::Done)
+		{
+			return;
+		}
+		task->_state = State::Running;
+		task->_notified = false;
+	}
+	if (cancelled())
+	{
+		task->Finish(nullptr, "task cancelled");
+		return;
+	}
+
+	VmStatus status;
+	std::string error;
+	try
+	{
+		status = vm->RunFor(TASK_SLICE_BUDGET);
+		if (status == VmStatus::Suspended)
+		{
+			//no host drives a task, the worker runs other items until the host operation finished
+			WorkStealingPool::Shared().HelpUntil([&vm]() { return vm->PendingReady(); });
+			vm->ResumePending();
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		status = VmStatus::Error;
+		error = ex.what();
+	}
+
+	switch (status)
+	{
+	case VmStatus::Completed:
+		task->Finish(vm->Top(), "");
+		return;
+	case VmStatus::Error:
+		task->Finish(nullptr, error.empty() && vm->LastPopped() != nullptr ? vm->LastPopped()->Inspect() : error);
+		return;
+	case VmStatus::Blocked:
+	{
+		//a wake that came in while this slice ran means the wait may be over already
+		std::lock_guard<std::mutex> lock(task->_lock);
+		if (!task->_notified && !cancelled())
+		{
+			task->_state = State::Parked;
+			return;
+		}
+		task->_state = State::Queued;
+		break;
+	}
+	default:
+	{
+		//out of budget or yielded, let the others have a turn
+		std::lock_guard<std::mutex> lock(task->_lock);
+		task->_state = State::Queued;
+		break;
+	}
+	}
+	task->Schedule();
+}
+
+void GreenTask::Finish(const IObject* result, const std::string& error)
+{
+	//the result is copied out, the vm and every store it references go away with it
+	//a task's heap can hold handles to the tasks it spawned, those reference the heap again through their vms
+	std::shared_ptr<ObjectStore> store;
+	if (result != nullptr)
+	{
+		store = std::make_shared<ObjectStore>();
+		result = Channel::Transfer(result, store->Factory().get());
+	}
+
+	std::vector<std::weak_ptr<GreenTask>> joiners;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_state = State::Done;
+		_result = result;
+		_resultStore = store;
+		_error = error;
+		joiners.swap(_joiners);
+	}
+	_vm = nullptr;
+	_finished.notify_all();
+	for (auto& joiner : joiners)
+	{
+		if (auto waiting = joiner.lock())
+		{
+			waiting->Wake();
+		}
+	}
+	_group->Remove(this);
+}
+
+Channel::Channel(size_t capacity) : _capacity(capacity), _store(std::make_shared<ObjectStore>())
+{
+	_factory = _store->Factory();
+}
+
+Channel::~Channel()
+{
+}
+
+bool Channel::Send(const IObject* value, const std::shared_ptr<GreenTask>& waiter)
+{
+	std::vector<std::weak_ptr<GreenTask>> receivers;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (!_closed && _buffer.size() >= _capacity)
+		{
+			if (waiter != nullptr)
+			{
+				_senders.push_back(waiter);
+				return false;
+			}
+			BlockUntil(lock, _changed, [this]() { return _closed || _buffer.size() < _capacity; });
+		}
+		if (_closed)
+		{
+			throw std::runtime_error("send on a closed channel");
+		}
+		_buffer.push_back(Transfer(value, _factory.get()));
+		receivers.swap(_receivers);
+	}
+	_changed.notify_all();
+	WakeAll(receivers);
+	return true;
+}
+
+bool Channel::Receive(const IObject*& value, const std::shared_ptr<GreenTask>& waiter)
+{
+	std::vector<std::weak_ptr<GreenTask>> senders;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (!_closed && _buffer.empty())
+		{
+			if (waiter != nullptr)
+			{
+				_receivers.push_back(waiter);
+				return false;
+			}
+			BlockUntil(lock, _changed, [this]() { return _closed || !_buffer.empty(); });
+		}
+		if (_buffer.empty())
+		{
+			//closed and drained
+			value = NullObj::NULL_OBJ_REF;
+			return true;
+		}
+		value = _buffer.front();
+		_buffer.pop_front();
+		senders.swap(_senders);
+	}
+	_changed.notify_all();
+	WakeAll(senders);
+	return true;
+}
+
+void Channel::Close()
+{
+	std::vector<std::weak_ptr<GreenTask>> waiters;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_closed = true;
+		waiters.swap(_senders);
+		waiters.insert(waiters.end(), _receivers.begin(), _receivers.end());
+		_receivers.clear();
+	}
+	_changed.notify_all();
+	WakeAll(waiters);
+}
+
+size_t Channel::Count() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _buffer.size();
+}
+
+bool Channel::Closed() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _closed;
+}
+
+void Channel::WakeAll(std::vector<std::weak_ptr<GreenTask>>& waiters)
+{
+	//every waiter tries again, the ones that lose the race park again
+	for (auto& waiter : waiters)
+	{
+		if (auto task = waiter.lock())
+		{
+			task->Wake();
+		}
+	}
+}
+
+IObject* Channel::Transfer(const IObject* obj, const ObjectFactory* factory)
+{
+	if (obj->IsThisA<ArrayObj>())
+	{
+		std::vector<const IObject*> elements;
+		for (auto* elem : dynamic_cast<const ArrayObj*>(obj)->Elements)
+		{
+			elements.push_back(Transfer(elem, factory));
+		}
+		return factory->New<ArrayObj>(elements);
+	}
+	if (obj->IsThisA<HashObj>())
+	{
+		std::unordered_map<HashKey, HashEntry> elements;
+		for (const auto& [key, entry] : dynamic_cast<const HashObj*>(obj)->Elements)
+		{
+			elements.emplace(key, HashEntry{ Transfer(entry.Key, factory), Transfer(entry.Value, factory) });
+		}
+		return factory->New<HashObj>(elements);
+	}
+	if (obj->IsThisA<FunctionCompiledObj>())
+	{
+		auto fn = dynamic_cast<const FunctionCompiledObj*>(obj);
+		auto copy = factory->New<FunctionCompiledObj>(fn->FuncInstructions, fn->NumLocals, fn->NumParameters);
+		copy->FuncOffset = fn->FuncOffset;
+		copy->MaxStackDepth = fn->MaxStackDepth;
+		return copy;
+	}
+	if (obj->IsThisA<ClosureObj>())
+	{
+		//Clone shares the function, it can live in the sender's nursery
+		auto closure = dynamic_cast<const ClosureObj*>(obj);
+		std::vector<const IObject*> frees;
+		for (auto* free : closure->Frees)
+		{
+			frees.push_back(Transfer(free, factory));
+		}
+		return factory->New<ClosureObj>(dynamic_cast<const FunctionCompiledObj*>(Transfer(closure->Function, factory)), frees);
+	}
+	if (obj->IsThisA<GeneratorObj>())
+	{
+		auto generator = dynamic_cast<const GeneratorObj*>(obj);
+		std::vector<const IObject*> slots;
+		for (auto* slot : generator->Slots)
+		{
+			slots.push_back(slot != nullptr ? Transfer(slot, factory) : nullptr);
+		}
+		auto copy = factory->New<GeneratorObj>(dynamic_cast<const ClosureObj*>(Transfer(generator->Closure, factory)), slots, generator->Ip);
+		copy->Status = generator->Status;
+		return copy;
+	}
+	if (obj->IsThisA<ArrayIteratorObj>())
+	{
+		auto iterator = dynamic_cast<const ArrayIteratorObj*>(obj);
+		return factory->New<ArrayIteratorObj>(dynamic_cast<const ArrayObj*>(Transfer(iterator->Array, factory)), iterator->Next);
+	}
+	return factory->Clone(obj);
+}
@@ -73,7 +73,9 @@ IObject* IdentifierObj::Clone(const ObjectFactory* factory) const
 
 IObject* FunctionCompiledObj::Clone(const ObjectFactory* factory) const
 {
-	return factory->New<FunctionCompiledObj>(FuncInstructions, NumLocals, NumParameters);
+	auto clone = factory->New<FunctionCompiledObj>(FuncInstructions, NumLocals, NumParameters);
+	clone->MaxStackDepth = MaxStackDepth;
+	return clone;
 }
 
 IObject* ReturnObj::Clone(const ObjectFactory* factory) const
@@ -96,6 +98,26 @@ IObject* BreakObj::Clone(const ObjectFactory* factory) const
 	return BREAK_OBJ_REF;
 }
 
+IObject* YieldObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<YieldObj>(Ticks, Blocked);
+}
+
+IObject* PendingObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<PendingObj>(Future);
+}
+
+IObject* TaskObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<TaskObj>(Task);
+}
+
+IObject* ChannelObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<ChannelObj>(Value);
+}
+
 IObject* ClosureObj::Clone(const ObjectFactory* factory) const
 {
 	std::vector<const IObject*> clonedFrees;
@@ -103,6 +125,30 @@ IObject* ClosureObj::Clone(const ObjectFactory* factory) const
 	return factory->New<ClosureObj>(Function, clonedFrees);
 }
 
+IObject* GeneratorObj::Clone(const ObjectFactory* factory) const
+{
+	std::vector<const IObject*> clonedSlots;
+	std::transform(Slots.begin(), Slots.end(), std::back_inserter(clonedSlots), [factory](const auto& slot) { return slot != nullptr ? slot->Clone(factory) : nullptr; });
+	auto clone = factory->New<GeneratorObj>(dynamic_cast<const ClosureObj*>(Closure->Clone(factory)), clonedSlots, Ip);
+	clone->Status = Status;
+	return clone;
+}
+
+IObject* RangeObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<RangeObj>(Start, End, Step);
+}
+
+IObject* RangeIteratorObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<RangeIteratorObj>(Next, End, Step);
+}
+
+IObject* ArrayIteratorObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<ArrayIteratorObj>(dynamic_cast<const ArrayObj*>(Array->Clone(factory)), Next);
+}
+
 const IObject* ArrayObj::Set(const IObject* key, const IObject* value)
 {
 	if (!key->IsThisA<IntegerObj>())
@@ -117,6 +163,91 @@ const IObject* ArrayObj::Set(const IObject* key, const IObject* value)
 	}
 
 	Elements[index->Value] = value;
+	Nursery::WriteBarrier(this, value);
+	return value;
+}
+
+std::string IntArrayObj::Inspect() const
+{
+	std::string out = "intArray([";
+	for (size_t i = 0; i < Values.size(); i++)
+	{
+		out.append(i > 0 ? ", " : "");
+		out.append(std::to_string(Values[i]));
+	}
+	out += "])";
+	return out;
+}
+
+IObject* IntArrayObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<IntArrayObj>(Values);
+}
+
+const IObject* IntArrayObj::Set(const IObject* key, const IObject* value)
+{
+	if (!key->IsThisA<IntegerObj>())
+	{
+		throw std::runtime_error("index must be an integer");
+	}
+	if (!value->IsThisA<IntegerObj>())
+	{
+		throw std::runtime_error("an intArray only holds integers");
+	}
+
+	auto index = dynamic_cast<const IntegerObj*>(key);
+	if (index->Value < 0 || index->Value >= Values.size())
+	{
+		throw std::runtime_error("index out of bounds");
+	}
+
+	//the value is copied into the buffer, no reference is kept
+	Values[index->Value] = dynamic_cast<const IntegerObj*>(value)->Value;
+	return value;
+}
+
+std::string DecimalArrayObj::Inspect() const
+{
+	std::string out = "decimalArray([";
+	for (size_t i = 0; i < Values.size(); i++)
+	{
+		out.append(i > 0 ? ", " : "");
+		out.append(std::to_string(Values[i]));
+	}
+	out += "])";
+	return out;
+}
+
+IObject* DecimalArrayObj::Clone(const ObjectFactory* factory) const
+{
+	return factory->New<DecimalArrayObj>(Values);
+}
+
+const IObject* DecimalArrayObj::Set(const IObject* key, const IObject* value)
+{
+	if (!key->IsThisA<IntegerObj>())
+	{
+		throw std::runtime_error("index must be an integer");
+	}
+
+	auto index = dynamic_cast<const IntegerObj*>(key);
+	if (index->Value < 0 || index->Value >= Values.size())
+	{
+		throw std::runtime_error("index out of bounds");
+	}
+
+	if (value->IsThisA<DecimalObj>())
+	{
+		Values[index->Value] = dynamic_cast<const DecimalObj*>(value)->Value;
+	}
+	else if (value->IsThisA<IntegerObj>())
+	{
+		Values[index->Value] = static_cast<float>(dynamic_cast<const IntegerObj*>(value)->Value);
+	}
+	else
+	{
+		throw std::runtime_error("a decimalArray only holds numbers");
+	}
 	return value;
 }
 
@@ -125,6 +256,8 @@ const IObject* HashObj::Set(const IObject* key, const IObject* value)
 	auto hashKey = HashKey(key->Type(), key->Inspect());
 		
 	Elements[hashKey] = HashEntry{key, value};
+	Nursery::WriteBarrier(this, key);
+	Nursery::WriteBarrier(this, value);
 	return value;
 }
 
@@ -143,6 +276,12 @@ std::function<IObject*(const std::vector<const IObject*>& args)> BuiltInObj::Res
 	return externals->GetBuiltInFunction(Name);
 }
 
+std::function<IObject*(const std::vector<const IObject*>& args)> BuiltInObj::Resolve(std::shared_ptr<BuiltIn> externals, const ObjectFactory* factory) const
+{
+	auto idx = Idx != -1 ? Idx : externals->BuiltInIdx(Name);
+	return externals->GetBuiltInFunction(idx, factory);
+}
+
 
 
 
@@ -0,0 +1,949 @@
+#include "IrFunction.h"
+#include <pch.h>
+
+namespace
+{
+	std::string OpName(OpCode::Constants opcode)
+	{
+		auto def = OpCode::Lookup(opcode);
+		if (std::holds_alternative<std::string>(def))
+		{
+			return std::format("OP_{}", static_cast<uint32_t>(opcode));
+		}
+		return std::get<Definition>(def).Name;
+	}
+
+	std::string SlotName(uint32_t encoded)
+	{
+		switch (GetTypeFromIdx(encoded))
+		{
+		case ScopeType::SCOPE_GLOBAL: return std::format("global {}", AdjustIdx(encoded));
+		case ScopeType::SCOPE_LOCAL: return std::format("local {}", AdjustIdx(encoded));
+		case ScopeType::SCOPE_EXTERN: return std::format("extern {}", AdjustIdx(encoded));
+		default: return std::format("free {}", AdjustIdx(encoded));
+		}
+	}
+}
+
+bool IrInstr::IsBranch() const
+{
+	return Op == OpCode::Constants::OP_JUMP || Op == OpCode::Constants::OP_JUMPIFZ
+		|| Op == OpCode::Constants::OP_ITER_NEXT || Op == OpCode::Constants::OP_FOR_RANGE;
+}
+
+bool IrInstr::IsTerminator() const
+{
+	return IsBranch() || Op == OpCode::Constants::OP_RETURN || Op == OpCode::Constants::OP_RET_VAL || Op == OpCode::Constants::OP_GEN_RETURN;
+}
+
+IrInstr* IrBlock::Last()
+{
+	for (auto it = Instrs.rbegin(); it != Instrs.rend(); ++it)
+	{
+		if (!it->Dead)
+		{
+			return &(*it);
+		}
+	}
+	return nullptr;
+}
+
+const IrInstr* IrBlock::Last() const
+{
+	return const_cast<IrBlock*>(this)->Last();
+}
+
+std::vector<uint32_t> IrBlock::Succs() const
+{
+	std::vector<uint32_t> succs;
+	if (Target != IrNoBlock)
+	{
+		succs.push_back(Target);
+	}
+	if (Next != IrNoBlock)
+	{
+		succs.push_back(Next);
+	}
+	return succs;
+}
+
+uint32_t IrFunction::Pops(OpCode::Constants opcode, const std::vector<uint32_t>& operands)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_ADD:
+	case OpCode::Constants::OP_SUB:
+	case OpCode::Constants::OP_MUL:
+	case OpCode::Constants::OP_DIV:
+	case OpCode::Constants::OP_MOD:
+	case OpCode::Constants::OP_BOR:
+	case OpCode::Constants::OP_BAND:
+	case OpCode::Constants::OP_BXOR:
+	case OpCode::Constants::OP_BLSHIFT:
+	case OpCode::Constants::OP_BRSHIFT:
+	case OpCode::Constants::OP_EQ:
+	case OpCode::Constants::OP_NEQ:
+	case OpCode::Constants::OP_GT:
+	case OpCode::Constants::OP_GTE:
+	case OpCode::Constants::OP_LT:
+	case OpCode::Constants::OP_LTE:
+	case OpCode::Constants::OP_AND:
+	case OpCode::Constants::OP_OR:
+	case OpCode::Constants::OP_INDEX:
+	case OpCode::Constants::OP_INDEX_NOCHECK:
+	case OpCode::Constants::OP_ADD_II:
+	case OpCode::Constants::OP_LT_II:
+	case OpCode::Constants::OP_CONCAT_SS:
+		return 2;
+	case OpCode::Constants::OP_NEGATE:
+	case OpCode::Constants::OP_NOT:
+	case OpCode::Constants::OP_BNOT:
+	case OpCode::Constants::OP_POP:
+	case OpCode::Constants::OP_JUMPIFZ:
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_RET_VAL:
+	case OpCode::Constants::OP_YIELD:
+	case OpCode::Constants::OP_ITER:
+		return 1;
+	case OpCode::Constants::OP_SET_ASSIGN:
+		return 3;
+	case OpCode::Constants::OP_ARRAY:
+	case OpCode::Constants::OP_ARRAY_SCRATCH:
+		return operands[0];
+	case OpCode::Constants::OP_HASH:
+	case OpCode::Constants::OP_HASH_SCRATCH:
+		return 2 * operands[0];
+	case OpCode::Constants::OP_CALL:
+	case OpCode::Constants::OP_CLOSURE:
+	case OpCode::Constants::OP_CLOSURE_SCRATCH:
+		return operands[0] + 1;
+	default:
+		//literals, loads, jumps and returns, OP_ITER_NEXT only peeks at the iterator
+		return 0;
+	}
+}
+
+uint32_t IrFunction::Pushes(OpCode::Constants opcode)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_POP:
+	case OpCode::Constants::OP_JUMP:
+	case OpCode::Constants::OP_JUMPIFZ:
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_SET_ASSIGN:
+	case OpCode::Constants::OP_RETURN:
+	case OpCode::Constants::OP_RET_VAL:
+	case OpCode::Constants::OP_GENERATOR:
+	case OpCode::Constants::OP_GEN_RETURN:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+bool IrFunction::IsPure(OpCode::Constants opcode)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_LINT:
+	case OpCode::Constants::OP_LDECIMAL:
+	case OpCode::Constants::OP_LSTRING:
+	case OpCode::Constants::OP_LFUN:
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+	case OpCode::Constants::OP_NULL:
+	case OpCode::Constants::OP_GET:
+	case OpCode::Constants::OP_CUR_CLOSURE:
+	case OpCode::Constants::OP_ARRAY:
+	case OpCode::Constants::OP_CLOSURE:
+	case OpCode::Constants::OP_ARRAY_SCRATCH:
+	case OpCode::Constants::OP_CLOSURE_SCRATCH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void IrFunction::CountGlobalAccesses(const RSInstructions& body, std::unordered_map<uint32_t, uint32_t>& reads, std::unordered_map<uint32_t, uint32_t>& writes)
+{
+	size_t offset = 0;
+	while (offset < body.size())
+	{
+		auto [opcode, operands, next] = OpCode::ReadOperand(body, offset);
+		auto global = !operands.empty() && GetTypeFromIdx(operands[0]) == ScopeType::SCOPE_GLOBAL;
+		if (global && (opcode == OpCode::Constants::OP_GET || opcode == OpCode::Constants::OP_SET_ASSIGN))
+		{
+			reads[operands[0]]++;
+		}
+		if (global && (opcode == OpCode::Constants::OP_SET || opcode == OpCode::Constants::OP_SET_ASSIGN))
+		{
+			writes[operands[0]]++;
+		}
+		//a nested body follows its OP_LFUN inline and is scanned in place, string data is skipped
+		if (opcode == OpCode::Constants::OP_LSTRING)
+		{
+			next += operands[0];
+		}
+		offset = next;
+	}
+}
+
+std::unordered_map<uint32_t, uint32_t> IrFunction::NestedGlobalWrites() const
+{
+	std::unordered_map<uint32_t, uint32_t> reads;
+	std::unordered_map<uint32_t, uint32_t> writes;
+	for (auto id : Layout)
+	{
+		for (auto& instr : Blocks[id].Instrs)
+		{
+			if (!instr.Dead && instr.Op == OpCode::Constants::OP_LFUN)
+			{
+				CountGlobalAccesses(instr.Data, reads, writes);
+			}
+		}
+	}
+	return writes;
+}
+
+bool IrFunction::TracksSlot(uint32_t slot, const std::unordered_map<uint32_t, uint32_t>& nestedWrites, bool includeFree) const
+{
+	switch (GetTypeFromIdx(slot))
+	{
+	case ScopeType::SCOPE_LOCAL:
+		return true;
+	case ScopeType::SCOPE_FREE:
+		return includeFree;
+	case ScopeType::SCOPE_GLOBAL:
+		//only the top level sees every store to a global
+		return IsProgram && !nestedWrites.contains(slot);
+	default:
+		return false;
+	}
+}
+
+IrFunction IrFunction::Lift(const std::string& name, const RSInstructions& instructions, const std::vector<DebugSymbol>& debugSymbols)
+{
+	IrFunction function;
+	function.Name = name;
+
+	std::vector<size_t> offsets;
+	std::vector<IrInstr> decoded;
+	std::set<size_t> leaders{ 0 };
+	std::set<size_t> targets;
+
+	size_t offset = 0;
+	while (offset < instructions.size())
+	{
+		auto [opcode, operands, next] = OpCode::ReadOperand(instructions, offset);
+		IrInstr instr{ opcode, operands };
+		if (opcode == OpCode::Constants::OP_LSTRING || opcode == OpCode::Constants::OP_LFUN)
+		{
+			auto length = opcode == OpCode::Constants::OP_LSTRING ? operands[0] : operands[2];
+			instr.Data.assign(instructions.begin() + next, instructions.begin() + next + length);
+			next += length;
+		}
+
+		if (instr.IsBranch())
+		{
+			leaders.insert(operands[0]);
+			targets.insert(operands[0]);
+		}
+		if (instr.IsTerminator())
+		{
+			leaders.insert(next);
+		}
+		offsets.push_back(offset);
+		decoded.push_back(std::move(instr));
+		offset = next;
+	}
+
+	//every debug symbol belongs to the instruction whose bytes hold its offset
+	for (auto& symbol : debugSymbols)
+	{
+		auto it = std::upper_bound(offsets.begin(), offsets.end(), symbol.Offset);
+		if (symbol.Offset >= instructions.size() || it == offsets.begin())
+		{
+			auto trailing = symbol;
+			trailing.Offset = 0;
+			function.TrailingDebug.push_back(trailing);
+			continue;
+		}
+		auto index = std::distance(offsets.begin(), it) - 1;
+		auto relative = symbol;
+		relative.Offset = symbol.Offset - offsets[index];
+		decoded[index].Debug.push_back(relative);
+	}
+
+	std::unordered_map<size_t, uint32_t> blockAt;
+	for (size_t i = 0; i < decoded.size(); i++)
+	{
+		if (function.Layout.empty() || leaders.contains(offsets[i]))
+		{
+			auto id = function.AddBlock();
+			function.Layout.push_back(id);
+			blockAt[offsets[i]] = id;
+		}
+		function.Blocks.back().Instrs.push_back(std::move(decoded[i]));
+	}
+
+	//a jump past the last instruction lands on an empty block
+	if (targets.contains(instructions.size()) || function.Layout.empty())
+	{
+		auto id = function.AddBlock();
+		function.Layout.push_back(id);
+		blockAt[instructions.size()] = id;
+	}
+
+	for (size_t i = 0; i < function.Layout.size(); i++)
+	{
+		auto& block = function.Blocks[function.Layout[i]];
+		auto* last = block.Last();
+		if (last != nullptr && last->IsBranch())
+		{
+			auto target = blockAt.find(last->Operands[0]);
+			if (target == blockAt.end())
+			{
+				throw std::runtime_error(std::format("jump into the middle of an instruction at {}", last->Operands[0]));
+			}
+			block.Target = target->second;
+		}
+
+		auto fallsThrough = last == nullptr || !last->IsTerminator() || last->Op == OpCode::Constants::OP_JUMPIFZ
+			|| last->Op == OpCode::Constants::OP_ITER_NEXT || last->Op == OpCode::Constants::OP_FOR_RANGE;
+		if (fallsThrough && i + 1 < function.Layout.size())
+		{
+			block.Next = function.Layout[i + 1];
+		}
+	}
+
+	function.BuildSsa();
+	return function;
+}
+
+uint32_t IrFunction::AddBlock()
+{
+	IrBlock block;
+	block.Id = static_cast<uint32_t>(Blocks.size());
+	Blocks.push_back(block);
+	return block.Id;
+}
+
+uint32_t IrFunction::AddSlot()
+{
+	auto index = NumSlots++;
+	return IsProgram ? index : (index | 0x8000);
+}
+
+uint32_t IrFunction::NewValue(IrValueKind kind, uint32_t block, uint32_t index)
+{
+	Values.push_back(IrValue{ kind, block, index, {} });
+	return static_cast<uint32_t>(Values.size() - 1);
+}
+
+const IrInstr* IrFunction::DefOf(uint32_t value) const
+{
+	auto& def = Values[value];
+	if (def.Kind != IrValueKind::Instr)
+	{
+		return nullptr;
+	}
+	return &Blocks[def.Block].Instrs[def.Index];
+}
+
+void IrFunction::BuildSsa()
+{
+	Values.assign(1, IrValue{});
+	for (auto& block : Blocks)
+	{
+		block.Phis.clear();
+		block.Preds.clear();
+		block.ExitStack.clear();
+		block.BranchStack.clear();
+		block.Reachable = false;
+	}
+
+	//one entry per incoming edge, the flag tells the branch edge from the fallthrough
+	std::vector<std::vector<std::pair<uint32_t, bool>>> edges(Blocks.size());
+	for (auto id : Layout)
+	{
+		auto& block = Blocks[id];
+		if (block.Target != IrNoBlock)
+		{
+			edges[block.Target].push_back({ id, true });
+			Blocks[block.Target].Preds.push_back(id);
+		}
+		if (block.Next != IrNoBlock)
+		{
+			edges[block.Next].push_back({ id, false });
+			Blocks[block.Next].Preds.push_back(id);
+		}
+	}
+
+	//stack depth on entry, decided by the first edge that reaches a block, unreachable blocks start empty
+	std::vector<uint32_t> entryDepth(Blocks.size(), 0);
+	if (!Layout.empty())
+	{
+		std::vector<uint32_t> pending{ Layout[0] };
+		Blocks[Layout[0]].Reachable = true;
+		while (!pending.empty())
+		{
+			auto id = pending.back();
+			pending.pop_back();
+			auto& block = Blocks[id];
+
+			int64_t depth = entryDepth[id];
+			int64_t branchDepth = depth;
+			for (auto& instr : block.Instrs)
+			{
+				if (instr.Dead)
+				{
+					continue;
+				}
+				depth = std::max<int64_t>(0, depth - Pops(instr.Op, instr.Operands)) + Pushes(instr.Op);
+				branchDepth = depth;
+				if (instr.Op == OpCode::Constants::OP_ITER_NEXT || instr.Op == OpCode::Constants::OP_FOR_RANGE)
+				{
+					branchDepth = std::max<int64_t>(0, depth - 2);
+				}
+			}
+
+			for (auto [succ, succDepth] : { std::pair{ block.Target, branchDepth }, std::pair{ block.Next, depth } })
+			{
+				if (succ != IrNoBlock && !Blocks[succ].Reachable)
+				{
+					Blocks[succ].Reachable = true;
+					entryDepth[succ] = static_cast<uint32_t>(succDepth);
+					pending.push_back(succ);
+				}
+			}
+		}
+	}
+
+	for (auto id : Layout)
+	{
+		auto& block = Blocks[id];
+		std::vector<uint32_t> stack;
+		for (uint32_t slot = 0; slot < entryDepth[id]; slot++)
+		{
+			block.Phis.push_back(IrPhi{ NewValue(IrValueKind::Phi, id, slot), {} });
+			stack.push_back(block.Phis.back().Result);
+		}
+
+		for (uint32_t index = 0; index < block.Instrs.size(); index++)
+		{
+			auto& instr = block.Instrs[index];
+			instr.Args.clear();
+			instr.Result = IrNoValue;
+			if (instr.Dead)
+			{
+				continue;
+			}
+
+			auto pops = Pops(instr.Op, instr.Operands);
+			instr.Args.resize(pops);
+			for (auto slot = pops; slot > 0; slot--)
+			{
+				uint32_t value;
+				if (stack.empty())
+				{
+					value = NewValue(IrValueKind::Undefined, id, index);
+				}
+				else
+				{
+					value = stack.back();
+					stack.pop_back();
+				}
+				instr.Args[slot - 1] = value;
+				Values[value].Uses.push_back(IrUse{ id, index, false });
+			}
+
+			if (Pushes(instr.Op) > 0)
+			{
+				instr.Result = NewValue(IrValueKind::Instr, id, index);
+				stack.push_back(instr.Result);
+			}
+		}
+
+		block.ExitStack = stack;
+		block.BranchStack = stack;
+		auto* last = block.Last();
+		if (last != nullptr && (last->Op == OpCode::Constants::OP_ITER_NEXT || last->Op == OpCode::Constants::OP_FOR_RANGE))
+		{
+			//an exhausted iterator is popped instead of pushing a value
+			block.BranchStack.resize(stack.size() >= 2 ? stack.size() - 2 : 0);
+		}
+	}
+
+	for (auto id : Layout)
+	{
+		auto& block = Blocks[id];
+		for (uint32_t slot = 0; slot < block.Phis.size(); slot++)
+		{
+			auto& phi = block.Phis[slot];
+			for (auto [pred, isBranch] : edges[id])
+			{
+				auto& incoming = isBranch ? Blocks[pred].BranchStack : Blocks[pred].ExitStack;
+				auto value = slot < incoming.size() ? incoming[slot] : NewValue(IrValueKind::Undefined, pred, 0);
+				phi.Incoming.push_back(value);
+				Values[value].Uses.push_back(IrUse{ id, slot, true });
+			}
+		}
+	}
+}
+
+std::vector<uint32_t> IrFunction::ReversePostOrder() const
+{
+	std::vector<uint32_t> order;
+	if (Layout.empty())
+	{
+		return order;
+	}
+
+	//iterative depth first search, a block is finished once all its successors are
+	std::vector<bool> visited(Blocks.size(), false);
+	std::vector<std::pair<uint32_t, size_t>> pending{ { Layout[0], 0 } };
+	visited[Layout[0]] = true;
+	while (!pending.empty())
+	{
+		auto& [id, next] = pending.back();
+		auto succs = Blocks[id].Succs();
+		if (next < succs.size())
+		{
+			auto succ = succs[next++];
+			if (!visited[succ])
+			{
+				visited[succ] = true;
+				pending.push_back({ succ, 0 });
+			}
+			continue;
+		}
+		order.push_back(id);
+		pending.pop_back();
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+std::vector<uint32_t> IrFunction::Dominators() const
+{
+	//cooper, harvey and kennedy's iterative algorithm over the reverse post order
+	std::vector<uint32_t> idom(Blocks.size(), IrNoBlock);
+	auto order = ReversePostOrder();
+	if (order.empty())
+	{
+		return idom;
+	}
+
+	std::vector<uint32_t> position(Blocks.size(), UINT32_MAX);
+	for (uint32_t i = 0; i < order.size(); i++)
+	{
+		position[order[i]] = i;
+	}
+
+	auto entry = order[0];
+	idom[entry] = entry;
+	auto changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 1; i < order.size(); i++)
+		{
+			auto id = order[i];
+			auto newIdom = IrNoBlock;
+			for (auto pred : Blocks[id].Preds)
+			{
+				if (idom[pred] == IrNoBlock)
+				{
+					continue;
+				}
+				if (newIdom == IrNoBlock)
+				{
+					newIdom = pred;
+					continue;
+				}
+
+				auto a = pred;
+				auto b = newIdom;
+				while (a != b)
+				{
+					while (position[a] > position[b])
+					{
+						a = idom[a];
+					}
+					while (position[b] > position[a])
+					{
+						b = idom[b];
+					}
+				}
+				newIdom = a;
+			}
+
+			if (newIdom != IrNoBlock && idom[id] != newIdom)
+			{
+				idom[id] = newIdom;
+				changed = true;
+			}
+		}
+	}
+	idom[entry] = IrNoBlock;
+	return idom;
+}
+
+bool IrFunction::Dominates(const std::vector<uint32_t>& idom, uint32_t dominator, uint32_t block)
+{
+	while (block != IrNoBlock)
+	{
+		if (block == dominator)
+		{
+			return true;
+		}
+		block = idom[block];
+	}
+	return false;
+}
+
+std::vector<IrLoop> IrFunction::Loops() const
+{
+	auto idom = Dominators();
+	std::map<uint32_t, IrLoop> loops;
+	for (auto id : ReversePostOrder())
+	{
+		for (auto succ : Blocks[id].Succs())
+		{
+			if (!Dominates(idom, succ, id))
+			{
+				continue;
+			}
+
+			//a back edge, walk up from its tail until the header
+			auto& loop = loops[succ];
+			loop.Header = succ;
+			loop.Blocks.insert(succ);
+			std::vector<uint32_t> pending{ id };
+			while (!pending.empty())
+			{
+				auto block = pending.back();
+				pending.pop_back();
+				if (!loop.Blocks.insert(block).second)
+				{
+					continue;
+				}
+				pending.insert(pending.end(), Blocks[block].Preds.begin(), Blocks[block].Preds.end());
+			}
+		}
+	}
+
+	std::vector<IrLoop> result;
+	for (auto& [header, loop] : loops)
+	{
+		result.push_back(loop);
+	}
+	//a loop nested in another has fewer blocks
+	std::ranges::stable_sort(result, [](const IrLoop& a, const IrLoop& b) { return a.Blocks.size() < b.Blocks.size(); });
+	return result;
+}
+
+uint32_t IrFunction::Preheader(const IrLoop& loop)
+{
+	//one entry per edge, a block can reach the header by jumping and by falling through
+	std::vector<uint32_t> outside;
+	for (auto pred : Blocks[loop.Header].Preds)
+	{
+		if (!loop.Blocks.contains(pred))
+		{
+			outside.push_back(pred);
+		}
+	}
+
+	//a single block that always goes on to the header already is one
+	if (outside.size() == 1)
+	{
+		auto& pred = Blocks[outside[0]];
+		auto* last = pred.Last();
+		if (pred.Succs().size() == 1 && (last == nullptr || !last->IsBranch() || last->Op == OpCode::Constants::OP_JUMP))
+		{
+			return outside[0];
+		}
+	}
+
+	auto id = AddBlock();
+	Blocks[id].Next = loop.Header;
+	for (auto pred : outside)
+	{
+		auto& block = Blocks[pred];
+		if (block.Target == loop.Header)
+		{
+			block.Target = id;
+		}
+		if (block.Next == loop.Header)
+		{
+			block.Next = id;
+		}
+	}
+	Layout.insert(std::ranges::find(Layout, loop.Header), id);
+	return id;
+}
+
+std::vector<std::string> IrFunction::Verify() const
+{
+	std::vector<std::string> problems;
+	if (Layout.empty())
+	{
+		problems.push_back(std::format("{}: no entry block", Name));
+		return problems;
+	}
+
+	std::set<uint32_t> laidOut;
+	for (auto id : Layout)
+	{
+		if (id >= Blocks.size() || !laidOut.insert(id).second)
+		{
+			problems.push_back(std::format("{}: block b{} is laid out twice or does not exist", Name, id));
+		}
+	}
+	if (!problems.empty())
+	{
+		return problems;
+	}
+
+	for (auto id : Layout)
+	{
+		auto& block = Blocks[id];
+		for (auto succ : block.Succs())
+		{
+			if (!laidOut.contains(succ))
+			{
+				problems.push_back(std::format("{}: b{} branches to b{} which is not laid out", Name, id, succ));
+			}
+		}
+
+		for (size_t i = 0; i < block.Instrs.size(); i++)
+		{
+			auto& instr = block.Instrs[i];
+			if (!instr.Dead && instr.IsTerminator() && &instr != block.Last())
+			{
+				problems.push_back(std::format("{}: {} in the middle of b{}", Name, OpName(instr.Op), id));
+			}
+		}
+
+		auto* last = block.Last();
+		auto isBranch = last != nullptr && last->IsBranch();
+		if (isBranch != (block.Target != IrNoBlock))
+		{
+			problems.push_back(std::format("{}: b{} branch target does not match its last instruction", Name, id));
+		}
+		auto ends = last != nullptr && last->IsTerminator() && last->Op != OpCode::Constants::OP_JUMPIFZ
+			&& last->Op != OpCode::Constants::OP_ITER_NEXT && last->Op != OpCode::Constants::OP_FOR_RANGE;
+		if (ends && block.Next != IrNoBlock)
+		{
+			problems.push_back(std::format("{}: b{} falls through after {}", Name, id, OpName(last->Op)));
+		}
+
+		//nothing is known about the stack of code that never runs
+		if (!block.Reachable)
+		{
+			continue;
+		}
+		if (block.Target != IrNoBlock && block.BranchStack.size() != Blocks[block.Target].Phis.size())
+		{
+			problems.push_back(std::format("{}: b{} leaves {} values for b{} which expects {}", Name, id, block.BranchStack.size(), block.Target, Blocks[block.Target].Phis.size()));
+		}
+		if (block.Next != IrNoBlock && block.ExitStack.size() != Blocks[block.Next].Phis.size())
+		{
+			problems.push_back(std::format("{}: b{} leaves {} values for b{} which expects {}", Name, id, block.ExitStack.size(), block.Next, Blocks[block.Next].Phis.size()));
+		}
+	}
+
+	for (uint32_t value = 1; value < Values.size(); value++)
+	{
+		auto& def = Values[value];
+		if (def.Kind == IrValueKind::Undefined && def.Block != IrNoBlock && Blocks[def.Block].Reachable)
+		{
+			problems.push_back(std::format("{}: b{} pops more values than it has", Name, def.Block));
+		}
+	}
+	return problems;
+}
+
+std::string IrFunction::PrintInstr(const IrInstr& instr) const
+{
+	std::string operand;
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	{
+		auto raw = instr.Operands[0];
+		operand = std::to_string(reinterpret_cast<int32_t&>(raw));
+		break;
+	}
+	case OpCode::Constants::OP_LDECIMAL:
+	{
+		auto raw = instr.Operands[0];
+		operand = std::format("{}", reinterpret_cast<float&>(raw));
+		break;
+	}
+	case OpCode::Constants::OP_LSTRING:
+		operand = std::format("\"{}\"", std::string(instr.Data.begin(), instr.Data.end()));
+		break;
+	case OpCode::Constants::OP_LFUN:
+		operand = std::format("locals={} params={} bytes={}", instr.Operands[0], instr.Operands[1], instr.Operands[2]);
+		break;
+	case OpCode::Constants::OP_GET:
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_SET_ASSIGN:
+		operand = SlotName(instr.Operands[0]);
+		break;
+	case OpCode::Constants::OP_JUMP:
+	case OpCode::Constants::OP_JUMPIFZ:
+	case OpCode::Constants::OP_ITER_NEXT:
+	case OpCode::Constants::OP_FOR_RANGE:
+		//branch targets are printed on the block
+		break;
+	default:
+		for (auto value : instr.Operands)
+		{
+			operand += operand.empty() ? std::to_string(value) : std::format(" {}", value);
+		}
+		break;
+	}
+
+	std::string result = instr.Result != IrNoValue ? std::format("v{} = ", instr.Result) : "";
+	result += OpName(instr.Op);
+	if (!operand.empty())
+	{
+		result += std::format(" [{}]", operand);
+	}
+	for (auto arg : instr.Args)
+	{
+		result += Values[arg].Kind == IrValueKind::Undefined ? " undef" : std::format(" v{}", arg);
+	}
+	return result;
+}
+
+std::string IrFunction::Print() const
+{
+	std::string result = std::format("fn {}\n", Name);
+	for (auto id : Layout)
+	{
+		auto& block = Blocks[id];
+		result += std::format("b{}:", id);
+		for (size_t i = 0; i < block.Preds.size(); i++)
+		{
+			result += std::format("{}b{}", i == 0 ? " <- " : ", ", block.Preds[i]);
+		}
+		result += block.Reachable ? "\n" : " (unreachable)\n";
+
+		for (auto& phi : block.Phis)
+		{
+			result += std::format("  v{} = phi", phi.Result);
+			for (size_t i = 0; i < phi.Incoming.size(); i++)
+			{
+				auto value = phi.Incoming[i];
+				auto name = Values[value].Kind == IrValueKind::Undefined ? std::string("undef") : std::format("v{}", value);
+				result += std::format("{} {} (b{})", i == 0 ? "" : ",", name, block.Preds[i]);
+			}
+			result += '\n';
+		}
+
+		for (auto& instr : block.Instrs)
+		{
+			if (!instr.Dead)
+			{
+				result += std::format("  {}\n", PrintInstr(instr));
+			}
+		}
+
+		if (block.Target != IrNoBlock)
+		{
+			result += std::format("  branch b{}\n", block.Target);
+		}
+		if (block.Next != IrNoBlock)
+		{
+			result += std::format("  next b{}\n", block.Next);
+		}
+	}
+	return result;
+}
+
+void IrFunction::Lower(RSInstructions& instructions, std::vector<DebugSymbol>& debugSymbols) const
+{
+	instructions.clear();
+	debugSymbols.clear();
+
+	std::vector<size_t> blockOffsets(Blocks.size(), 0);
+	std::vector<std::pair<size_t, uint32_t>> patches;
+	//symbols of dropped instructions describe whatever takes their place
+	std::vector<DebugSymbol> pending;
+
+	auto place = [&](const DebugSymbol& symbol, size_t offset)
+		{
+			auto placed = symbol;
+			placed.Offset = offset;
+			debugSymbols.push_back(placed);
+		};
+
+	for (size_t i = 0; i < Layout.size(); i++)
+	{
+		auto& block = Blocks[Layout[i]];
+		blockOffsets[block.Id] = instructions.size();
+
+		for (auto& instr : block.Instrs)
+		{
+			if (instr.Dead)
+			{
+				for (auto& symbol : instr.Debug)
+				{
+					if (symbol.Offset == 0)
+					{
+						pending.push_back(symbol);
+					}
+				}
+				continue;
+			}
+
+			for (auto& symbol : pending)
+			{
+				place(symbol, instructions.size());
+			}
+			pending.clear();
+			for (auto& symbol : instr.Debug)
+			{
+				place(symbol, instructions.size() + symbol.Offset);
+			}
+
+			if (instr.IsBranch())
+			{
+				patches.push_back({ instructions.size(), block.Target });
+			}
+			auto bytes = OpCode::Make(instr.Op, instr.Operands);
+			instructions.insert(instructions.end(), bytes.begin(), bytes.end());
+			instructions.insert(instructions.end(), instr.Data.begin(), instr.Data.end());
+		}
+
+		//a fallthrough to a block that is no longer next in line needs a jump
+		auto following = i + 1 < Layout.size() ? Layout[i + 1] : IrNoBlock;
+		if (block.Next != IrNoBlock && block.Next != following)
+		{
+			patches.push_back({ instructions.size(), block.Next });
+			auto bytes = OpCode::Make(OpCode::Constants::OP_JUMP, { 0 });
+			instructions.insert(instructions.end(), bytes.begin(), bytes.end());
+		}
+	}
+
+	for (auto& symbol : pending)
+	{
+		place(symbol, instructions.size());
+	}
+	for (auto& symbol : TrailingDebug)
+	{
+		place(symbol, instructions.size());
+	}
+
+	for (auto [position, target] : patches)
+	{
+		auto offset = blockOffsets[target];
+		instructions[position + 1] = (offset >> 8) & 0xFF;
+		instructions[position + 2] = offset & 0xFF;
+	}
+}
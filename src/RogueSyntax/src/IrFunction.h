@@ -0,0 +1,157 @@
+#pragma once
+#include <StandardLib.h>
+#include <OpCode.h>
+
+//mid-level ir, a control flow graph lifted from the stack code of one compilation unit
+//every value on the operand stack is an ssa value, locals and globals stay memory behind OP_GET/OP_SET
+//instructions keep their stack order so a block lowers by emitting them as they are: a pass that drops a
+//value drops (or rewrites) its consumer too, then BuildSsa renumbers everything
+
+constexpr uint32_t IrNoValue = 0;
+constexpr uint32_t IrNoBlock = UINT32_MAX;
+
+struct IrInstr
+{
+	OpCode::Constants Op;
+	std::vector<uint32_t> Operands;
+	//characters of an OP_LSTRING, the body of an OP_LFUN
+	RSInstructions Data;
+	//debug symbols at this instruction, offsets relative to its first byte (an OP_LFUN carries its body's too)
+	std::vector<DebugSymbol> Debug;
+	//skipped when lowering, its debug symbols move to the next instruction
+	bool Dead = false;
+
+	//filled by BuildSsa, values popped (bottom of the stack first) and the value pushed
+	std::vector<uint32_t> Args;
+	uint32_t Result = IrNoValue;
+
+	bool IsBranch() const;
+	bool IsTerminator() const;
+};
+
+struct IrPhi
+{
+	uint32_t Result = IrNoValue;
+	//one value per incoming edge, same order as IrBlock::Preds
+	std::vector<uint32_t> Incoming;
+};
+
+struct IrBlock
+{
+	uint32_t Id = 0;
+	std::vector<IrInstr> Instrs;
+	//block the branch at the end jumps to, and the block reached by falling through
+	uint32_t Target = IrNoBlock;
+	uint32_t Next = IrNoBlock;
+
+	//filled by BuildSsa, one phi per stack slot live on entry (bottom first) and one pred per incoming edge
+	std::vector<IrPhi> Phis;
+	std::vector<uint32_t> Preds;
+	std::vector<uint32_t> ExitStack;
+	std::vector<uint32_t> BranchStack;
+	bool Reachable = false;
+
+	//the last live instruction, nullptr for an empty block
+	IrInstr* Last();
+	const IrInstr* Last() const;
+	std::vector<uint32_t> Succs() const;
+};
+
+enum class IrValueKind
+{
+	Undefined, //popped from an empty stack, only happens in unreachable code
+	Phi,
+	Instr,
+};
+
+struct IrUse
+{
+	uint32_t Block;
+	uint32_t Index;
+	bool IsPhi;
+};
+
+struct IrValue
+{
+	IrValueKind Kind = IrValueKind::Undefined;
+	uint32_t Block = IrNoBlock;
+	uint32_t Index = 0;
+	std::vector<IrUse> Uses;
+};
+
+struct IrLoop
+{
+	uint32_t Header = IrNoBlock;
+	//the header and every block that reaches a back edge to it without passing through it
+	std::set<uint32_t> Blocks;
+};
+
+class IrFunction
+{
+public:
+	//jump operands are relative to the start of the instructions, like a function body
+	static IrFunction Lift(const std::string& name, const RSInstructions& instructions, const std::vector<DebugSymbol>& debugSymbols);
+	void Lower(RSInstructions& instructions, std::vector<DebugSymbol>& debugSymbols) const;
+
+	//recomputes preds, phis and values from the blocks, passes call it after changing instructions or edges
+	void BuildSsa();
+	//empty when the graph is consistent
+	std::vector<std::string> Verify() const;
+	std::string Print() const;
+
+	//reachable blocks, every block before its successors except along back edges
+	std::vector<uint32_t> ReversePostOrder() const;
+	//immediate dominator of every block, IrNoBlock for the entry and for unreachable blocks
+	std::vector<uint32_t> Dominators() const;
+	static bool Dominates(const std::vector<uint32_t>& idom, uint32_t dominator, uint32_t block);
+	//natural loops, a loop comes before the loops around it
+	std::vector<IrLoop> Loops() const;
+	//a block that runs right before every entry into the loop, one is added in front of the header when there is none
+	uint32_t Preheader(const IrLoop& loop);
+
+	uint32_t AddBlock();
+	//a new slot for a temporary, encoded like the unit's own variables
+	uint32_t AddSlot();
+	const IrValue& Value(uint32_t value) const { return Values[value]; }
+	//the instruction that pushed a value, nullptr for phis and undefined values
+	const IrInstr* DefOf(uint32_t value) const;
+
+	static uint32_t Pops(OpCode::Constants opcode, const std::vector<uint32_t>& operands);
+	static uint32_t Pushes(OpCode::Constants opcode);
+	//no side effects and no errors for any operand, safe to drop when the value is unused
+	static bool IsPure(OpCode::Constants opcode);
+	//counts the loads (OP_GET, OP_SET_ASSIGN) and stores (OP_SET, OP_SET_ASSIGN) of globals in an OP_LFUN body and the bodies nested in it
+	static void CountGlobalAccesses(const RSInstructions& body, std::unordered_map<uint32_t, uint32_t>& reads, std::unordered_map<uint32_t, uint32_t>& writes);
+	//stores to globals by the functions nested in this one, they change behind any call
+	std::unordered_map<uint32_t, uint32_t> NestedGlobalWrites() const;
+	//a slot only this unit's own stores can change, locals and the program's globals no nested function stores to,
+	//free slots are set when the closure is made and count too when includeFree is set
+	bool TracksSlot(uint32_t slot, const std::unordered_map<uint32_t, uint32_t>& nestedWrites, bool includeFree) const;
+
+	std::string Name;
+	//the top level of the program, nested functions are already compiled into it so every use of a global is visible
+	bool IsProgram = false;
+	//slots the unit uses, locals of a function or globals of the program
+	uint32_t NumSlots = 0;
+	//leading locals the caller stores the arguments in
+	uint32_t NumParams = 0;
+	//builtins that only read their arguments, by extern index
+	std::vector<bool> PureExterns;
+	//type tag of every result of a builtin, by extern index, 0 when it varies
+	std::vector<std::size_t> ExternTypes;
+	//leading arguments a builtin neither keeps nor returns, by extern index
+	std::vector<std::size_t> BorrowedArgs;
+	//builtins whose result is the length of an array argument, by extern index
+	std::vector<bool> LengthExterns;
+	std::vector<IrBlock> Blocks;
+	//emission order, the first block is the entry
+	std::vector<uint32_t> Layout;
+	//debug symbols past the last instruction
+	std::vector<DebugSymbol> TrailingDebug;
+	//index 0 is IrNoValue
+	std::vector<IrValue> Values;
+
+private:
+	uint32_t NewValue(IrValueKind kind, uint32_t block, uint32_t index);
+	std::string PrintInstr(const IrInstr& instr) const;
+};
@@ -0,0 +1,101 @@
+#include "IrPassManager.h"
+#include "ConstantFolding.h"
+#include "DeadCodeElimination.h"
+#include "BoundsCheckElimination.h"
+#include "LoopInvariantCodeMotion.h"
+#include "CommonSubexpressionElimination.h"
+#include "StrengthReduction.h"
+#include "TypeInference.h"
+#include "EscapeAnalysis.h"
+#include "SlotAllocation.h"
+#include <pch.h>
+
+IrPassManager IrPassManager::Default(const CompilerOptions& options)
+{
+	IrPassManager manager;
+	manager.EnableDump(options.DumpIr);
+	manager.EnableVerify(options.VerifyIr);
+	if (options.EnableConstantFolding)
+	{
+		manager.Add(std::make_shared<ConstantFoldingPass>());
+	}
+	if (options.EnableDeadCodeElimination)
+	{
+		manager.Add(std::make_shared<DeadCodeEliminationPass>());
+	}
+	//before code motion moves the len(...) out of the loop condition
+	if (options.EnableBoundsCheckElimination)
+	{
+		manager.Add(std::make_shared<BoundsCheckEliminationPass>());
+	}
+	if (options.EnableLoopInvariantCodeMotion)
+	{
+		manager.Add(std::make_shared<LoopInvariantCodeMotionPass>());
+	}
+	if (options.EnableCommonSubexpressionElimination)
+	{
+		manager.Add(std::make_shared<CommonSubexpressionEliminationPass>());
+	}
+	if (options.EnableStrengthReduction)
+	{
+		manager.Add(std::make_shared<StrengthReductionPass>());
+	}
+	//last, the typed and scratch opcodes are only understood by the vm
+	if (options.EnableTypeSpecialization)
+	{
+		manager.Add(std::make_shared<TypeInferencePass>());
+	}
+	if (options.EnableEscapeAnalysis)
+	{
+		manager.Add(std::make_shared<EscapeAnalysisPass>());
+	}
+	//after every pass that adds temporaries
+	if (options.EnableSlotReuse)
+	{
+		manager.Add(std::make_shared<SlotAllocationPass>());
+	}
+	return manager;
+}
+
+void IrPassManager::Add(const std::shared_ptr<IrPass>& pass)
+{
+	_passes.push_back(pass);
+}
+
+void IrPassManager::Run(IrFunction& function)
+{
+	Verify(function, "lifting");
+	if (_dumpEnabled)
+	{
+		_dump += function.Print();
+	}
+
+	for (auto& pass : _passes)
+	{
+		if (!pass->Run(function))
+		{
+			continue;
+		}
+
+		function.BuildSsa();
+		Verify(function, pass->Name());
+		if (_dumpEnabled)
+		{
+			_dump += std::format("; after {}\n{}", pass->Name(), function.Print());
+		}
+	}
+}
+
+void IrPassManager::Verify(const IrFunction& function, const std::string& after) const
+{
+	if (!_verify)
+	{
+		return;
+	}
+
+	auto problems = function.Verify();
+	if (!problems.empty())
+	{
+		throw std::runtime_error(std::format("invalid ir after {}: {}", after, problems.front()));
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <StandardLib.h>
+#include <CompilerOptions.h>
+#include "IrFunction.h"
+
+class IrPass
+{
+public:
+	virtual ~IrPass() = default;
+	virtual std::string Name() const = 0;
+	//true when the function changed, the manager rebuilds the ssa values before the next pass
+	virtual bool Run(IrFunction& function) = 0;
+};
+
+class IrPassManager
+{
+public:
+	//the pipeline the compiler runs for the given options
+	static IrPassManager Default(const CompilerOptions& options);
+
+	void Add(const std::shared_ptr<IrPass>& pass);
+	void Run(IrFunction& function);
+
+	//text form of every function before the first pass and after each pass that changed it
+	void EnableDump(bool enable) { _dumpEnabled = enable; }
+	void EnableVerify(bool enable) { _verify = enable; }
+	const std::string& Dump() const { return _dump; }
+	size_t Size() const { return _passes.size(); }
+
+private:
+	void Verify(const IrFunction& function, const std::string& after) const;
+
+	std::vector<std::shared_ptr<IrPass>> _passes;
+	bool _dumpEnabled = false;
+	bool _verify = false;
+	std::string _dump;
+};
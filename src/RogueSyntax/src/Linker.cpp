@@ -34,4 +34,8 @@ void Linker::LinkInstructions(ByteCode& code, const ObjectCode& objectCode)
 
 	code.DebugSymbols.reserve(objectCode.DebugSymbols.size());
 	code.DebugSymbols = objectCode.DebugSymbols;
+
+	code.NumGlobals = objectCode.NumGlobals;
+	code.MaxStackDepth = objectCode.MaxStackDepth;
+	code.Functions = objectCode.Functions;
 }
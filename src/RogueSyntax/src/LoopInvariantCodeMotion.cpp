@@ -0,0 +1,215 @@
+#include "LoopInvariantCodeMotion.h"
+#include <pch.h>
+
+bool LoopInvariantCodeMotionPass::Run(IrFunction& function)
+{
+	//a hoist adds a block and a store, so the loops are found again after each one,
+	//the preheader of an inner loop sits in the outer loop and its header can then be hoisted further
+	auto changed = false;
+	auto progress = true;
+	while (progress)
+	{
+		progress = false;
+		for (auto& loop : function.Loops())
+		{
+			if (Hoist(function, loop))
+			{
+				function.BuildSsa();
+				progress = true;
+				changed = true;
+				break;
+			}
+		}
+	}
+	return changed;
+}
+
+bool LoopInvariantCodeMotionPass::Hoist(IrFunction& function, const IrLoop& loop)
+{
+	FindLoopEffects(function, loop);
+
+	//only the header runs every time the loop is entered, code in the body may never run at all
+	std::vector<uint32_t> roots;
+	for (auto& instr : function.Blocks[loop.Header].Instrs)
+	{
+		if (instr.Dead)
+		{
+			continue;
+		}
+		if (instr.Result == IrNoValue || !Invariant(function, instr.Result))
+		{
+			//moving a value ahead of a side effect or an error would change what the program does first
+			if (!IrFunction::IsPure(instr.Op))
+			{
+				break;
+			}
+			continue;
+		}
+		if (instr.Args.empty())
+		{
+			continue;
+		}
+
+		//the whole expression moves at once, not each of its operands
+		auto& uses = function.Value(instr.Result).Uses;
+		if (uses.size() == 1 && !uses[0].IsPhi)
+		{
+			auto& user = function.Blocks[uses[0].Block].Instrs[uses[0].Index];
+			if (user.Result != IrNoValue && Invariant(function, user.Result))
+			{
+				continue;
+			}
+		}
+		roots.push_back(instr.Result);
+	}
+	if (roots.empty())
+	{
+		return false;
+	}
+
+	auto preheader = function.Preheader(loop);
+	std::vector<IrInstr> hoisted;
+	for (auto root : roots)
+	{
+		std::vector<uint32_t> values;
+		Collect(function, root, values);
+		for (auto value : values)
+		{
+			auto& def = function.Value(value);
+			auto& instr = function.Blocks[def.Block].Instrs[def.Index];
+			IrInstr copy;
+			copy.Op = instr.Op;
+			copy.Operands = instr.Operands;
+			copy.Data = instr.Data;
+			copy.Debug = std::move(instr.Debug);
+			instr.Debug.clear();
+			hoisted.push_back(std::move(copy));
+			if (value != root)
+			{
+				instr.Dead = true;
+			}
+		}
+
+		//the header loads the stored result in place of computing it
+		auto slot = function.AddSlot();
+		IrInstr store;
+		store.Op = OpCode::Constants::OP_SET;
+		store.Operands = { slot };
+		hoisted.push_back(std::move(store));
+
+		auto& def = function.Value(root);
+		auto& instr = function.Blocks[def.Block].Instrs[def.Index];
+		instr.Op = OpCode::Constants::OP_GET;
+		instr.Operands = { slot };
+		instr.Data.clear();
+	}
+
+	auto& block = function.Blocks[preheader];
+	auto* last = block.Last();
+	auto at = (last != nullptr && last->IsTerminator()) ? block.Instrs.begin() + (last - block.Instrs.data()) : block.Instrs.end();
+	block.Instrs.insert(at, hoisted.begin(), hoisted.end());
+	return true;
+}
+
+void LoopInvariantCodeMotionPass::FindLoopEffects(const IrFunction& function, const IrLoop& loop)
+{
+	_loopWrites.clear();
+	_nestedWrites = function.NestedGlobalWrites();
+	_loopRunsCode = false;
+
+	for (auto id : loop.Blocks)
+	{
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			if (instr.Dead)
+			{
+				continue;
+			}
+
+			switch (instr.Op)
+			{
+			case OpCode::Constants::OP_SET:
+			case OpCode::Constants::OP_SET_ASSIGN:
+				_loopWrites.insert(instr.Operands[0]);
+				break;
+			case OpCode::Constants::OP_CALL:
+			case OpCode::Constants::OP_YIELD:
+			case OpCode::Constants::OP_ITER_NEXT:
+			case OpCode::Constants::OP_FOR_RANGE:
+				_loopRunsCode = true;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+bool LoopInvariantCodeMotionPass::Invariant(const IrFunction& function, uint32_t value) const
+{
+	auto* def = function.DefOf(value);
+	if (def == nullptr)
+	{
+		return false;
+	}
+
+	switch (def->Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	case OpCode::Constants::OP_LDECIMAL:
+	case OpCode::Constants::OP_LSTRING:
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+	case OpCode::Constants::OP_NULL:
+		return true;
+	case OpCode::Constants::OP_GET:
+		return SlotInvariant(function, def->Operands[0]);
+	case OpCode::Constants::OP_CALL:
+	{
+		//a builtin marked pure, user functions can do anything
+		auto* callee = function.DefOf(def->Args[0]);
+		if (callee == nullptr || callee->Op != OpCode::Constants::OP_GET || GetTypeFromIdx(callee->Operands[0]) != ScopeType::SCOPE_EXTERN)
+		{
+			return false;
+		}
+		auto idx = static_cast<size_t>(AdjustIdx(callee->Operands[0]));
+		if (idx >= function.PureExterns.size() || !function.PureExterns[idx])
+		{
+			return false;
+		}
+		break;
+	}
+	default:
+		if (def->Op < OpCode::Constants::OP_ADD || def->Op > OpCode::Constants::OP_BNOT)
+		{
+			return false;
+		}
+		break;
+	}
+	return std::ranges::all_of(def->Args, [this, &function](uint32_t arg) { return Invariant(function, arg); });
+}
+
+bool LoopInvariantCodeMotionPass::SlotInvariant(const IrFunction& function, uint32_t slot) const
+{
+	if (_loopWrites.contains(slot))
+	{
+		return false;
+	}
+	if (GetTypeFromIdx(slot) != ScopeType::SCOPE_GLOBAL)
+	{
+		return true;
+	}
+
+	//the top level sees every function that can store to a global, anywhere else a call might run one
+	return function.IsProgram ? function.TracksSlot(slot, _nestedWrites, false) : !_loopRunsCode;
+}
+
+void LoopInvariantCodeMotionPass::Collect(const IrFunction& function, uint32_t value, std::vector<uint32_t>& values)
+{
+	auto& def = function.Value(value);
+	for (auto arg : function.Blocks[def.Block].Instrs[def.Index].Args)
+	{
+		Collect(function, arg, values);
+	}
+	values.push_back(value);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//moves computations the loop condition repeats with the same operands on every iteration, like `length - i - 1`,
+//into a preheader that stores them in a temporary slot once before the loop is entered
+class LoopInvariantCodeMotionPass : public IrPass
+{
+public:
+	std::string Name() const override { return "loop invariant code motion"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	bool Hoist(IrFunction& function, const IrLoop& loop);
+	void FindLoopEffects(const IrFunction& function, const IrLoop& loop);
+
+	//same value every time the header runs, operators and pure builtin calls on literals and slots the loop leaves alone
+	bool Invariant(const IrFunction& function, uint32_t value) const;
+	bool SlotInvariant(const IrFunction& function, uint32_t slot) const;
+	//the instructions of the value, operands first (the order they run in)
+	static void Collect(const IrFunction& function, uint32_t value, std::vector<uint32_t>& values);
+
+	//slots stored to inside the loop, and globals stored to by any function of the program
+	std::set<uint32_t> _loopWrites;
+	std::unordered_map<uint32_t, uint32_t> _nestedWrites;
+	//calls and iterators in the loop can run code that stores to globals
+	bool _loopRunsCode = false;
+};
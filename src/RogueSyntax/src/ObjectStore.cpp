@@ -24,8 +24,16 @@ ObjectStore::~ObjectStore()
 {
 }
 
+std::shared_ptr<ObjectStore> ObjectStore::NewRegion(size_t initialSize)
+{
+	auto region = std::make_shared<ObjectStore>();
+	region->_arena = std::make_unique<std::pmr::monotonic_buffer_resource>(initialSize);
+	return region;
+}
+
 void ObjectStore::Add(const std::shared_ptr<IObject>& obj)
 {
+	std::lock_guard<std::mutex> lock(_lock);
 	_store.emplace_back(std::move(obj));
 }
 
@@ -35,6 +43,409 @@ ObjectFactory::ObjectFactory(ObjectStore* store)
 {
 }
 
+ObjectFactory::ObjectFactory(ObjectStore* store, Nursery* nursery)
+	: _store(store), _nursery(nursery)
+{
+}
+
 ObjectFactory::~ObjectFactory()
 {
 }
+
+static thread_local Nursery* s_activeNursery = nullptr;
+
+Nursery::Nursery(const std::shared_ptr<ObjectFactory>& tenured, size_t size)
+	: _size(size), _tenured(tenured)
+{
+}
+
+Nursery::~Nursery()
+{
+	for (auto* obj : _objects)
+	{
+		obj->~IObject();
+	}
+	if (s_activeNursery == this)
+	{
+		s_activeNursery = nullptr;
+	}
+}
+
+void Nursery::SetSize(size_t size)
+{
+	_size = size;
+}
+
+bool Nursery::Contains(const IObject* obj) const
+{
+	auto address = reinterpret_cast<const std::byte*>(obj);
+	for (size_t i = 0; i <= _chunk && i < _chunks.size(); i++)
+	{
+		auto* memory = _chunks[i].Memory.get();
+		if (address >= memory && address < memory + _chunks[i].Size)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void* Nursery::Allocate(size_t size, size_t alignment)
+{
+	while (true)
+	{
+		if (_chunk < _chunks.size())
+		{
+			auto aligned = (_offset + alignment - 1) & ~(alignment - 1);
+			if (aligned + size <= _chunks[_chunk].Size)
+			{
+				_offset = aligned + size;
+				_used += size;
+				return _chunks[_chunk].Memory.get() + aligned;
+			}
+			if (_chunk + 1 < _chunks.size())
+			{
+				_chunk++;
+				_offset = 0;
+				continue;
+			}
+		}
+
+		//out of space before the next safe point, grow - the collection will reset everything
+		auto chunkSize = std::max({ _size, size + alignment, static_cast<size_t>(4096) });
+		_chunks.push_back(Chunk{ std::make_unique<std::byte[]>(chunkSize), chunkSize });
+		_chunk = _chunks.size() - 1;
+		_offset = 0;
+	}
+}
+
+void Nursery::Remember(const IObject* container)
+{
+	_remembered.insert(const_cast<IObject*>(container));
+}
+
+void Nursery::WriteBarrier(const IObject* container, const IObject* value)
+{
+	auto* nursery = s_activeNursery;
+	if (nursery != nullptr && nursery->Contains(value) && !nursery->Contains(container))
+	{
+		nursery->Remember(container);
+	}
+}
+
+Nursery* Nursery::Active()
+{
+	return s_activeNursery;
+}
+
+void Nursery::SetActive(Nursery* nursery)
+{
+	s_activeNursery = nursery;
+}
+
+void Nursery::Collect(const std::function<void(const Forwarder& forward)>& roots)
+{
+	if (_objects.empty())
+	{
+		_remembered.clear();
+		return;
+	}
+
+	_stats.MinorCollections++;
+	_stats.RememberedSetSize = _remembered.size();
+
+	roots([this](const IObject* obj) { return Forward(obj); });
+
+	for (auto* container : _remembered)
+	{
+		ForwardChildren(container);
+	}
+
+	//promoted objects may reference other nursery objects, scan until nothing new is promoted
+	while (!_promoted.empty())
+	{
+		auto* obj = _promoted.back();
+		_promoted.pop_back();
+		ForwardChildren(obj);
+	}
+
+	_stats.Reclaimed += _objects.size() - _forwarded.size();
+	for (auto* obj : _objects)
+	{
+		obj->~IObject();
+	}
+
+	_objects.clear();
+	_forwarded.clear();
+	_remembered.clear();
+	_chunk = 0;
+	_offset = 0;
+	_used = 0;
+
+	//drop overflow chunks, keep the first for reuse
+	if (_chunks.size() > 1 || (!_chunks.empty() && _chunks[0].Size < _size))
+	{
+		_chunks.clear();
+	}
+}
+
+const IObject* Nursery::Forward(const IObject* obj)
+{
+	if (obj == nullptr || !Contains(obj))
+	{
+		return obj;
+	}
+
+	auto it = _forwarded.find(obj);
+	if (it != _forwarded.end())
+	{
+		return it->second;
+	}
+
+	auto promoted = Promote(obj);
+	_forwarded[obj] = promoted;
+	_promoted.push_back(promoted);
+	_stats.Promoted++;
+	return promoted;
+}
+
+IObject* Nursery::Promote(const IObject* obj)
+{
+	//shallow copy into the object store, children are forwarded afterwards
+	if (obj->IsThisA<IntegerObj>())
+	{
+		_stats.BytesPromoted += sizeof(IntegerObj);
+		return _tenured->New<IntegerObj>(dynamic_cast<const IntegerObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<DecimalObj>())
+	{
+		_stats.BytesPromoted += sizeof(DecimalObj);
+		return _tenured->New<DecimalObj>(dynamic_cast<const DecimalObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<StringObj>())
+	{
+		_stats.BytesPromoted += sizeof(StringObj);
+		return _tenured->New<StringObj>(dynamic_cast<const StringObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<BooleanObj>())
+	{
+		_stats.BytesPromoted += sizeof(BooleanObj);
+		return _tenured->New<BooleanObj>(dynamic_cast<const BooleanObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<ArrayObj>())
+	{
+		_stats.BytesPromoted += sizeof(ArrayObj);
+		return _tenured->New<ArrayObj>(dynamic_cast<const ArrayObj*>(obj)->Elements);
+	}
+	if (obj->IsThisA<IntArrayObj>())
+	{
+		//the nursery copy is destroyed after the collection, its buffer moves instead of being copied
+		auto arr = const_cast<IntArrayObj*>(dynamic_cast<const IntArrayObj*>(obj));
+		_stats.BytesPromoted += sizeof(IntArrayObj) + arr->Values.size() * sizeof(int32_t);
+		return _tenured->New<IntArrayObj>(std::move(arr->Values));
+	}
+	if (obj->IsThisA<DecimalArrayObj>())
+	{
+		auto arr = const_cast<DecimalArrayObj*>(dynamic_cast<const DecimalArrayObj*>(obj));
+		_stats.BytesPromoted += sizeof(DecimalArrayObj) + arr->Values.size() * sizeof(float);
+		return _tenured->New<DecimalArrayObj>(std::move(arr->Values));
+	}
+	if (obj->IsThisA<HashObj>())
+	{
+		_stats.BytesPromoted += sizeof(HashObj);
+		return _tenured->New<HashObj>(dynamic_cast<const HashObj*>(obj)->Elements);
+	}
+	if (obj->IsThisA<FunctionCompiledObj>())
+	{
+		_stats.BytesPromoted += sizeof(FunctionCompiledObj);
+		auto fn = dynamic_cast<const FunctionCompiledObj*>(obj);
+		auto promoted = _tenured->New<FunctionCompiledObj>(fn->FuncInstructions, fn->NumLocals, fn->NumParameters);
+		promoted->FuncOffset = fn->FuncOffset;
+		promoted->MaxStackDepth = fn->MaxStackDepth;
+		return promoted;
+	}
+	if (obj->IsThisA<ClosureObj>())
+	{
+		_stats.BytesPromoted += sizeof(ClosureObj);
+		auto closure = dynamic_cast<const ClosureObj*>(obj);
+		return _tenured->New<ClosureObj>(closure->Function, closure->Frees);
+	}
+	if (obj->IsThisA<GeneratorObj>())
+	{
+		_stats.BytesPromoted += sizeof(GeneratorObj);
+		auto generator = dynamic_cast<const GeneratorObj*>(obj);
+		auto promoted = _tenured->New<GeneratorObj>(generator->Closure, generator->Slots, generator->Ip);
+		promoted->Status = generator->Status;
+		return promoted;
+	}
+	if (obj->IsThisA<RangeObj>())
+	{
+		_stats.BytesPromoted += sizeof(RangeObj);
+		auto range = dynamic_cast<const RangeObj*>(obj);
+		return _tenured->New<RangeObj>(range->Start, range->End, range->Step);
+	}
+	if (obj->IsThisA<RangeIteratorObj>())
+	{
+		_stats.BytesPromoted += sizeof(RangeIteratorObj);
+		auto iterator = dynamic_cast<const RangeIteratorObj*>(obj);
+		return _tenured->New<RangeIteratorObj>(iterator->Next, iterator->End, iterator->Step);
+	}
+	if (obj->IsThisA<ArrayIteratorObj>())
+	{
+		_stats.BytesPromoted += sizeof(ArrayIteratorObj);
+		auto iterator = dynamic_cast<const ArrayIteratorObj*>(obj);
+		return _tenured->New<ArrayIteratorObj>(iterator->Array, iterator->Next);
+	}
+	if (obj->IsThisA<BuiltInObj>())
+	{
+		_stats.BytesPromoted += sizeof(BuiltInObj);
+		auto builtin = dynamic_cast<const BuiltInObj*>(obj);
+		return builtin->Idx != -1 ? _tenured->New<BuiltInObj>(builtin->Idx) : _tenured->New<BuiltInObj>(builtin->Name);
+	}
+	if (obj->IsThisA<IdentifierObj>())
+	{
+		_stats.BytesPromoted += sizeof(IdentifierObj);
+		auto ident = dynamic_cast<const IdentifierObj*>(obj);
+		return _tenured->New<IdentifierObj>(ident->Name, ident->Value);
+	}
+	if (obj->IsThisA<ReturnObj>())
+	{
+		_stats.BytesPromoted += sizeof(ReturnObj);
+		return _tenured->New<ReturnObj>(dynamic_cast<const ReturnObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<ErrorObj>())
+	{
+		_stats.BytesPromoted += sizeof(ErrorObj);
+		auto error = dynamic_cast<const ErrorObj*>(obj);
+		return _tenured->New<ErrorObj>(error->Message, error->Token);
+	}
+	if (obj->IsThisA<FunctionObj>())
+	{
+		_stats.BytesPromoted += sizeof(FunctionObj);
+		auto fn = dynamic_cast<const FunctionObj*>(obj);
+		return _tenured->New<FunctionObj>(fn->Parameters, fn->Body);
+	}
+	if (obj->IsThisA<TaskObj>())
+	{
+		_stats.BytesPromoted += sizeof(TaskObj);
+		return _tenured->New<TaskObj>(dynamic_cast<const TaskObj*>(obj)->Task);
+	}
+	if (obj->IsThisA<ChannelObj>())
+	{
+		_stats.BytesPromoted += sizeof(ChannelObj);
+		return _tenured->New<ChannelObj>(dynamic_cast<const ChannelObj*>(obj)->Value);
+	}
+	if (obj->IsThisA<NullObj>())
+	{
+		return NullObj::NULL_OBJ_REF;
+	}
+	if (obj->IsThisA<VoidObj>())
+	{
+		return VoidObj::VOID_OBJ_REF;
+	}
+	if (obj->IsThisA<BreakObj>())
+	{
+		return BreakObj::BREAK_OBJ_REF;
+	}
+	if (obj->IsThisA<ContinueObj>())
+	{
+		return ContinueObj::CONTINUE_OBJ_REF;
+	}
+	throw std::runtime_error(std::format("Nursery: cannot promote object of type {}", obj->TypeName()));
+}
+
+void Nursery::ForwardChildren(IObject* obj)
+{
+	if (obj->IsThisA<ArrayObj>())
+	{
+		for (auto& elem : dynamic_cast<ArrayObj*>(obj)->Elements)
+		{
+			elem = Forward(elem);
+		}
+	}
+	else if (obj->IsThisA<HashObj>())
+	{
+		for (auto& [key, entry] : dynamic_cast<HashObj*>(obj)->Elements)
+		{
+			entry.Key = Forward(entry.Key);
+			entry.Value = Forward(entry.Value);
+		}
+	}
+	else if (obj->IsThisA<ClosureObj>())
+	{
+		auto closure = dynamic_cast<ClosureObj*>(obj);
+		closure->Function = dynamic_cast<const FunctionCompiledObj*>(Forward(closure->Function));
+		for (auto& free : closure->Frees)
+		{
+			free = Forward(free);
+		}
+	}
+	else if (obj->IsThisA<GeneratorObj>())
+	{
+		auto generator = dynamic_cast<GeneratorObj*>(obj);
+		generator->Closure = dynamic_cast<const ClosureObj*>(Forward(generator->Closure));
+		for (auto& slot : generator->Slots)
+		{
+			slot = Forward(slot);
+		}
+	}
+	else if (obj->IsThisA<ArrayIteratorObj>())
+	{
+		auto iterator = dynamic_cast<ArrayIteratorObj*>(obj);
+		iterator->Array = dynamic_cast<const ArrayObj*>(Forward(iterator->Array));
+	}
+	else if (obj->IsThisA<IdentifierObj>())
+	{
+		auto ident = dynamic_cast<IdentifierObj*>(obj);
+		ident->Value = Forward(ident->Value);
+	}
+	else if (obj->IsThisA<ReturnObj>())
+	{
+		auto ret = dynamic_cast<ReturnObj*>(obj);
+		ret->Value = Forward(ret->Value);
+	}
+}
+
+ScratchRegion::ScratchRegion(size_t size)
+	: _size(size)
+{
+}
+
+ScratchRegion::~ScratchRegion()
+{
+	Release(0);
+}
+
+void* ScratchRegion::Allocate(size_t size, size_t alignment)
+{
+	//reserved on first use, most frames never allocate here
+	if (_memory == nullptr)
+	{
+		_memory = std::make_unique<std::byte[]>(_size);
+	}
+
+	auto aligned = (_offset + alignment - 1) & ~(alignment - 1);
+	if (aligned + size > _size)
+	{
+		return nullptr;
+	}
+	_offset = aligned + size;
+	return _memory.get() + aligned;
+}
+
+void ScratchRegion::Release(size_t mark)
+{
+	//objects are laid out in allocation order, everything past the mark came after it
+	while (!_objects.empty() && reinterpret_cast<std::byte*>(_objects.back()) >= _memory.get() + mark)
+	{
+		_objects.back()->~IObject();
+		_objects.pop_back();
+	}
+	_offset = std::min(_offset, mark);
+}
+
+bool ScratchRegion::Released(const IObject* obj) const
+{
+	auto address = reinterpret_cast<const std::byte*>(obj);
+	return _memory != nullptr && address >= _memory.get() + _offset && address < _memory.get() + _size;
+}
@@ -47,6 +47,20 @@ const std::unordered_map<OpCode::Constants, Definition> OpCode::Definitions = {
 	{ OpCode::Constants::OP_RETURN,      Definition{ "OP_RETURN", {} } },
 	{ OpCode::Constants::OP_RET_VAL,     Definition{ "OP_RET_VAL", {} } },
 	{ OpCode::Constants::OP_CUR_CLOSURE, Definition{ "OP_CUR_CLOSURE", {} } },
+	{ OpCode::Constants::OP_GENERATOR,   Definition{ "OP_GENERATOR", {} } },
+	{ OpCode::Constants::OP_YIELD,       Definition{ "OP_YIELD", {} } },
+	{ OpCode::Constants::OP_GEN_RETURN,  Definition{ "OP_GEN_RETURN", {} } },
+	{ OpCode::Constants::OP_ITER,        Definition{ "OP_ITER", {} } },
+	{ OpCode::Constants::OP_ITER_NEXT,   Definition{ "OP_ITER_NEXT", { 2 } } },
+	{ OpCode::Constants::OP_FOR_RANGE,   Definition{ "OP_FOR_RANGE", { 2 } } },
+	{ OpCode::Constants::OP_ADD_II,      Definition{ "OP_ADD_II", {} } },
+	{ OpCode::Constants::OP_LT_II,       Definition{ "OP_LT_II", {} } },
+	{ OpCode::Constants::OP_CONCAT_SS,   Definition{ "OP_CONCAT_SS", {} } },
+	{ OpCode::Constants::OP_ARRAY_SCRATCH,   Definition{ "OP_ARRAY_SCR", {2} } },
+	{ OpCode::Constants::OP_HASH_SCRATCH,    Definition{ "OP_HASH_SCR", {2} } },
+	{ OpCode::Constants::OP_CLOSURE_SCRATCH, Definition{ "OP_CLOSURE_SCR", { 2 } } },
+	{ OpCode::Constants::OP_INDEX_NOCHECK,   Definition{ "OP_INDEX_NOCHK", {} } },
+	{ OpCode::Constants::OP_SET_KEEP,        Definition{ "OP_SET_KEEP", { 2 } } },
 };
 
 std::variant<Definition, std::string> OpCode::Lookup(const OpCode::Constants opcode)
@@ -151,7 +165,8 @@ RSInstructions OpCode::MakeStringLiteral(const std::string& value)
 
 std::tuple<OpCode::Constants, std::vector<uint32_t>, size_t> OpCode::ReadOperand(const RSInstructions& instructions, size_t offset)
 {
-	if (instructions.size() < 2)
+	//a lone OP_RETURN is a complete function body
+	if (offset >= instructions.size())
 	{
 		throw std::runtime_error("No instructions");
 	}
@@ -221,7 +236,8 @@ std::vector<uint8_t> OpCode::ReadData(std::tuple<OpCode::Constants, std::vector<
 
 OpCode::Constants OpCode::GetOpcode(const RSInstructions& instructions, size_t offset)
 {
-	if (instructions.size() < 2)
+	//a lone OP_RETURN is a complete function body
+	if (offset >= instructions.size())
 	{
 		throw std::runtime_error("No instructions");
 	}
@@ -231,6 +247,54 @@ OpCode::Constants OpCode::GetOpcode(const RSInstructions& instructions, size_t o
 	return opcode;
 }
 
+int OpCode::StackEffect(OpCode::Constants opcode, const std::vector<uint32_t>& operands)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_CONSTANT:
+	case OpCode::Constants::OP_LINT:
+	case OpCode::Constants::OP_LDECIMAL:
+	case OpCode::Constants::OP_LSTRING:
+	case OpCode::Constants::OP_LFUN:
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+	case OpCode::Constants::OP_NULL:
+	case OpCode::Constants::OP_GET:
+	case OpCode::Constants::OP_CUR_CLOSURE:
+	case OpCode::Constants::OP_ITER_NEXT:
+	case OpCode::Constants::OP_FOR_RANGE:
+		return 1;
+	case OpCode::Constants::OP_ARRAY:
+	case OpCode::Constants::OP_ARRAY_SCRATCH:
+		return 1 - static_cast<int>(operands[0]);
+	case OpCode::Constants::OP_HASH:
+	case OpCode::Constants::OP_HASH_SCRATCH:
+		return 1 - 2 * static_cast<int>(operands[0]);
+	case OpCode::Constants::OP_NEGATE:
+	case OpCode::Constants::OP_NOT:
+	case OpCode::Constants::OP_BNOT:
+	case OpCode::Constants::OP_JUMP:
+	case OpCode::Constants::OP_GENERATOR:
+	case OpCode::Constants::OP_GEN_RETURN:
+	case OpCode::Constants::OP_ITER:
+	case OpCode::Constants::OP_SET_KEEP:
+		return 0;
+	case OpCode::Constants::OP_YIELD:
+		//the yielded value is replaced with the value of the yield expression on resume
+		return 0;
+	case OpCode::Constants::OP_SET_ASSIGN:
+		return -3;
+	case OpCode::Constants::OP_CALL:
+		return -static_cast<int>(operands[0]);
+	case OpCode::Constants::OP_CLOSURE:
+	case OpCode::Constants::OP_CLOSURE_SCRATCH:
+		return -static_cast<int>(operands[0]);
+	default:
+		//binary operators, pop, set, conditional jumps and returns all consume one value
+		return -1;
+	}
+}
+
 std::string OpCode::PrintInstructions(const RSInstructions& instructions)
 {
 	std::string result{};
@@ -316,7 +380,7 @@ std::vector<DissaemblyDetail> OpCode::Disassemble(const RSInstructions& instruct
 			detail.Operands[i + 1] = operands[i];
 		}
 
-		if (op == OpCode::Constants::OP_GET || op == OpCode::Constants::OP_SET)
+		if (op == OpCode::Constants::OP_GET || op == OpCode::Constants::OP_SET || op == OpCode::Constants::OP_SET_KEEP)
 		{
 			auto adjustedIdx = AdjustIdx(operands[0]);
 			auto type = GetTypeFromIdx(operands[0]);
@@ -392,7 +456,7 @@ std::string OpCode::PrintDisassemblyDetail(const DissaemblyDetail& detail)
 			decompiled += std::format("{: <6}", detail.Operands[i]);
 		}
 	}
-	if (detail.Instruction == "OP_GET" || detail.Instruction == "OP_SET")
+	if (detail.Instruction == "OP_GET" || detail.Instruction == "OP_SET" || detail.Instruction == "OP_SET_KEEP")
 	{
 		decompiled += std::format(" // {: <6} {: <2}", detail.ScopeType, detail.Index);
 	}
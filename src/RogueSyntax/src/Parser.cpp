@@ -145,6 +145,11 @@ IExpression* Parser::ParseExpression(const Precedence precedence)
 
 IExpression* Parser::ParseIdentifier()
 {
+	//everywhere else yield stays a name so the yield builtin can still be called
+	if (_currentToken.Literal == "yield" && !_generatorBodies.empty() && _generatorBodies.back())
+	{
+		return ParseYieldExpression();
+	}
 	return _currentStore->New_Identifier(_currentToken, _currentToken.Literal);
 }
 
@@ -322,6 +327,11 @@ IStatement* Parser::ParseForStatement()
 
 	NextToken();
 
+	if (CurrentTokenIs(TokenType::TOKEN_IDENT) && PeekTokenIs(TokenType::TOKEN_IN))
+	{
+		return ParseForInStatement(token);
+	}
+
 	auto init = Parser::ParseStatement();
 
 	NextToken();
@@ -349,6 +359,30 @@ IStatement* Parser::ParseForStatement()
 	return _currentStore->New_ForStatement(token, init, condition, post, action);
 }
 
+IStatement* Parser::ParseForInStatement(const RSToken& token)
+{
+	auto name = _currentStore->New_Identifier(_currentToken, _currentToken.Literal);
+
+	NextToken();
+	NextToken();
+
+	auto iterable = ParseExpression(Precedence::LOWEST);
+
+	if (!ExpectPeek(TokenType::TOKEN_RPAREN))
+	{
+		return nullptr;
+	}
+
+	if (!ExpectPeek(TokenType::TOKEN_LBRACE))
+	{
+		return nullptr;
+	}
+
+	auto action = ParseBlockStatement();
+
+	return _currentStore->New_ForInStatement(token, name, iterable, action);
+}
+
 IExpression* Parser::ParseArrayLiteral()
 {
 	auto token = _currentToken;
@@ -379,7 +413,7 @@ IExpression* Parser::ParseHashLiteral()
 	//assume the current is {
 	auto token = _currentToken;
 
-	std::map<IExpression*, IExpression*> pairs;
+	std::vector<std::pair<IExpression*, IExpression*>> pairs;
 
 	while (!PeekTokenIs(TokenType::TOKEN_RBRACE))
 	{
@@ -397,7 +431,7 @@ IExpression* Parser::ParseHashLiteral()
 
 			auto value = ParseExpression(Precedence::LOWEST);
 
-			pairs[key] = value;
+			pairs.emplace_back(key, value);
 		}
 	}
 	NextToken();
@@ -547,6 +581,13 @@ IExpression* Parser::ParseFunctionLiteral()
 {
 	auto token = _currentToken;
 
+	bool isGenerator = false;
+	if (PeekTokenIs(TokenType::TOKEN_ASTERISK))
+	{
+		NextToken();
+		isGenerator = true;
+	}
+
 	if (!ExpectPeek(TokenType::TOKEN_LPAREN))
 	{
 		return nullptr;
@@ -574,9 +615,13 @@ IExpression* Parser::ParseFunctionLiteral()
 		return nullptr;
 	}
 
+	_generatorBodies.push_back(isGenerator);
 	auto body = ParseBlockStatement();
+	_generatorBodies.pop_back();
 
-	return _currentStore->New_FunctionLiteral(token, parameters, body);
+	auto function = _currentStore->New_FunctionLiteral(token, parameters, body);
+	function->IsGenerator = isGenerator;
+	return function;
 }
 
 IExpression* Parser::ParseCallExpression(const IExpression* function)
@@ -610,6 +655,27 @@ IExpression* Parser::ParseCallExpression(const IExpression* function)
 	return _currentStore->New_CallExpression(token, function, arguments);
 }
 
+IExpression* Parser::ParseYieldExpression()
+{
+	auto token = _currentToken;
+
+	//a bare yield hands out null
+	if (PeekTokenIs(TokenType::TOKEN_SEMICOLON) || PeekTokenIs(TokenType::TOKEN_RBRACE))
+	{
+		return _currentStore->New_YieldExpression(token, _currentStore->New_NullLiteral(token));
+	}
+
+	NextToken();
+
+	auto value = ParseExpression(Precedence::LOWEST);
+	if (value == nullptr)
+	{
+		return nullptr;
+	}
+
+	return _currentStore->New_YieldExpression(token, value);
+}
+
 IStatement* Parser::ParseLetStatement()
 {
 	auto token = _currentToken;
@@ -0,0 +1,359 @@
+#include "PeepholeOptimizer.h"
+#include <pch.h>
+
+bool PeepholeOptimizer::Run(ObjectCode& code)
+{
+	auto body = Decode(code.Instructions, 0, code.Instructions.size());
+	if (!Optimize(body))
+	{
+		return false;
+	}
+
+	RSInstructions instructions;
+	instructions.reserve(code.Instructions.size());
+	std::vector<std::pair<size_t, size_t>> moved;
+	Encode(body, Layout(body), instructions, moved);
+	moved.push_back({ code.Instructions.size(), instructions.size() });
+
+	//symbols of removed instructions move to the instruction after them
+	for (auto& symbol : code.DebugSymbols)
+	{
+		auto it = std::lower_bound(moved.begin(), moved.end(), symbol.Offset, [](const auto& entry, size_t offset) { return entry.first < offset; });
+		symbol.Offset = it != moved.end() ? it->second : instructions.size();
+	}
+	code.Instructions = std::move(instructions);
+	return true;
+}
+
+PeepholeOptimizer::Body PeepholeOptimizer::Decode(const RSInstructions& instructions, size_t begin, size_t end)
+{
+	Body body;
+	auto offset = begin;
+	while (offset < end)
+	{
+		auto [opcode, operands, next] = OpCode::ReadOperand(instructions, offset);
+		Instr instr{ opcode, operands };
+		instr.Offset = offset - begin;
+		instr.Absolute = offset;
+		if (opcode == OpCode::Constants::OP_LSTRING)
+		{
+			next += operands[0];
+		}
+		instr.Bytes.assign(instructions.begin() + offset, instructions.begin() + next);
+		if (opcode == OpCode::Constants::OP_LFUN)
+		{
+			instr.Body = Decode(instructions, next, next + operands[2]);
+			next += operands[2];
+		}
+		body.push_back(std::move(instr));
+		offset = next;
+	}
+	return body;
+}
+
+bool PeepholeOptimizer::Optimize(Body& body)
+{
+	auto changed = false;
+	for (auto& instr : body)
+	{
+		if (instr.Op == OpCode::Constants::OP_LFUN)
+		{
+			changed = Optimize(instr.Body) || changed;
+		}
+	}
+
+	//removing a pair can make a jump the next instruction of another, and retargeting a jump can free up a pair
+	auto progress = true;
+	while (progress)
+	{
+		auto targets = Targets(body);
+		progress = KeepStores(body, targets);
+		progress = DropPushes(body, targets) || progress;
+		progress = ThreadJumps(body) || progress;
+		progress = DropJumpsToNext(body) || progress;
+		changed = changed || progress;
+	}
+	return changed;
+}
+
+bool PeepholeOptimizer::ThreadJumps(Body& body)
+{
+	auto changed = false;
+	for (size_t i = 0; i < body.size(); i = Next(body, i))
+	{
+		auto& instr = body[i];
+		if (instr.Removed || !IsJump(instr.Op))
+		{
+			continue;
+		}
+
+		auto target = static_cast<size_t>(instr.Operands[0]);
+		for (size_t hops = 0; hops < body.size(); hops++)
+		{
+			auto at = Resolve(body, target);
+			if (at == body.size() || at == i || body[at].Op != OpCode::Constants::OP_JUMP)
+			{
+				break;
+			}
+			auto next = static_cast<size_t>(body[at].Operands[0]);
+			//the vm charges its budget on back-edges so one has to stay a back-edge, and the loop opcodes only exit forward
+			auto loop = instr.Op == OpCode::Constants::OP_ITER_NEXT || instr.Op == OpCode::Constants::OP_FOR_RANGE;
+			if ((loop && next <= instr.Offset) || (target <= instr.Offset && next > instr.Offset))
+			{
+				break;
+			}
+			target = next;
+		}
+
+		if (Resolve(body, target) != Resolve(body, instr.Operands[0]))
+		{
+			instr.Operands[0] = static_cast<uint32_t>(target);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool PeepholeOptimizer::KeepStores(Body& body, const std::set<size_t>& targets)
+{
+	auto changed = false;
+	for (size_t i = 0; i < body.size(); i = Next(body, i))
+	{
+		auto next = Next(body, i);
+		if (body[i].Removed || body[i].Op != OpCode::Constants::OP_SET || next == body.size() || targets.contains(next))
+		{
+			continue;
+		}
+		auto& load = body[next];
+		auto scope = GetTypeFromIdx(body[i].Operands[0]);
+		if (load.Op != OpCode::Constants::OP_GET || load.Operands[0] != body[i].Operands[0] || (scope != ScopeType::SCOPE_GLOBAL && scope != ScopeType::SCOPE_LOCAL))
+		{
+			continue;
+		}
+		body[i].Op = OpCode::Constants::OP_SET_KEEP;
+		body[i].Changed = true;
+		load.Removed = true;
+		changed = true;
+	}
+	return changed;
+}
+
+bool PeepholeOptimizer::DropPushes(Body& body, std::set<size_t>& targets)
+{
+	auto changed = false;
+	for (size_t i = 0; i < body.size(); i = Next(body, i))
+	{
+		auto next = Next(body, i);
+		if (body[i].Removed || next == body.size() || targets.contains(next))
+		{
+			continue;
+		}
+
+		auto& push = body[i];
+		auto& pop = body[next];
+		if ((IsPush(push) && pop.Op == OpCode::Constants::OP_POP) || (push.Op == OpCode::Constants::OP_TRUE && pop.Op == OpCode::Constants::OP_JUMPIFZ))
+		{
+			if (!Overwritten(body, Next(body, next)))
+			{
+				continue;
+			}
+			push.Removed = pop.Removed = true;
+		}
+		else if (push.Op == OpCode::Constants::OP_FALSE && pop.Op == OpCode::Constants::OP_JUMPIFZ)
+		{
+			if (!Overwritten(body, Resolve(body, pop.Operands[0])))
+			{
+				continue;
+			}
+			push.Removed = true;
+			pop.Op = OpCode::Constants::OP_JUMP;
+		}
+		else
+		{
+			continue;
+		}
+
+		//jumps to the removed push land on what follows it now
+		if (targets.contains(i))
+		{
+			targets.insert(Next(body, i));
+		}
+		changed = true;
+	}
+	return changed;
+}
+
+bool PeepholeOptimizer::DropJumpsToNext(Body& body)
+{
+	auto changed = false;
+	for (size_t i = 0; i < body.size(); i = Next(body, i))
+	{
+		auto& instr = body[i];
+		if (instr.Removed || instr.Op != OpCode::Constants::OP_JUMP || instr.Operands[0] <= instr.Offset)
+		{
+			continue;
+		}
+		if (Resolve(body, instr.Operands[0]) == Next(body, i))
+		{
+			instr.Removed = true;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+size_t PeepholeOptimizer::Resolve(const Body& body, size_t offset)
+{
+	auto it = std::lower_bound(body.begin(), body.end(), offset, [](const Instr& instr, size_t off) { return instr.Offset < off; });
+	auto index = static_cast<size_t>(std::distance(body.begin(), it));
+	while (index < body.size() && body[index].Removed)
+	{
+		index++;
+	}
+	return index;
+}
+
+size_t PeepholeOptimizer::Next(const Body& body, size_t index)
+{
+	index++;
+	while (index < body.size() && body[index].Removed)
+	{
+		index++;
+	}
+	return index;
+}
+
+std::set<size_t> PeepholeOptimizer::Targets(const Body& body)
+{
+	std::set<size_t> targets;
+	for (auto& instr : body)
+	{
+		if (!instr.Removed && IsJump(instr.Op))
+		{
+			targets.insert(Resolve(body, instr.Operands[0]));
+		}
+	}
+	return targets;
+}
+
+bool PeepholeOptimizer::Overwritten(const Body& body, size_t index)
+{
+	while (index < body.size())
+	{
+		auto& instr = body[index];
+		switch (instr.Op)
+		{
+		case OpCode::Constants::OP_POP:
+		case OpCode::Constants::OP_SET:
+		case OpCode::Constants::OP_SET_KEEP:
+		case OpCode::Constants::OP_SET_ASSIGN:
+		case OpCode::Constants::OP_JUMPIFZ:
+		case OpCode::Constants::OP_RETURN:
+		case OpCode::Constants::OP_RET_VAL:
+			return true;
+		case OpCode::Constants::OP_JUMP:
+			//the vm can stop at a back-edge with the value still the last popped one
+			if (instr.Operands[0] <= instr.Offset)
+			{
+				return false;
+			}
+			index = Resolve(body, instr.Operands[0]);
+			continue;
+		case OpCode::Constants::OP_CALL:
+		case OpCode::Constants::OP_ITER:
+		case OpCode::Constants::OP_ITER_NEXT:
+		case OpCode::Constants::OP_FOR_RANGE:
+		case OpCode::Constants::OP_GENERATOR:
+		case OpCode::Constants::OP_YIELD:
+		case OpCode::Constants::OP_GEN_RETURN:
+			return false;
+		default:
+			break;
+		}
+		index = Next(body, index);
+	}
+	//the end of the program, its last popped value is the result
+	return false;
+}
+
+size_t PeepholeOptimizer::Layout(Body& body)
+{
+	size_t offset = 0;
+	for (auto& instr : body)
+	{
+		instr.NewOffset = offset;
+		if (instr.Removed)
+		{
+			continue;
+		}
+		if (instr.Op == OpCode::Constants::OP_LFUN)
+		{
+			instr.Operands[2] = static_cast<uint32_t>(Layout(instr.Body));
+			offset += instr.Operands[2];
+		}
+		offset += instr.Bytes.size();
+	}
+	return offset;
+}
+
+void PeepholeOptimizer::Encode(const Body& body, size_t size, RSInstructions& out, std::vector<std::pair<size_t, size_t>>& moved)
+{
+	for (auto& instr : body)
+	{
+		moved.push_back({ instr.Absolute, out.size() });
+		if (instr.Removed)
+		{
+			continue;
+		}
+
+		RSInstructions bytes;
+		if (IsJump(instr.Op))
+		{
+			auto target = Resolve(body, instr.Operands[0]);
+			bytes = OpCode::Make(instr.Op, { static_cast<uint32_t>(target == body.size() ? size : body[target].NewOffset) });
+		}
+		else if (instr.Op == OpCode::Constants::OP_LFUN || instr.Changed)
+		{
+			bytes = OpCode::Make(instr.Op, instr.Operands);
+		}
+		else
+		{
+			bytes = instr.Bytes;
+		}
+		out.insert(out.end(), bytes.begin(), bytes.end());
+
+		if (instr.Op == OpCode::Constants::OP_LFUN)
+		{
+			Encode(instr.Body, instr.Operands[2], out, moved);
+		}
+	}
+}
+
+bool PeepholeOptimizer::IsJump(OpCode::Constants opcode)
+{
+	return opcode == OpCode::Constants::OP_JUMP || opcode == OpCode::Constants::OP_JUMPIFZ
+		|| opcode == OpCode::Constants::OP_ITER_NEXT || opcode == OpCode::Constants::OP_FOR_RANGE;
+}
+
+bool PeepholeOptimizer::IsPush(const Instr& instr)
+{
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	case OpCode::Constants::OP_LDECIMAL:
+	case OpCode::Constants::OP_LSTRING:
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+	case OpCode::Constants::OP_NULL:
+	case OpCode::Constants::OP_CUR_CLOSURE:
+		return true;
+	case OpCode::Constants::OP_GET:
+	{
+		//an undefined global is an error
+		auto scope = GetTypeFromIdx(instr.Operands[0]);
+		return scope == ScopeType::SCOPE_LOCAL || scope == ScopeType::SCOPE_FREE;
+	}
+	default:
+		return false;
+	}
+}
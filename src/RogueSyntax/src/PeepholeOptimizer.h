@@ -0,0 +1,58 @@
+#pragma once
+#include <StandardLib.h>
+#include <OpCode.h>
+
+//rewrites short instruction sequences of the finished bytecode the ir passes leave behind, nested if and while statements
+//jump to jumps, a store is loaded straight back and literal conditions and statements push values only to pop them again
+class PeepholeOptimizer
+{
+public:
+	//true if the code changed, jumps, function bodies and debug symbols are moved to the offsets left after the rewrites
+	static bool Run(ObjectCode& code);
+
+private:
+	struct Instr
+	{
+		OpCode::Constants Op;
+		std::vector<uint32_t> Operands;
+		//the encoded instruction, only the header of an OP_LFUN
+		RSInstructions Bytes;
+		//relative to the start of the function body, like the jump targets
+		size_t Offset = 0;
+		size_t Absolute = 0;
+		size_t NewOffset = 0;
+		bool Removed = false;
+		bool Changed = false;
+		//instructions of an OP_LFUN body
+		std::vector<Instr> Body;
+	};
+	typedef std::vector<Instr> Body;
+
+	static Body Decode(const RSInstructions& instructions, size_t begin, size_t end);
+	static bool Optimize(Body& body);
+
+	//point jumps at the end of a chain of unconditional jumps
+	static bool ThreadJumps(Body& body);
+	//OP_SET x, OP_GET x becomes OP_SET_KEEP x
+	static bool KeepStores(Body& body, const std::set<size_t>& targets);
+	//pushes popped straight away and branches on literal conditions
+	static bool DropPushes(Body& body, std::set<size_t>& targets);
+	//unconditional jumps to the instruction that follows them
+	static bool DropJumpsToNext(Body& body);
+
+	//index of the first instruction left at or after the offset, body.size() past the last one
+	static size_t Resolve(const Body& body, size_t offset);
+	static size_t Next(const Body& body, size_t index);
+	//indexes of the instructions jumps land on
+	static std::set<size_t> Targets(const Body& body);
+	//something from the instruction on pops before the vm can stop, the value a removed pop left as the last popped
+	//value is replaced before anything reads it
+	static bool Overwritten(const Body& body, size_t index);
+
+	static size_t Layout(Body& body);
+	//moved maps the old offset of every instruction to its new one, removed instructions to the instruction after them
+	static void Encode(const Body& body, size_t size, RSInstructions& out, std::vector<std::pair<size_t, size_t>>& moved);
+	static bool IsJump(OpCode::Constants opcode);
+	//pushes a value without anything else happening
+	static bool IsPush(const Instr& instr);
+};
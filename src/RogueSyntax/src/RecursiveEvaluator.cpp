@@ -88,8 +88,12 @@ void RecursiveEvaluator::NodeEval(const LetStatement* let)
 		
 		auto identClone = EvalFactory->Clone(target);
 		auto* ident = dynamic_cast<IdentifierObj*>(identClone);
-		ident->Set(nullptr, value);
-		EvalEnvironment->Set(_env, ident->Name, value);
+		if (ident != nullptr)
+		{
+			ident->Set(nullptr, value);
+		}
+		//an unbound name that matches a builtin evaluated to the builtin, the let still binds a variable
+		EvalEnvironment->Set(_env, dynamic_cast<const Identifier*>(let->Name)->Value, value);
 	}
 	else if (let->Name->IsThisA<IndexExpression>())
 	{
@@ -133,21 +137,19 @@ void RecursiveEvaluator::NodeEval(const LetStatement* let)
 
 void RecursiveEvaluator::NodeEval(const Identifier* ident)
 {
-	if (EvalBuiltIn->IsBuiltIn(ident->Value))
+	//a variable shadows a builtin of the same name
+	auto value = EvalEnvironment->Get(_env, ident->Value);
+	if (value != nullptr)
+	{
+		_results.push(EvalFactory->New<IdentifierObj>(ident->Value, value));
+	}
+	else if (EvalBuiltIn->IsBuiltIn(ident->Value))
 	{
 		_results.push(EvalFactory->New<BuiltInObj>(ident->Value));
 	}
 	else
 	{
-		auto value = EvalEnvironment->Get(_env, ident->Value);
-		if (value != nullptr)
-		{
-			_results.push(EvalFactory->New<IdentifierObj>(ident->Value, value));
-		}
-		else
-		{
-			_results.push(EvalFactory->New<IdentifierObj>(ident->Value, NullObj::NULL_OBJ_REF));
-		}
+		_results.push(EvalFactory->New<IdentifierObj>(ident->Value, NullObj::NULL_OBJ_REF));
 	}
 }
 
@@ -278,7 +280,7 @@ void RecursiveEvaluator::NodeEval(const CallExpression* call)
 	if (function->IsThisA<BuiltInObj>())
 	{
 		auto* builtInObj = dynamic_cast<const BuiltInObj*>(function);
-		auto builtInToCall = EvalBuiltIn->GetBuiltInFunction(builtInObj->Name);
+		auto builtInToCall = builtInObj->Resolve(EvalBuiltIn, EvalFactory.get());
 
 		if (builtInToCall == nullptr)
 		{
@@ -514,6 +516,64 @@ void RecursiveEvaluator::NodeEval(const ForStatement* forEx)
 	_results.push(NullObj::NULL_OBJ_REF);
 }
 
+void RecursiveEvaluator::NodeEval(const ForInStatement* forIn)
+{
+	auto iterable = Eval(forIn->Iterable, _env);
+
+	iterable = UnwrapIfReturnObj(iterable);
+	iterable = UnwrapIfIdentObj(iterable);
+
+	if (iterable->IsThisA<ErrorObj>())
+	{
+		_results.push(iterable);
+		return;
+	}
+
+	//generators need the vm, the evaluators only walk arrays and ranges
+	if (!iterable->IsThisA<ArrayObj>() && !iterable->IsThisA<RangeObj>())
+	{
+		_results.push(MakeError(_env, std::format("can only iterate over arrays and ranges, got {}", iterable->TypeName()), forIn->BaseToken));
+		return;
+	}
+
+	auto* name = dynamic_cast<const Identifier*>(forIn->Name);
+	auto count = IterationCount(iterable);
+	for (size_t i = 0; i < count; i++)
+	{
+		EvalEnvironment->Set(_env, name->Value, IterationElement(iterable, i));
+		auto evaluated = Eval(forIn->Action, _env);
+		if (evaluated != nullptr)
+		{
+			if (evaluated->IsThisA<ReturnObj>())
+			{
+				auto* ret = dynamic_cast<const ReturnObj*>(evaluated);
+				if (ret->Value == BreakObj::BREAK_OBJ_REF)
+				{
+					return;
+				}
+
+				if (ret->Value != ContinueObj::CONTINUE_OBJ_REF)
+				{
+					_results.push(evaluated);
+					return;
+				}
+			}
+
+			if (evaluated->IsThisA<ErrorObj>())
+			{
+				_results.push(evaluated);
+				return;
+			}
+		}
+	}
+	_results.push(NullObj::NULL_OBJ_REF);
+}
+
+void RecursiveEvaluator::NodeEval(const YieldExpression* yield)
+{
+	_results.push(MakeError(_env, "yield is only supported by the compiler", yield->BaseToken));
+}
+
 void RecursiveEvaluator::NodeEval(const BreakStatement* breakStmt)
 {
 	_results.push(EvalFactory->New<ReturnObj>(BreakObj::BREAK_OBJ_REF));
@@ -19,20 +19,42 @@ std::shared_ptr<Program> RogueSyntax::Parse(const std::string& input, const std:
 	return parser.ParseProgram(unit);
 }
 
-ObjectCode RogueSyntax::Compile(const std::string& input, const std::string& unit) const
+std::shared_ptr<Program> RogueSyntax::ParseOrThrow(const std::string& input, const std::string& unit) const
 {
 	Lexer lexer(input);
 	Parser parser(lexer);
 	auto program = parser.ParseProgram(unit);
-	if (!parser.Errors().empty())
+	auto errors = parser.Errors();
+	if (!errors.empty())
 	{
-		throw std::runtime_error("Parser error"); //TODO: better error handling
+		std::string message = "parser errors:";
+		for (const auto& error : errors)
+		{
+			message.append("\n\t").append(error);
+		}
+		throw std::runtime_error(message);
 	}
+	return program;
+}
 
-	Compiler compiler(_objectStore->Factory());
+ObjectCode RogueSyntax::Compile(const std::string& input, const std::string& unit) const
+{
+	auto program = ParseOrThrow(input, unit);
+	Compiler compiler(_objectStore->Factory(), _compilerOptions);
 	return compiler.Compile(program, _builtIn, "PRG");
 }
 
+std::string RogueSyntax::DumpIr(const std::string& input, const std::string& unit) const
+{
+	auto program = ParseOrThrow(input, unit);
+	auto options = _compilerOptions;
+	options.EnableIrPasses = true;
+	options.DumpIr = true;
+	Compiler compiler(_objectStore->Factory(), options);
+	compiler.Compile(program, _builtIn, "PRG");
+	return compiler.IrDump();
+}
+
 std::string RogueSyntax::Disassemble(const ByteCode& code, bool includeDebugSymbols) const
 {
 	if (includeDebugSymbols)
@@ -58,6 +80,26 @@ std::shared_ptr<RogueVM> RogueSyntax::MakeVM(ByteCode code) const
 	return std::make_shared<RogueVM>(code, _builtIn, _objectStore->Factory());
 }
 
+std::shared_ptr<RogueVM> RogueSyntax::MakeVM(const std::shared_ptr<const ByteCode>& code) const
+{
+	return std::make_shared<RogueVM>(code, _builtIn, _objectStore->Factory());
+}
+
+std::shared_ptr<RogueVM> RogueSyntax::MakeIsolatedVM(const std::shared_ptr<const ByteCode>& code) const
+{
+	return RogueVM::NewIsolated(code, _builtIn);
+}
+
+std::shared_ptr<VmPool> RogueSyntax::MakeVmPool(size_t maxIdlePerProgram) const
+{
+	return std::make_shared<VmPool>(_builtIn, _objectStore->Factory(), maxIdlePerProgram);
+}
+
+std::shared_ptr<VmScheduler> RogueSyntax::MakeScheduler(const std::shared_ptr<const ByteCode>& code, const SchedulerOptions& options) const
+{
+	return std::make_shared<VmScheduler>(code, _builtIn, _objectStore->Factory(), options);
+}
+
 const IObject* RogueSyntax::QuickEval(EvaluatorType type, const std::string& input) const
 {
 	auto program = Parse(input, "QUICKEVAL");
@@ -76,7 +118,86 @@ const IObject* RogueSyntax::QuickEval(EvaluatorType type, const std::string& inp
 	}
 }
 
-void RogueSyntax::RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func)
+void RogueSyntax::RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func, bool pure)
+{
+	_builtIn->RegisterBuiltIn(name, func, pure);
+}
+
+ExecutionScope RogueSyntax::BeginRun()
+{
+	auto previous = _objectStore;
+	_objectStore = ObjectStore::NewRegion();
+	return ExecutionScope(this, _objectStore, previous);
+}
+
+void RogueSyntax::EndRun(const std::shared_ptr<ObjectStore>& previous)
+{
+	_objectStore = previous;
+}
+
+ExecutionScope::ExecutionScope(RogueSyntax* syntax, const std::shared_ptr<ObjectStore>& region, const std::shared_ptr<ObjectStore>& previous)
+	: _syntax(syntax), _region(region), _previous(previous)
+{
+}
+
+ExecutionScope::ExecutionScope(ExecutionScope&& other) noexcept
+	: _syntax(other._syntax), _region(std::move(other._region)), _previous(std::move(other._previous))
+{
+	other._syntax = nullptr;
+}
+
+ExecutionScope::~ExecutionScope()
+{
+	if (_syntax != nullptr)
+	{
+		_syntax->EndRun(_previous);
+	}
+}
+
+const IObject* ExecutionScope::Keep(const IObject* obj) const
 {
-	_builtIn->RegisterBuiltIn(name, func);
-}
\ No newline at end of file
+	//clones share the function of a closure, so every closure the value reaches is rebuilt with a function of its own
+	auto factory = _previous->Factory();
+	if (obj->IsThisA<ClosureObj>())
+	{
+		auto closure = dynamic_cast<const ClosureObj*>(obj);
+		std::vector<const IObject*> frees;
+		std::transform(closure->Frees.begin(), closure->Frees.end(), std::back_inserter(frees), [this](const auto& free) { return Keep(free); });
+		auto function = dynamic_cast<FunctionCompiledObj*>(factory->Clone(closure->Function));
+		function->FuncOffset = closure->Function->FuncOffset;
+		return factory->New<ClosureObj>(function, frees);
+	}
+	if (obj->IsThisA<GeneratorObj>())
+	{
+		auto generator = dynamic_cast<const GeneratorObj*>(obj);
+		std::vector<const IObject*> slots;
+		std::transform(generator->Slots.begin(), generator->Slots.end(), std::back_inserter(slots), [this](const auto& slot) { return slot != nullptr ? Keep(slot) : nullptr; });
+		auto kept = factory->New<GeneratorObj>(dynamic_cast<const ClosureObj*>(Keep(generator->Closure)), slots, generator->Ip);
+		kept->Status = generator->Status;
+		return kept;
+	}
+	if (obj->IsThisA<ArrayObj>())
+	{
+		auto array = dynamic_cast<const ArrayObj*>(obj);
+		std::vector<const IObject*> elements;
+		std::transform(array->Elements.begin(), array->Elements.end(), std::back_inserter(elements), [this](const auto& elem) { return Keep(elem); });
+		return factory->New<ArrayObj>(elements);
+	}
+	if (obj->IsThisA<HashObj>())
+	{
+		auto hash = dynamic_cast<const HashObj*>(obj);
+		std::unordered_map<HashKey, HashEntry> elements;
+		for (const auto& [key, entry] : hash->Elements)
+		{
+			elements.emplace(key, HashEntry{ Keep(entry.Key), Keep(entry.Value) });
+		}
+		return factory->New<HashObj>(elements);
+	}
+	if (obj->IsThisA<ArrayIteratorObj>())
+	{
+		auto iterator = dynamic_cast<const ArrayIteratorObj*>(obj);
+		return factory->New<ArrayIteratorObj>(dynamic_cast<const ArrayObj*>(Keep(iterator->Array)), iterator->Next);
+	}
+	return factory->Clone(obj);
+}
+
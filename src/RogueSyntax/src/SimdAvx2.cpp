@@ -0,0 +1,66 @@
+//built with avx2 enabled and without the precompiled header, only reached when the cpu and os report avx2
+#include "SimdKernelsImpl.h"
+
+#ifdef ROGUESYNTAX_SIMD_X86
+#include <immintrin.h>
+
+namespace
+{
+	struct Avx2Int
+	{
+		using T = int32_t;
+		using Reg = __m256i;
+		using Mask = __m256i;
+		static constexpr size_t Width = 8;
+		static constexpr bool VectorDiv = false;
+
+		static Reg Load(const T* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void Store(T* p, Reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static Reg Set1(T v) { return _mm256_set1_epi32(v); }
+		static Reg Add(Reg a, Reg b) { return _mm256_add_epi32(a, b); }
+		static Reg Sub(Reg a, Reg b) { return _mm256_sub_epi32(a, b); }
+		static Reg Mul(Reg a, Reg b) { return _mm256_mullo_epi32(a, b); }
+		static Reg Min(Reg a, Reg b) { return _mm256_min_epi32(a, b); }
+		static Reg Max(Reg a, Reg b) { return _mm256_max_epi32(a, b); }
+		static Mask Eq(Reg a, Reg b) { return _mm256_cmpeq_epi32(a, b); }
+		static Mask Neq(Reg a, Reg b) { return _mm256_xor_si256(_mm256_cmpeq_epi32(a, b), _mm256_set1_epi32(-1)); }
+		static Mask Lt(Reg a, Reg b) { return _mm256_cmpgt_epi32(b, a); }
+		static Mask Lte(Reg a, Reg b) { return _mm256_xor_si256(_mm256_cmpgt_epi32(a, b), _mm256_set1_epi32(-1)); }
+		static Mask Gt(Reg a, Reg b) { return _mm256_cmpgt_epi32(a, b); }
+		static Mask Gte(Reg a, Reg b) { return _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), _mm256_set1_epi32(-1)); }
+		static void StoreMask(int32_t* p, Mask m) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_and_si256(m, _mm256_set1_epi32(1))); }
+	};
+
+	struct Avx2Decimal
+	{
+		using T = float;
+		using Reg = __m256;
+		using Mask = __m256;
+		static constexpr size_t Width = 8;
+		static constexpr bool VectorDiv = true;
+
+		static Reg Load(const T* p) { return _mm256_loadu_ps(p); }
+		static void Store(T* p, Reg v) { _mm256_storeu_ps(p, v); }
+		static Reg Set1(T v) { return _mm256_set1_ps(v); }
+		static Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+		static Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+		static Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+		static Reg Div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+		static Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+		static Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+		static Mask Eq(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+		static Mask Neq(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+		static Mask Lt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static Mask Lte(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Mask Gt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static Mask Gte(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static void StoreMask(int32_t* p, Mask m) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_and_si256(_mm256_castps_si256(m), _mm256_set1_epi32(1))); }
+	};
+}
+
+const SimdKernelTable& Avx2KernelTable()
+{
+	static const SimdKernelTable table = MakeKernelTable<Avx2Int, Avx2Decimal>();
+	return table;
+}
+#endif
@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "SimdKernelsImpl.h"
+
+#if defined(ROGUESYNTAX_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	template <typename Elem>
+	struct ScalarLanes
+	{
+		using T = Elem;
+		using Reg = Elem;
+		using Mask = bool;
+		static constexpr size_t Width = 1;
+		static constexpr bool VectorDiv = true;
+
+		static Reg Load(const T* p) { return *p; }
+		static void Store(T* p, Reg v) { *p = v; }
+		static Reg Set1(T v) { return v; }
+		static Reg Add(Reg a, Reg b) { return Plus(a, b); }
+		static Reg Sub(Reg a, Reg b) { return Minus(a, b); }
+		static Reg Mul(Reg a, Reg b) { return Times(a, b); }
+		static Reg Div(Reg a, Reg b) { return Divide(a, b); }
+		static Reg Min(Reg a, Reg b) { return b < a ? b : a; }
+		static Reg Max(Reg a, Reg b) { return b > a ? b : a; }
+		static Mask Eq(Reg a, Reg b) { return a == b; }
+		static Mask Neq(Reg a, Reg b) { return a != b; }
+		static Mask Lt(Reg a, Reg b) { return a < b; }
+		static Mask Lte(Reg a, Reg b) { return a <= b; }
+		static Mask Gt(Reg a, Reg b) { return a > b; }
+		static Mask Gte(Reg a, Reg b) { return a >= b; }
+		static void StoreMask(int32_t* p, Mask m) { *p = m ? 1 : 0; }
+	};
+
+	SimdLevel DetectLevel()
+	{
+#if defined(ROGUESYNTAX_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		auto maxLeaf = info[0];
+		__cpuid(info, 1);
+		auto sse41 = (info[2] & (1 << 19)) != 0;
+		//avx needs the os to save the ymm registers
+		auto osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		auto avx2 = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? SimdLevel::Avx2 : sse41 ? SimdLevel::Sse41 : SimdLevel::Scalar;
+#elif defined(ROGUESYNTAX_SIMD_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return SimdLevel::Avx2;
+		}
+		return __builtin_cpu_supports("sse4.1") ? SimdLevel::Sse41 : SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	const SimdKernelTable* TableFor(SimdLevel level)
+	{
+#ifdef ROGUESYNTAX_SIMD_X86
+		switch (level)
+		{
+		case SimdLevel::Avx2:
+			return &Avx2KernelTable();
+		case SimdLevel::Sse41:
+			return &Sse41KernelTable();
+		default:
+			break;
+		}
+#endif
+		return &ScalarKernelTable();
+	}
+
+	struct ActiveKernels
+	{
+		ActiveKernels() : Detected(DetectLevel()), Level(Detected), Table(TableFor(Detected)) {}
+
+		SimdLevel Detected;
+		std::atomic<SimdLevel> Level;
+		std::atomic<const SimdKernelTable*> Table;
+	};
+
+	ActiveKernels& Kernels()
+	{
+		static ActiveKernels kernels;
+		return kernels;
+	}
+}
+
+const SimdKernelTable& ScalarKernelTable()
+{
+	static const SimdKernelTable table = MakeKernelTable<ScalarLanes<int32_t>, ScalarLanes<float>>();
+	return table;
+}
+
+SimdLevel SimdKernels::Detected()
+{
+	return Kernels().Detected;
+}
+
+SimdLevel SimdKernels::Active()
+{
+	return Kernels().Level;
+}
+
+void SimdKernels::SetLevel(SimdLevel level)
+{
+	auto& kernels = Kernels();
+	level = std::min(level, kernels.Detected);
+	kernels.Table = TableFor(level);
+	kernels.Level = level;
+}
+
+const SimdKernelTable& SimdKernels::Table()
+{
+	return *Kernels().Table.load(std::memory_order_relaxed);
+}
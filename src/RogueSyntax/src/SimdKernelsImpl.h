@@ -0,0 +1,237 @@
+#pragma once
+#include <SimdKernels.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ROGUESYNTAX_SIMD_X86
+#endif
+
+//one table per instruction set, each built in its own translation unit with the matching compiler flags
+const SimdKernelTable& ScalarKernelTable();
+#ifdef ROGUESYNTAX_SIMD_X86
+const SimdKernelTable& Sse41KernelTable();
+const SimdKernelTable& Avx2KernelTable();
+#endif
+
+//the kernels are written once against a lane traits type V:
+//  T, Reg, Mask, Width, VectorDiv
+//  Load, Store, Set1, Add, Sub, Mul, (Div), Min, Max, Eq, Neq, Lt, Lte, Gt, Gte, StoreMask
+//the unnamed namespace keeps every instantiation local to the translation unit that was compiled for its
+//instruction set, the linker must never pick an avx2 copy for a caller running on an older cpu
+namespace
+{
+	inline int32_t Plus(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+	inline int32_t Minus(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+	inline int32_t Times(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+	inline int32_t Divide(int32_t a, int32_t b) { return b == -1 ? Minus(0, a) : a / b; }
+	inline float Plus(float a, float b) { return a + b; }
+	inline float Minus(float a, float b) { return a - b; }
+	inline float Times(float a, float b) { return a * b; }
+	inline float Divide(float a, float b) { return a / b; }
+
+	template <typename T>
+	bool Holds(CompareOp op, T a, T b)
+	{
+		switch (op)
+		{
+		case CompareOp::Eq: return a == b;
+		case CompareOp::Neq: return a != b;
+		case CompareOp::Lt: return a < b;
+		case CompareOp::Lte: return a <= b;
+		case CompareOp::Gt: return a > b;
+		default: return a >= b;
+		}
+	}
+
+	template <typename V>
+	typename V::T Sum(const typename V::T* a, size_t n)
+	{
+		auto acc = V::Set1(0);
+		size_t i = 0;
+		for (; i + V::Width <= n; i += V::Width)
+		{
+			acc = V::Add(acc, V::Load(a + i));
+		}
+
+		typename V::T lanes[V::Width];
+		V::Store(lanes, acc);
+		typename V::T total = 0;
+		for (size_t l = 0; l < V::Width; l++)
+		{
+			total = Plus(total, lanes[l]);
+		}
+		for (; i < n; i++)
+		{
+			total = Plus(total, a[i]);
+		}
+		return total;
+	}
+
+	template <typename V>
+	typename V::T Dot(const typename V::T* a, const typename V::T* b, size_t n)
+	{
+		auto acc = V::Set1(0);
+		size_t i = 0;
+		for (; i + V::Width <= n; i += V::Width)
+		{
+			acc = V::Add(acc, V::Mul(V::Load(a + i), V::Load(b + i)));
+		}
+
+		typename V::T lanes[V::Width];
+		V::Store(lanes, acc);
+		typename V::T total = 0;
+		for (size_t l = 0; l < V::Width; l++)
+		{
+			total = Plus(total, lanes[l]);
+		}
+		for (; i < n; i++)
+		{
+			total = Plus(total, Times(a[i], b[i]));
+		}
+		return total;
+	}
+
+	template <typename V, bool IsMin>
+	typename V::T Extreme(const typename V::T* a, size_t n)
+	{
+		auto acc = V::Set1(a[0]);
+		size_t i = 0;
+		for (; i + V::Width <= n; i += V::Width)
+		{
+			auto x = V::Load(a + i);
+			acc = IsMin ? V::Min(acc, x) : V::Max(acc, x);
+		}
+
+		typename V::T lanes[V::Width];
+		V::Store(lanes, acc);
+		auto best = lanes[0];
+		for (size_t l = 1; l < V::Width; l++)
+		{
+			best = IsMin ? (lanes[l] < best ? lanes[l] : best) : (lanes[l] > best ? lanes[l] : best);
+		}
+		for (; i < n; i++)
+		{
+			best = IsMin ? (a[i] < best ? a[i] : best) : (a[i] > best ? a[i] : best);
+		}
+		return best;
+	}
+
+	template <typename V, typename VecOp, typename ScalarOp>
+	void ArithLoop(const typename V::T* a, const typename V::T* b, bool scalar, typename V::T* out, size_t n, VecOp vec, ScalarOp one)
+	{
+		size_t i = 0;
+		if (scalar)
+		{
+			auto y = V::Set1(b[0]);
+			for (; i + V::Width <= n; i += V::Width)
+			{
+				V::Store(out + i, vec(V::Load(a + i), y));
+			}
+			for (; i < n; i++)
+			{
+				out[i] = one(a[i], b[0]);
+			}
+			return;
+		}
+		for (; i + V::Width <= n; i += V::Width)
+		{
+			V::Store(out + i, vec(V::Load(a + i), V::Load(b + i)));
+		}
+		for (; i < n; i++)
+		{
+			out[i] = one(a[i], b[i]);
+		}
+	}
+
+	template <typename V>
+	void Arith(VectorOp op, const typename V::T* a, const typename V::T* b, bool scalar, typename V::T* out, size_t n)
+	{
+		using T = typename V::T;
+		using Reg = typename V::Reg;
+		switch (op)
+		{
+		case VectorOp::Add:
+			ArithLoop<V>(a, b, scalar, out, n, [](Reg x, Reg y) { return V::Add(x, y); }, [](T x, T y) { return Plus(x, y); });
+			break;
+		case VectorOp::Sub:
+			ArithLoop<V>(a, b, scalar, out, n, [](Reg x, Reg y) { return V::Sub(x, y); }, [](T x, T y) { return Minus(x, y); });
+			break;
+		case VectorOp::Mul:
+			ArithLoop<V>(a, b, scalar, out, n, [](Reg x, Reg y) { return V::Mul(x, y); }, [](T x, T y) { return Times(x, y); });
+			break;
+		case VectorOp::Div:
+			if constexpr (V::VectorDiv)
+			{
+				ArithLoop<V>(a, b, scalar, out, n, [](Reg x, Reg y) { return V::Div(x, y); }, [](T x, T y) { return Divide(x, y); });
+			}
+			else
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					out[i] = Divide(a[i], scalar ? b[0] : b[i]);
+				}
+			}
+			break;
+		}
+	}
+
+	template <typename V, typename VecCmp>
+	void CompareLoop(CompareOp op, const typename V::T* a, const typename V::T* b, bool scalar, int32_t* out, size_t n, VecCmp vec)
+	{
+		size_t i = 0;
+		auto y = V::Set1(b[0]);
+		for (; i + V::Width <= n; i += V::Width)
+		{
+			V::StoreMask(out + i, vec(V::Load(a + i), scalar ? y : V::Load(b + i)));
+		}
+		for (; i < n; i++)
+		{
+			out[i] = Holds(op, a[i], scalar ? b[0] : b[i]) ? 1 : 0;
+		}
+	}
+
+	template <typename V>
+	void Compare(CompareOp op, const typename V::T* a, const typename V::T* b, bool scalar, int32_t* out, size_t n)
+	{
+		using Reg = typename V::Reg;
+		switch (op)
+		{
+		case CompareOp::Eq:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Eq(x, y); });
+			break;
+		case CompareOp::Neq:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Neq(x, y); });
+			break;
+		case CompareOp::Lt:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Lt(x, y); });
+			break;
+		case CompareOp::Lte:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Lte(x, y); });
+			break;
+		case CompareOp::Gt:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Gt(x, y); });
+			break;
+		case CompareOp::Gte:
+			CompareLoop<V>(op, a, b, scalar, out, n, [](Reg x, Reg y) { return V::Gte(x, y); });
+			break;
+		}
+	}
+
+	template <typename VInt, typename VDecimal>
+	SimdKernelTable MakeKernelTable()
+	{
+		SimdKernelTable table;
+		table.SumInt = &Sum<VInt>;
+		table.SumDecimal = &Sum<VDecimal>;
+		table.MinInt = &Extreme<VInt, true>;
+		table.MaxInt = &Extreme<VInt, false>;
+		table.MinDecimal = &Extreme<VDecimal, true>;
+		table.MaxDecimal = &Extreme<VDecimal, false>;
+		table.DotInt = &Dot<VInt>;
+		table.DotDecimal = &Dot<VDecimal>;
+		table.ArithInt = &Arith<VInt>;
+		table.ArithDecimal = &Arith<VDecimal>;
+		table.CompareInt = &Compare<VInt>;
+		table.CompareDecimal = &Compare<VDecimal>;
+		return table;
+	}
+}
@@ -0,0 +1,66 @@
+//built with sse4.1 enabled and without the precompiled header, only reached when the cpu reports sse4.1
+#include "SimdKernelsImpl.h"
+
+#ifdef ROGUESYNTAX_SIMD_X86
+#include <immintrin.h>
+
+namespace
+{
+	struct Sse41Int
+	{
+		using T = int32_t;
+		using Reg = __m128i;
+		using Mask = __m128i;
+		static constexpr size_t Width = 4;
+		static constexpr bool VectorDiv = false;
+
+		static Reg Load(const T* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void Store(T* p, Reg v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static Reg Set1(T v) { return _mm_set1_epi32(v); }
+		static Reg Add(Reg a, Reg b) { return _mm_add_epi32(a, b); }
+		static Reg Sub(Reg a, Reg b) { return _mm_sub_epi32(a, b); }
+		static Reg Mul(Reg a, Reg b) { return _mm_mullo_epi32(a, b); }
+		static Reg Min(Reg a, Reg b) { return _mm_min_epi32(a, b); }
+		static Reg Max(Reg a, Reg b) { return _mm_max_epi32(a, b); }
+		static Mask Eq(Reg a, Reg b) { return _mm_cmpeq_epi32(a, b); }
+		static Mask Neq(Reg a, Reg b) { return _mm_xor_si128(_mm_cmpeq_epi32(a, b), _mm_set1_epi32(-1)); }
+		static Mask Lt(Reg a, Reg b) { return _mm_cmplt_epi32(a, b); }
+		static Mask Lte(Reg a, Reg b) { return _mm_xor_si128(_mm_cmpgt_epi32(a, b), _mm_set1_epi32(-1)); }
+		static Mask Gt(Reg a, Reg b) { return _mm_cmpgt_epi32(a, b); }
+		static Mask Gte(Reg a, Reg b) { return _mm_xor_si128(_mm_cmplt_epi32(a, b), _mm_set1_epi32(-1)); }
+		static void StoreMask(int32_t* p, Mask m) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_and_si128(m, _mm_set1_epi32(1))); }
+	};
+
+	struct Sse41Decimal
+	{
+		using T = float;
+		using Reg = __m128;
+		using Mask = __m128;
+		static constexpr size_t Width = 4;
+		static constexpr bool VectorDiv = true;
+
+		static Reg Load(const T* p) { return _mm_loadu_ps(p); }
+		static void Store(T* p, Reg v) { _mm_storeu_ps(p, v); }
+		static Reg Set1(T v) { return _mm_set1_ps(v); }
+		static Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+		static Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+		static Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+		static Reg Div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+		static Reg Min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+		static Reg Max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+		static Mask Eq(Reg a, Reg b) { return _mm_cmpeq_ps(a, b); }
+		static Mask Neq(Reg a, Reg b) { return _mm_cmpneq_ps(a, b); }
+		static Mask Lt(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+		static Mask Lte(Reg a, Reg b) { return _mm_cmple_ps(a, b); }
+		static Mask Gt(Reg a, Reg b) { return _mm_cmpgt_ps(a, b); }
+		static Mask Gte(Reg a, Reg b) { return _mm_cmpge_ps(a, b); }
+		static void StoreMask(int32_t* p, Mask m) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_and_si128(_mm_castps_si128(m), _mm_set1_epi32(1))); }
+	};
+}
+
+const SimdKernelTable& Sse41KernelTable()
+{
+	static const SimdKernelTable table = MakeKernelTable<Sse41Int, Sse41Decimal>();
+	return table;
+}
+#endif
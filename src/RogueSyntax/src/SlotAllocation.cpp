@@ -0,0 +1,175 @@
+#include "SlotAllocation.h"
+#include <pch.h>
+
+bool SlotAllocationPass::Run(IrFunction& function)
+{
+	//globals are shared with every function of the program
+	if (function.IsProgram || function.NumSlots <= 1)
+	{
+		return false;
+	}
+
+	auto liveIn = LiveIn(function);
+	auto interference = Interference(function, liveIn);
+
+	//the caller stores the arguments in the first slots, every other local takes the lowest slot none of its neighbours has
+	std::vector<uint32_t> assigned(function.NumSlots);
+	uint32_t numSlots = function.NumParams;
+	for (uint32_t slot = 0; slot < function.NumSlots; slot++)
+	{
+		if (slot < function.NumParams)
+		{
+			assigned[slot] = slot;
+			continue;
+		}
+		std::set<uint32_t> taken;
+		for (auto other : interference[slot])
+		{
+			if (other < slot)
+			{
+				taken.insert(assigned[other]);
+			}
+		}
+		uint32_t candidate = 0;
+		while (taken.contains(candidate))
+		{
+			candidate++;
+		}
+		assigned[slot] = candidate;
+		numSlots = std::max(numSlots, candidate + 1);
+	}
+
+	auto changed = numSlots != function.NumSlots;
+	for (auto id : function.Layout)
+	{
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			auto local = LocalOf(instr);
+			if (!local.has_value() || assigned[*local] == *local)
+			{
+				continue;
+			}
+			instr.Operands[0] = assigned[*local] | 0x8000;
+			changed = true;
+		}
+	}
+	function.NumSlots = numSlots;
+	return changed;
+}
+
+std::vector<SlotAllocationPass::Slots> SlotAllocationPass::LiveIn(const IrFunction& function) const
+{
+	//backward over the graph until nothing changes, a loop carries what its header needs around the back edge
+	std::vector<Slots> liveIn(function.Blocks.size());
+	auto order = function.ReversePostOrder();
+	auto changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
+		{
+			auto& block = function.Blocks[*it];
+			Slots live;
+			for (auto succ : block.Succs())
+			{
+				live.insert(liveIn[succ].begin(), liveIn[succ].end());
+			}
+			for (auto instr = block.Instrs.rbegin(); instr != block.Instrs.rend(); ++instr)
+			{
+				Step(*instr, live, nullptr);
+			}
+			if (live != liveIn[*it])
+			{
+				liveIn[*it] = std::move(live);
+				changed = true;
+			}
+		}
+	}
+	return liveIn;
+}
+
+std::vector<SlotAllocationPass::Slots> SlotAllocationPass::Interference(const IrFunction& function, const std::vector<Slots>& liveIn) const
+{
+	std::vector<Slots> interference(function.NumSlots);
+	for (auto id : function.ReversePostOrder())
+	{
+		auto& block = function.Blocks[id];
+		Slots live;
+		for (auto succ : block.Succs())
+		{
+			live.insert(liveIn[succ].begin(), liveIn[succ].end());
+		}
+		for (auto instr = block.Instrs.rbegin(); instr != block.Instrs.rend(); ++instr)
+		{
+			Step(*instr, live, &interference);
+		}
+	}
+
+	//the arguments and anything loaded before it is stored are all there when the frame starts
+	auto& entry = liveIn[function.Layout.front()];
+	Slots start(entry.begin(), entry.end());
+	for (uint32_t param = 0; param < function.NumParams && param < function.NumSlots; param++)
+	{
+		start.insert(param);
+	}
+	for (auto slot : start)
+	{
+		for (auto other : start)
+		{
+			if (slot != other)
+			{
+				interference[slot].insert(other);
+			}
+		}
+	}
+	return interference;
+}
+
+void SlotAllocationPass::Step(const IrInstr& instr, Slots& live, std::vector<Slots>* interference)
+{
+	auto local = LocalOf(instr);
+	if (instr.Dead || !local.has_value())
+	{
+		return;
+	}
+
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_GET:
+		live.insert(*local);
+		break;
+	case OpCode::Constants::OP_SET:
+	case OpCode::Constants::OP_SET_ASSIGN:
+		//a store clobbers whatever shares its slot, so it conflicts with every other local still needed after it
+		if (interference != nullptr)
+		{
+			for (auto other : live)
+			{
+				if (other != *local)
+				{
+					(*interference)[*local].insert(other);
+					(*interference)[other].insert(*local);
+				}
+			}
+		}
+		live.erase(*local);
+		//an indexed store reads the container it replaces
+		if (instr.Op == OpCode::Constants::OP_SET_ASSIGN)
+		{
+			live.insert(*local);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+std::optional<uint32_t> SlotAllocationPass::LocalOf(const IrInstr& instr)
+{
+	if ((instr.Op != OpCode::Constants::OP_GET && instr.Op != OpCode::Constants::OP_SET && instr.Op != OpCode::Constants::OP_SET_ASSIGN) ||
+		GetTypeFromIdx(instr.Operands[0]) != ScopeType::SCOPE_LOCAL)
+	{
+		return std::nullopt;
+	}
+	return static_cast<uint32_t>(AdjustIdx(instr.Operands[0]));
+}
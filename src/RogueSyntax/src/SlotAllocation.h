@@ -0,0 +1,22 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//every let of a function gets its own local, so block scoped temporaries widen the frame a call reserves,
+//locals that are never live at the same time are given one slot and the frame shrinks to the slots left
+class SlotAllocationPass : public IrPass
+{
+public:
+	std::string Name() const override { return "slot allocation"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	typedef std::set<uint32_t> Slots;
+
+	//the locals whose value may still be loaded at the start of every block
+	std::vector<Slots> LiveIn(const IrFunction& function) const;
+	//pairs of locals one of which is stored while the other is live
+	std::vector<Slots> Interference(const IrFunction& function, const std::vector<Slots>& liveIn) const;
+	static void Step(const IrInstr& instr, Slots& live, std::vector<Slots>* interference);
+	static std::optional<uint32_t> LocalOf(const IrInstr& instr);
+};
@@ -176,8 +176,12 @@ void StackEvaluator::NodeEval(const LetStatement* let)
 
 			auto identClone = EvalFactory->Clone(identResult);
 			auto* ident = dynamic_cast<IdentifierObj*>(identClone);
-			auto result = ident->Set(nullptr, value);
-			EvalEnvironment->Set(_currentEnv, ident->Name, value);
+			if (ident != nullptr)
+			{
+				ident->Set(nullptr, value);
+			}
+			//an unbound name that matches a builtin evaluated to the builtin, the let still binds a variable
+			EvalEnvironment->Set(_currentEnv, dynamic_cast<const Identifier*>(let->Name)->Value, value);
 		}
 	}
 	else if (typeid(*(let->Name)) == typeid(IndexExpression))
@@ -224,23 +228,21 @@ void StackEvaluator::NodeEval(const LetStatement* let)
 }
 void StackEvaluator::NodeEval(const Identifier* ident)
 {
-	if (EvalBuiltIn->IsBuiltIn(ident->Value))
+	//a variable shadows a builtin of the same name
+	auto value = EvalEnvironment->Get(_currentEnv, ident->Value);
+	if (value != nullptr)
+	{
+		Push_Result(EvalFactory->New<IdentifierObj>(ident->Value, value));
+		//EvalEnvironment->Set(env, ident->Value, value);
+	}
+	else if (EvalBuiltIn->IsBuiltIn(ident->Value))
 	{
 		Push_Result(EvalFactory->New<BuiltInObj>(ident->Value));
 	}
 	else
 	{
-		auto value = EvalEnvironment->Get(_currentEnv, ident->Value);
-		if (value != nullptr)
-		{
-			Push_Result(EvalFactory->New<IdentifierObj>(ident->Value, value));
-			//EvalEnvironment->Set(env, ident->Value, value);
-		}
-		else
-		{
-			Push_Result(EvalFactory->New<IdentifierObj>(ident->Value, NullObj::NULL_OBJ_REF));
-			EvalEnvironment->Set(_currentEnv, ident->Value, NullObj::NULL_OBJ_REF);
-		}
+		Push_Result(EvalFactory->New<IdentifierObj>(ident->Value, NullObj::NULL_OBJ_REF));
+		EvalEnvironment->Set(_currentEnv, ident->Value, NullObj::NULL_OBJ_REF);
 		//result = MakeError(std::format("identifier not found: {}", ident->Value), ident->BaseToken);
 	}
 }
@@ -392,7 +394,7 @@ void StackEvaluator::NodeEval(const CallExpression* call)
 		if (function->IsThisA<BuiltInObj>())
 		{
 			auto func = dynamic_cast<const BuiltInObj*>(function);
-			auto builtInToCall = EvalBuiltIn->GetBuiltInFunction(func->Name);
+			auto builtInToCall = func->Resolve(EvalBuiltIn, EvalFactory.get());
 			if (builtInToCall == nullptr)
 			{
 				Push_Result(MakeError(_currentEnv, std::format("unknown function: {}", func->Name), call->BaseToken));
@@ -634,6 +636,73 @@ void StackEvaluator::NodeEval(const ForStatement* forExp)
 		Push_Eval(forExp->Post, 0, _currentEnv);
 	}
 }
+void StackEvaluator::NodeEval(const ForInStatement* forIn)
+{
+	//the iterable is kept in the environment between steps, signal 2 + i means element i was just run
+	auto hidden = std::format("for#{}", forIn->Id());
+	auto* name = dynamic_cast<const Identifier*>(forIn->Name);
+	size_t next = 0;
+	if (_currentSignal == 0)
+	{
+		Push_Eval(forIn, 1, _currentEnv);
+		Push_Eval(forIn->Iterable, 0, _currentEnv);
+		return;
+	}
+	else if (_currentSignal == 1)
+	{
+		auto iterable = Pop_ResultAndUnwrap();
+		if (iterable->IsThisA<ErrorObj>())
+		{
+			Push_Result(iterable);
+			return;
+		}
+
+		//generators need the vm, the evaluators only walk arrays and ranges
+		if (!iterable->IsThisA<ArrayObj>() && !iterable->IsThisA<RangeObj>())
+		{
+			Push_Result(MakeError(_currentEnv, std::format("can only iterate over arrays and ranges, got {}", iterable->TypeName()), forIn->BaseToken));
+			return;
+		}
+		EvalEnvironment->Set(_currentEnv, hidden, iterable);
+	}
+	else
+	{
+		//check the action for return/error
+		if (ResultIsReturn())
+		{
+			auto top = Pop_Result();
+
+			auto* ret = dynamic_cast<const ReturnObj*>(top);
+			if (!(ret->Value == ContinueObj::CONTINUE_OBJ_REF || ret->Value == BreakObj::BREAK_OBJ_REF))
+			{
+				Push_Result(top);
+				return;
+			}
+			if (ret->Value == BreakObj::BREAK_OBJ_REF)
+			{
+				return;
+			}
+		}
+
+		if (ResultIsError())
+		{
+			return;
+		}
+		next = _currentSignal - 1;
+	}
+
+	auto* iterable = EvalEnvironment->Get(_currentEnv, hidden);
+	if (next < IterationCount(iterable))
+	{
+		EvalEnvironment->Set(_currentEnv, name->Value, IterationElement(iterable, next));
+		Push_Eval(forIn, static_cast<int32_t>(next) + 2, _currentEnv);
+		Push_Eval(forIn->Action, 0, _currentEnv);
+	}
+}
+void StackEvaluator::NodeEval(const YieldExpression* yield)
+{
+	Push_Result(MakeError(_currentEnv, "yield is only supported by the compiler", yield->BaseToken));
+}
 void StackEvaluator::NodeEval(const ContinueStatement* cont)
 {
 	Push_Result(EvalFactory->New<ReturnObj>(ContinueObj::CONTINUE_OBJ_REF));
@@ -31,6 +31,8 @@ public:
 	void NodeEval(const NullLiteral* null) override;
 	void NodeEval(const WhileStatement* whileExp) override;
 	void NodeEval(const ForStatement* forExp) override;
+	void NodeEval(const ForInStatement* forIn) override;
+	void NodeEval(const YieldExpression* yield) override;
 	void NodeEval(const ContinueStatement* cont) override;
 	void NodeEval(const BreakStatement* brk) override;
 
@@ -0,0 +1,68 @@
+#include "StrengthReduction.h"
+#include "TypeInference.h"
+#include <pch.h>
+
+bool StrengthReductionPass::Run(IrFunction& function)
+{
+	auto types = TypeInferencePass().Infer(function);
+
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			if (instr.Dead || instr.Args.size() != 2 || instr.Op < OpCode::Constants::OP_MUL || instr.Op > OpCode::Constants::OP_MOD)
+			{
+				continue;
+			}
+			auto left = types[instr.Args[0]];
+			auto* right = function.DefOf(instr.Args[1]);
+			auto exponent = right != nullptr ? PowerOfTwo(*right) : std::nullopt;
+			if (!exponent.has_value() || !TypeInferencePass::IsInt(left) || (instr.Op != OpCode::Constants::OP_MUL && !TypeInferencePass::IsNatural(left)))
+			{
+				continue;
+			}
+
+			//the literal is only used by this operator
+			auto& def = function.Value(instr.Args[1]);
+			auto& literal = function.Blocks[def.Block].Instrs[def.Index];
+			switch (instr.Op)
+			{
+			case OpCode::Constants::OP_MUL:
+				instr.Op = OpCode::Constants::OP_BLSHIFT;
+				literal.Operands = { *exponent };
+				break;
+			case OpCode::Constants::OP_DIV:
+				instr.Op = OpCode::Constants::OP_BRSHIFT;
+				literal.Operands = { *exponent };
+				break;
+			default:
+				instr.Op = OpCode::Constants::OP_BAND;
+				literal.Operands = { (1u << *exponent) - 1 };
+				break;
+			}
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+std::optional<uint32_t> StrengthReductionPass::PowerOfTwo(const IrInstr& instr)
+{
+	if (instr.Op != OpCode::Constants::OP_LINT)
+	{
+		return std::nullopt;
+	}
+	auto raw = instr.Operands[0];
+	auto value = reinterpret_cast<int32_t&>(raw);
+	if (value <= 0 || (value & (value - 1)) != 0)
+	{
+		return std::nullopt;
+	}
+	uint32_t exponent = 0;
+	while ((1 << exponent) != value)
+	{
+		exponent++;
+	}
+	return exponent;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//integer multiplies by a power of two become left shifts, divides and remainders of values proven never negative become
+//right shifts and masks, C++ division truncates towards zero so `-3 / 2` is not `-3 >> 1`
+class StrengthReductionPass : public IrPass
+{
+public:
+	std::string Name() const override { return "strength reduction"; }
+	bool Run(IrFunction& function) override;
+
+private:
+	//the exponent of a positive power of two literal
+	static std::optional<uint32_t> PowerOfTwo(const IrInstr& instr);
+};
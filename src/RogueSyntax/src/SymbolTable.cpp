@@ -69,8 +69,9 @@ Symbol SymbolTable::Define(const std::string& name)
 		return _store[index];
 	}
 
+	//a definition shadows a builtin of the same name instead of binding to it
 	index = FindInAllContexts(name);
-	if (index != -1)
+	if (index != -1 && _store[index].Type != ScopeType::SCOPE_EXTERN)
 	{
 		return _store[index];
 	}
@@ -138,6 +139,18 @@ Symbol SymbolTable::DefineFree(const Symbol& symbol)
 	return freeSym;
 }
 
+Symbol SymbolTable::DefineInlined(const std::string& name, const std::string& hostContext)
+{
+	//inlined parameters always get a fresh slot from the host context, they never rebind an outer name
+	auto decorated = _decorator.DecorateWithCurrentContex(name);
+	auto& idxMap = _contexts[hostContext];
+	int index = idxMap.NextSymIndex++;
+	auto type = _stack.size() <= 1 ? ScopeType::SCOPE_GLOBAL : ScopeType::SCOPE_LOCAL;
+	auto symbol = Symbol{ type, name, decorated, hostContext, _stack.top(), index };
+	_store.push_back(symbol);
+	return symbol;
+}
+
 uint32_t SymbolTable::NumberOfSymbolsInContext(uint32_t stackContext)
 {
 	uint32_t cnt = 0;
@@ -44,6 +44,7 @@ public:
 	Symbol DefineExternal(const std::string& name, int idx);
 	Symbol Resolve(const std::string& name);
 	Symbol DefineFree(const Symbol& symbol);
+	Symbol DefineInlined(const std::string& name, const std::string& hostContext);
 
 	uint32_t NumberOfSymbolsInContext(uint32_t stackContext);
 	std::vector<Symbol> SymbolsInContext(uint32_t stackContext);
@@ -70,6 +70,7 @@ const TokenType TokenType::TOKEN_WHILE         = { TokenType::NextTokenNumber++,
 const TokenType TokenType::TOKEN_BREAK         = { TokenType::NextTokenNumber++, "BREAK" };
 const TokenType TokenType::TOKEN_CONTINUE      = { TokenType::NextTokenNumber++, "CONTINUE" };
 const TokenType TokenType::TOKEN_FOR           = { TokenType::NextTokenNumber++, "FOR" };
+const TokenType TokenType::TOKEN_IN            = { TokenType::NextTokenNumber++, "IN" };
 
 //comments
 const TokenType TokenType::TOKEN_COMMENT       = { TokenType::NextTokenNumber++, "//" };
@@ -86,6 +87,7 @@ const std::map<std::string, TokenType> TokenType::KEYWORD_TOKEN_MAP = {
 	{"break", TokenType::TOKEN_BREAK},
 	{"continue", TokenType::TOKEN_CONTINUE},
 	{"for", TokenType::TOKEN_FOR},
+	{"in", TokenType::TOKEN_IN},
 	{"null", TokenType::TOKEN_NULL}
 };
 
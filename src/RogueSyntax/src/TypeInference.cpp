@@ -0,0 +1,308 @@
+#include "TypeInference.h"
+#include <pch.h>
+
+bool TypeInferencePass::Run(IrFunction& function)
+{
+	auto types = Infer(function);
+
+	auto changed = false;
+	for (auto id : function.Layout)
+	{
+		for (auto& instr : function.Blocks[id].Instrs)
+		{
+			if (instr.Dead || instr.Args.size() != 2)
+			{
+				continue;
+			}
+			auto opcode = Specialize(instr.Op, types[instr.Args[0]], types[instr.Args[1]]);
+			if (opcode != instr.Op)
+			{
+				instr.Op = opcode;
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+std::vector<IrType> TypeInferencePass::Infer(const IrFunction& function)
+{
+	_nestedWrites = function.NestedGlobalWrites();
+
+	//forward over the graph until the slot types at the end of every block settle,
+	//a pred not visited yet is left out of the meet and the loop around it is visited again
+	std::vector<IrType> types(function.Values.size(), IrType::Unknown);
+	std::vector<std::optional<SlotTypes>> exits(function.Blocks.size());
+	auto order = function.ReversePostOrder();
+	auto changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (auto id : order)
+		{
+			auto& block = function.Blocks[id];
+			SlotTypes slots;
+			auto first = id != order[0];
+			for (auto pred : block.Preds)
+			{
+				if (!exits[pred].has_value())
+				{
+					continue;
+				}
+				auto entry = Entry(function, pred, id, *exits[pred], types);
+				if (first)
+				{
+					slots = std::move(entry);
+					first = false;
+				}
+				else
+				{
+					Meet(slots, entry);
+				}
+			}
+
+			for (auto& instr : block.Instrs)
+			{
+				if (instr.Dead)
+				{
+					continue;
+				}
+				if (instr.Result != IrNoValue)
+				{
+					types[instr.Result] = ResultOf(function, instr, types, slots);
+				}
+				if (instr.Op == OpCode::Constants::OP_SET && function.TracksSlot(instr.Operands[0], _nestedWrites, false) && types[instr.Args[0]] != IrType::Unknown)
+				{
+					slots[instr.Operands[0]] = types[instr.Args[0]];
+				}
+				else if (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN)
+				{
+					slots.erase(instr.Operands[0]);
+				}
+			}
+
+			if (exits[id] != slots)
+			{
+				exits[id] = slots;
+				changed = true;
+			}
+		}
+	}
+	return types;
+}
+
+OpCode::Constants TypeInferencePass::Specialize(OpCode::Constants opcode, IrType left, IrType right)
+{
+	if (IsInt(left) && IsInt(right))
+	{
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_ADD: return OpCode::Constants::OP_ADD_II;
+		case OpCode::Constants::OP_LT: return OpCode::Constants::OP_LT_II;
+		default: return opcode;
+		}
+	}
+	if (left == IrType::String && right == IrType::String && opcode == OpCode::Constants::OP_ADD)
+	{
+		return OpCode::Constants::OP_CONCAT_SS;
+	}
+	return opcode;
+}
+
+IrType TypeInferencePass::ResultOf(const IrFunction& function, const IrInstr& instr, const std::vector<IrType>& types, const SlotTypes& slots) const
+{
+	switch (instr.Op)
+	{
+	case OpCode::Constants::OP_LINT:
+	{
+		auto raw = instr.Operands[0];
+		return reinterpret_cast<int32_t&>(raw) >= 0 ? IrType::Natural : IrType::Int;
+	}
+	case OpCode::Constants::OP_LDECIMAL:
+		return IrType::Decimal;
+	case OpCode::Constants::OP_LSTRING:
+		return IrType::String;
+	case OpCode::Constants::OP_TRUE:
+	case OpCode::Constants::OP_FALSE:
+		return IrType::Bool;
+	case OpCode::Constants::OP_GET:
+	{
+		auto it = slots.find(instr.Operands[0]);
+		return it != slots.end() ? it->second : IrType::Unknown;
+	}
+	case OpCode::Constants::OP_CALL:
+	{
+		auto* callee = function.DefOf(instr.Args[0]);
+		if (callee == nullptr || callee->Op != OpCode::Constants::OP_GET || GetTypeFromIdx(callee->Operands[0]) != ScopeType::SCOPE_EXTERN)
+		{
+			return IrType::Unknown;
+		}
+		auto idx = static_cast<size_t>(AdjustIdx(callee->Operands[0]));
+		auto tag = idx < function.ExternTypes.size() ? function.ExternTypes[idx] : 0;
+		if (tag == typeid(IntegerObj).hash_code())
+		{
+			return IrType::Int;
+		}
+		if (tag == typeid(DecimalObj).hash_code())
+		{
+			return IrType::Decimal;
+		}
+		if (tag == typeid(StringObj).hash_code())
+		{
+			return IrType::String;
+		}
+		if (tag == typeid(BooleanObj).hash_code())
+		{
+			return IrType::Bool;
+		}
+		return IrType::Unknown;
+	}
+	case OpCode::Constants::OP_ADD:
+	case OpCode::Constants::OP_ADD_II:
+	{
+		//`i + 1` of a counter below some Int is at most the largest Int
+		auto one = [&function](uint32_t value) { auto* def = function.DefOf(value); return def != nullptr && def->Op == OpCode::Constants::OP_LINT && def->Operands[0] == 1; };
+		auto left = types[instr.Args[0]];
+		auto right = types[instr.Args[1]];
+		if ((left == IrType::Bounded && one(instr.Args[1])) || (right == IrType::Bounded && one(instr.Args[0])))
+		{
+			return IrType::Natural;
+		}
+		return Binary(OpCode::Constants::OP_ADD, left, right);
+	}
+	default:
+		if (instr.Op >= OpCode::Constants::OP_ADD && instr.Op <= OpCode::Constants::OP_OR)
+		{
+			return Binary(instr.Op, types[instr.Args[0]], types[instr.Args[1]]);
+		}
+		if (instr.Op >= OpCode::Constants::OP_NEGATE && instr.Op <= OpCode::Constants::OP_BNOT)
+		{
+			return Prefix(instr.Op, types[instr.Args[0]]);
+		}
+		return IrType::Unknown;
+	}
+}
+
+IrType TypeInferencePass::Binary(OpCode::Constants opcode, IrType left, IrType right)
+{
+	if (IsInt(left) && IsInt(right))
+	{
+		if (opcode >= OpCode::Constants::OP_EQ)
+		{
+			return IrType::Bool;
+		}
+		//operators that cannot turn non-negative operands into a negative result, and masks that clear the sign bit,
+		//sums and products wrap around so they are only proven for a bounded value plus one, see ResultOf
+		auto natural = IsNatural(left) && IsNatural(right);
+		switch (opcode)
+		{
+		case OpCode::Constants::OP_DIV:
+		case OpCode::Constants::OP_MOD:
+		case OpCode::Constants::OP_BOR:
+		case OpCode::Constants::OP_BXOR:
+		case OpCode::Constants::OP_BRSHIFT:
+			return natural ? IrType::Natural : IrType::Int;
+		case OpCode::Constants::OP_BAND:
+			return (IsNatural(left) || IsNatural(right)) ? IrType::Natural : IrType::Int;
+		default:
+			return IrType::Int;
+		}
+	}
+
+	//mixed operands go through the TypeCoercer, only the same type on both sides is followed
+	if (left != right || left == IrType::Unknown)
+	{
+		return IrType::Unknown;
+	}
+	if (opcode >= OpCode::Constants::OP_EQ)
+	{
+		return IrType::Bool;
+	}
+
+	switch (left)
+	{
+	case IrType::Decimal:
+		return opcode <= OpCode::Constants::OP_MOD ? IrType::Decimal : IrType::Unknown;
+	case IrType::String:
+		return opcode == OpCode::Constants::OP_ADD ? IrType::String : IrType::Unknown;
+	default:
+		return IrType::Unknown;
+	}
+}
+
+IrType TypeInferencePass::Prefix(OpCode::Constants opcode, IrType right)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_NOT:
+		return (IsInt(right) || right == IrType::Decimal || right == IrType::Bool) ? IrType::Bool : IrType::Unknown;
+	case OpCode::Constants::OP_NEGATE:
+		return IsInt(right) ? IrType::Int : right == IrType::Decimal ? IrType::Decimal : IrType::Unknown;
+	default:
+		return IsInt(right) ? IrType::Int : IrType::Unknown;
+	}
+}
+
+void TypeInferencePass::Meet(SlotTypes& slots, const SlotTypes& other)
+{
+	for (auto it = slots.begin(); it != slots.end();)
+	{
+		auto match = other.find(it->first);
+		if (match != other.end() && IsInt(match->second) && IsInt(it->second))
+		{
+			//only one of the paths may prove it is never negative, or bounded
+			if (match->second != it->second)
+			{
+				it->second = IsNatural(match->second) && IsNatural(it->second) ? IrType::Natural : IrType::Int;
+			}
+			++it;
+		}
+		else if (match == other.end() || match->second != it->second)
+		{
+			it = slots.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+TypeInferencePass::SlotTypes TypeInferencePass::Entry(const IrFunction& function, uint32_t pred, uint32_t id, const SlotTypes& exit, const std::vector<IrType>& types)
+{
+	auto& block = function.Blocks[pred];
+	auto* last = block.Last();
+	if (last == nullptr || last->Op != OpCode::Constants::OP_JUMPIFZ || block.Next != id || block.Target == id)
+	{
+		return exit;
+	}
+	auto* condition = function.DefOf(last->Args[0]);
+	if (condition == nullptr || (condition->Op != OpCode::Constants::OP_LT && condition->Op != OpCode::Constants::OP_LT_II) || !IsInt(types[condition->Args[1]]))
+	{
+		return exit;
+	}
+	auto* load = function.DefOf(condition->Args[0]);
+	auto match = load != nullptr && load->Op == OpCode::Constants::OP_GET ? exit.find(load->Operands[0]) : exit.end();
+	if (match == exit.end() || !IsNatural(match->second))
+	{
+		return exit;
+	}
+
+	//the slot still holds the value that was compared
+	auto& value = function.Value(condition->Args[0]);
+	if (value.Block != pred)
+	{
+		return exit;
+	}
+	for (auto i = value.Index + 1; i < block.Instrs.size(); i++)
+	{
+		auto& instr = block.Instrs[i];
+		if (!instr.Dead && (instr.Op == OpCode::Constants::OP_SET || instr.Op == OpCode::Constants::OP_SET_ASSIGN) && instr.Operands[0] == load->Operands[0])
+		{
+			return exit;
+		}
+	}
+	auto entry = exit;
+	entry[load->Operands[0]] = IrType::Bounded;
+	return entry;
+}
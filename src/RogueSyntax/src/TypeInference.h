@@ -0,0 +1,46 @@
+#pragma once
+#include <StandardLib.h>
+#include "IrPassManager.h"
+
+//what a value holds on every path that reaches it, Unknown when paths disagree or nothing is proven
+enum class IrType
+{
+	Unknown,
+	Int,
+	//an Int that is never negative
+	Natural,
+	//a Natural that falls through a `<` against an Int, so adding one to it cannot wrap
+	Bounded,
+	Decimal,
+	String,
+	Bool,
+};
+
+//flow sensitive types for values and variables, from literals, known builtin results and the operators applied to them,
+//then operators whose operand types are proven become the typed opcodes, every other site keeps the generic one
+class TypeInferencePass : public IrPass
+{
+public:
+	std::string Name() const override { return "type inference"; }
+	bool Run(IrFunction& function) override;
+
+	//the type of every value, indexed like IrFunction::Values
+	std::vector<IrType> Infer(const IrFunction& function);
+	//the typed opcode for the operands, the opcode itself when there is none
+	static OpCode::Constants Specialize(OpCode::Constants opcode, IrType left, IrType right);
+	static bool IsInt(IrType type) { return type == IrType::Int || IsNatural(type); }
+	static bool IsNatural(IrType type) { return type == IrType::Natural || type == IrType::Bounded; }
+
+private:
+	typedef std::unordered_map<uint32_t, IrType> SlotTypes;
+
+	IrType ResultOf(const IrFunction& function, const IrInstr& instr, const std::vector<IrType>& types, const SlotTypes& slots) const;
+	static IrType Binary(OpCode::Constants opcode, IrType left, IrType right);
+	static IrType Prefix(OpCode::Constants opcode, IrType right);
+	static void Meet(SlotTypes& slots, const SlotTypes& other);
+	//the slot types at the end of pred, with the slot a `<` compares bounded on the edge that falls through the branch
+	static SlotTypes Entry(const IrFunction& function, uint32_t pred, uint32_t id, const SlotTypes& exit, const std::vector<IrType>& types);
+
+	//stores to globals by the functions nested in the one being inferred
+	std::unordered_map<uint32_t, uint32_t> _nestedWrites;
+};
@@ -0,0 +1,263 @@
+#include "TypedArrays.h"
+#include <pch.h>
+
+namespace
+{
+	bool IsNumber(const IObject* obj)
+	{
+		return obj->IsThisA<IntegerObj>() || obj->IsThisA<DecimalObj>();
+	}
+
+	bool IsDecimal(const IObject* obj)
+	{
+		return obj->IsThisA<DecimalArrayObj>() || obj->IsThisA<DecimalObj>();
+	}
+
+	//an operand viewed as elements of T, borrows the array's buffer unless it has to be converted
+	template <typename T>
+	class Elements
+	{
+	public:
+		Elements(const IObject* obj)
+		{
+			if (obj->IsThisA<IntArrayObj>())
+			{
+				View(dynamic_cast<const IntArrayObj*>(obj)->Values);
+			}
+			else if (obj->IsThisA<DecimalArrayObj>())
+			{
+				View(dynamic_cast<const DecimalArrayObj*>(obj)->Values);
+			}
+			else if (obj->IsThisA<IntegerObj>())
+			{
+				_storage.push_back(static_cast<T>(dynamic_cast<const IntegerObj*>(obj)->Value));
+				Scalar = true;
+			}
+			else
+			{
+				_storage.push_back(static_cast<T>(dynamic_cast<const DecimalObj*>(obj)->Value));
+				Scalar = true;
+			}
+			Size = _data != nullptr ? Size : _storage.size();
+		}
+
+		const T* Data() const { return _data != nullptr ? _data : _storage.data(); }
+
+		size_t Size = 0;
+		bool Scalar = false;
+
+	private:
+		template <typename U>
+		void View(const std::vector<U>& values)
+		{
+			if constexpr (std::is_same_v<T, U>)
+			{
+				_data = values.data();
+				Size = values.size();
+			}
+			else
+			{
+				_storage.assign(values.begin(), values.end());
+			}
+		}
+
+		const T* _data = nullptr;
+		std::vector<T> _storage;
+	};
+
+	template <typename T>
+	size_t ResultSize(const Elements<T>& a, const Elements<T>& b)
+	{
+		if (!a.Scalar && !b.Scalar && a.Size != b.Size)
+		{
+			throw std::runtime_error(std::format("typed array lengths differ. got={} and {}", a.Size, b.Size));
+		}
+		return a.Scalar ? b.Size : a.Size;
+	}
+
+	template <typename T, typename ArrayT, typename Kernel>
+	IObject* ApplyArithmetic(const ObjectFactory* factory, VectorOp op, const IObject* left, const IObject* right, Kernel kernel)
+	{
+		Elements<T> a(left);
+		Elements<T> b(right);
+		auto n = ResultSize(a, b);
+		std::vector<T> out(n);
+		if (n == 0)
+		{
+			return factory->New<ArrayT>(std::move(out));
+		}
+
+		if constexpr (std::is_integral_v<T>)
+		{
+			if (op == VectorOp::Div && std::find(b.Data(), b.Data() + b.Size, 0) != b.Data() + b.Size)
+			{
+				throw std::runtime_error("division by zero");
+			}
+		}
+
+		if (!a.Scalar)
+		{
+			kernel(op, a.Data(), b.Data(), b.Scalar, out.data(), n);
+		}
+		else if (op == VectorOp::Add || op == VectorOp::Mul)
+		{
+			kernel(op, b.Data(), a.Data(), true, out.data(), n);
+		}
+		else
+		{
+			//the kernels only broadcast the right hand side
+			std::vector<T> broadcast(n, a.Data()[0]);
+			kernel(op, broadcast.data(), b.Data(), false, out.data(), n);
+		}
+		return factory->New<ArrayT>(std::move(out));
+	}
+
+	CompareOp Flip(CompareOp op)
+	{
+		switch (op)
+		{
+		case CompareOp::Lt: return CompareOp::Gt;
+		case CompareOp::Lte: return CompareOp::Gte;
+		case CompareOp::Gt: return CompareOp::Lt;
+		case CompareOp::Gte: return CompareOp::Lte;
+		default: return op;
+		}
+	}
+
+	template <typename T, typename Kernel>
+	IObject* ApplyCompare(const ObjectFactory* factory, CompareOp op, const IObject* left, const IObject* right, Kernel kernel)
+	{
+		Elements<T> a(left);
+		Elements<T> b(right);
+		auto n = ResultSize(a, b);
+		std::vector<int32_t> out(n);
+		if (n > 0)
+		{
+			if (a.Scalar)
+			{
+				kernel(Flip(op), b.Data(), a.Data(), true, out.data(), n);
+			}
+			else
+			{
+				kernel(op, a.Data(), b.Data(), b.Scalar, out.data(), n);
+			}
+		}
+		return factory->New<IntArrayObj>(std::move(out));
+	}
+
+	template <typename T>
+	std::vector<T> ElementsOf(const std::string& name, const IObject* source)
+	{
+		std::vector<T> values;
+		if (source->IsThisA<IntegerObj>())
+		{
+			auto size = dynamic_cast<const IntegerObj*>(source)->Value;
+			if (size < 0)
+			{
+				throw std::runtime_error(std::format("length passed to `{}` must not be negative", name));
+			}
+			values.resize(size);
+		}
+		else if (source->IsThisA<IntArrayObj>() || source->IsThisA<DecimalArrayObj>())
+		{
+			Elements<T> elements(source);
+			values.assign(elements.Data(), elements.Data() + elements.Size);
+		}
+		else if (source->IsThisA<RangeObj>())
+		{
+			auto range = dynamic_cast<const RangeObj*>(source);
+			values.reserve(range->Count());
+			for (size_t i = 0; i < range->Count(); i++)
+			{
+				values.push_back(static_cast<T>(range->At(i)));
+			}
+		}
+		else if (source->IsThisA<ArrayObj>())
+		{
+			auto arr = dynamic_cast<const ArrayObj*>(source);
+			values.reserve(arr->Elements.size());
+			for (auto* element : arr->Elements)
+			{
+				if (!IsNumber(element) || (std::is_integral_v<T> && !element->IsThisA<IntegerObj>()))
+				{
+					throw std::runtime_error(std::format("element passed to `{}` not supported, got {}", name, element->TypeName()));
+				}
+				values.push_back(Elements<T>(element).Data()[0]);
+			}
+		}
+		else
+		{
+			throw std::runtime_error(std::format("argument to `{}` not supported, got {}", name, source->TypeName()));
+		}
+		return values;
+	}
+}
+
+bool TypedArrays::IsTypedArray(const IObject* obj)
+{
+	return obj->IsThisA<IntArrayObj>() || obj->IsThisA<DecimalArrayObj>();
+}
+
+bool TypedArrays::IsOperand(const IObject* left, const IObject* right)
+{
+	return (IsTypedArray(left) && (IsTypedArray(right) || IsNumber(right)))
+		|| (IsNumber(left) && IsTypedArray(right));
+}
+
+IObject* TypedArrays::Arithmetic(const ObjectFactory* factory, VectorOp op, const IObject* left, const IObject* right)
+{
+	if (!IsOperand(left, right))
+	{
+		throw std::runtime_error(std::format("typed array operands not supported, got {} {}", left->TypeName(), right->TypeName()));
+	}
+
+	auto& kernels = SimdKernels::Table();
+	if (IsDecimal(left) || IsDecimal(right))
+	{
+		return ApplyArithmetic<float, DecimalArrayObj>(factory, op, left, right, kernels.ArithDecimal);
+	}
+	return ApplyArithmetic<int32_t, IntArrayObj>(factory, op, left, right, kernels.ArithInt);
+}
+
+IObject* TypedArrays::Compare(const ObjectFactory* factory, CompareOp op, const IObject* left, const IObject* right)
+{
+	if (!IsOperand(left, right))
+	{
+		throw std::runtime_error(std::format("typed array operands not supported, got {} {}", left->TypeName(), right->TypeName()));
+	}
+
+	auto& kernels = SimdKernels::Table();
+	if (IsDecimal(left) || IsDecimal(right))
+	{
+		return ApplyCompare<float>(factory, op, left, right, kernels.CompareDecimal);
+	}
+	return ApplyCompare<int32_t>(factory, op, left, right, kernels.CompareInt);
+}
+
+IObject* TypedArrays::At(const ObjectFactory* factory, const IObject* arr, size_t index)
+{
+	if (arr->IsThisA<IntArrayObj>())
+	{
+		return factory->New<IntegerObj>(dynamic_cast<const IntArrayObj*>(arr)->Values[index]);
+	}
+	return factory->New<DecimalObj>(dynamic_cast<const DecimalArrayObj*>(arr)->Values[index]);
+}
+
+size_t TypedArrays::Size(const IObject* arr)
+{
+	if (arr->IsThisA<IntArrayObj>())
+	{
+		return dynamic_cast<const IntArrayObj*>(arr)->Values.size();
+	}
+	return dynamic_cast<const DecimalArrayObj*>(arr)->Values.size();
+}
+
+IObject* TypedArrays::MakeInt(const ObjectFactory* factory, const IObject* source)
+{
+	return factory->New<IntArrayObj>(ElementsOf<int32_t>("intArray", source));
+}
+
+IObject* TypedArrays::MakeDecimal(const ObjectFactory* factory, const IObject* source)
+{
+	return factory->New<DecimalArrayObj>(ElementsOf<float>("decimalArray", source));
+}
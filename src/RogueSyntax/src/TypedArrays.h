@@ -0,0 +1,29 @@
+#pragma once
+#include <StandardLib.h>
+#include <IObject.h>
+#include <SimdKernels.h>
+
+//operators and builtins over IntArrayObj and DecimalArrayObj, all of them run on the active simd kernels
+//an operand may be a plain number that is applied to every element, mixing int and decimal produces decimals
+class TypedArrays
+{
+public:
+	static bool IsTypedArray(const IObject* obj);
+
+	//true when one side is a typed array and the other a typed array or a number
+	static bool IsOperand(const IObject* left, const IObject* right);
+
+	//elementwise, the arrays must have the same length - throws on anything else
+	static IObject* Arithmetic(const ObjectFactory* factory, VectorOp op, const IObject* left, const IObject* right);
+
+	//an intArray holding 1 where the comparison holds and 0 elsewhere
+	static IObject* Compare(const ObjectFactory* factory, CompareOp op, const IObject* left, const IObject* right);
+
+	//element i as an IntegerObj or DecimalObj, the index must be in range
+	static IObject* At(const ObjectFactory* factory, const IObject* arr, size_t index);
+	static size_t Size(const IObject* arr);
+
+	//from an array of numbers, a range, a length filled with zeros or the other typed kind
+	static IObject* MakeInt(const ObjectFactory* factory, const IObject* source);
+	static IObject* MakeDecimal(const ObjectFactory* factory, const IObject* source);
+};
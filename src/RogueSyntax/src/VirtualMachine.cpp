@@ -8,6 +8,7 @@
 #include "VirtualMachine.h"
 #include "VirtualMachine.h"
 #include "pch.h"
+#include "TypedArrays.h"
 
 
 std::string StackTrace::ToString() const
@@ -26,31 +27,406 @@ std::string RogueVm_RuntimeError::ToString() const
 };
 
 RogueVM::RogueVM(const ByteCode& byteCode, const std::shared_ptr<ObjectFactory>& factory)
-	: _byteCode(byteCode), _externals(nullptr), _factory(factory), _coercer(factory), _onError(std::bind(&RogueVM::OnErrorInternal, this, std::placeholders::_1)), _onBreak(std::bind(&RogueVM::OnBreakInternal, this, std::placeholders::_1))
+	: RogueVM(std::make_shared<const ByteCode>(byteCode), nullptr, factory)
 {
-	//main frame
-	auto function = _factory->New<FunctionCompiledObj>(_byteCode.Instructions, 0, 0);
-	auto closure = _factory->New<ClosureObj>(function, std::vector<const IObject*>{});
-	PushFrame(Frame(closure, 0));
-	_externals = nullptr;
 }
 
-RogueVM::RogueVM(const ByteCode& byteCode, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory) : _byteCode(byteCode), _externals(externals), _factory(factory), _coercer(factory), _onError(std::bind(&RogueVM::OnErrorInternal, this, std::placeholders::_1)), _onBreak(std::bind(&RogueVM::OnBreakInternal, this, std::placeholders::_1))
+RogueVM::RogueVM(const ByteCode& byteCode, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory)
+	: RogueVM(std::make_shared<const ByteCode>(byteCode), externals, factory)
 {
-	//main frame
-	auto function = _factory->New<FunctionCompiledObj>(_byteCode.Instructions, 0, 0);
-	auto closure = _factory->New<ClosureObj>(function, std::vector<const IObject*>{});
-	PushFrame(Frame(closure, 0));
+}
+
+RogueVM::RogueVM(const std::shared_ptr<const ByteCode>& byteCode, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, const VmLimits& limits, const ClosureObj* mainClosure) : _limits(limits), _byteCode(byteCode), _externals(externals), _nursery(std::make_unique<Nursery>(factory, Nursery::DEFAULT_SIZE)), _factory(factory->WithNursery(_nursery.get())), _coercer(_factory), _onError(std::bind(&RogueVM::OnErrorInternal, this, std::placeholders::_1)), _onBreak(std::bind(&RogueVM::OnBreakInternal, this, std::placeholders::_1))
+{
+	//globals and the main frame are sized from the compiled layout, everything else grows on demand
+	_globals.resize(_byteCode->NumGlobals, nullptr);
+	_stack.resize(std::max<size_t>(_limits.InitialStackSize, _byteCode->MaxStackDepth), nullptr);
+	_frames.resize(_limits.InitialFrames);
+
+	//main frame - allocated in the store so it survives collections and resets without being copied
+	PushFrame(Frame(mainClosure != nullptr ? mainClosure : MakeMainClosure(*_byteCode, factory), 0));
+}
+
+std::shared_ptr<RogueVM> RogueVM::NewIsolated(const std::shared_ptr<const ByteCode>& byteCode, const std::shared_ptr<BuiltIn>& externals, const VmLimits& limits)
+{
+	auto heap = std::make_shared<ObjectStore>();
+	auto vm = std::make_shared<RogueVM>(byteCode, externals, heap->Factory(), limits);
+	vm->_heap = heap;
+	return vm;
+}
+
+const ClosureObj* RogueVM::MakeMainClosure(const ByteCode& byteCode, const std::shared_ptr<ObjectFactory>& factory)
+{
+	auto function = factory->New<FunctionCompiledObj>(byteCode.Instructions, 0, 0);
+	function->MaxStackDepth = byteCode.MaxStackDepth;
+	return factory->New<ClosureObj>(function, std::vector<const IObject*>{});
 }
 
 RogueVM::~RogueVM()
 {
+	CancelTasks();
+}
+
+static thread_local RogueVM* s_activeVm = nullptr;
+
+RogueVM* RogueVM::Active()
+{
+	return s_activeVm;
+}
+
+std::shared_ptr<RogueVM> RogueVM::Fork(const ClosureObj* mainClosure) const
+{
+	auto heap = std::make_shared<ObjectStore>();
+	auto vm = std::make_shared<RogueVM>(_byteCode, _externals, heap->Factory(), _limits, mainClosure);
+	vm->_heap = heap;
+	//the globals can reference anything this vm references
+	vm->_adopted = _adopted;
+	vm->Adopt(_heap);
+	vm->_globals = _globals;
+	vm->_globalsUsed = _globalsUsed;
+	vm->_readOnlyGlobals = 1;
+	vm->_builtins = _builtins;
+	vm->_parallelThreshold = _parallelThreshold;
+	vm->_taskGroup = _taskGroup;
+	vm->_status = VmStatus::Running;
+	return vm;
+}
+
+void RogueVM::Start(const ClosureObj* closure, const std::vector<const IObject*>& args)
+{
+	auto fn = closure->Function;
+	if (args.size() != fn->NumParameters)
+	{
+		throw std::runtime_error(std::format("Expected {} arguments but got {}", fn->NumParameters, args.size()));
+	}
+
+	//the main frame has nothing left to run, the vm completes when the closure returns into it
+	_frames[0].SetIp(static_cast<int>(_frames[0].Instructions().size()));
+	Push(closure);
+	for (auto* arg : args)
+	{
+		Push(arg);
+	}
+	auto frame = Frame(closure, _sp - static_cast<int>(args.size()));
+	PushFrame(frame);
+	EnsureStack(frame.BasePointer() + fn->NumLocals + fn->MaxStackDepth);
+	_sp = frame.BasePointer() + fn->NumLocals;
+}
+
+std::shared_ptr<GreenTask> RogueVM::Spawn(const ClosureObj* closure, const std::vector<const IObject*>& args)
+{
+	//the task reads these from another thread, after the collection they are in the store and never move
+	std::vector<const IObject*> inputs{ closure };
+	inputs.insert(inputs.end(), args.begin(), args.end());
+	_roots.push_back(&inputs);
+	MinorCollection();
+	_roots.pop_back();
+
+	if (_taskGroup == nullptr)
+	{
+		_taskGroup = std::make_shared<TaskGroup>();
+		_ownsTaskGroup = true;
+	}
+
+	auto vm = Fork(_frames[0].Closure());
+	vm->SetNurserySize(TASK_NURSERY_SIZE);
+	vm->Start(dynamic_cast<const ClosureObj*>(inputs[0]), std::vector<const IObject*>(inputs.begin() + 1, inputs.end()));
+
+	auto task = std::make_shared<GreenTask>(vm, _taskGroup);
+	vm->_task = task.get();
+	_taskGroup->Add(task);
+	task->Schedule();
+	return task;
+}
+
+std::shared_ptr<GreenTask> RogueVM::CurrentTask() const
+{
+	return _task != nullptr ? _task->shared_from_this() : nullptr;
+}
+
+void RogueVM::CancelTasks()
+{
+	if (_ownsTaskGroup)
+	{
+		_taskGroup->Cancel();
+		_taskGroup = nullptr;
+		_ownsTaskGroup = false;
+	}
+}
+
+void RogueVM::Adopt(const std::shared_ptr<ObjectStore>& store)
+{
+	if (store != nullptr && store != _heap && std::find(_adopted.begin(), _adopted.end(), store) == _adopted.end())
+	{
+		_adopted.push_back(store);
+	}
+}
+
+const IObject* RogueVM::Call(const IObject* callable, const std::vector<const IObject*>& args)
+{
+	auto* previousVm = s_activeVm;
+	auto* previousNursery = Nursery::Active();
+	s_activeVm = this;
+	Nursery::SetActive(_nursery.get());
+
+	//callbacks are not preemptible, keep whatever is left of the budget for the caller
+	auto budget = _budget;
+	_budget = std::numeric_limits<int64_t>::max();
+
+	auto calleeIdx = _sp;
+	auto entryFrames = _frameIndex;
+	const IObject* result = NullObj::NULL_OBJ_REF;
+	try
+	{
+		Push(callable);
+		for (auto* arg : args)
+		{
+			Push(arg);
+		}
+
+		if (callable->IsThisA<ClosureObj>())
+		{
+			auto closure = dynamic_cast<const ClosureObj*>(callable);
+			auto fn = closure->Function;
+			if (args.size() != fn->NumParameters)
+			{
+				throw RogueVm_RuntimeError{ std::format("Expected {} arguments but got {}", fn->NumParameters, args.size()), GetRuntimeInfo() };
+			}
+
+			auto frame = Frame(closure, _sp - static_cast<int>(args.size()));
+			PushFrame(frame);
+			EnsureStack(frame.BasePointer() + fn->NumLocals + fn->MaxStackDepth);
+			_sp = frame.BasePointer() + fn->NumLocals;
+			Execute(entryFrames);
+			if (_frameIndex > entryFrames)
+			{
+				throw RogueVm_RuntimeError{ "Cannot yield inside a callback from native code", GetRuntimeInfo() };
+			}
+			if (_sp > calleeIdx)
+			{
+				result = _stack[_sp - 1];
+			}
+		}
+		else if (callable->IsThisA<BuiltInObj>())
+		{
+			auto builtin = dynamic_cast<const BuiltInObj*>(callable);
+			if (_builtins != nullptr && builtin->Idx >= 0 && builtin->Idx < _builtins->size())
+			{
+				result = (*_builtins)[builtin->Idx](_factory.get(), args);
+			}
+			else if (_externals != nullptr)
+			{
+				result = builtin->Resolve(_externals, _factory.get())(args);
+			}
+			else
+			{
+				throw std::runtime_error("No external symbols provided");
+			}
+			if (result->IsThisA<PendingObj>())
+			{
+				throw RogueVm_RuntimeError{ "Cannot suspend inside a callback from native code", GetRuntimeInfo() };
+			}
+		}
+		else
+		{
+			throw std::runtime_error("Can only call functions or externals");
+		}
+	}
+	catch (...)
+	{
+		_budget = budget;
+		s_activeVm = previousVm;
+		Nursery::SetActive(previousNursery);
+		throw;
+	}
+
+	_sp = calleeIdx;
+	_frameIndex = entryFrames;
+	_budget = budget;
+	s_activeVm = previousVm;
+	Nursery::SetActive(previousNursery);
+	return result;
+}
+
+bool RogueVM::IsTruthy(const IObject* obj)
+{
+	if (obj->IsThisA<BooleanObj>())
+	{
+		return obj == BooleanObj::TRUE_OBJ_REF;
+	}
+	return _coercer.EvalAsBoolean(obj) == BooleanObj::TRUE_OBJ_REF;
+}
+
+std::vector<const IObject*> RogueVM::ParallelChunks(std::vector<const IObject*> inputs, size_t count, const ChunkTask& task, const CombineTask& combine)
+{
+	std::vector<const IObject*> output;
+	auto& pool = WorkStealingPool::Shared();
+	auto parallel = count >= _parallelThreshold && pool.WorkerCount() > 0;
+	//a few chunks per participant so stealing can balance uneven callbacks
+	auto chunks = parallel ? std::min(count, pool.SlotCount() * 4) : 1;
+	std::vector<std::vector<const IObject*>> outputs(chunks);
+	std::vector<std::shared_ptr<RogueVM>> workers(pool.SlotCount());
+
+	auto roots = _roots.size();
+	_roots.push_back(&inputs);
+	_roots.push_back(&output);
+	_readOnlyGlobals++;
+	if (parallel)
+	{
+		//workers read the inputs and globals from other threads, tenure them so collections here never move them
+		//a collection leaves the nursery empty, anything this vm allocates from now on is invisible to the workers
+		MinorCollection();
+	}
+	//workers must not read this vm's frames while this thread grows them
+	auto mainClosure = _frames[0].Closure();
+
+	auto finish = [&]()
+	{
+		for (auto& worker : workers)
+		{
+			if (worker != nullptr)
+			{
+				//promote what the worker rooted so its store holds everything this vm now references
+				worker->MinorCollection();
+				_adopted.push_back(worker->_heap);
+			}
+		}
+	};
+	auto restore = [&]()
+	{
+		_roots.resize(roots);
+		_readOnlyGlobals--;
+	};
+
+	try
+	{
+		if (parallel)
+		{
+			pool.ParallelFor(chunks, [&](size_t chunk, size_t slot)
+			{
+				RogueVM* vm = this;
+				if (slot != 0)
+				{
+					if (workers[slot] == nullptr)
+					{
+						workers[slot] = Fork(mainClosure);
+					}
+					vm = workers[slot].get();
+				}
+				vm->_roots.push_back(&outputs[chunk]);
+				task(*vm, inputs, count * chunk / chunks, count * (chunk + 1) / chunks, outputs[chunk]);
+			});
+		}
+		else if (count > 0)
+		{
+			_roots.push_back(&outputs[0]);
+			task(*this, inputs, 0, count, outputs[0]);
+		}
+	}
+	catch (...)
+	{
+		finish();
+		restore();
+		throw;
+	}
+	finish();
+
+	for (auto& chunk : outputs)
+	{
+		output.insert(output.end(), chunk.begin(), chunk.end());
+	}
+
+	try
+	{
+		if (combine != nullptr)
+		{
+			combine(*this, inputs, output);
+		}
+	}
+	catch (...)
+	{
+		restore();
+		throw;
+	}
+	restore();
+	return output;
 }
 
 void RogueVM::Run()
-{	
+{
+	_budget = std::numeric_limits<int64_t>::max();
+	_deadline.reset();
+	RunInternal();
+}
+
+VmStatus RogueVM::RunFor(uint64_t maxInstructions)
+{
+	_budget = static_cast<int64_t>(std::min<uint64_t>(maxInstructions, std::numeric_limits<int64_t>::max()));
+	_deadline.reset();
+	return RunInternal();
+}
+
+VmStatus RogueVM::RunUntil(std::chrono::steady_clock::time_point deadline)
+{
+	_budget = DEADLINE_SLICE;
+	_deadline = deadline;
+	return RunInternal();
+}
+
+bool RogueVM::BudgetExhausted()
+{
+	if (_deadline.has_value() && std::chrono::steady_clock::now() < _deadline.value())
+	{
+		_budget = DEADLINE_SLICE;
+		return false;
+	}
+	_status = VmStatus::BudgetExhausted;
+	return true;
+}
+
+bool RogueVM::PendingReady() const
+{
+	return _pending.valid() && _pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void RogueVM::Resume(const IObject* result)
+{
+	if (_status != VmStatus::Suspended)
+	{
+		throw std::runtime_error("Only a suspended vm can be resumed");
+	}
+	_pending = std::shared_future<HostResult>();
+	//the slot the call left behind
+	Push(result);
+	_status = VmStatus::Running;
+}
+
+void RogueVM::ResumePending()
+{
+	if (_status != VmStatus::Suspended)
+	{
+		throw std::runtime_error("Only a suspended vm can be resumed");
+	}
+	auto build = _pending.get();
+	Resume(build(_factory.get()));
+}
+
+VmStatus RogueVM::RunInternal()
+{
+	//a suspended vm has nothing to run until the host resumes it
+	if (_status == VmStatus::Completed || _status == VmStatus::Error || _status == VmStatus::Suspended)
+	{
+		return _status;
+	}
+
+	_status = VmStatus::Running;
+	_builtins = _externals != nullptr ? _externals->Functions() : nullptr;
 	bool hadError = false;
 	RogueVm_RuntimeError error;
+	auto* previousNursery = Nursery::Active();
+	auto* previousVm = s_activeVm;
+	Nursery::SetActive(_nursery.get());
+	s_activeVm = this;
 	try
 	{
 		Execute();
@@ -58,12 +434,113 @@ void RogueVM::Run()
 	catch (const RogueVm_RuntimeError& ex)
 	{
 		hadError = true;
-		error = ex;;
+		error = ex;
+	}
+	catch (...)
+	{
+		//results must outlive the nursery
+		_status = VmStatus::Error;
+		MinorCollection();
+		Nursery::SetActive(previousNursery);
+		s_activeVm = previousVm;
+		throw;
 	}
 	if (hadError)
 	{
+		_status = VmStatus::Error;
 		_onError(error);
 	}
+	else if (_status == VmStatus::Running)
+	{
+		_status = VmStatus::Completed;
+	}
+	MinorCollection();
+	Nursery::SetActive(previousNursery);
+	s_activeVm = previousVm;
+	return _status;
+}
+
+void RogueVM::Reset()
+{
+	//only clear what a run can have touched
+	std::fill(_globals.begin(), _globals.begin() + _globalsUsed, nullptr);
+	std::fill(_stack.begin(), _stack.begin() + _sp, nullptr);
+	_globalsUsed = 0;
+	_sp = 0;
+	_outputRegister = nullptr;
+	_status = VmStatus::Ready;
+	_waitTicks = 0;
+	_pending = std::shared_future<HostResult>();
+	CancelTasks();
+
+	auto mainClosure = _frames[0].Closure();
+	_frameIndex = 0;
+	_scratch.Release(0);
+	PushFrame(Frame(mainClosure, 0));
+
+	_onError = std::bind(&RogueVM::OnErrorInternal, this, std::placeholders::_1);
+	_onBreak = std::bind(&RogueVM::OnBreakInternal, this, std::placeholders::_1);
+
+	//nothing is rooted anymore, this releases the whole nursery
+	MinorCollection();
+}
+
+void RogueVM::SetLimits(const VmLimits& limits)
+{
+	_limits = limits;
+}
+
+void RogueVM::SetNurserySize(size_t size)
+{
+	MinorCollection();
+	_nursery->SetSize(size);
+}
+
+size_t RogueVM::NurserySize() const
+{
+	return _nursery->Size();
+}
+
+const NurseryStats& RogueVM::GetNurseryStats() const
+{
+	return _nursery->Stats();
+}
+
+void RogueVM::CollectNursery()
+{
+	MinorCollection();
+}
+
+void RogueVM::MinorCollection()
+{
+	//scratch objects never move but can hold on to nursery objects
+	for (auto* obj : _scratch.Objects())
+	{
+		_nursery->Remember(obj);
+	}
+	_nursery->Collect([this](const Nursery::Forwarder& forward)
+	{
+		for (int i = 0; i < _sp; i++)
+		{
+			_stack[i] = forward(_stack[i]);
+		}
+		for (int i = 0; i < _globalsUsed; i++)
+		{
+			_globals[i] = forward(_globals[i]);
+		}
+		for (int i = 0; i < _frameIndex; i++)
+		{
+			_frames[i].SetClosure(dynamic_cast<const ClosureObj*>(forward(_frames[i].Closure())));
+		}
+		_outputRegister = forward(_outputRegister);
+		for (auto* roots : _roots)
+		{
+			for (auto& obj : *roots)
+			{
+				obj = forward(obj);
+			}
+		}
+	});
 }
 
 void RogueVM::Set_RTI_ErrorCallback(const std::function<void(const RogueVm_RuntimeError&)>& onError)
@@ -84,11 +561,25 @@ void RogueVM::Push(const IObject* obj)
 {
 	if (_sp >= _stack.size()) 
 	{ 
-		throw std::exception("Stack Overflow"); 
+		EnsureStack(_sp + 1);
 	}  
 	_stack[_sp++] = obj; 
 }
 
+void RogueVM::EnsureStack(size_t required)
+{
+	if (required <= _stack.size())
+	{
+		return;
+	}
+	if (required > _limits.MaxStackSize)
+	{
+		throw RogueVm_RuntimeError{ std::format("Stack overflow: {} slots exceeds the limit of {}", required, _limits.MaxStackSize), GetRuntimeInfo() };
+	}
+	auto grown = std::min(std::max(required, _stack.size() * 2), _limits.MaxStackSize);
+	_stack.resize(grown, nullptr);
+}
+
 const IObject* RogueVM::Pop() 
 { 
 	if (_sp == 0) 
@@ -149,7 +640,7 @@ FrameTrace RogueVM::GetFrameTrace(const size_t idx, const Frame& frame) const
 		trace.FrameInstructionOffset = ipAdjust;
 
 		auto i = 0;
-		while (_globals[i] != nullptr)
+		while (i < _globals.size() && _globals[i] != nullptr)
 		{
 			StackValue value;
 			value.Type = _globals[i]->TypeName();
@@ -228,10 +719,16 @@ std::string RogueVM::PrintStack() const
 	return stack;
 }
 
-void RogueVM::Execute()
+void RogueVM::Execute(int exitFrame)
 {
-	while (CurrentFrame().Ip() < CurrentFrame().Instructions().size())
+	while (_frameIndex > exitFrame && CurrentFrame().Ip() < CurrentFrame().Instructions().size())
 	{
+		//safe point - every live value is reachable from the stack, globals, frames or native roots
+		if (_nursery->CollectionRequested())
+		{
+			MinorCollection();
+		}
+
 		const auto& instructions = CurrentFrame().Instructions();
 		CurrentFrame().SaveBeforeIp(); //save the ip before the instruction is executed
 		auto opcode = OpCode::GetOpcode(instructions, CurrentFrame().Ip());
@@ -282,10 +779,15 @@ void RogueVM::Execute()
 			}
 			auto function = _factory->New<FunctionCompiledObj>(fnInstructions, numLocals, numParameters);
 			function->FuncOffset = CurrentFrame().BaseOffset() + CurrentFrame().Ip() - numInstructions;
+			if (auto* layout = _byteCode->FindFunction(function->FuncOffset))
+			{
+				function->MaxStackDepth = layout->MaxStackDepth;
+			}
 			Push(function);
 			break;
 		}
 		case OpCode::Constants::OP_ARRAY:
+		case OpCode::Constants::OP_ARRAY_SCRATCH:
 		{
 			auto numElements = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
 			IncrementFrameIp(2);
@@ -297,11 +799,12 @@ void RogueVM::Execute()
 				elements.push_back(Pop());
 			}
 			std::reverse(elements.begin(), elements.end());
-			auto array = _factory->New<ArrayObj>(elements);
+			auto array = opcode == OpCode::Constants::OP_ARRAY_SCRATCH ? NewScratch<ArrayObj>(elements) : _factory->New<ArrayObj>(elements);
 			Push(array);
 			break;
 		}
 		case OpCode::Constants::OP_HASH:
+		case OpCode::Constants::OP_HASH_SCRATCH:
 		{
 			auto numElements = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
 			IncrementFrameIp(2);
@@ -315,7 +818,7 @@ void RogueVM::Execute()
 				pairs[HashKey{ key->Type(), key->Inspect() }] = HashEntry{ key, value };
 			}
 
-			auto hash = _factory->New<HashObj>(pairs);
+			auto hash = opcode == OpCode::Constants::OP_HASH_SCRATCH ? NewScratch<HashObj>(pairs) : _factory->New<HashObj>(pairs);
 			Push(hash);
 			break;
 		}
@@ -352,6 +855,31 @@ void RogueVM::Execute()
 			ExecutePrefix(opcode);
 			break;
 		}
+		case OpCode::Constants::OP_ADD_II:
+		{
+			//the compiler proved the operand types, they are only checked in debug builds
+			auto right = Pop();
+			auto left = Pop();
+			assert(left->IsThisA<IntegerObj>() && right->IsThisA<IntegerObj>());
+			Push(_factory->New<IntegerObj>(static_cast<const IntegerObj*>(left)->Value + static_cast<const IntegerObj*>(right)->Value));
+			break;
+		}
+		case OpCode::Constants::OP_LT_II:
+		{
+			auto right = Pop();
+			auto left = Pop();
+			assert(left->IsThisA<IntegerObj>() && right->IsThisA<IntegerObj>());
+			Push(static_cast<const IntegerObj*>(left)->Value < static_cast<const IntegerObj*>(right)->Value ? BooleanObj::TRUE_OBJ_REF : BooleanObj::FALSE_OBJ_REF);
+			break;
+		}
+		case OpCode::Constants::OP_CONCAT_SS:
+		{
+			auto right = Pop();
+			auto left = Pop();
+			assert(left->IsThisA<StringObj>() && right->IsThisA<StringObj>());
+			Push(_factory->New<StringObj>(static_cast<const StringObj*>(left)->Value + static_cast<const StringObj*>(right)->Value));
+			break;
+		}
 		case OpCode::Constants::OP_POP:
 		{
 			Pop();
@@ -370,27 +898,32 @@ void RogueVM::Execute()
 		case OpCode::Constants::OP_JUMP:
 		{
 			auto pos = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
+			auto from = CurrentFrame().Ip();
 			SetFrameIp(pos);
+			//back-edge - the vm is resumable from the loop head
+			if (pos < from && Checkpoint(from - pos))
+			{
+				return;
+			}
 			break;
 		}
 		case OpCode::Constants::OP_JUMPIFZ:
 		{
 			auto pos = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
+			auto from = CurrentFrame().Ip();
 			IncrementFrameIp(2);
 			auto condition = Pop();
-			if (condition->IsThisA<BooleanObj>())
+			if (!condition->IsThisA<BooleanObj>())
 			{
-				if (condition == BooleanObj::FALSE_OBJ_REF)
-				{
-					SetFrameIp(pos);
-				}
+				condition = _coercer.EvalAsBoolean(condition);
 			}
-			else
+			if (condition == BooleanObj::FALSE_OBJ_REF)
 			{
-				auto coerced = _coercer.EvalAsBoolean(condition);
-				if (coerced == BooleanObj::FALSE_OBJ_REF)
+				SetFrameIp(pos);
+				//threaded onto a loop's back-edge by the peephole optimizer
+				if (pos < from && Checkpoint(from - pos))
 				{
-					SetFrameIp(pos);
+					return;
 				}
 			}
 			break;
@@ -407,6 +940,13 @@ void RogueVM::Execute()
 			ExecuteSetInstruction(idx);
 			break;
 		}
+		case OpCode::Constants::OP_SET_KEEP:
+		{
+			auto idx = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
+			IncrementFrameIp(2);
+			Push(ExecuteSetInstruction(idx));
+			break;
+		}
 		case OpCode::Constants::OP_GET:
 		{
 			auto idx = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
@@ -433,11 +973,10 @@ void RogueVM::Execute()
 						auto arrayClone = _factory->Clone(arr);
 						auto arrayObj = dynamic_cast<ArrayObj*>(arrayClone);
 						auto rValueClone = _factory->Clone(rValue);
-						arrayObj->Elements[index->Value] = rValueClone;
+						arrayObj->Set(index, rValueClone);
 
 						Push(arrayObj);
 						ExecuteSetInstruction(idx);
-						Push(rValueClone);
 					}
 					else
 					{
@@ -450,22 +989,27 @@ void RogueVM::Execute()
 					throw std::runtime_error("Index must be an integer");
 				}
 			}
+			else if (TypedArrays::IsTypedArray(arrValue))
+			{
+				//elements are copied into the buffer, the typed array never references the rvalue
+				auto arrayClone = dynamic_cast<IAssignableObject*>(_factory->Clone(arrValue));
+				arrayClone->Set(indexValue, rValue);
+
+				Push(arrayClone);
+				ExecuteSetInstruction(idx);
+			}
 			else if (arrValue->IsThisA<HashObj>())
 			{
 				auto hashClone = _factory->Clone(arrValue);
 				auto hash = dynamic_cast<HashObj*>(hashClone);
-				auto key = HashKey{ indexValue->Type(), indexValue->Inspect() };
-
 				auto rValueClone = _factory->Clone(rValue);
 
 				auto keyClone = _factory->Clone(indexValue);
 
-				auto entry = HashEntry{ keyClone, rValueClone };
-				hash->Elements[key] = entry;
+				hash->Set(keyClone, rValueClone);
 
 				Push(hash);
 				ExecuteSetInstruction(idx);
-				Push(rValueClone);
 			}
 			else
 			{
@@ -482,6 +1026,28 @@ void RogueVM::Execute()
 
 			break;
 		}
+		case OpCode::Constants::OP_INDEX_NOCHECK:
+		{
+			auto index = Pop();
+			auto left = Pop();
+
+			auto arr = dynamic_cast<const ArrayObj*>(left);
+			auto idx = dynamic_cast<const IntegerObj*>(index);
+			if (arr == nullptr || idx == nullptr)
+			{
+				ExecuteIndexOperation(left, index);
+				break;
+			}
+#ifdef ROGUESYNTAX_CHECK_PROOFS
+			if (idx->Value < 0 || idx->Value >= arr->Elements.size())
+			{
+				auto rti = GetRuntimeInfo();
+				throw RogueVm_RuntimeError{ std::format("Bounds check elimination proved index {} in bounds of {} elements", idx->Value, arr->Elements.size()), rti };
+			}
+#endif
+			Push(arr->Elements[idx->Value]);
+			break;
+		}
 
 		case OpCode::Constants::OP_CALL:
 		{
@@ -501,8 +1067,13 @@ void RogueVM::Execute()
 
 				auto frame = Frame(closure, _sp - numArgs);
 				PushFrame(frame);
-				//make room for locals
+				//make room for locals and the deepest point of the function's operand stack
+				EnsureStack(frame.BasePointer() + fn->NumLocals + fn->MaxStackDepth);
 				_sp = frame.BasePointer() + fn->NumLocals;
+				if (Checkpoint(fn->FuncInstructions.size()))
+				{
+					return;
+				}
 			}
 			else if (callee->IsThisA<BuiltInObj>())
 			{
@@ -513,9 +1084,39 @@ void RogueVM::Execute()
 
 				auto builtin = dynamic_cast<const BuiltInObj*>(callee);
 				auto args = std::vector<const IObject*>(_stack.begin() + calleeIdx + 1, _stack.begin() + _sp);
-				auto fn = builtin->Resolve(_externals);
-				auto result = fn(args);
+				IObject* result = nullptr;
+				if (builtin->Idx >= 0 && builtin->Idx < _builtins->size())
+				{
+					//straight from the snapshot, no lock or shared state touched per call
+					result = (*_builtins)[builtin->Idx](_factory.get(), args);
+				}
+				else
+				{
+					result = builtin->Resolve(_externals, _factory.get())(args);
+				}
+				if (result->IsThisA<YieldObj>() && dynamic_cast<const YieldObj*>(result)->Blocked)
+				{
+					//leave the call on the stack and run it again on resume
+					SetFrameIp(CurrentFrame().BeforeIp());
+					_status = VmStatus::Blocked;
+					return;
+				}
 				_sp = calleeIdx;
+				if (result->IsThisA<PendingObj>())
+				{
+					//the call evaluates to whatever the host resumes the vm with
+					_pending = dynamic_cast<const PendingObj*>(result)->Future;
+					_status = VmStatus::Suspended;
+					return;
+				}
+				if (result->IsThisA<YieldObj>())
+				{
+					//the call evaluates to null when the host resumes the vm
+					_waitTicks = dynamic_cast<const YieldObj*>(result)->Ticks;
+					_status = VmStatus::Yielded;
+					Push(NullObj::NULL_OBJ_REF);
+					return;
+				}
 				Push(result);
 			}
 			else
@@ -525,6 +1126,7 @@ void RogueVM::Execute()
 			break;
 		}
 		case OpCode::Constants::OP_CLOSURE:
+		case OpCode::Constants::OP_CLOSURE_SCRATCH:
 		{
 			//auto idx = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
 			//IncrementFrameIp(2);
@@ -542,7 +1144,7 @@ void RogueVM::Execute()
 			}
 			_sp = _sp - numFree;
 
-			auto closure = _factory->New<ClosureObj>(fn, free);
+			auto closure = opcode == OpCode::Constants::OP_CLOSURE_SCRATCH ? NewScratch<ClosureObj>(fn, free) : _factory->New<ClosureObj>(fn, free);
 			Push(closure);
 			break;
 		}
@@ -552,11 +1154,158 @@ void RogueVM::Execute()
 			Push(closure);
 			break;
 		}
+		case OpCode::Constants::OP_GENERATOR:
+		{
+			//first instruction of a fn*, the call evaluates to a generator holding the arguments
+			auto frame = PopFrame();
+			auto slots = std::vector<const IObject*>(_stack.begin() + frame.BasePointer(), _stack.begin() + _sp);
+			auto generator = _factory->New<GeneratorObj>(frame.Closure(), slots, frame.Ip());
+			_sp = frame.BasePointer() - 1;
+			Push(generator);
+			break;
+		}
+		case OpCode::Constants::OP_ITER:
+		{
+			auto iterable = Pop();
+			if (iterable->IsThisA<GeneratorObj>())
+			{
+				Push(iterable);
+			}
+			else if (iterable->IsThisA<ArrayObj>())
+			{
+				Push(_factory->New<ArrayIteratorObj>(dynamic_cast<const ArrayObj*>(iterable), 0));
+			}
+			else if (iterable->IsThisA<RangeObj>())
+			{
+				auto range = dynamic_cast<const RangeObj*>(iterable);
+				Push(_factory->New<RangeIteratorObj>(range->Start, range->End, range->Step));
+			}
+			else
+			{
+				throw std::runtime_error(std::format("Can only iterate over arrays, ranges and generators, got {}", iterable->TypeName()));
+			}
+			break;
+		}
+		case OpCode::Constants::OP_FOR_RANGE:
+		{
+			//one compare, one add and the boxed loop variable per step
+			auto iterator = _stack[_sp - 1];
+			if (iterator->IsThisA<RangeIteratorObj>())
+			{
+				auto rangeIt = static_cast<RangeIteratorObj*>(const_cast<IObject*>(iterator));
+				if (rangeIt->Done())
+				{
+					_sp--;
+					SetFrameIp(instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1]);
+					break;
+				}
+				IncrementFrameIp(2);
+				Push(_factory->New<IntegerObj>(static_cast<int>(rangeIt->Next)));
+				rangeIt->Next += rangeIt->Step;
+				break;
+			}
+			//the range builtin was replaced by the host, iterate whatever it returned
+			[[fallthrough]];
+		}
+		case OpCode::Constants::OP_ITER_NEXT:
+		{
+			auto pos = instructions[CurrentFrame().Ip()] << 8 | instructions[CurrentFrame().Ip() + 1];
+			IncrementFrameIp(2);
+
+			//the iterator stays on the stack, it is popped once exhausted
+			auto iterator = _stack[_sp - 1];
+			if (iterator->IsThisA<RangeIteratorObj>())
+			{
+				auto rangeIt = const_cast<RangeIteratorObj*>(dynamic_cast<const RangeIteratorObj*>(iterator));
+				if (rangeIt->Done())
+				{
+					_sp--;
+					SetFrameIp(pos);
+				}
+				else
+				{
+					Push(_factory->New<IntegerObj>(static_cast<int>(rangeIt->Next)));
+					rangeIt->Next += rangeIt->Step;
+				}
+				break;
+			}
+			if (iterator->IsThisA<ArrayIteratorObj>())
+			{
+				auto arrayIt = const_cast<ArrayIteratorObj*>(dynamic_cast<const ArrayIteratorObj*>(iterator));
+				if (arrayIt->Next < arrayIt->Array->Elements.size())
+				{
+					Push(arrayIt->Array->Elements[arrayIt->Next++]);
+				}
+				else
+				{
+					_sp--;
+					SetFrameIp(pos);
+				}
+				break;
+			}
+
+			auto generator = const_cast<GeneratorObj*>(dynamic_cast<const GeneratorObj*>(iterator));
+			if (generator->Status == GeneratorObj::State::Done)
+			{
+				_sp--;
+				SetFrameIp(pos);
+				break;
+			}
+			if (generator->Status == GeneratorObj::State::Running)
+			{
+				throw RogueVm_RuntimeError{ "Generator is already running", GetRuntimeInfo() };
+			}
+
+			//resume the body in a frame directly above the generator, its yield finds it there
+			auto fn = generator->Closure->Function;
+			auto frame = Frame(generator->Closure, generator->Ip, _sp);
+			PushFrame(frame);
+			EnsureStack(frame.BasePointer() + fn->NumLocals + fn->MaxStackDepth + 1);
+			std::copy(generator->Slots.begin(), generator->Slots.end(), _stack.begin() + _sp);
+			_sp += static_cast<int>(generator->Slots.size());
+			if (generator->Status == GeneratorObj::State::Suspended)
+			{
+				//the yield expression evaluates to null
+				Push(NullObj::NULL_OBJ_REF);
+			}
+			generator->Status = GeneratorObj::State::Running;
+			break;
+		}
+		case OpCode::Constants::OP_YIELD:
+		{
+			auto value = Pop();
+			auto frame = PopFrame();
+			auto generator = const_cast<GeneratorObj*>(dynamic_cast<const GeneratorObj*>(_stack[frame.BasePointer() - 1]));
+			generator->Slots.assign(_stack.begin() + frame.BasePointer(), _stack.begin() + _sp);
+			generator->Ip = frame.Ip();
+			generator->Status = GeneratorObj::State::Suspended;
+			if (!_nursery->Contains(generator))
+			{
+				//a tenured generator now holds nursery values
+				_nursery->Remember(generator);
+			}
+			_sp = frame.BasePointer();
+			Push(value);
+			break;
+		}
+		case OpCode::Constants::OP_GEN_RETURN:
+		{
+			auto frame = PopFrame();
+			auto generator = const_cast<GeneratorObj*>(dynamic_cast<const GeneratorObj*>(_stack[frame.BasePointer() - 1]));
+			generator->Status = GeneratorObj::State::Done;
+			generator->Slots.clear();
+			generator->Slots.shrink_to_fit();
+			_sp = frame.BasePointer();
+			//run the loop's next again, it sees the finished generator and leaves the loop
+			SetFrameIp(CurrentFrame().BeforeIp());
+			break;
+		}
 		case OpCode::Constants::OP_RETURN:
 		{
 			auto frame = PopFrame();
 			_sp = frame.BasePointer();
 			Pop();
+			ReleaseScratch(frame);
 			break;
 		}
 		case OpCode::Constants::OP_RET_VAL:
@@ -573,6 +1322,7 @@ void RogueVM::Execute()
 				_sp = frame.BasePointer();
 				Pop();
 				Push(result);
+				ReleaseScratch(frame);
 			}
 			break;
 		}
@@ -584,10 +1334,15 @@ void RogueVM::Execute()
 
 void RogueVM::PushFrame(Frame frame)
 {
-	if (_frameIndex >= MAX_FRAMES)
+	if (_frameIndex >= _frames.size())
 	{
-		throw std::runtime_error("Frame stack overflow");
+		if (_frameIndex >= _limits.MaxFrames)
+		{
+			throw RogueVm_RuntimeError{ std::format("Frame stack overflow: more than {} frames", _limits.MaxFrames), GetRuntimeInfo() };
+		}
+		_frames.resize(std::min(std::max<size_t>(_frames.size() * 2, 1), _limits.MaxFrames));
 	}
+	frame.SetScratchMark(_scratch.Mark());
 	_frames[_frameIndex++] = frame;
 }
 
@@ -600,10 +1355,25 @@ Frame RogueVM::PopFrame()
 	return _frames[--_frameIndex];
 }
 
+void RogueVM::ReleaseScratch(const Frame& frame)
+{
+	_scratch.Release(frame.ScratchMark());
+	//the return popped the callee into the output register, a callback passed to a builtin can live in the region
+	if (_scratch.Released(_outputRegister))
+	{
+		_outputRegister = NullObj::NULL_OBJ_REF;
+	}
+}
+
 void RogueVM::ExecuteArithmeticInfix(OpCode::Constants opcode)
 {
 	auto right = Pop();
 	auto left = Pop();
+	if (TypedArrays::IsOperand(left, right))
+	{
+		ExecuteTypedArrayArithmeticInfix(opcode, left, right);
+		return;
+	}
 	if (left->Type() != right->Type())
 	{
 		if (_coercer.CanCoerceTypes(left, right))
@@ -747,6 +1517,54 @@ void RogueVM::ExecuteDecimalArithmeticInfix(OpCode::Constants opcode, const Deci
 	}
 }
 
+void RogueVM::ExecuteTypedArrayArithmeticInfix(OpCode::Constants opcode, const IObject* left, const IObject* right)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_ADD:
+		Push(TypedArrays::Arithmetic(_factory.get(), VectorOp::Add, left, right));
+		break;
+	case OpCode::Constants::OP_SUB:
+		Push(TypedArrays::Arithmetic(_factory.get(), VectorOp::Sub, left, right));
+		break;
+	case OpCode::Constants::OP_MUL:
+		Push(TypedArrays::Arithmetic(_factory.get(), VectorOp::Mul, left, right));
+		break;
+	case OpCode::Constants::OP_DIV:
+		Push(TypedArrays::Arithmetic(_factory.get(), VectorOp::Div, left, right));
+		break;
+	default:
+		throw std::runtime_error(MakeOpCodeError("ExecuteTypedArrayArithmeticInfix: Unknown opcode", opcode));
+	}
+}
+
+void RogueVM::ExecuteTypedArrayComparisonInfix(OpCode::Constants opcode, const IObject* left, const IObject* right)
+{
+	switch (opcode)
+	{
+	case OpCode::Constants::OP_EQ:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Eq, left, right));
+		break;
+	case OpCode::Constants::OP_NEQ:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Neq, left, right));
+		break;
+	case OpCode::Constants::OP_GT:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Gt, left, right));
+		break;
+	case OpCode::Constants::OP_GTE:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Gte, left, right));
+		break;
+	case OpCode::Constants::OP_LT:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Lt, left, right));
+		break;
+	case OpCode::Constants::OP_LTE:
+		Push(TypedArrays::Compare(_factory.get(), CompareOp::Lte, left, right));
+		break;
+	default:
+		throw std::runtime_error(MakeOpCodeError("ExecuteTypedArrayComparisonInfix: Unknown opcode", opcode));
+	}
+}
+
 void RogueVM::ExecuteStringArithmeticInfix(OpCode::Constants opcode, const StringObj* left, const StringObj* right)
 {
 	switch (opcode)
@@ -766,6 +1584,11 @@ void RogueVM::ExecuteComparisonInfix(OpCode::Constants opcode)
 {
 	auto right = Pop();
 	auto left = Pop();
+	if (TypedArrays::IsOperand(left, right))
+	{
+		ExecuteTypedArrayComparisonInfix(opcode, left, right);
+		return;
+	}
 	if (left->Type() != right->Type())
 	{
 		throw std::runtime_error("Type mismatch");
@@ -1079,6 +1902,36 @@ void RogueVM::ExecuteIndexOperation(const IObject* left, const IObject* index)
 		auto value = arr->Elements[idx->Value];
 		Push(value);
 	}
+	else if (left->IsThisA<RangeObj>())
+	{
+		auto range = dynamic_cast<const RangeObj*>(left);
+		auto idx = dynamic_cast<const IntegerObj*>(index);
+		if (idx == nullptr)
+		{
+			throw std::runtime_error("Index must be an integer");
+		}
+		if (idx->Value < 0 || idx->Value >= range->Count())
+		{
+			auto rti = GetRuntimeInfo();
+			throw RogueVm_RuntimeError{ std::format("Index out of bounds value[{}] > {}", idx->Value, range->Count()), rti };
+		}
+		Push(_factory->New<IntegerObj>(range->At(idx->Value)));
+	}
+	else if (TypedArrays::IsTypedArray(left))
+	{
+		auto idx = dynamic_cast<const IntegerObj*>(index);
+		if (idx == nullptr)
+		{
+			throw std::runtime_error("Index must be an integer");
+		}
+		auto size = TypedArrays::Size(left);
+		if (idx->Value < 0 || idx->Value >= size)
+		{
+			auto rti = GetRuntimeInfo();
+			throw RogueVm_RuntimeError{ std::format("Index out of bounds value[{}] > {}", idx->Value, size), rti };
+		}
+		Push(TypedArrays::At(_factory.get(), left, idx->Value));
+	}
 	else if (left->IsThisA<HashObj>())
 	{
 		const IObject* result = NullObj::NULL_OBJ_REF;
@@ -1120,6 +1973,10 @@ void RogueVM::ExecuteGetInstruction(int idx)
 		case ScopeType::SCOPE_GLOBAL:
 		{
 			auto adjustedIdx = AdjustIdx(idx);
+			if (adjustedIdx >= _globals.size())
+			{
+				throw RogueVm_RuntimeError{ std::format("Global {} is not defined", adjustedIdx), GetRuntimeInfo() };
+			}
 			auto global = _globals[adjustedIdx];
 			Push(global);
 			break;
@@ -1147,18 +2004,28 @@ void RogueVM::ExecuteGetInstruction(int idx)
 	}
 }
 
-void RogueVM::ExecuteSetInstruction(int idx)
+const IObject* RogueVM::ExecuteSetInstruction(int idx)
 {
 	auto type = GetTypeFromIdx(idx);
 	switch (type)
 	{
 		case ScopeType::SCOPE_GLOBAL:
 		{
+			if (_readOnlyGlobals > 0)
+			{
+				throw RogueVm_RuntimeError{ _task != nullptr ? "Cannot assign a global inside a spawned task" : "Cannot assign a global inside a parallel callback", GetRuntimeInfo() };
+			}
 			auto adjustedIdx = AdjustIdx(idx);
 			auto global = Pop();
 			auto cloned = _factory->Clone(global);
+			if (adjustedIdx >= _globals.size())
+			{
+				//bytecode built without a layout
+				_globals.resize(adjustedIdx + 1, nullptr);
+			}
 			_globals[adjustedIdx] = cloned;
-			break;
+			_globalsUsed = std::max(_globalsUsed, adjustedIdx + 1);
+			return cloned;
 		}
 		case ScopeType::SCOPE_LOCAL:
 		{
@@ -1167,9 +2034,10 @@ void RogueVM::ExecuteSetInstruction(int idx)
 			auto localIdx = CurrentFrame().BasePointer() + adjustedIdx;
 			auto cloned =  _factory->Clone(local);
 			_stack[localIdx] = cloned;
-			break;
+			return cloned;
 		}
 	}
+	return nullptr;
 }
 
 
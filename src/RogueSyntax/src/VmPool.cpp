@@ -0,0 +1,60 @@
+#include "pch.h"
+
+VmPool::VmPool(const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, size_t maxIdlePerProgram)
+	: _externals(externals), _factory(factory), _maxIdlePerProgram(maxIdlePerProgram)
+{
+}
+
+VmPool::~VmPool()
+{
+}
+
+std::shared_ptr<RogueVM> VmPool::Acquire(const std::shared_ptr<const ByteCode>& code)
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto it = _idle.find(code.get());
+		if (it != _idle.end() && !it->second.empty())
+		{
+			auto vm = it->second.back();
+			it->second.pop_back();
+			return vm;
+		}
+	}
+	return std::make_shared<RogueVM>(code, _externals, _factory);
+}
+
+void VmPool::Release(const std::shared_ptr<RogueVM>& vm)
+{
+	if (vm == nullptr)
+	{
+		return;
+	}
+
+	vm->Reset();
+
+	std::lock_guard<std::mutex> lock(_lock);
+	auto& idle = _idle[vm->Code().get()];
+	if (idle.size() < _maxIdlePerProgram)
+	{
+		idle.push_back(vm);
+	}
+}
+
+size_t VmPool::IdleCount() const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	size_t count = 0;
+	for (const auto& [code, idle] : _idle)
+	{
+		count += idle.size();
+	}
+	return count;
+}
+
+size_t VmPool::IdleCount(const std::shared_ptr<const ByteCode>& code) const
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	auto it = _idle.find(code.get());
+	return it != _idle.end() ? it->second.size() : 0;
+}
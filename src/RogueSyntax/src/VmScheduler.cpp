@@ -0,0 +1,153 @@
+#include "pch.h"
+
+VmScheduler::VmScheduler(const std::shared_ptr<const ByteCode>& code, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, const SchedulerOptions& options)
+	: _code(code), _externals(externals), _factory(factory), _options(options)
+{
+	_mainClosure = RogueVM::MakeMainClosure(*_code, _factory);
+}
+
+VmScheduler::~VmScheduler()
+{
+}
+
+VmScheduler::TaskId VmScheduler::Spawn(int priority)
+{
+	auto vm = std::make_shared<RogueVM>(_code, _externals, _factory, _options.Limits, _mainClosure);
+	vm->SetNurserySize(_options.NurserySize);
+
+	auto id = static_cast<TaskId>(_tasks.size());
+	Task task{ vm, TaskInfo{} };
+	task.Info.Priority = priority;
+	_tasks.push_back(task);
+	_runQueues[priority].push_back(id);
+	return id;
+}
+
+size_t VmScheduler::Tick()
+{
+	return Tick(std::chrono::steady_clock::time_point::max());
+}
+
+size_t VmScheduler::Tick(std::chrono::nanoseconds timeSlice)
+{
+	return Tick(std::chrono::steady_clock::now() + timeSlice);
+}
+
+size_t VmScheduler::Tick(std::chrono::steady_clock::time_point deadline)
+{
+	Wake();
+
+	size_t turns = 0;
+	auto clock = std::chrono::steady_clock::now();
+	for (auto& [priority, queue] : _runQueues)
+	{
+		//tasks that go back on the queue during this tick wait for the next one
+		auto count = queue.size();
+		for (size_t i = 0; i < count && clock < deadline; i++)
+		{
+			auto id = queue.front();
+			queue.pop_front();
+			RunTurn(id, clock);
+			turns++;
+		}
+	}
+
+	_tick++;
+	return turns;
+}
+
+size_t VmScheduler::RunnableCount() const
+{
+	size_t count = 0;
+	for (const auto& [priority, queue] : _runQueues)
+	{
+		count += queue.size();
+	}
+	return count;
+}
+
+void VmScheduler::Wake()
+{
+	auto end = _sleeping.upper_bound(_tick);
+	for (auto it = _sleeping.begin(); it != end; it++)
+	{
+		auto& task = _tasks[it->second];
+		task.Info.State = TaskState::Runnable;
+		_runQueues[task.Info.Priority].push_back(it->second);
+	}
+	_sleeping.erase(_sleeping.begin(), end);
+
+	//polling never blocks, a task whose operation has not finished is skipped
+	auto waiting = std::partition(_suspended.begin(), _suspended.end(), [this](TaskId id) { return !_tasks[id].Vm->PendingReady(); });
+	for (auto it = waiting; it != _suspended.end(); it++)
+	{
+		auto& task = _tasks[*it];
+		try
+		{
+			task.Vm->ResumePending();
+			task.Info.State = TaskState::Runnable;
+			_runQueues[task.Info.Priority].push_back(*it);
+		}
+		catch (const std::exception& ex)
+		{
+			task.Info.State = TaskState::Error;
+			task.Info.Error = ex.what();
+		}
+	}
+	_suspended.erase(waiting, _suspended.end());
+}
+
+void VmScheduler::RunTurn(TaskId id, std::chrono::steady_clock::time_point& clock)
+{
+	auto& task = _tasks[id];
+	auto budget = _options.SliceBudget * (1 + std::max(task.Info.Priority, 0));
+
+	VmStatus status;
+	try
+	{
+		status = task.Vm->RunFor(budget);
+	}
+	catch (const std::exception& ex)
+	{
+		//one broken script must not stop the others
+		status = VmStatus::Error;
+		task.Info.Error = ex.what();
+	}
+
+	//the end of one turn is the start of the next, one clock read per turn
+	auto now = std::chrono::steady_clock::now();
+	task.Info.Time += now - clock;
+	task.Info.Slices++;
+	clock = now;
+
+	switch (status)
+	{
+	case VmStatus::Yielded:
+		if (task.Vm->WaitTicks() > 0)
+		{
+			task.Info.State = TaskState::Sleeping;
+			task.Info.WakeTick = _tick + task.Vm->WaitTicks();
+			_sleeping.emplace(task.Info.WakeTick, id);
+			break;
+		}
+		_runQueues[task.Info.Priority].push_back(id);
+		break;
+	case VmStatus::BudgetExhausted:
+		_runQueues[task.Info.Priority].push_back(id);
+		break;
+	case VmStatus::Suspended:
+		task.Info.State = TaskState::Suspended;
+		_suspended.push_back(id);
+		break;
+	case VmStatus::Completed:
+		task.Info.State = TaskState::Completed;
+		break;
+	default:
+		task.Info.State = TaskState::Error;
+		if (task.Info.Error.empty() && task.Vm->LastPopped() != nullptr)
+		{
+			task.Info.Error = task.Vm->LastPopped()->Inspect();
+		}
+		break;
+	}
+}
@@ -0,0 +1,277 @@
+#include "pch.h"
+
+struct WorkStealingPool::Job
+{
+	struct Range
+	{
+		std::mutex Lock;
+		size_t Begin = 0;
+		size_t End = 0;
+	};
+
+	Job(size_t slots, const std::function<void(size_t, size_t)>& task) : Ranges(slots), Task(task) {};
+
+	std::vector<Range> Ranges;
+	const std::function<void(size_t, size_t)>& Task;
+	std::atomic<size_t> NextSlot = 1;
+	std::atomic<size_t> Remaining = 0;
+	std::atomic<bool> Failed = false;
+
+	std::mutex Lock;
+	std::condition_variable Finished;
+	std::exception_ptr Error;
+};
+
+//the pool and queue of the worker running on this thread
+static thread_local WorkStealingPool* s_pool = nullptr;
+static thread_local size_t s_worker = 0;
+
+WorkStealingPool::WorkStealingPool(size_t workers)
+{
+	for (size_t i = 0; i <= workers; i++)
+	{
+		_queues.push_back(std::make_unique<Queue>());
+	}
+	_threads.reserve(workers);
+	for (size_t i = 0; i < workers; i++)
+	{
+		_threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (auto& thread : _threads)
+	{
+		thread.join();
+	}
+}
+
+WorkStealingPool& WorkStealingPool::Shared()
+{
+	static WorkStealingPool pool;
+	return pool;
+}
+
+void WorkStealingPool::ParallelFor(size_t chunks, const std::function<void(size_t chunk, size_t slot)>& task)
+{
+	if (chunks == 0)
+	{
+		return;
+	}
+
+	//hand every slot an even share up front, stealing evens out the rest
+	auto slots = std::min(SlotCount(), chunks);
+	auto job = std::make_shared<Job>(slots, task);
+	job->Remaining = chunks;
+	for (size_t i = 0; i < slots; i++)
+	{
+		job->Ranges[i].Begin = chunks * i / slots;
+		job->Ranges[i].End = chunks * (i + 1) / slots;
+	}
+
+	if (slots > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_jobs.push_back(job);
+		}
+		_wake.notify_all();
+	}
+
+	Work(*job, 0);
+
+	{
+		std::unique_lock<std::mutex> lock(job->Lock);
+		job->Finished.wait(lock, [&job]() { return job->Remaining == 0; });
+	}
+
+	if (slots > 1)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto it = std::find(_jobs.begin(), _jobs.end(), job);
+		if (it != _jobs.end())
+		{
+			_jobs.erase(it);
+		}
+	}
+
+	if (job->Error != nullptr)
+	{
+		std::rethrow_exception(job->Error);
+	}
+}
+
+void WorkStealingPool::Submit(std::function<void()> item)
+{
+	auto queue = s_pool == this ? s_worker : _threads.size();
+	{
+		std::lock_guard<std::mutex> lock(_queues[queue]->Lock);
+		_queues[queue]->Items.push_back(std::move(item));
+	}
+	{
+		//counted under the pool lock so a worker about to sleep cannot miss it
+		std::lock_guard<std::mutex> lock(_lock);
+		_queued++;
+	}
+	_wake.notify_one();
+}
+
+bool WorkStealingPool::IsWorkerThread() const
+{
+	return s_pool == this;
+}
+
+void WorkStealingPool::HelpUntil(const std::function<bool()>& done)
+{
+	auto queue = s_pool == this ? s_worker : _threads.size();
+	while (!done())
+	{
+		std::function<void()> item;
+		if (TakeItem(queue, item))
+		{
+			item();
+			continue;
+		}
+		//done is signalled somewhere else, check it again every so often
+		std::unique_lock<std::mutex> lock(_lock);
+		_wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return _stopping || _queued > 0; });
+	}
+}
+
+bool WorkStealingPool::TakeItem(size_t worker, std::function<void()>& item)
+{
+	//newest of our own first - it is the most likely to still be in cache
+	{
+		auto& own = *_queues[worker];
+		std::lock_guard<std::mutex> lock(own.Lock);
+		if (!own.Items.empty())
+		{
+			item = std::move(own.Items.back());
+			own.Items.pop_back();
+			_queued--;
+			return true;
+		}
+	}
+
+	//then the oldest of the shared queue and the other workers
+	for (size_t i = 0; i < _queues.size(); i++)
+	{
+		auto& victim = *_queues[(_queues.size() - 1 + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(victim.Lock);
+		if (!victim.Items.empty())
+		{
+			item = std::move(victim.Items.front());
+			victim.Items.pop_front();
+			_queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::WorkerLoop(size_t worker)
+{
+	s_pool = this;
+	s_worker = worker;
+	while (true)
+	{
+		std::shared_ptr<Job> job;
+		size_t slot = 0;
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_wake.wait(lock, [this]() { return _stopping || !_jobs.empty() || _queued > 0; });
+			if (_stopping)
+			{
+				return;
+			}
+
+			if (_jobs.empty())
+			{
+				lock.unlock();
+				//parallel jobs go first, their caller is blocked until every chunk ran
+				std::function<void()> item;
+				if (TakeItem(worker, item))
+				{
+					item();
+				}
+				continue;
+			}
+
+			job = _jobs.front();
+			slot = job->NextSlot++;
+			if (slot + 1 >= job->Ranges.size())
+			{
+				//last slot handed out, nobody else can join
+				_jobs.pop_front();
+			}
+		}
+
+		if (slot < job->Ranges.size())
+		{
+			Work(*job, slot);
+		}
+	}
+}
+
+void WorkStealingPool::Work(Job& job, size_t slot)
+{
+	size_t chunk = 0;
+	while (TakeChunk(job, slot, chunk))
+	{
+		if (!job.Failed)
+		{
+			try
+			{
+				job.Task(chunk, slot);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(job.Lock);
+				if (job.Error == nullptr)
+				{
+					job.Error = std::current_exception();
+				}
+				job.Failed = true;
+			}
+		}
+
+		if (--job.Remaining == 0)
+		{
+			std::lock_guard<std::mutex> lock(job.Lock);
+			job.Finished.notify_all();
+		}
+	}
+}
+
+bool WorkStealingPool::TakeChunk(Job& job, size_t slot, size_t& chunk)
+{
+	//own work from the front
+	{
+		auto& own = job.Ranges[slot];
+		std::lock_guard<std::mutex> lock(own.Lock);
+		if (own.Begin < own.End)
+		{
+			chunk = own.Begin++;
+			return true;
+		}
+	}
+
+	//steal from the back of the others
+	for (size_t i = 1; i < job.Ranges.size(); i++)
+	{
+		auto& victim = job.Ranges[(slot + i) % job.Ranges.size()];
+		std::lock_guard<std::mutex> lock(victim.Lock);
+		if (victim.Begin < victim.End)
+		{
+			chunk = --victim.End;
+			return true;
+		}
+	}
+	return false;
+}
@@ -50,3 +50,28 @@ void Repl::Start()
 	}
 }
 
+
+int Repl::DumpIr(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Error: cannot open " << path << std::endl;
+		return 1;
+	}
+
+	std::stringstream source;
+	source << file.rdbuf();
+
+	RogueSyntax syntax;
+	try
+	{
+		std::cout << syntax.DumpIr(source.str(), path);
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
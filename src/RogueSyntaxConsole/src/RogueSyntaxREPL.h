@@ -10,6 +10,8 @@ class Repl
 public:
 
 	void Start();
+	//prints the compiler's ir for a script file
+	int DumpIr(const std::string& path);
 
 private:
 	const std::string _prompt = ">> ";
@@ -1,11 +1,13 @@
-
 #include <RogueSyntaxCore.h>
 #include "RogueSyntaxREPL.h"
 
 int main(int argc, char *argv[])
 {
 	Repl console;
+	if (argc == 3 && std::string(argv[1]) == "--dump-ir")
+	{
+		return console.DumpIr(argv[2]);
+	}
 	console.Start();
 	return 0;
 }
-
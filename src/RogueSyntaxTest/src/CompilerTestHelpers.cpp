@@ -138,15 +138,28 @@ bool TestObjectCode(const std::vector<ConstantValue>& expectedConstants, const s
 }
 
 bool CompilerTest(const std::vector<ConstantValue>& expectedConstants, const std::vector<RSInstructions>& expectedInstructions, std::string input)
+{
+	//the instruction tests check the plain code generation, optimizations are tested with explicit options
+	return CompilerTest(expectedConstants, expectedInstructions, input, CompilerOptions::Unoptimized());
+}
+
+bool CompilerTest(const std::vector<ConstantValue>& expectedConstants, const std::vector<RSInstructions>& expectedInstructions, std::string input, const CompilerOptions& options)
 {
 	RogueSyntax syn;
+	syn.SetCompilerOptions(options);
 	auto byteCode = syn.Compile(input, "COMPILETEST");
 	return TestObjectCode(expectedConstants, expectedInstructions, byteCode);
 }
 
 bool VmTest(std::string input, ConstantValue expected)
+{
+	return VmTest(input, expected, CompilerOptions());
+}
+
+bool VmTest(std::string input, ConstantValue expected, const CompilerOptions& options)
 {
 	RogueSyntax syn;
+	syn.SetCompilerOptions(options);
 	auto objCode = syn.Compile(input, "");
 	auto str = OpCode::PrintInstructions(objCode.Instructions);
 
@@ -40,5 +40,7 @@ RSInstructions ConcatInstructions(const std::vector<RSInstructions>& instruction
 bool TestByteCode(const std::vector<ConstantValue>& expectedConstants, const std::vector<RSInstructions>& expectedInstructions, const ByteCode& actual);
 
 bool CompilerTest(const std::vector<ConstantValue>& expectedConstants, const std::vector<RSInstructions>& expectedInstructions, std::string input);
+bool CompilerTest(const std::vector<ConstantValue>& expectedConstants, const std::vector<RSInstructions>& expectedInstructions, std::string input, const CompilerOptions& options);
 
-bool VmTest(std::string input, ConstantValue expected);
\ No newline at end of file
+bool VmTest(std::string input, ConstantValue expected);
+bool VmTest(std::string input, ConstantValue expected, const CompilerOptions& options);
\ No newline at end of file
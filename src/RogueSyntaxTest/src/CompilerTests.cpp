@@ -1,6 +1,7 @@
 #include <vector>
 #include "CompilerTestHelpers.h"
 #include <RogueSyntaxCore.h>
+#include <RogueSyntax.h>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
@@ -848,6 +849,103 @@ TEST_CASE("Function Tests")
 	REQUIRE(CompilerTest(expectedConstants, expectedInstructions, input));
 }
 
+TEST_CASE("Inlined Function Tests")
+{
+	auto [input, expectedConstants, expectedInstructions] = GENERATE(table<std::string, std::vector<ConstantValue>, std::vector<RSInstructions>>(
+		{
+			{ "let noArg = fn() { 24; }; noArg();", { },
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeIntegerLiteral(24),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),0,0
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(24),
+					OpCode::Make(OpCode::Constants::OP_POP, {})
+				}
+			},
+			{ "let manyArg = fn(x,y,z) { return x+y+z;}; manyArg(1,2,3);", { },
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0 | 0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {1 | 0x8000}),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_GET, {2 | 0x8000}),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),3,3
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_SET, {3}),
+					OpCode::Make(OpCode::Constants::OP_SET, {2}),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {3}),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {})
+				}
+			},
+			{ "let f = fn(x) { x + 1; }; f = 2; f(1);", { },
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0 | 0x8000}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),1,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {})
+				}
+			}
+		}));
+
+	CAPTURE(input);
+	//only the inliner, the ir passes would collapse the inlined bodies
+	auto options = CompilerOptions();
+	options.EnableIrPasses = false;
+	options.EnablePeephole = false;
+	REQUIRE(CompilerTest(expectedConstants, expectedInstructions, input, options));
+}
+
 TEST_CASE("Let statement scopes tests")
 {
 	auto [input, expectedConstants, expectedInstructions] = GENERATE(table<std::string, std::vector<ConstantValue>, std::vector<RSInstructions>>(
@@ -1061,6 +1159,44 @@ TEST_CASE("For loop test")
 	REQUIRE(CompilerTest(expectedConstants, expectedInstructions, input));
 }
 
+TEST_CASE("For in loop test")
+{
+	auto [input, expectedConstants, expectedInstructions] = GENERATE(table<std::string, std::vector<ConstantValue>, std::vector<RSInstructions>>(
+		{
+			{ "for (x in [1, 2]) { x; }", {  },
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {2}),
+					OpCode::Make(OpCode::Constants::OP_ITER, {}),
+					OpCode::Make(OpCode::Constants::OP_ITER_NEXT, { 28 }),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, { 14 }),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "for (i in range(3)) { i; }", {  },
+				{
+					OpCode::Make(OpCode::Constants::OP_GET, {17 | 0x4000}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::Make(OpCode::Constants::OP_ITER, {}),
+					OpCode::Make(OpCode::Constants::OP_FOR_RANGE, { 26 }),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, { 12 }),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(CompilerTest(expectedConstants, expectedInstructions, input));
+}
+
 TEST_CASE("External functions")
 {
 	auto [input, expectedConstants, expectedInstructions] = GENERATE(table<std::string, std::vector<ConstantValue>, std::vector<RSInstructions>>(
@@ -1131,3 +1267,1256 @@ TEST_CASE("Closure Test")
 	CAPTURE(input);
 	REQUIRE(CompilerTest(expectedConstants, expectedInstructions, input));
 }
+
+TEST_CASE("Frame layout")
+{
+	//expected functions are {locals, stack depth} in offset order
+	auto [input, globals, depth, functions] = GENERATE(table<std::string, uint32_t, uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>(
+		{
+			{ "1 + 2;", 0, 2, {} },
+			{ "let a = 1; let b = [a, 2, 3];", 2, 3, {} },
+			{ "if (true) { 10 } else { 20 }; 3333;", 0, 1, {} },
+			{ "let x = 0; while (x < 10) { x = x + 1; }; x;", 1, 2, {} },
+			{ "let f = fn(a, b) { a + b * 2; }; f(1, 2);", 1, 3, { {2, 3} } },
+			{ "let outer = fn(a) { fn(b) { a + b; }; }; let adder = outer(1); adder(2);", 2, 2, { {1, 2}, {2, 2} } },
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	syn.SetCompilerOptions(CompilerOptions::Unoptimized());
+	auto code = syn.Link(syn.Compile(input, ""));
+
+	REQUIRE(code.NumGlobals == globals);
+	REQUIRE(code.MaxStackDepth == depth);
+	REQUIRE(code.Functions.size() == functions.size());
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		REQUIRE(code.Functions[i].NumLocals == functions[i].first);
+		REQUIRE(code.Functions[i].MaxStackDepth == functions[i].second);
+		REQUIRE(code.FindFunction(code.Functions[i].Offset) == &code.Functions[i]);
+	}
+}
+
+TEST_CASE("Slot Reuse Tests")
+{
+	//locals of each function in offset order, with and without the pass
+	auto [input, shared, separate] = GENERATE(table<std::string, std::vector<uint32_t>, std::vector<uint32_t>>(
+		{
+			{ "let f = fn(n) { if (n > 0) { let a = n; a } else { let b = n + 1; b } };", { 1 }, { 3 } },
+			{ "let f = fn(n) { let i = 0; while (i < n) { let t = i * 2; i = i + t + 1; } let j = 0; while (j < n) { let u = j; j = j + u + 1; } j };", { 3 }, { 5 } },
+			//arguments nothing loads any more leave their slots to later locals
+			{ "let f = fn(a, b) { let c = a + b; let d = c * 2; c + d };", { 2 }, { 4 } },
+			{ "let f = fn(a) { let b = a * 2; a + b };", { 2 }, { 2 } },
+			{ "let f = fn(a) { let b = a; fn(c) { let d = c; d + a } };", { 2, 1 }, { 2, 3 } },
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Link(syn.Compile(input, ""));
+
+	options.EnableSlotReuse = true;
+	syn.SetCompilerOptions(options);
+	auto reused = syn.Link(syn.Compile(input, ""));
+
+	REQUIRE(kept.Functions.size() == separate.size());
+	REQUIRE(reused.Functions.size() == shared.size());
+	for (size_t i = 0; i < shared.size(); i++)
+	{
+		REQUIRE(kept.Functions[i].NumLocals == separate[i]);
+		REQUIRE(reused.Functions[i].NumLocals == shared[i]);
+	}
+}
+
+TEST_CASE("IR round trip")
+{
+	auto input = GENERATE(as<std::string>{},
+		"1 + 2 * 3;",
+		"let a = \"abc\"; let b = {\"a\": 1, 2: [a, 3.5]}; b[2][0];",
+		"if (1 < 2) { 10 } else { 20 }; 3333;",
+		"let a = [0, 0]; let h = {}; let i = 0; while (i < 2) { a[i] = i; h[i] = a; i = i + 1; }; a;",
+		"let x = 0; while (x < 10) { if (x == 5) { break; } x = x + 1; }; x;",
+		"let s = 0; for (let i = 0; i < 10; i = i + 1) { if (i % 2 == 0) { continue; } s = s + i; }; s;",
+		"let s = 0; for (i in [1, 2, 3]) { if (i == 2) { continue; } if (i == 3) { break; } s = s + i; }; s;",
+		"let s = 0; for (i in range(0, 10)) { for (j in range(0, i)) { s = s + j; } }; s;",
+		"let f = fn(a, b) { if (a > b) { return a; }; b; }; f(1, 2);",
+		"let outer = fn(a) { fn(b) { a + b; }; }; let adder = outer(1); adder(2);",
+		"let g = fn*(n) { let i = 0; while (i < n) { yield i; i = i + 1; } }; let s = 0; for (v in g(4)) { s = s + v; }; s;",
+		"let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2); }; fib(10);");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions();
+	options.EnableIrPasses = false;
+	options.EnablePeephole = false;
+	syn.SetCompilerOptions(options);
+	auto direct = syn.Compile(input, "");
+
+	options.EnableIrPasses = true;
+	options.EnableConstantFolding = false;
+	options.EnableDeadCodeElimination = false;
+	options.EnableBoundsCheckElimination = false;
+	options.EnableLoopInvariantCodeMotion = false;
+	options.EnableCommonSubexpressionElimination = false;
+	options.EnableStrengthReduction = false;
+	options.EnableTypeSpecialization = false;
+	options.EnableSlotReuse = false;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto lowered = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(lowered.Instructions) == OpCode::PrintInstructions(direct.Instructions));
+	REQUIRE(lowered.MaxStackDepth == direct.MaxStackDepth);
+
+	auto offsets = [](const ObjectCode& code)
+		{
+			std::vector<std::pair<size_t, std::string>> result;
+			for (auto& symbol : code.DebugSymbols)
+			{
+				result.push_back({ symbol.Offset, symbol.SourceAst });
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		};
+	REQUIRE(offsets(lowered) == offsets(direct));
+}
+
+TEST_CASE("Constant Folding Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "60 * 60 * 24;",
+				{
+					OpCode::MakeIntegerLiteral(86400),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "\"a\" + \"b\" + 1;",
+				{
+					OpCode::MakeStringLiteral("ab1"),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "-5; !true; 1.5 * 2;",
+				{
+					OpCode::MakeIntegerLiteral(-5),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::Make(OpCode::Constants::OP_FALSE, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::MakeDecimalLiteral(3.0f),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let SIZE = 10; SIZE - 1;",
+				{
+					OpCode::MakeIntegerLiteral(10),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(9),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//reassigned, so the let is not a constant
+			{ "let x = 1; x = 2; x + 1;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//left for the vm, which reports the error
+			{ "1 / 0; 2147483647 + 1; \"a\" - 1;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_DIV, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::MakeIntegerLiteral(2147483647),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::MakeStringLiteral("a"),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SUB, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableConstantFolding = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Dead Code Elimination Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "if (true) { 10 } else { 20 }; 3333;",
+				{
+					OpCode::MakeIntegerLiteral(3333),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the condition is what the program leaves as its result
+			{ "if (false) { 10 }",
+				{
+					OpCode::Make(OpCode::Constants::OP_FALSE, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let x = 1; let y = 2; x;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the unused value can still fail, so it is computed and popped
+			{ "let a = 1; let b = a + 1; 3;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let f = fn() { return 1; 2; }; f();",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),0,0
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_CALL, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let x = 0; while (x < 3) { x = x + 1; break; x = 5; }; x;",
+				{
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_LT, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {32}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableDeadCodeElimination = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Bounds Check Elimination Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "let f = fn(a) { let s = 0; let j = 0; while (j < len(a)) { s = s + a[j]; j = j + 1; } s };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x4000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+									OpCode::Make(OpCode::Constants::OP_LT, {}),
+									OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {61}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_INDEX_NOCHECK, {}),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_JUMP, {16}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),3,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableBoundsCheckElimination = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Bounds check elimination keeps unproven checks")
+{
+	//the index stored to or the array replaced before the index, other conditions and indexes, a possibly negative index
+	//and globals a called function writes keep the check
+	auto input = GENERATE(as<std::string>{},
+		"let a = [1, 2]; let s = 0; let j = 0; while (j < len(a)) { j = j + 1; if (j < 2) { s = s + a[j]; } }; s;",
+		"let a = [1, 2]; let s = 0; let j = 0; while (j < len(a)) { if (j > 0) { a = [1]; }; s = s + a[j]; j = j + 1; }; s;",
+		"let a = [1, 2]; let s = 0; let j = 0; while (j < len(a)) { let k = 0; while (k < 2) { s = s + a[j]; a = rest(a); k = k + 1; } }; s;",
+		"let a = [1, 2]; let b = [3]; let s = 0; let j = 0; while (j < len(a)) { s = s + b[j]; j = j + 1; }; s;",
+		"let a = [1, 2]; let s = 0; let j = 0; while (j <= len(a)) { s = s + a[j]; j = j + 1; }; s;",
+		"let a = [1, 2, 3]; let s = 0; let j = 0; while (j < len(a) - 1) { s = s + a[j + 1]; j = j + 1; }; s;",
+		"let a = [1, 2]; let s = 0; let j = 1; while (j < len(a)) { s = s + a[j]; j = j - 1; }; s;",
+		"let a = [1, 2]; let g = fn() { a = [1]; 0; }; let s = 0; let j = 0; while (j < len(a)) { g(); s = s + a[j]; j = j + 1; }; s;");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Compile(input, "");
+
+	options.EnableBoundsCheckElimination = true;
+	syn.SetCompilerOptions(options);
+	auto eliminated = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(eliminated.Instructions) == OpCode::PrintInstructions(kept.Instructions));
+}
+
+TEST_CASE("Loop Invariant Code Motion Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			//the block before the loop becomes the preheader, the result is kept in a new global
+			{ "let n = 5; let x = 0; while (x < n - 1) { x = x + 1; }; x;",
+				{
+					OpCode::MakeIntegerLiteral(5),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SUB, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {2}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_LT, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {53}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {28}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//len is pure, the function gets a third local for it
+			{ "let f = fn(a) { let i = 0; while (i < len(a)) { i = i + 1; } i }; f([1, 2]);",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x4000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_LT, {}),
+									OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {45}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_JUMP, {20}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),3,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {2}),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableLoopInvariantCodeMotion = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Loop invariant code motion leaves variant code")
+{
+	//operands written in the loop, globals a called function writes, impure calls and values after a side effect stay put
+	auto input = GENERATE(as<std::string>{},
+		"let n = 5; let x = 0; while (x < n - 1) { n = n - 1; x = x + 1; }; x;",
+		"let n = 6; let g = fn() { n = n - 2; 0; }; let x = 0; while (x < n / 2) { g(); x = x + 1; }; x;",
+		"let n = 4; let f = fn() { let x = 0; while (x < n - 1) { x = x + 1; push([], x); } x }; f();",
+		"let a = [1]; let x = 0; while (x < len(rest(a))) { x = x + 1; }; x;",
+		"let f = fn(v) { v }; let n = 3; let x = 0; while (f(x) < n * 2) { x = x + 1; }; x;",
+		"let s = 0; let n = 3; for (i in [1, 2]) { s = s + n * i; }; s;");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Compile(input, "");
+
+	options.EnableLoopInvariantCodeMotion = true;
+	syn.SetCompilerOptions(options);
+	auto hoisted = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(hoisted.Instructions) == OpCode::PrintInstructions(kept.Instructions));
+	REQUIRE(hoisted.NumGlobals == kept.NumGlobals);
+}
+
+TEST_CASE("Common Subexpression Elimination Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			//the first result is stored in a temporary
+			{ "let a = [1, 2]; let j = 0; a[j + 1] + a[j + 1];",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {2}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {2}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//or in the variable it was already stored to
+			{ "let a = [1, 2]; let j = 0; let t = a[j]; t + a[j];",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {2}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {2}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_GET, {2}),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//a store to the array leaves its index alone
+			{ "let f = fn(a, j) { a[j + 1] = a[j]; a[j + 1] };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+									OpCode::Make(OpCode::Constants::OP_SET_ASSIGN, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8002}),
+									OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),3,2
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableCommonSubexpressionElimination = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Common subexpression elimination leaves changed operands")
+{
+	//stores between the repeats, globals a called function writes, impure calls, rows of nested arrays and single operators stay put
+	auto input = GENERATE(as<std::string>{},
+		"let x = 1; let y = x * 2; x = 2; let z = x * 2; z;",
+		"let n = 1; let g = fn() { n = n + 1; 0; }; let y = [n + 1, g(), n + 1]; y;",
+		"let f = fn(v) { v }; let y = [f(1) + 1, f(1) + 1]; y;",
+		"let m = [[1, 2]]; let i = 0; m[i][0] + m[i][1];",
+		"let x = 1; -x + -x;",
+		"let a = [1]; let j = 0; let x = 0; if (a[j] > 0) { x = a[j]; }; x;");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Compile(input, "");
+
+	options.EnableCommonSubexpressionElimination = true;
+	syn.SetCompilerOptions(options);
+	auto eliminated = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(eliminated.Instructions) == OpCode::PrintInstructions(kept.Instructions));
+	REQUIRE(eliminated.NumGlobals == kept.NumGlobals);
+}
+
+TEST_CASE("Strength Reduction Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "let i = 5; [i * 8, i / 4, i % 2];",
+				{
+					OpCode::MakeIntegerLiteral(5),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_BLSHIFT, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_BRSHIFT, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_BAND, {}),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {3}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//may be negative, only the multiply is the same as a shift
+			{ "let i = 5 - 6; [i * 8, i / 4, i % 2];",
+				{
+					OpCode::MakeIntegerLiteral(5),
+					OpCode::MakeIntegerLiteral(6),
+					OpCode::Make(OpCode::Constants::OP_SUB, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_BLSHIFT, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(4),
+					OpCode::Make(OpCode::Constants::OP_DIV, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_MOD, {}),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {3}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//not a power of two, and a decimal
+			{ "let i = 5; let d = 1.5; [i * 6, d * 2];",
+				{
+					OpCode::MakeIntegerLiteral(5),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeDecimalLiteral(1.5f),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(6),
+					OpCode::Make(OpCode::Constants::OP_MUL, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_MUL, {}),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {2}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//a counter that only grows by one below its bound stays non-negative around the loop
+			{ "let i = 0; let s = 0; while (i < 4) { s = i % 2; i = i + 1; }; s;",
+				{
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(4),
+					OpCode::Make(OpCode::Constants::OP_LT, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {55}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_BAND, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {16}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//a sum of values that are never negative can wrap around
+			{ "let a = 2147483647; let b = a + 3; b % 4;",
+				{
+					OpCode::MakeIntegerLiteral(2147483647),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::MakeIntegerLiteral(4),
+					OpCode::Make(OpCode::Constants::OP_MOD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableStrengthReduction = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Type Specialization Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "let x = 1; x + 2;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_ADD_II, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "len([1]) < 2;",
+				{
+					OpCode::Make(OpCode::Constants::OP_GET, {0x4000}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ARRAY, {1}),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_LT_II, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let s = \"a\"; s + \"b\";",
+				{
+					OpCode::MakeStringLiteral("a"),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeStringLiteral("b"),
+					OpCode::Make(OpCode::Constants::OP_CONCAT_SS, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the types disagree where the branches meet
+			{ "let x = 1; if (x < 2) { x = \"s\"; }; x + 1;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_LT_II, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {29}),
+					OpCode::MakeStringLiteral("s"),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//a parameter can be anything
+			{ "let f = fn(a) { a + 1 };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_ADD, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),1,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+			//the function stores to the global behind the call
+			{ "let x = 1; let f = fn() { x = \"s\"; 0; }; f(); x + 1;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeStringLiteral("s"),
+									OpCode::Make(OpCode::Constants::OP_SET, {0}),
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),0,0
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {1}),
+					OpCode::Make(OpCode::Constants::OP_GET, {1}),
+					OpCode::Make(OpCode::Constants::OP_CALL, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "1 + 2.5;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::MakeDecimalLiteral(2.5f),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableTypeSpecialization = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Escape Analysis Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			{ "let f = fn(x) { [x, x][0] };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_ARRAY_SCRATCH, {2}),
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),1,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+			//the store keeps a copy
+			{ "let f = fn(k) { let h = {\"a\": k}; h[\"a\"] };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeStringLiteral("a"),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::Make(OpCode::Constants::OP_HASH_SCRATCH, {1}),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::MakeStringLiteral("a"),
+									OpCode::Make(OpCode::Constants::OP_INDEX, {}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),2,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+			//map is done with its callback when it returns
+			{ "let f = fn(a) { map(a, fn(v) { v }) };",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0x4000 | 27}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									MakeFunctionLiteral
+									(
+										MakeFunction
+										(
+											ConcatInstructions
+											(
+												{
+													OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+													OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+												}
+											),1,1
+										).get()
+									),
+									OpCode::Make(OpCode::Constants::OP_CLOSURE_SCRATCH, {0}),
+									OpCode::Make(OpCode::Constants::OP_CALL, {2}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),1,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.EnableEscapeAnalysis = true;
+	options.VerifyIr = true;
+	REQUIRE(CompilerTest({}, expectedInstructions, input, options));
+}
+
+TEST_CASE("Escape analysis keeps escaping allocations")
+{
+	//returned, stored in a container, passed to a function or a builtin that keeps it, allocated in a loop, the main frame or a generator
+	auto input = GENERATE(as<std::string>{},
+		"let f = fn(x) { [x] }; f(1);",
+		"let f = fn(x) { [[x]] }; f(1);",
+		"let f = fn(x) { fn() { x } }; f(1)();",
+		"let g = fn(a) { a }; let f = fn(x) { g({1: x}) }; f(1);",
+		"let f = fn(a) { push(a, [1]) }; f([]);",
+		"let f = fn(a) { map(a, fn*(v) { yield v; }) }; f([1]);",
+		"let f = fn(x) { let i = 0; while (i < 2) { i = i + [x][0]; }; i }; f(1);",
+		"[1, 2][0];",
+		"let gen = fn*(x) { let p = [x, x]; let y = p[0]; yield y; }; let s = 0; for (v in gen(1)) { s = s + v; }; s;");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnableIrPasses = true;
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Compile(input, "");
+
+	options.EnableEscapeAnalysis = true;
+	syn.SetCompilerOptions(options);
+	auto analyzed = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(analyzed.Instructions) == OpCode::PrintInstructions(kept.Instructions));
+}
+
+TEST_CASE("Dead code debug symbols")
+{
+	auto input = GENERATE(as<std::string>{},
+		"let f = fn(a) { if (a > 1) { return 1; } else { return 2; } 3; }; f(5);",
+		"let x = 0; while (true) { x = x + 1; if (x > 3) { break; } }; x;",
+		"let s = 0; for (i in [1, 2, 3]) { if (true) { continue; } s = s + i; }; s;",
+		"let unused = fn(a) { a }; let used = 4; used;",
+		"let f = fn(a) { let i = 0; while (i < len(a) - 1) { i = i + 1; } i }; f([1, 2, 3]);");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions();
+	options.VerifyIr = true;
+	syn.SetCompilerOptions(options);
+	auto code = syn.Compile(input, "");
+
+	//every symbol is remapped onto the start of an instruction that is still there, or the end of the code
+	std::set<size_t> starts{ code.Instructions.size() };
+	size_t offset = 0;
+	while (offset < code.Instructions.size())
+	{
+		starts.insert(offset);
+		auto [opcode, operands, next] = OpCode::ReadOperand(code.Instructions, offset);
+		offset = next + (opcode == OpCode::Constants::OP_LSTRING ? operands[0] : 0);
+	}
+	for (auto& symbol : code.DebugSymbols)
+	{
+		CAPTURE(symbol.SourceAst);
+		REQUIRE(starts.contains(symbol.Offset));
+	}
+}
+
+TEST_CASE("Peephole Tests")
+{
+	auto [input, expectedInstructions] = GENERATE(table<std::string, std::vector<RSInstructions>>(
+		{
+			//the branch to the continue jumps straight to the loop head, the store is loaded back without a second lookup
+			{ "let x = 0; while (x < 3) { x = x + 1; if (x == 2) { continue; } } x;",
+				{
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_LT, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {47}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_ADD, {}),
+					OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_EQ, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {8}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {8}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {8}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let f = fn(n) { let u = 0; if (n > 1) { if (n > 2) { u = 1; } } else { u = 2; } u }; f(3);",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::MakeIntegerLiteral(0),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_GT, {}),
+									OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {43}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::MakeIntegerLiteral(2),
+									OpCode::Make(OpCode::Constants::OP_GT, {}),
+									OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {51}),
+									OpCode::MakeIntegerLiteral(1),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_JUMP, {51}),
+									OpCode::MakeIntegerLiteral(2),
+									OpCode::Make(OpCode::Constants::OP_SET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),2,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the function body shrinks
+			{ "let f = fn(n) { let u = n * 2; u }; f(3);",
+				{
+					MakeFunctionLiteral
+					(
+						MakeFunction
+						(
+							ConcatInstructions
+							(
+								{
+									OpCode::Make(OpCode::Constants::OP_GET, {0x8000}),
+									OpCode::MakeIntegerLiteral(2),
+									OpCode::Make(OpCode::Constants::OP_MUL, {}),
+									OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0x8001}),
+									OpCode::Make(OpCode::Constants::OP_RET_VAL, {}),
+								}
+							),2,1
+						).get()
+					),
+					OpCode::Make(OpCode::Constants::OP_CLOSURE, {0}),
+					OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0}),
+					OpCode::MakeIntegerLiteral(3),
+					OpCode::Make(OpCode::Constants::OP_CALL, {1}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let x = 1; null; 5; x;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the last popped value is the result of the program
+			{ "null; 5;",
+				{
+					OpCode::MakeIntegerLiteral(5),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "while (true) { break; } 7;",
+				{
+					OpCode::Make(OpCode::Constants::OP_JUMP, {6}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {0}),
+					OpCode::MakeIntegerLiteral(7),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			{ "let x = 0; if (false) { x = 1; } else { x = 2; } x;",
+				{
+					OpCode::MakeIntegerLiteral(0),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {22}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_JUMP, {30}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+			//the load is a jump target, the path around the if still needs it
+			{ "let x = 1; if (x > 1) { x = 2; } x;",
+				{
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_SET_KEEP, {0}),
+					OpCode::MakeIntegerLiteral(1),
+					OpCode::Make(OpCode::Constants::OP_GT, {}),
+					OpCode::Make(OpCode::Constants::OP_JUMPIFZ, {25}),
+					OpCode::MakeIntegerLiteral(2),
+					OpCode::Make(OpCode::Constants::OP_SET, {0}),
+					OpCode::Make(OpCode::Constants::OP_GET, {0}),
+					OpCode::Make(OpCode::Constants::OP_POP, {}),
+				}
+			},
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnablePeephole = true;
+	syn.SetCompilerOptions(options);
+	auto code = syn.Compile(input, "");
+
+	REQUIRE(OpCode::PrintInstructions(code.Instructions) == OpCode::PrintInstructions(ConcatInstructions(expectedInstructions)));
+}
+
+TEST_CASE("Peephole debug symbols")
+{
+	auto input = GENERATE(as<std::string>{},
+		"let x = 1; null; 5; x;",
+		"let x = 0; while (x < 3) { x = x + 1; if (x == 2) { continue; } } x;",
+		"let f = fn(n) { let u = 0; if (n > 1) { if (n > 2) { u = 1; } } else { u = 2; } u }; f(3);",
+		"let f = fn(n) { let u = n * 2; null; u }; let g = fn(m) { f(m) + 1 }; g(3);");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	syn.SetCompilerOptions(options);
+	auto kept = syn.Compile(input, "");
+	options.EnablePeephole = true;
+	syn.SetCompilerOptions(options);
+	auto code = syn.Compile(input, "");
+
+	//symbols of removed instructions move onto the instruction after them, every other symbol follows its instruction
+	std::set<size_t> starts{ code.Instructions.size() };
+	size_t offset = 0;
+	while (offset < code.Instructions.size())
+	{
+		starts.insert(offset);
+		auto [opcode, operands, next] = OpCode::ReadOperand(code.Instructions, offset);
+		offset = next + (opcode == OpCode::Constants::OP_LSTRING ? operands[0] : 0);
+	}
+	REQUIRE(code.DebugSymbols.size() == kept.DebugSymbols.size());
+	for (auto& symbol : code.DebugSymbols)
+	{
+		CAPTURE(symbol.SourceAst);
+		REQUIRE(starts.contains(symbol.Offset));
+	}
+}
+
+TEST_CASE("IR dump")
+{
+	auto [input, expected] = GENERATE(table<std::string, std::string>(
+		{
+			{
+				"let x = 0; while (x < 3) { x = x + 1; }; x;",
+				"fn main\n"
+				"b0:\n"
+				"  v1 = OP_LINT [0]\n"
+				"  OP_SET [global 0] v1\n"
+				"  next b1\n"
+				"b1: <- b0, b2\n"
+				"  v2 = OP_GET [global 0]\n"
+				"  v3 = OP_LINT [3]\n"
+				"  v4 = OP_LT v2 v3\n"
+				"  OP_JUMPIFZ v4\n"
+				"  branch b3\n"
+				"  next b2\n"
+				"b2: <- b1\n"
+				"  v5 = OP_GET [global 0]\n"
+				"  v6 = OP_LINT [1]\n"
+				"  v7 = OP_ADD v5 v6\n"
+				"  OP_SET [global 0] v7\n"
+				"  OP_JUMP\n"
+				"  branch b1\n"
+				"b3: <- b1\n"
+				"  v8 = OP_GET [global 0]\n"
+				"  OP_POP v8\n"
+			},
+			{
+				"let f = fn(a) { a * 2 }; for (i in [1]) { i * 2; }",
+				"fn f#0\n"
+				"b0:\n"
+				"  v1 = OP_GET [local 0]\n"
+				"  v2 = OP_LINT [2]\n"
+				"  v3 = OP_MUL v1 v2\n"
+				"  OP_RET_VAL v3\n"
+				"fn main\n"
+				"b0:\n"
+				"  v1 = OP_LFUN [locals=1 params=1 bytes=10]\n"
+				"  v2 = OP_CLOSURE [0] v1\n"
+				"  OP_SET [global 0] v2\n"
+				"  v3 = OP_LINT [1]\n"
+				"  v4 = OP_ARRAY [1] v3\n"
+				"  v5 = OP_ITER v4\n"
+				"  next b1\n"
+				"b1: <- b0, b2\n"
+				"  v6 = phi v5 (b0), v8 (b2)\n"
+				"  v7 = OP_ITER_NEXT\n"
+				"  branch b4\n"
+				"  next b2\n"
+				"b2: <- b1\n"
+				"  v8 = phi v6 (b1)\n"
+				"  v9 = phi v7 (b1)\n"
+				"  OP_SET [global 1] v9\n"
+				"  v10 = OP_GET [global 1]\n"
+				"  v11 = OP_LINT [2]\n"
+				"  v12 = OP_MUL v10 v11\n"
+				"  OP_POP v12\n"
+				"  OP_JUMP\n"
+				"  branch b1\n"
+				"b3: (unreachable)\n"
+				"  OP_POP undef\n"
+				"  next b4\n"
+				"b4: <- b1, b3\n"
+			},
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	syn.SetCompilerOptions(options);
+	REQUIRE(syn.DumpIr(input, "main") == expected);
+}
+
+TEST_CASE("Parser errors are reported")
+{
+	auto dumpIr = GENERATE(false, true);
+
+	CAPTURE(dumpIr);
+	RogueSyntax syn;
+	std::string error;
+	try
+	{
+		if (dumpIr)
+		{
+			syn.DumpIr("let = 5;", "main");
+		}
+		else
+		{
+			syn.Compile("let = 5;", "main");
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		error = ex.what();
+	}
+	REQUIRE(error == "parser errors:\n\tNo prefix parse function for = found\n\texpected next token to be =, got INT instead");
+}
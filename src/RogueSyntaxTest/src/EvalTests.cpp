@@ -316,6 +316,55 @@ TEST_CASE("FOR tests")
 	REQUIRE(TestEvalInteger(eng, input, expected));
 }
 
+TEST_CASE("FOR IN tests")
+{
+	auto [eng] = GENERATE(table<EvaluatorType>({ EvaluatorType::Stack, EvaluatorType::Recursive }));
+	auto [input, expected] = GENERATE(table<std::string, int32_t>(
+	{
+		{"let sum = 0; for (x in [1, 2, 3, 4]) { sum = sum + x; }; sum;", 10},
+		{"let sum = 0; for (x in [1, 2, 3, 4]) { if (x == 3) { break; } sum = sum + x; }; sum;", 3},
+		{"let sum = 0; for (x in [1, 2, 3, 4]) { if (x == 3) { continue; } sum = sum + x; }; sum;", 7},
+		{"let sum = 0; for (a in [1, 2]) { for (b in [10, 20]) { sum = sum + a * b; } }; sum;", 90},
+		{"let sum = 0; for (i in range(1, 10, 2)) { sum = sum + i; }; sum;", 25},
+		{"len(range(0, 10, 3)) + range(0, 10, 3)[2];", 10},
+	}));
+
+	CAPTURE(input);
+	REQUIRE(TestEvalInteger(eng, input, expected));
+}
+
+TEST_CASE("Native collection tests")
+{
+	auto [eng] = GENERATE(table<EvaluatorType>({ EvaluatorType::Stack, EvaluatorType::Recursive }));
+	auto [input, expected] = GENERATE(table<std::string, int32_t>(
+	{
+		{"sort([5, 3, 9, 1])[0];", 1},
+		{"sort([5, 3, 9, 1])[3];", 9},
+		{"reverse([1, 2, 3])[0];", 3},
+		{"indexOf([4, 5, 6], 6);", 2},
+		{"let sort = fn(x) { x * 2 }; sort(4);", 8},
+	}));
+
+	CAPTURE(input);
+	REQUIRE(TestEvalInteger(eng, input, expected));
+}
+
+TEST_CASE("Typed array tests")
+{
+	auto [eng] = GENERATE(table<EvaluatorType>({ EvaluatorType::Stack, EvaluatorType::Recursive }));
+	auto [input, expected] = GENERATE(table<std::string, int32_t>(
+	{
+		{"sum(intArray(range(100)));", 4950},
+		{"let a = intArray(range(10)); (a * 2 + 1)[4];", 9},
+		{"let a = intArray(range(10)); sum(a >= 5);", 5},
+		{"dot(intArray([1, 2, 3]), intArray([4, 5, 6]));", 32},
+		{"let a = intArray([3, 1, 2]); a[0] + len(a);", 6},
+	}));
+
+	CAPTURE(input);
+	REQUIRE(TestEvalInteger(eng, input, expected));
+}
+
 TEST_CASE("Decimal and String tests")
 {
 	auto [eng] = GENERATE(table<EvaluatorType>({ EvaluatorType::Stack, EvaluatorType::Recursive }));
@@ -1051,6 +1051,41 @@ TEST_CASE("Test for parsing")
 		REQUIRE(forStatement->ToString() == test.expectedValue);
 	}
 }
+
+TEST_CASE("Test for in and generator parsing")
+{
+	struct Test
+	{
+		std::string input;
+		std::string expectedValue;
+	};
+
+	std::vector<Test> tests = {
+		{"for (x in [1, 2]) { x; }"              , "for (x in [1, 2]) {x}"},
+		{"for(x in range(y)){ x; }"              , "for (x in range(y)) {x}"},
+		{"let g = fn*(n) { yield n; };"          , "let g = fn*(n){yield n};"},
+		{"let g = fn*() { yield; };"             , "let g = fn*(){yield null};"},
+		{"let g = fn() { yield(1); };"           , "let g = fn(){yield(1)};"},
+	};
+
+	for (auto& test : tests)
+	{
+		Lexer lexer(test.input);
+		Parser parser(lexer);
+
+		UNSCOPED_INFO(test.input);
+		auto program = parser.ParseProgram("TESTPRG");
+		auto errors = parser.Errors();
+		for (auto& error : errors)
+		{
+			UNSCOPED_INFO(error);
+		}
+		REQUIRE(errors.size() == 0);
+
+		REQUIRE(program->Statements.size() == 1);
+		REQUIRE(program->Statements[0]->ToString() == test.expectedValue);
+	}
+}
 	
 TEST_CASE("TEST ASSIGN OPERATORS")
 {
@@ -1,7 +1,10 @@
 #include <vector>
 #include <sstream>
+#include <thread>
+#include <atomic>
 #include "CompilerTestHelpers.h"
 #include <RogueSyntaxCore.h>
+#include <RogueSyntax.h>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
@@ -259,6 +262,265 @@ TEST_CASE("For loop instruction")
 	REQUIRE(VmTest(input, expected));
 }
 
+TEST_CASE("For in loop instruction")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let sum = 0; for (x in [1, 2, 3, 4]) { sum = sum + x; }; sum;", 10},
+			{"let sum = 0; for (x in []) { sum = sum + 1; }; sum;", 0},
+			{"let sum = 0; for (x in [1, 2, 3, 4]) { if (x == 3) { break; } sum = sum + x; }; sum;", 3},
+			{"let sum = 0; for (x in [1, 2, 3, 4]) { if (x == 3) { continue; } sum = sum + x; }; sum;", 7},
+			{"let sum = 0; for (a in [1, 2]) { for (b in [10, 20]) { sum = sum + a * b; } }; sum;", 90},
+			{"let sum = 0; for (a in [1, 2, 3]) { for (b in [1, 2, 3]) { if (b == 2) { break; } sum = sum + a; } }; sum;", 6},
+			{"let f = fn(arr) { for (x in arr) { if (x > 2) { return x; } }; 0; }; f([1, 2, 3, 4]);", 3},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+}
+
+TEST_CASE("Range instructions")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let sum = 0; for (i in range(10)) { sum = sum + i; }; sum;", 45},
+			{"let sum = 0; for (i in range(2, 5)) { sum = sum + i; }; sum;", 9},
+			{"let sum = 0; for (i in range(10, 0, -3)) { sum = sum + i; }; sum;", 22},
+			{"let sum = 0; for (i in range(5, 5)) { sum = sum + 1; }; sum;", 0},
+			{"let sum = 0; for (i in range(10)) { if (i == 4) { break; } sum = sum + i; }; sum;", 6},
+			{"let sum = 0; for (i in range(10)) { if (i % 2 == 0) { continue; } sum = sum + i; }; sum;", 25},
+			{"let sum = 0; for (i in range(3)) { for (j in range(3)) { sum = sum + i * j; } }; sum;", 9},
+			{"let r = range(1, 10, 2); let sum = 0; for (i in r) { sum = sum + i; }; sum;", 25},
+			{"let range = fn(n) { [n, n]; }; let sum = 0; for (i in range(4)) { sum = sum + i; }; sum;", 8},
+			{"len(range(0, 10, 3));", 4},
+			{"len(range(10, 0, -3));", 4},
+			{"len(range(3, 1));", 0},
+			{"range(0, 10, 3)[2];", 6},
+			{"range(10, 0, -1)[9];", 1},
+			{"range(0, 10, 0);", "range step must not be zero"},
+			{"range();", "wrong number of arguments. got=0, wanted=1..3"},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+}
+
+TEST_CASE("Typed array instructions")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"sum(intArray([1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]));", 66},
+			{"sum(intArray(range(1000)));", 499500},
+			{"sum(decimalArray([1.5, 2.5, 3]));", 7.0f},
+			{"sum(intArray(0));", 0},
+			{"min(intArray([4, -2, 9, 7, 3, 8, 1, 6, 5]));", -2},
+			{"max(intArray([4, -2, 9, 7, 3, 8, 1, 6, 5]));", 9},
+			{"max(decimalArray([0.5, -1.5, 2.25]));", 2.25f},
+			{"dot(intArray(range(1, 10)), intArray(range(1, 10)));", 285},
+			{"dot(decimalArray([1, 2]), decimalArray([0.5, 0.25]));", 1.0f},
+			{"let a = intArray(range(9)); let b = a + a; b[8];", 16},
+			{"let a = intArray(range(9)); (a - 1)[0];", -1},
+			{"let a = intArray(range(9)); (10 - a)[3];", 7},
+			{"let a = intArray(range(9)); (a * a)[7];", 49},
+			{"let a = intArray([7, 8, 9]); (a / 2)[2];", 4},
+			{"let a = intArray([2, 4, 8]); (16 / a)[1];", 4},
+			{"let a = intArray([1, 2, 3]); (a * 0.5)[2];", 1.5f},
+			{"let a = decimalArray([1, 2, 3]); (a + 1)[0];", 2.0f},
+			{"scale(intArray(range(10)), 3)[9];", 27},
+			{"sum(intArray(range(20)) > 9);", 10},
+			{"sum(5 > intArray(range(20)));", 5},
+			{"sum(intArray(range(20)) == intArray(range(20)));", 20},
+			{"sum(decimalArray(range(10)) <= 4);", 5},
+			{"len(intArray(range(7)) != 3);", 7},
+			{"len(decimalArray(12));", 12},
+			{"let a = intArray([1, 2, 3]); a[1] = 20; sum(a);", 24},
+			{"let a = decimalArray([1, 2, 3]); a[0] = 5; a[0];", 5.0f},
+			{"let a = intArray([1, 2, 3]); let b = a; b[0] = 10; a[0];", 1},
+			{"sum(intArray(decimalArray([1.5, 2.5])));", 3},
+			{"len(toArray(intArray(range(4))));", 4},
+			{"toArray(decimalArray([1, 2]))[1];", 2.0f},
+			{"intArray([1, 2]) + intArray([1, 2, 3]);", "typed array lengths differ. got=2 and 3"},
+			{"intArray([1, 2]) / 0;", "division by zero"},
+			{"min(intArray(0));", "argument to `min` must not be empty"},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+}
+
+TEST_CASE("Typed array kernels agree at every simd level")
+{
+	std::vector<int32_t> ints;
+	std::vector<float> decimals;
+	for (int i = 0; i < 37; i++)
+	{
+		ints.push_back((i * 7919) % 101 - 50);
+		decimals.push_back(static_cast<float>(ints.back()) * 0.25f + 0.125f);
+	}
+
+	auto scalarInt = static_cast<int32_t>(3);
+	auto scalarDecimal = 1.5f;
+	auto collect = [&]()
+	{
+		auto& kernels = SimdKernels::Table();
+		std::vector<float> results;
+		for (size_t n : { size_t(1), size_t(3), size_t(8), size_t(13), ints.size() })
+		{
+			results.push_back(static_cast<float>(kernels.SumInt(ints.data(), n)));
+			results.push_back(kernels.SumDecimal(decimals.data(), n));
+			results.push_back(static_cast<float>(kernels.MinInt(ints.data(), n)));
+			results.push_back(static_cast<float>(kernels.MaxInt(ints.data(), n)));
+			results.push_back(kernels.MinDecimal(decimals.data(), n));
+			results.push_back(kernels.MaxDecimal(decimals.data(), n));
+			results.push_back(static_cast<float>(kernels.DotInt(ints.data(), ints.data(), n)));
+			results.push_back(kernels.DotDecimal(decimals.data(), decimals.data(), n));
+
+			std::vector<int32_t> intOut(n);
+			std::vector<float> decimalOut(n);
+			for (auto op : { VectorOp::Add, VectorOp::Sub, VectorOp::Mul, VectorOp::Div })
+			{
+				kernels.ArithInt(op, ints.data(), &scalarInt, true, intOut.data(), n);
+				results.insert(results.end(), intOut.begin(), intOut.end());
+				kernels.ArithDecimal(op, decimals.data(), decimals.data(), false, decimalOut.data(), n);
+				results.insert(results.end(), decimalOut.begin(), decimalOut.end());
+				kernels.ArithDecimal(op, decimals.data(), &scalarDecimal, true, decimalOut.data(), n);
+				results.insert(results.end(), decimalOut.begin(), decimalOut.end());
+			}
+			for (auto op : { CompareOp::Eq, CompareOp::Neq, CompareOp::Lt, CompareOp::Lte, CompareOp::Gt, CompareOp::Gte })
+			{
+				kernels.CompareInt(op, ints.data(), &scalarInt, true, intOut.data(), n);
+				results.insert(results.end(), intOut.begin(), intOut.end());
+				kernels.CompareDecimal(op, decimals.data(), decimals.data() + 1, false, intOut.data(), n - 1);
+				results.insert(results.end(), intOut.begin(), intOut.begin() + n - 1);
+			}
+		}
+		return results;
+	};
+
+	auto detected = SimdKernels::Detected();
+	SimdKernels::SetLevel(SimdLevel::Scalar);
+	auto expected = collect();
+	for (auto level : { SimdLevel::Sse41, SimdLevel::Avx2 })
+	{
+		if (level > detected)
+		{
+			break;
+		}
+		SimdKernels::SetLevel(level);
+		CAPTURE(static_cast<int>(level));
+		auto actual = collect();
+		REQUIRE(actual.size() == expected.size());
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			CAPTURE(i);
+			//vector sums add in a different order than the scalar loop
+			REQUIRE(std::abs(actual[i] - expected[i]) <= 1e-3f * std::max(1.0f, std::abs(expected[i])));
+		}
+	}
+	SimdKernels::SetLevel(detected);
+	REQUIRE(SimdKernels::Active() == detected);
+}
+
+TEST_CASE("Collection builtins")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"sort([5, 3, 9, 1, 7])[0];", 1},
+			{"sort([5, 3, 9, 1, 7])[4];", 9},
+			{"sort([2.5, 1, -3])[2];", 2.5f},
+			{"sort([\"pear\", \"apple\", \"fig\"])[0];", "apple"},
+			{"sort([3, 1, 2], fn(a, b) { a > b })[0];", 3},
+			{"sort([3, 1, 2], fn(a, b) { b - a })[2];", 1},
+			{"sort([[2, 0], [1, 1], [2, 2], [1, 3]], fn(a, b) { a[0] < b[0] })[1][1];", 3},
+			{"sort([]);", Array({})},
+			{"sort(intArray([4, 2, 8]))[0];", 2},
+			{"len(map([1, 2, 3], fn(x) { [x] }));", 3},
+			{"map([1, 2, 3], fn(x) { x * x })[2];", 9},
+			{"len(filter([1, 2, 3, 4, 5], fn(x) { x > 2 }));", 3},
+			{"reduce([1, 2, 3, 4], fn(a, b) { a + b });", 10},
+			{"reduce([1, 2, 3, 4], fn(a, b) { a * b }, 10);", 240},
+			{"reduce([], fn(a, b) { a + b });", NullObj()},
+			{"indexOf([1, \"a\", 3], \"a\");", 1},
+			{"indexOf([1, 2, 3], 3);", 2},
+			{"indexOf([1, 2, 3], \"3\");", -1},
+			{"reverse([1, 2, 3])[0];", 3},
+			{"reverse(\"abc\");", "cba"},
+			{"let offset = 10; map([1, 2], fn(x) { x + offset })[1];", 12},
+			{"let total = fn(arr) { reduce(map(arr, fn(x) { x * 2 }), fn(a, b) { a + b }) }; total(sort([3, 1, 2]));", 12},
+			{"map([1]);", "wrong number of arguments. got=1, wanted=2"},
+			{"reduce([1]);", "wrong number of arguments. got=1, wanted=2..3"},
+			{"sort([1], fn(a, b) { a < b }, 3);", "wrong number of arguments. got=3, wanted=1..2"},
+			{"let map = fn(x) { x + 1 }; map(3);", 4},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+}
+
+TEST_CASE("Collection callbacks survive collections")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(
+		"let items = [];"
+		"let i = 0; while (i < 200) { items = push(items, [(i * 37) % 200]); i = i + 1; }"
+		"let sorted = sort(items, fn(a, b) { let boxed = [a[0], b[0]]; boxed[0] < boxed[1] });"
+		"let mapped = map(sorted, fn(x) { [x[0] * 2] });"
+		"let kept = filter(mapped, fn(x) { [x[0] % 4][0] == 0 });"
+		"reduce(kept, fn(acc, x) { acc + [x[0]][0] }, 0) + sorted[199][0];", "")));
+	vm->SetNurserySize(512);
+	vm->Run();
+
+	REQUIRE(vm->GetNurseryStats().MinorCollections > 1);
+	REQUIRE(TestConstant(19999, vm->LastPopped()));
+}
+
+TEST_CASE("Generator instructions")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let count = fn*(n) { let i = 0; while (i < n) { yield i; i = i + 1; } }; let sum = 0; for (x in count(5)) { sum = sum + x; }; sum;", 10},
+			{"let none = fn*() { }; let sum = 0; for (x in none()) { sum = sum + 1; }; sum;", 0},
+			{"let early = fn*() { yield 1; return 5; yield 2; }; let sum = 0; for (x in early()) { sum = sum + x; }; sum;", 1},
+			{"let count = fn*(n) { let i = 0; while (i < n) { yield i; i = i + 1; } }; let it = count(6); let sum = 0; for (x in it) { if (x == 2) { break; } sum = sum + x; } for (y in it) { sum = sum + y * 10; }; sum;", 121},
+			{"let pairs = fn*(arr) { for (a in arr) { for (b in arr) { yield a * b; } } }; let sum = 0; for (x in pairs([1, 2, 3])) { sum = sum + x; }; sum;", 36},
+			{"let nat = fn*() { let i = 0; while (true) { yield i; i = i + 1; } };"
+			 "let evens = fn*(src) { for (x in src) { if (x % 2 == 0) { yield x; } } };"
+			 "let squares = fn*(src) { for (x in src) { yield x * x; } };"
+			 "let take = fn*(src, n) { let c = 0; for (x in src) { if (c == n) { return null; } yield x; c = c + 1; } };"
+			 "let sum = 0; for (v in take(squares(evens(nat())), 10)) { sum = sum + v; }; sum;", 1140},
+			{"let offset = 100; let shifted = fn*(arr) { for (x in arr) { yield x + offset; } }; let sum = 0; for (x in shifted([1, 2])) { sum = sum + x; }; sum;", 203},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+}
+
+TEST_CASE("Generator collections and budgets")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(
+		"let nat = fn*() { let i = 0; while (true) { yield [i]; i = i + 1; } };"
+		"let take = fn*(src, n) { let c = 0; for (x in src) { if (c == n) { return null; } yield x[0]; c = c + 1; } };"
+		"let sum = 0; for (v in take(nat(), 300)) { sum = sum + v; }; sum;", "")));
+	vm->SetNurserySize(512);
+	while (vm->RunFor(100) == VmStatus::BudgetExhausted)
+	{
+	}
+
+	REQUIRE(vm->Status() == VmStatus::Completed);
+	REQUIRE(vm->GetNurseryStats().MinorCollections > 1);
+	REQUIRE(TestConstant(44850, vm->LastPopped()));
+}
+
+TEST_CASE("Generator reentry")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let self = null; let loopback = fn*() { for (y in self) { yield y; } }; let self = loopback(); for (z in self) { }", "")));
+	vm->Run();
+	REQUIRE(vm->Status() == VmStatus::Error);
+	REQUIRE(vm->LastPopped()->Inspect().find("Generator is already running") != std::string::npos);
+}
+
 TEST_CASE("Extern/Builtin Function tests")
 {
 	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
@@ -304,7 +566,9 @@ TEST_CASE("Closure Tests")
 			{"let newClosure = fn(a) { fn() { a; }; }; let closure = newClosure(99); closure();", 99},
 			{"let newAdder = fn(a, b) { fn(c) { a + b + c; }; }; let adder = newAdder(1, 2); adder(8);", 11},
 			{"let newAdder = fn(a, b) { let c = a + b; fn(d) { c + d; }; }; let adder = newAdder(1, 2); adder(8);", 11},
-			{"let newClosure = fn(a) { fn(b) { a + b; }; }; let closure = newClosure(2); closure(3);", 5}
+			{"let newClosure = fn(a) { fn(b) { a + b; }; }; let closure = newClosure(2); closure(3);", 5},
+			{"[fn(x) { x * 2 }, fn(a, b) { a - b }][1](5, 2);", 3},
+			{"let f = fn(x) { x }; let f = fn(a, b) { a - b }; f(5, 2);", 3}
 		}));
 
 	CAPTURE(input);
@@ -338,8 +602,1007 @@ TEST_CASE("Many function calls")
 	REQUIRE(VmTest(input, expected));
 }
 
+TEST_CASE("Inlined function calls")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let add = fn(a, b) { a + b; }; add(2, 3);", 5},
+			{"let sq = fn(x) { return x * x; }; sq(sq(3));", 81},
+			{"let y = 10; let f = fn(x) { x + 1; }; f(1) + y;", 12},
+			{"let x = 10; let f = fn(x) { x + 1; }; f(1) + x;", 21},
+			{"let g = fn(a) { len(a) + first(a); }; g([4, 5, 6]);", 7},
+			{"let f = fn(x) { x * 2; }; let t = 0; for (let i = 0; i < 4; i = i + 1) { t = t + f(i); }; t;", 12},
+			{"let f = fn(x) { x * 2; }; let h = fn(y) { let z = f(y); z + 1; }; h(4);", 9},
+			{"let f = fn(n) { if (n == 0) { return 0; } f(n - 1); }; f(3);", 0},
+			{"let f = fn(x) { x + 1; }; f = fn(x) { x + 2; }; f(1);", 3},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Constant folding")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"60 * 60 * 24;", 86400},
+			{"let SIZE = 10; let t = 0; for (let i = 0; i < SIZE * 2; i = i + 1) { t = t + SIZE - 1; }; t;", 180},
+			{"\"n\" + 2 + 1;", "n21"},
+			{"let a = 2.5; a * 2.0 + 1;", 6.0f},
+			{"!(1 < 2) || (3 == 3);", true},
+			{"-(2 - 7) * ~0;", -5},
+			{"let n = 1; let f = fn() { n = 2; 0; }; f(); n + 1;", 3},
+			{"let x = 1; if (x > 0) { x = 5; }; x * 2;", 10},
+			{"let f = fn() { let k = 3; let m = k * k; m + k; }; f();", 12},
+			{"let big = 2147483647; let s = \"\" + big; len(s);", 10},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Dead code elimination")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let f = fn(a) { if (a > 1) { return 1; } else { return 2; } 3; }; f(5);", 1},
+			{"let x = 0; while (true) { x = x + 1; if (x > 3) { break; } }; x;", 4},
+			{"let s = 0; for (i in [1, 2, 3]) { if (true) { continue; } s = s + i; }; s;", 0},
+			{"if (false) { 5 }", false},
+			{"if (true) { 5 } else { 6 }", 5},
+			{"let unused = fn(a) { a }; let used = 4; used;", 4},
+			{"let a = [1, 2]; let b = a; b[0] = 9; b[0];", 9},
+			{"let f = fn() { let k = 3; let unused = k * 2; k; }; f();", 3},
+			{"let x = 10; let f = fn() { x }; f();", 10},
+			{"let x = 1; let y = 2;", 2},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Loop invariant code motion")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let n = 5; let x = 0; while (x < n - 1) { x = x + 1; }; x;", 4},
+			{"let f = fn(a) { let i = 0; let s = 0; while (i < len(a)) { s = s + a[i]; i = i + 1; } s }; f([1, 2, 3]);", 6},
+			{"let n = 5; let x = 0; while (x < n - 1) { n = n - 1; x = x + 1; }; x;", 2},
+			{"let n = 6; let g = fn() { n = n - 2; 0; }; let x = 0; while (x < n / 2) { g(); x = x + 1; }; x;", 2},
+			{"let a = [1]; let x = 0; while (x < 4 - len(a)) { a = push(a, x); x = x + 1; }; x;", 2},
+			{"let n = 4; let f = fn() { let x = 0; while (x < n - 1) { x = x + 1; } x }; f();", 3},
+			{"let s = 0; let i = 0; let n = 3; while (i < n) { let j = 0; while (j < n - i) { s = s + 1; j = j + 1; } i = i + 1; }; s;", 6},
+			{"let bubble = fn(arr) { let length = len(arr); let i = 0; while (i < length) { let j = 0; while (j < length - i - 1) { if (arr[j] > arr[j + 1]) { let t = arr[j]; arr[j] = arr[j + 1]; arr[j + 1] = t; } j = j + 1; } i = i + 1; } arr }; bubble([5, 1, 4, 2, 3])[4] * 10 + bubble([5, 1, 4, 2, 3])[0];", 51},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Pure builtins leave the loop")
+{
+	auto pure = GENERATE(true, false);
+
+	CAPTURE(pure);
+	RogueSyntax syn;
+	auto calls = std::make_shared<int>(0);
+	syn.RegisterBuiltIn("limit", [calls](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		(*calls)++;
+		return factory->Clone(args[0]);
+	}, pure);
+
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let x = 0; while (x < limit(5)) { x = x + 1; }; x;", "")));
+	vm->Run();
+
+	REQUIRE(TestConstant(5, vm->LastPopped()));
+	REQUIRE(*calls == (pure ? 1 : 6));
+}
+
+TEST_CASE("Type specialization")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let s = 0; let i = 0; while (i < 100) { s = s + i; i = i + 1; }; s;", 4950},
+			{"let s = \"\"; let i = 0; while (i < 3) { s = s + \"ab\"; i = i + 1; }; s;", "ababab"},
+			{"let x = 1; let i = 0; while (i < 2) { x = x + \"a\"; i = i + 1; }; x;", "1aa"},
+			{"let x = 1; let f = fn() { x = \"s\"; 0; }; f(); x + \"t\";", "st"},
+			{"let f = fn(a) { let n = len(a); n < 3 }; f([1, 2]);", true},
+			{"let x = 1.5; let y = 2; x + 1.5 < 4.0 == y < 3;", true},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Common subexpression elimination")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let f = fn(a, j) { if (a[j] > a[j + 1]) { let t = a[j]; a[j] = a[j + 1]; a[j + 1] = t; }; a }; f([2, 1], 0);", Array({1,2})},
+			{"let n = 1; let g = fn() { n = n + 1; 0; }; let y = [n + 1, g(), n + 1]; y;", Array({2,0,3})},
+			{"let x = 3; let y = x * x + 1; x = 4; let z = x * x + 1; [y, z];", Array({10,17})},
+			{"let m = [[1, 2], [3, 4]]; let i = 1; m[i][0] + m[i][1] + m[i][0];", 10},
+			{"let s = \"ab\"; let t = s + \"c\"; len(s + \"c\") + len(t);", 6},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Strength reduction")
+{
+	//C++ division truncates towards zero, values that may be negative keep the divide
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let s = 0; let i = 0; while (i < 10) { s = s + i % 4 + i / 2 + i * 8; i = i + 1; }; s;", 393},
+			{"let f = fn(a) { let i = len(a) - 10; [i / 2, i % 4, i * 4, (0 - i) / 2] }; f([1, 2, 3]);", Array({-3,-3,-28,3})},
+			{"let i = 7; let j = 0; while (j < 3) { i = i - 5; j = j + 1; }; [i / 2, i % 2];", Array({-4,0})},
+			//sums and products of values that are never negative still wrap around
+			{"let a = 2147483647; let b = a + 3; b % 4;", -2},
+			{"let f = fn() { let a = 2147483647; let b = a * 2; [b % 4, b / 2] }; f();", Array({-2,-1})},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Bounds check elimination")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let f = fn(a) { let s = 0; let j = 0; while (j < len(a)) { s = s + a[j]; j = j + 1; } s }; f([1, 2, 3]);", 6},
+			{"let a = [4, 5, 6]; let s = 0; for (let i = 0; i < len(a); i = i + 1) { s = s + a[i] * a[i]; }; s;", 77},
+			//not an array, the index is still checked
+			{"let h = {0: 7}; let s = 0; let j = 0; while (j < len([1])) { s = s + h[j]; j = j + 1; }; s;", 7},
+			{"let r = range(0, 4); let s = 0; let j = 0; while (j < len(r)) { s = s + r[j]; j = j + 1; }; s;", 6},
+		}));
+
+	CAPTURE(input);
+	REQUIRE(VmTest(input, expected));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Bounds check elimination keeps errors")
+{
+	auto input = GENERATE(as<std::string>{},
+		"let a = [1, 2]; let s = 0; let j = 0; while (j < len(a)) { j = j + 1; s = s + a[j]; }; s;",
+		"let a = [1, 2]; let s = 0; let j = 0; while (j < len(a)) { if (j > 0) { a = [1]; }; s = s + a[j]; j = j + 1; }; s;");
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	vm->Run();
+	REQUIRE(vm->Status() == VmStatus::Error);
+	REQUIRE(vm->LastPopped()->Inspect().find("Index out of bounds") != std::string::npos);
+}
+
+TEST_CASE("Slot reuse")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let f = fn(n) { if (n < 2) { let r = n; return r; } let a = f(n - 1); let b = f(n - 2); a + b }; f(15);", 610},
+			{"let f = fn(a, b) { let c = a + b; let d = c * 2; c + d }; f(1, 2);", 9},
+			{"let f = fn(n) { let s = 0; for (x in [1, 2, 3]) { let y = x * n; s = s + y; } for (x in [4, 5]) { let z = x; s = s + z; } s }; f(2);", 21},
+			{"let f = fn(a) { let b = a + 1; let g = fn(c) { c + b }; let d = 10; g(d) }; f(1);", 12},
+			{"let g = fn*(n) { let i = 0; while (i < n) { let t = i * 10; yield t; i = i + 1; } let u = 5; yield u; }; let s = 0; for (v in g(3)) { s = s + v; }; s;", 35},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions();
+	options.EnableInlining = false;
+	REQUIRE(VmTest(input, expected, options));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Peephole optimizer")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let x = 0; while (x < 3) { x = x + 1; if (x == 2) { continue; } } x;", 3},
+			{"let f = fn(n) { let u = 0; if (n > 1) { if (n > 2) { u = 1; } } else { u = 2; } u }; f(3) * 100 + f(2) * 10 + f(0);", 102},
+			{"let f = fn(n) { let u = n * 2; null; u }; f(3);", 6},
+			{"let x = 1; null; 5; x;", 1},
+			{"let a = [1, 2]; let b = a; b[0] = 5; a[0] * 10 + b[0];", 15},
+			{"while (true) { break; } 7;", 7},
+			{"let s = 0; for (i in [1, 2]) { for (j in [3, 4]) { if (j == 3) { continue; } s = s + i * j; } } s;", 12},
+			{"let g = fn*(n) { let i = 0; while (i < n) { if (i == 1) { i = i + 1; continue; } yield i; i = i + 1; } }; let s = 0; for (v in g(4)) { s = s + v; }; s;", 5},
+		}));
+
+	CAPTURE(input);
+	auto options = CompilerOptions();
+	options.EnableInlining = false;
+	REQUIRE(VmTest(input, expected, options));
+	options = CompilerOptions::Unoptimized();
+	options.EnablePeephole = true;
+	REQUIRE(VmTest(input, expected, options));
+}
+
+TEST_CASE("Peephole optimizer keeps back-edge budgets")
+{
+	//the branch around the continue is threaded onto the loop's back-edge, the vm still has to stop there
+	RogueSyntax syn;
+	auto options = CompilerOptions::Unoptimized();
+	options.EnablePeephole = true;
+	syn.SetCompilerOptions(options);
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let x = 0; while (x < 100) { x = x + 1; if (x < 0) { continue; } } x;", "")));
+
+	int slices = 0;
+	while (vm->RunFor(20) == VmStatus::BudgetExhausted)
+	{
+		slices++;
+	}
+	REQUIRE(vm->Status() == VmStatus::Completed);
+	REQUIRE(slices > 10);
+	REQUIRE(TestConstant(100, vm->LastPopped()));
+}
+
+TEST_CASE("Type specialization follows builtin overrides")
+{
+	//an overridden builtin no longer has a known result type
+	RogueSyntax syn;
+	syn.RegisterBuiltIn("len", [](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		return factory->New<StringObj>("n");
+	});
+
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("len([1]) + \"!\";", "")));
+	vm->Run();
+	REQUIRE(TestConstant("n!", vm->LastPopped()));
+}
+
+TEST_CASE("Escape analysis")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let f = fn(x, y) { let p = [x, y]; p[0] * 10 + [x, y][1] }; f(1, 2) + f(3, 4);", 46},
+			{"let f = fn(k) { let h = {\"a\": k}; {\"b\": k + 1}[\"b\"] + h[\"a\"] }; f(2);", 5},
+			{"let f = fn(a) { map(a, fn(v) { v * 2 }) }; f([1, 2, 3])[2];", 6},
+			{"let f = fn(a) { len(filter([a, a + 1, a + 2], fn(v) { v > a })) }; f(4);", 2},
+			{"let f = fn(n) { if (n == 0) { return 0; }; [n, n][0] + f(n - 1) }; f(100);", 5050},
+			//more than the region holds, the rest goes to the nursery
+			{"let f = fn(n) { if (n == 0) { return 0; }; [n, n][0] + f(n - 1) }; f(3000);", 4501500},
+			{"let f = fn(x) { [x] }; let g = fn(x) { let a = f(x); a[0] + f(x + 1)[0] }; g(1);", 3},
+			{"let f = fn(x) { fn(y) { x + y } }; f(1)(2);", 3},
+		}));
+
+	CAPTURE(input);
+	//an inlined call runs in the main frame
+	auto options = CompilerOptions();
+	options.EnableInlining = false;
+	REQUIRE(VmTest(input, expected, options));
+	REQUIRE(VmTest(input, expected, CompilerOptions::Unoptimized()));
+}
+
+TEST_CASE("Escape analysis survives collections")
+{
+	//the elements of the array are in the nursery while the loop over it allocates enough to collect
+	RogueSyntax syn;
+	auto options = CompilerOptions();
+	options.EnableInlining = false;
+	syn.SetCompilerOptions(options);
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let f = fn(x) { let s = 0; for (v in [x * 2, x * 3]) { let i = 0; while (i < 50) { s = s + v; i = i + 1; } }; s }; f(1);", "")));
+	vm->SetNurserySize(512);
+	vm->Run();
+	REQUIRE(vm->GetNurseryStats().MinorCollections > 1);
+	REQUIRE(TestConstant(250, vm->LastPopped()));
+}
+
+TEST_CASE("Escape analysis keeps temporaries out of the nursery")
+{
+	auto input = "let f = fn(x) { [x, x + 1][1] + {\"k\": x}[\"k\"] }; f(1) + f(2);";
+	RogueSyntax syn;
+	auto options = CompilerOptions();
+	options.EnableInlining = false;
+	options.EnableEscapeAnalysis = false;
+	syn.SetCompilerOptions(options);
+	auto heap = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	heap->Run();
+
+	options.EnableEscapeAnalysis = true;
+	syn.SetCompilerOptions(options);
+	auto scratch = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	scratch->Run();
+
+	REQUIRE(TestConstant(8, scratch->LastPopped()));
+	REQUIRE(scratch->GetNurseryStats().Allocated + 4 == heap->GetNurseryStats().Allocated);
+}
+
+TEST_CASE("Nursery collections")
+{
+	auto [input, expected] = GENERATE(table<std::string, ConstantValue>(
+		{
+			{"let x = 0; for (let i = 0; i < 500; i = i + 1) { x = x + i; }; x;", 124750},
+			{"let a = []; for (let i = 0; i < 100; i = i + 1) { a = push(a, i * 2); }; a[99] + len(a);", 298},
+			{"let h = {1: 0}; for (let i = 0; i < 200; i = i + 1) { h[1] = h[1] + i; }; h[1];", 19900},
+			{"let s = \"\"; for (let i = 0; i < 100; i = i + 1) { s = s + \"a\"; }; len(s);", 100},
+			{"let mk = fn(a) { fn(b) { a + b; }; }; let t = 0; for (let i = 0; i < 100; i = i + 1) { let add = mk(i); t = t + add(1); }; t;", 5050},
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	vm->SetNurserySize(512);
+	vm->Run();
+
+	auto& stats = vm->GetNurseryStats();
+	REQUIRE(stats.MinorCollections > 1);
+	REQUIRE(stats.Promoted < stats.Allocated);
+	REQUIRE(TestConstant(expected, vm->LastPopped()));
+}
+
+TEST_CASE("Nursery write barrier")
+{
+	ObjectStore store;
+	auto factory = store.Factory();
+	auto holder = factory->New<ArrayObj>(std::vector<const IObject*>{ NullObj::NULL_OBJ_REF });
+
+	RogueSyntax syn;
+	syn.RegisterBuiltIn("stash", [holder](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		holder->Set(factory->New<IntegerObj>(0), args[0]);
+		return VoidObj::VOID_OBJ_REF;
+	});
+	syn.RegisterBuiltIn("fetch", [holder](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		return factory->Clone(holder->Elements[0]);
+	});
+
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("stash([1, 2, 3]); let x = 0; for (let i = 0; i < 200; i = i + 1) { x = x + i; }; fetch()[2];", "")));
+	vm->SetNurserySize(512);
+	vm->Run();
+
+	REQUIRE(vm->GetNurseryStats().MinorCollections > 1);
+	REQUIRE(TestConstant(3, vm->LastPopped()));
+	REQUIRE(holder->Elements[0]->Inspect() == "[1, 2, 3]");
+}
+
+TEST_CASE("Nursery disabled")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let x = 0; for (let i = 0; i < 100; i = i + 1) { x = x + i; }; x;", "")));
+	vm->SetNurserySize(0);
+	auto allocated = vm->GetNurseryStats().Allocated;
+	vm->Run();
+
+	REQUIRE(vm->GetNurseryStats().Allocated == allocated);
+	REQUIRE(TestConstant(4950, vm->LastPopped()));
+}
+
+TEST_CASE("Execution scope regions")
+{
+	auto [input, expected] = GENERATE(table<std::string, std::string>(
+		{
+			{"let x = 0; for (let i = 0; i < 50; i = i + 1) { x = x + i; }; x;", "1225"},
+			{"let a = [1, 2]; a = push(a, \"three\"); a;", "[1, 2, three]"},
+			{"let h = {\"k\": [1, {2: 3}]}; h;", "{k: [1, {2: 3}]}"},
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto byteCode = syn.Link(syn.Compile(input, ""));
+	auto before = syn.ObjectCount();
+
+	const IObject* kept = nullptr;
+	for (int run = 0; run < 3; run++)
+	{
+		auto scope = syn.BeginRun();
+		auto vm = syn.MakeVM(byteCode);
+		vm->Run();
+		REQUIRE(scope.ObjectCount() > 0);
+		REQUIRE(syn.ObjectCount() == scope.ObjectCount());
+		REQUIRE(vm->LastPopped()->Inspect() == expected);
+		if (run == 2)
+		{
+			kept = scope.Keep(vm->LastPopped());
+		}
+	}
+
+	REQUIRE(kept->Inspect() == expected);
+	REQUIRE(syn.ObjectCount() - before < 10);
+}
+
+TEST_CASE("Execution scope keeps nested closures")
+{
+	RogueSyntax syn;
+	auto byteCode = std::make_shared<const ByteCode>(syn.Link(syn.Compile(
+		"let count = fn*(n) { let i = 0; while (i < n) { yield i; i = i + 1; } };"
+		"let sum = fn(g) { let s = 0; for (x in g) { s = s + x; }; s; };"
+		"[fn(x) { x }, count(4), {\"sum\": sum}];", "")));
+
+	const IObject* kept = nullptr;
+	{
+		auto scope = syn.BeginRun();
+		auto vm = syn.MakeVM(byteCode);
+		vm->Run();
+		kept = scope.Keep(vm->LastPopped());
+	}
+
+	auto& elements = dynamic_cast<const ArrayObj*>(kept)->Elements;
+	auto sum = dynamic_cast<const HashObj*>(elements[2])->Elements.begin()->second.Value;
+	IntegerObj seven(7);
+	auto vm = syn.MakeVM(byteCode);
+	REQUIRE(TestConstant(7, vm->Call(elements[0], { &seven })));
+	REQUIRE(TestConstant(6, vm->Call(sum, { elements[1] })));
+}
+
+TEST_CASE("Execution scope quick eval")
+{
+	RogueSyntax syn;
+	auto before = syn.ObjectCount();
+	{
+		auto scope = syn.BeginRun();
+		auto result = syn.QuickEval(EvaluatorType::Stack, "let a = [1, 2, 3]; len(a) + first(a);");
+		REQUIRE(result->Inspect() == "4");
+	}
+	REQUIRE(syn.ObjectCount() == before);
+}
+
+TEST_CASE("VM reset and rerun")
+{
+	auto [input, expected] = GENERATE(table<std::string, std::string>(
+		{
+			{"let x = 0; for (let i = 0; i < 10; i = i + 1) { x = x + i; }; x;", "45"},
+			{"let a = [1, 2]; a = push(a, 3); a;", "[1, 2, 3]"},
+			{"let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2); }; fib(10);", "55"},
+			{"let makeAdder = fn(a) { fn(b) { a + b; }; }; let adder = makeAdder(2); adder(3);", "5"},
+		}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto byteCode = std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, "")));
+	auto vm = syn.MakeVM(byteCode);
+	for (int run = 0; run < 3; run++)
+	{
+		vm->Run();
+		REQUIRE(vm->LastPopped()->Inspect() == expected);
+		vm->Reset();
+		REQUIRE(vm->LastPopped() == nullptr);
+	}
+}
+
+TEST_CASE("VM stack sizing")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let a = 1; let b = 2; let c = [a, b];", "")));
+	REQUIRE(vm->GlobalCapacity() == 3);
+	REQUIRE(vm->StackCapacity() == STACK_SIZE);
+	REQUIRE(vm->FrameCapacity() == FRAME_SIZE);
+}
+
+TEST_CASE("VM deep recursion")
+{
+	auto [depth, maxFrames, expected] = GENERATE(table<int, size_t, std::string>(
+		{
+			{ 100, MAX_FRAMES, "100" },
+			{ 20000, MAX_FRAMES, "20000" },
+			{ 100, 50, "Frame stack overflow" },
+		}));
+
+	CAPTURE(depth, maxFrames);
+	RogueSyntax syn;
+	auto input = std::format("let count = fn(n) {{ if (n == 0) {{ return 0; }}; 1 + count(n - 1); }}; count({});", depth);
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	VmLimits limits;
+	limits.MaxFrames = maxFrames;
+	vm->SetLimits(limits);
+	vm->Run();
+
+	REQUIRE(vm->LastPopped()->Inspect().find(expected) != std::string::npos);
+}
+
+TEST_CASE("VM instruction budget")
+{
+	auto [input, budget, expected] = GENERATE(table<std::string, uint64_t, std::string>(
+		{
+			{ "let x = 0; for (let i = 0; i < 1000; i = i + 1) { x = x + i; }; x;", 100, "499500" },
+			{ "let x = 0; while (x < 500) { x = x + 1; }; x;", 1, "500" },
+			{ "let fib = fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2); }; fib(15);", 200, "610" },
+			{ "1 + 2;", 1, "3" },
+		}));
+
+	CAPTURE(input, budget);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile(input, "")));
+	REQUIRE(vm->Status() == VmStatus::Ready);
+
+	int slices = 0;
+	auto status = VmStatus::Ready;
+	do
+	{
+		status = vm->RunFor(budget);
+		slices++;
+	} while (status == VmStatus::BudgetExhausted && slices < 100000);
+
+	REQUIRE(status == VmStatus::Completed);
+	REQUIRE(vm->LastPopped()->Inspect() == expected);
+	//completed vms stay completed until they are reset
+	REQUIRE(vm->RunFor(budget) == VmStatus::Completed);
+
+	vm->Reset();
+	vm->Run();
+	REQUIRE(vm->Status() == VmStatus::Completed);
+	REQUIRE(vm->LastPopped()->Inspect() == expected);
+}
+
+TEST_CASE("VM budget stops infinite loops")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let x = 0; while (true) { x = x + 1; }; x;", "")));
+	REQUIRE(vm->RunFor(10000) == VmStatus::BudgetExhausted);
+	REQUIRE(vm->RunFor(10000) == VmStatus::BudgetExhausted);
+
+	auto start = std::chrono::steady_clock::now();
+	REQUIRE(vm->RunUntil(start + std::chrono::milliseconds(20)) == VmStatus::BudgetExhausted);
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
+
+TEST_CASE("VM budget error status")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let a = [1, 2]; for (let i = 0; i < 10; i = i + 1) { a[i] = i; }; a;", "")));
+	REQUIRE(vm->RunFor(5) == VmStatus::BudgetExhausted);
+	while (vm->RunFor(5) == VmStatus::BudgetExhausted)
+	{
+	}
+	REQUIRE(vm->Status() == VmStatus::Error);
+	REQUIRE(vm->LastPopped()->Inspect().find("Index out of bounds") != std::string::npos);
+}
+
+TEST_CASE("VM yield builtins")
+{
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let i = 0; yield(); i = i + 1; wait(3); i + 1;", "")));
+	REQUIRE(vm->RunFor(1000) == VmStatus::Yielded);
+	REQUIRE(vm->WaitTicks() == 0);
+	REQUIRE(vm->RunFor(1000) == VmStatus::Yielded);
+	REQUIRE(vm->WaitTicks() == 3);
+	REQUIRE(vm->RunFor(1000) == VmStatus::Completed);
+	REQUIRE(TestConstant(2, vm->LastPopped()));
+}
+
+TEST_CASE("VM suspends on host operations")
+{
+	RogueSyntax syn;
+	std::promise<HostResult> promise;
+	auto future = promise.get_future().share();
+	syn.RegisterBuiltIn("load", [future](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		return factory->New<PendingObj>(future);
+	});
+	auto vm = syn.MakeVM(syn.Link(syn.Compile("let a = load(); let b = load(); a + b;", "")));
+
+	REQUIRE(vm->RunFor(1000) == VmStatus::Suspended);
+	REQUIRE_FALSE(vm->PendingReady());
+	//nothing runs until the host resumes it
+	REQUIRE(vm->RunFor(1000) == VmStatus::Suspended);
+
+	promise.set_value([](const ObjectFactory* factory) -> IObject* { return factory->New<IntegerObj>(40); });
+	REQUIRE(vm->PendingReady());
+	vm->ResumePending();
+	REQUIRE(vm->RunFor(1000) == VmStatus::Suspended);
+
+	ObjectStore store;
+	vm->Resume(store.Factory()->New<IntegerObj>(2));
+	REQUIRE(vm->RunFor(1000) == VmStatus::Completed);
+	REQUIRE(TestConstant(42, vm->LastPopped()));
+	REQUIRE_THROWS(vm->Resume(NullObj::NULL_OBJ_REF));
+
+	//a spawned task has no host to resume it, the pool waits for the operation
+	auto spawner = syn.MakeVM(syn.Link(syn.Compile("await(spawn(fn() { load() + 1 }));", "")));
+	spawner->Run();
+	REQUIRE(TestConstant(41, spawner->LastPopped()));
+}
+
+TEST_CASE("Scheduler round robin")
+{
+	RogueSyntax syn;
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let i = 0; while (i < 5) { i = i + 1; yield(); }; i;", "")));
+	auto scheduler = syn.MakeScheduler(code);
+
+	std::vector<VmScheduler::TaskId> tasks;
+	for (int i = 0; i < 2000; i++)
+	{
+		tasks.push_back(scheduler->Spawn());
+	}
+
+	for (int tick = 0; tick < 5; tick++)
+	{
+		REQUIRE(scheduler->Tick() == tasks.size());
+		REQUIRE_FALSE(scheduler->Done());
+	}
+	scheduler->Tick();
+	REQUIRE(scheduler->Done());
+
+	for (auto id : tasks)
+	{
+		REQUIRE(scheduler->Info(id).State == TaskState::Completed);
+		REQUIRE(scheduler->Info(id).Slices == 6);
+		REQUIRE(TestConstant(5, scheduler->Vm(id)->LastPopped()));
+	}
+	//idle tasks stay small
+	REQUIRE(scheduler->Vm(tasks[0])->StackCapacity() <= 64);
+	REQUIRE(scheduler->Vm(tasks[0])->FrameCapacity() <= 8);
+}
+
+TEST_CASE("Scheduler wait")
+{
+	RogueSyntax syn;
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let n = 0; while (n < 3) { n = n + 1; wait(2); }; n;", "")));
+	auto scheduler = syn.MakeScheduler(code);
+	auto id = scheduler->Spawn();
+
+	std::vector<size_t> turns;
+	while (!scheduler->Done() && turns.size() < 20)
+	{
+		turns.push_back(scheduler->Tick());
+	}
+	REQUIRE(turns == std::vector<size_t>{ 1, 0, 1, 0, 1, 0, 1 });
+	REQUIRE(TestConstant(3, scheduler->Vm(id)->LastPopped()));
+}
+
+TEST_CASE("Scheduler priorities and time slices")
+{
+	RogueSyntax syn;
+	syn.RegisterBuiltIn("spin", [](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		return NullObj::NULL_OBJ_REF;
+	});
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("spin(); 1;", "")));
+	auto scheduler = syn.MakeScheduler(code);
+	auto low = scheduler->Spawn(0);
+	auto high = scheduler->Spawn(5);
+
+	//the slice runs out after the first turn, the higher priority goes first
+	REQUIRE(scheduler->Tick(std::chrono::milliseconds(1)) == 1);
+	REQUIRE(scheduler->Info(high).State == TaskState::Completed);
+	REQUIRE(scheduler->Info(low).State == TaskState::Runnable);
+	REQUIRE(scheduler->Info(high).Time >= std::chrono::milliseconds(5));
+
+	REQUIRE(scheduler->Tick(std::chrono::milliseconds(1)) == 1);
+	REQUIRE(scheduler->Info(low).State == TaskState::Completed);
+	REQUIRE(scheduler->Done());
+}
+
+TEST_CASE("Scheduler resumes suspended tasks")
+{
+	RogueSyntax syn;
+	std::vector<std::promise<HostResult>> promises(64);
+	std::atomic<size_t> started = 0;
+	syn.RegisterBuiltIn("lookup", [&](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+	{
+		return factory->New<PendingObj>(promises[started++].get_future().share());
+	});
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let v = lookup(); v * 2;", "")));
+	auto scheduler = syn.MakeScheduler(code);
+
+	std::vector<VmScheduler::TaskId> tasks;
+	for (size_t i = 0; i < promises.size(); i++)
+	{
+		tasks.push_back(scheduler->Spawn());
+	}
+
+	REQUIRE(scheduler->Tick() == tasks.size());
+	REQUIRE(scheduler->SuspendedCount() == tasks.size());
+	REQUIRE(scheduler->Tick() == 0);
+	REQUIRE_FALSE(scheduler->Done());
+
+	//finish the operations on other threads, the tasks come back in the order they completed
+	std::vector<std::thread> hosts;
+	for (size_t i = 0; i < promises.size(); i++)
+	{
+		hosts.emplace_back([&promises, i]()
+		{
+			promises[i].set_value([i](const ObjectFactory* factory) -> IObject* { return factory->New<IntegerObj>(static_cast<int>(i)); });
+		});
+	}
+	for (auto& host : hosts)
+	{
+		host.join();
+	}
+
+	scheduler->Tick();
+	REQUIRE(scheduler->Done());
+	int total = 0;
+	for (auto id : tasks)
+	{
+		REQUIRE(scheduler->Info(id).State == TaskState::Completed);
+		total += dynamic_cast<const IntegerObj*>(scheduler->Vm(id)->LastPopped())->Value;
+	}
+	REQUIRE(total == 63 * 64);
+}
+
+TEST_CASE("Scheduler isolates errors")
+{
+	RogueSyntax syn;
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("yield(); len(1, 2);", "")));
+	auto scheduler = syn.MakeScheduler(code);
+	auto id = scheduler->Spawn();
+	scheduler->Tick();
+	scheduler->Tick();
+	REQUIRE(scheduler->Info(id).State == TaskState::Error);
+	REQUIRE(scheduler->Info(id).Error.find("wrong number of arguments") != std::string::npos);
+}
+
+//the ide examples, returning their message instead of printing it
+static const std::vector<std::pair<std::string, std::string>> s_examplePrograms = {
+	{ "let factorial = fn(x) { if (x == 0) { return 1; } else { return x * factorial(x - 1); } }; let number = 10; let result = factorial(number); let printResult = fn(result) { let output = \"The factorial of \" + number + \" is \" + result; return output; }; printResult(result);",
+		"The factorial of 10 is 3628800" },
+	{ "let bubbleSort = fn(arr) { let length = len(arr); let i = 0; while (i < length) { let j = 0; while (j < length - i - 1) { if (arr[j] > arr[j + 1]) { let temp = arr[j]; arr[j] = arr[j + 1]; arr[j + 1] = temp; } j = j + 1; } i = i + 1; } return arr; }; bubbleSort([64, 34, 25, 12, 22, 11, 90]);",
+		"[11, 12, 22, 25, 34, 64, 90]" },
+	{ "let fibonacci = fn(n) { let fib = [0, 1]; let i = 2; while (i < n) { let next = fib[i - 1] + fib[i - 2]; fib = push(fib, next); i = i + 1; } return fib; }; let fibs = fibonacci(20); fibs[19];",
+		"4181" },
+	{ "let isPrime = fn(n) { if (n < 2) { return false; } let i = 2; while (i * i <= n) { if (n % i == 0) { return false; } i = i + 1; } return true; }; let findPrimes = fn(limit) { let primes = []; let num = 2; while (num <= limit) { if (isPrime(num)) { primes = push(primes, num); } num = num + 1; } return primes; }; findPrimes(50);",
+		"[2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47]" },
+};
+
+//runs every example the given number of times on each thread, returns the number of runs that gave a wrong result
+static size_t RunExamplesOnThreads(RogueSyntax& syn, const std::vector<std::shared_ptr<const ByteCode>>& programs, size_t threads, size_t iterations)
+{
+	std::atomic<size_t> failures = 0;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&]()
+		{
+			for (size_t i = 0; i < iterations; i++)
+			{
+				for (size_t p = 0; p < programs.size(); p++)
+				{
+					auto vm = syn.MakeIsolatedVM(programs[p]);
+					vm->Run();
+					if (vm->LastPopped() == nullptr || vm->LastPopped()->Inspect() != s_examplePrograms[p].second)
+					{
+						failures++;
+					}
+				}
+			}
+		});
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	return failures;
+}
+
+static std::vector<std::shared_ptr<const ByteCode>> CompileExamples(RogueSyntax& syn)
+{
+	std::vector<std::shared_ptr<const ByteCode>> programs;
+	for (auto& [input, expected] : s_examplePrograms)
+	{
+		programs.push_back(std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, ""))));
+	}
+	return programs;
+}
+
+TEST_CASE("VM threads share bytecode")
+{
+	RogueSyntax syn;
+	auto programs = CompileExamples(syn);
+	auto threads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+
+	//builtins registered while other threads run are picked up on their next run
+	std::thread registrar([&syn]()
+	{
+		for (int i = 0; i < 100; i++)
+		{
+			syn.RegisterBuiltIn(std::format("extra{}", i % 10), [](const ObjectFactory* factory, const std::vector<const IObject*>& args) -> IObject*
+			{
+				return NullObj::NULL_OBJ_REF;
+			});
+		}
+	});
+	REQUIRE(RunExamplesOnThreads(syn, programs, threads, 25) == 0);
+	registrar.join();
+
+	//shared store vms are safe too, just contended
+	std::vector<std::thread> workers;
+	std::atomic<size_t> failures = 0;
+	for (size_t t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&]()
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				auto vm = syn.MakeVM(programs[i % programs.size()]);
+				vm->Run();
+				if (vm->LastPopped()->Inspect() != s_examplePrograms[i % programs.size()].second)
+				{
+					failures++;
+				}
+			}
+		});
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	REQUIRE(failures == 0);
+}
+
+TEST_CASE("Parallel builtins")
+{
+	//every case runs on the worker pool and sequentially on the calling vm
+	auto threshold = GENERATE(size_t(0), size_t(PARALLEL_THRESHOLD));
+	auto [input, expected] = GENERATE(table<std::string, std::string>({
+		{ "pmap([1, 2, 3, 4, 5], fn(x) { x * x });", "[1, 4, 9, 16, 25]" },
+		{ "pmap([], fn(x) { x });", "[]" },
+		{ "pmap([1, 2], fn(x) { [x, x] });", "[[1, 1], [2, 2]]" },
+		{ "let k = 3; pmap([1, 2, 3], fn(x) { x * k });", "[3, 6, 9]" },
+		{ "let adder = fn(n) { fn(x) { x + n } }; pmap([1, 2, 3], adder(10));", "[11, 12, 13]" },
+		{ "pmap([\"a\", \"bb\"], len);", "[1, 2]" },
+		{ "pfilter([1, 2, 3, 4, 5, 6], fn(x) { x % 2 == 0 });", "[2, 4, 6]" },
+		{ "pfilter([1, 2, 3], fn(x) { false });", "[]" },
+		{ "preduce([1, 2, 3, 4], fn(a, b) { a + b });", "10" },
+		{ "preduce([1, 2, 3], fn(a, b) { a + b }, 10);", "16" },
+		{ "preduce([], fn(a, b) { a + b }, 10);", "10" },
+		{ "preduce([], fn(a, b) { a + b });", "null" },
+		{ "preduce([\"a\", \"b\", \"c\", \"d\"], fn(a, b) { a + b });", "abcd" },
+		{ "pmap([[1, 2], [3, 4]], fn(a) { preduce(a, fn(x, y) { x + y }) });", "[3, 7]" },
+		{ "let build = fn(n) { let a = []; let i = 0; while (i < n) { a = push(a, i); i = i + 1; } a }; let arr = build(3000); preduce(pmap(arr, fn(x) { x * 2 }), fn(a, b) { a + b });", "8997000" },
+		{ "let build = fn(n) { let a = []; let i = 0; while (i < n) { a = push(a, i); i = i + 1; } a }; len(pfilter(build(3000), fn(x) { x % 3 == 0 }));", "1000" },
+	}));
+
+	CAPTURE(input, threshold);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, ""))));
+	vm->SetParallelThreshold(threshold);
+	REQUIRE(vm->RunFor(std::numeric_limits<uint64_t>::max()) == VmStatus::Completed);
+	REQUIRE(vm->LastPopped()->Inspect() == expected);
+}
+
+TEST_CASE("Parallel builtins keep order")
+{
+	RogueSyntax syn;
+	auto code = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let build = fn(n) { let a = []; let i = 0; while (i < n) { a = push(a, i); i = i + 1; } a }; pmap(build(5000), fn(x) { x + 1 });", "")));
+	auto vm = syn.MakeVM(code);
+	vm->SetNurserySize(4096);
+	vm->Run();
+
+	std::string expected = "[1";
+	for (int i = 2; i <= 5000; i++)
+	{
+		expected += std::format(", {}", i);
+	}
+	expected += "]";
+	REQUIRE(vm->Status() == VmStatus::Completed);
+	REQUIRE(vm->LastPopped()->Inspect() == expected);
+}
+
+TEST_CASE("Parallel builtins reject global writes")
+{
+	auto threshold = GENERATE(size_t(0), size_t(PARALLEL_THRESHOLD));
+	auto input = GENERATE(
+		std::string("let total = 0; pmap([1, 2, 3], fn(x) { total = total + x; x });"),
+		std::string("let seen = [0]; pfilter([1, 2, 3], fn(x) { seen[0] = x; true });"),
+		std::string("let prev = 0; preduce([1, 2, 3], fn(a, b) { prev = b; a + b });")
+	);
+
+	CAPTURE(input, threshold);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, ""))));
+	vm->SetParallelThreshold(threshold);
+	REQUIRE(vm->RunFor(std::numeric_limits<uint64_t>::max()) == VmStatus::Error);
+	REQUIRE(vm->LastPopped()->Inspect().find("Cannot assign a global inside a parallel callback") != std::string::npos);
+}
+
+TEST_CASE("Tasks and channels")
+{
+	auto [input, expected] = GENERATE(table<std::string, std::string>({
+		{ "let t = spawn(fn(a, b) { a + b }, 2, 3); await(t);", "5" },
+		{ "let t = spawn(fn() { let a = 1; }); await(t);", "null" },
+		{ "let k = 10; await(spawn(fn(x) { x * k }, 4));", "40" },
+		{ "await(spawn(fn() { await(spawn(fn(x) { x + 1 }, 41)) }));", "42" },
+		{ "let t = spawn(fn() { let k = 3; fn(x) { x * k } }); let f = await(t); f(5);", "15" },
+		{ "let ts = []; let i = 0; while (i < 50) { ts = push(ts, spawn(fn(x) { x * x }, i)); i = i + 1; } let total = 0; i = 0; while (i < 50) { total = total + await(ts[i]); i = i + 1; } total;", "40425" },
+		{ "let ch = channel(1); spawn(fn(c) { send(c, [1, 2]); send(c, \"x\"); }, ch); [recv(ch), recv(ch)];", "[[1, 2], x]" },
+		{ "let ch = channel(); spawn(fn(c) { let k = 5; send(c, fn(x) { x * k }); }, ch); let f = recv(ch); f(3);", "15" },
+		{ "let ch = channel(2); close(ch); recv(ch);", "null" },
+		{ "let ch = channel(4); spawn(fn(c) { let i = 1; while (i <= 100) { send(c, i); i = i + 1; } close(c); }, ch); let consumer = spawn(fn(c) { let total = 0; let v = recv(c); while (v) { total = total + v; v = recv(c); } total }, ch); await(consumer);", "5050" },
+		{ "let work = channel(2); let done = channel(2); let worker = fn(w, d) { let v = recv(w); while (v) { send(d, v * 2); v = recv(w); } }; spawn(worker, work, done); spawn(worker, work, done); spawn(fn(w) { let i = 1; while (i <= 20) { send(w, i); i = i + 1; } close(w); }, work); let total = 0; let n = 0; while (n < 20) { total = total + recv(done); n = n + 1; } total;", "420" },
+	}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, ""))));
+	REQUIRE(vm->RunFor(std::numeric_limits<uint64_t>::max()) == VmStatus::Completed);
+	REQUIRE(vm->LastPopped()->Inspect() == expected);
+}
+
+TEST_CASE("Task errors")
+{
+	auto [input, expected] = GENERATE(table<std::string, std::string>({
+		{ "await(spawn(fn() { [1][5] }));", "awaited task failed" },
+		{ "let g = 1; await(spawn(fn() { g = 2; }));", "Cannot assign a global inside a spawned task" },
+		{ "spawn(fn(x) { x });", "Expected 1 arguments but got 0" },
+		{ "spawn(1);", "first argument to `spawn` must be a function" },
+		{ "let ch = channel(1); close(ch); send(ch, 1);", "send on a closed channel" },
+		{ "channel(0);", "argument to `channel` must be a positive INTEGER" },
+	}));
+
+	CAPTURE(input);
+	RogueSyntax syn;
+	auto vm = syn.MakeVM(std::make_shared<const ByteCode>(syn.Link(syn.Compile(input, ""))));
+	std::string error;
+	try
+	{
+		vm->Run();
+	}
+	catch (const std::exception& ex)
+	{
+		error = ex.what();
+	}
+	REQUIRE(error.find(expected) != std::string::npos);
+}
+
+TEST_CASE("VM pool reuse")
+{
+	RogueSyntax syn;
+	auto sum = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let x = 0; for (let i = 0; i < 10; i = i + 1) { x = x + i; }; x;", "")));
+	auto text = std::make_shared<const ByteCode>(syn.Link(syn.Compile("let s = \"a\" + \"b\"; s;", "")));
+	auto pool = syn.MakeVmPool(2);
+
+	auto first = pool->Acquire(sum);
+	first->Run();
+	REQUIRE(TestConstant(45, first->LastPopped()));
+	pool->Release(first);
+	REQUIRE(pool->IdleCount(sum) == 1);
+
+	auto second = pool->Acquire(sum);
+	REQUIRE(second == first);
+	REQUIRE(pool->IdleCount() == 0);
+	second->Run();
+	REQUIRE(TestConstant(45, second->LastPopped()));
+
+	auto other = pool->Acquire(text);
+	REQUIRE(other != second);
+	other->Run();
+	REQUIRE(other->LastPopped()->Inspect() == "ab");
+
+	//only keeps up to the max idle per program
+	auto third = pool->Acquire(sum);
+	auto fourth = pool->Acquire(sum);
+	pool->Release(second);
+	pool->Release(third);
+	pool->Release(fourth);
+	pool->Release(other);
+	REQUIRE(pool->IdleCount(sum) == 2);
+	REQUIRE(pool->IdleCount(text) == 1);
+}
+
 #ifdef DO_BENCHMARK
 
+TEST_CASE("BENCHMARK VM thread scaling")
+{
+	RogueSyntax syn;
+	auto programs = CompileExamples(syn);
+	const size_t iterations = 200;
+
+	auto measure = [&](size_t threads)
+	{
+		auto start = std::chrono::steady_clock::now();
+		REQUIRE(RunExamplesOnThreads(syn, programs, threads, iterations) == 0);
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return (threads * iterations * programs.size()) / seconds;
+	};
+
+	auto single = measure(1);
+	for (size_t threads = 2; threads <= std::thread::hardware_concurrency(); threads *= 2)
+	{
+		auto throughput = measure(threads);
+		std::cout << std::format("{} threads: {:.0f} runs/s, {:.2f}x\n", threads, throughput, throughput / single);
+	}
+}
+
 TEST_CASE("BENCHMARK VM")
 {
 	auto input = "let x = 0; for (let i = 0; i < 100; i = i + 1) { x = x + i; }; x;";
@@ -139,14 +139,14 @@ struct BooleanLiteral : IExpression
 
 struct HashLiteral : IExpression
 {
-	HashLiteral(const RSToken& token, const std::map<IExpression*, IExpression*>& pairs);
+	HashLiteral(const RSToken& token, const std::vector<std::pair<IExpression*, IExpression*>>& pairs);
 	virtual ~HashLiteral() = default;
 	std::string ToString() const override;
 
 	void Eval(Evaluator* evaluator) const;
 	void Compile(Compiler* compiler) const;
 	
-	std::map<IExpression*, IExpression*> Elements;
+	std::vector<std::pair<IExpression*, IExpression*>> Elements;
 };
 
 struct PrefixExpression : IExpression
@@ -215,6 +215,8 @@ struct FunctionLiteral : IExpression
 	std::string Name;
 	std::vector<IExpression*> Parameters;
 	const IStatement* Body;
+	//fn* - calling it returns a generator that runs the body lazily
+	bool IsGenerator = false;
 };
 
 struct CallExpression : IExpression
@@ -278,6 +280,34 @@ struct ForStatement : IStatement
 	const IStatement* Action;
 };
 
+//for (name in iterable) { action }
+struct ForInStatement : IStatement
+{
+	ForInStatement(const RSToken& token, const IExpression* name, const IExpression* iterable, const IStatement* action);
+	virtual ~ForInStatement() = default;
+	std::string ToString() const override;
+
+	void Eval(Evaluator* evaluator) const;
+	void Compile(Compiler* compiler) const;
+
+	const IExpression* Name;
+	const IExpression* Iterable;
+	const IStatement* Action;
+};
+
+//hands a value to whoever iterates the generator and suspends it until the next value is wanted
+struct YieldExpression : IExpression
+{
+	YieldExpression(const RSToken& token, const IExpression* value);
+	virtual ~YieldExpression() = default;
+	std::string ToString() const override;
+
+	void Eval(Evaluator* evaluator) const;
+	void Compile(Compiler* compiler) const;
+
+	const IExpression* Value;
+};
+
 struct StringLiteral : IExpression
 {
 	StringLiteral(const RSToken& token, const std::string& value);
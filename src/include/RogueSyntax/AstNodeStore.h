@@ -17,7 +17,7 @@ public:
 	NullLiteral* New_NullLiteral(const RSToken& token);
 	IntegerLiteral* New_IntegerLiteral(const RSToken& token, const int value);
 	BooleanLiteral* New_BooleanLiteral(const RSToken& token, const bool value);
-	HashLiteral* New_HashLiteral(const RSToken& token, const std::map<IExpression*, IExpression*>& pairs);
+	HashLiteral* New_HashLiteral(const RSToken& token, const std::vector<std::pair<IExpression*, IExpression*>>& pairs);
 	InfixExpression* New_InfixExpression(const RSToken& token, const IExpression* left, const std::string& op, const IExpression* right);
 	PrefixExpression* New_PrefixExpression(const RSToken& token, const std::string& op, const IExpression* right);
 	BlockStatement* New_BlockStatement(const RSToken& token, const std::vector<IStatement*>& statements);
@@ -28,6 +28,8 @@ public:
 	BreakStatement* New_BreakStatement(const RSToken& token);
 	ContinueStatement* New_ContinueStatement(const RSToken& token);
 	ForStatement* New_ForStatement(const RSToken& token, const IStatement* init, const IExpression* condition, const IStatement* post, const IStatement* action);
+	ForInStatement* New_ForInStatement(const RSToken& token, const IExpression* name, const IExpression* iterable, const IStatement* action);
+	YieldExpression* New_YieldExpression(const RSToken& token, const IExpression* value);
 	StringLiteral* New_StringLiteral(const RSToken& token, const std::string& value);
 	DecimalLiteral* New_DecimalLiteral(const RSToken& token, const float value);
 	ArrayLiteral* New_ArrayLiteral(const RSToken& token, const std::vector<IExpression*>& elements);
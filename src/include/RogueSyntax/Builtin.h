@@ -4,29 +4,35 @@
 #include "Token.h"
 #include "IObject.h"
 
+//registration and lookup are thread safe, lookups work on an immutable snapshot of the table
 class BuiltIn
 {
 public:
+	typedef std::vector<std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)>> FunctionTable;
 
 	BuiltIn(const std::shared_ptr<ObjectFactory> factory);
 	std::function<IObject*(const std::vector<const IObject*>& args)> GetBuiltInFunction(const std::string& name);
 	std::function<IObject*(const std::vector<const IObject*>& args)> GetBuiltInFunction(const int idx);
-	void RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func);
+	//allocates results with the given factory, the vm passes its own so results land in its nursery
+	std::function<IObject*(const std::vector<const IObject*>& args)> GetBuiltInFunction(const int idx, const ObjectFactory* factory);
+	//a pure builtin only reads its arguments and returns a result, the optimizer may call it fewer times than the program does
+	void RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func, bool pure = false);
 
 	std::function<IObject* (const std::vector<const IObject*>& args)> Caller(std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func);
 
-	bool IsBuiltIn(const std::string& name) const { return  std::find(_builtinNames.begin(), _builtinNames.end(), name) != _builtinNames.end(); };
-	int BuiltInIdx(const std::string& name) const
-	{
-		auto it = std::find(_builtinNames.begin(), _builtinNames.end(), name);
-		if (it != _builtinNames.end())
-		{
-			return std::distance(_builtinNames.begin(), it);
-		}
-		return -1;
-	};
+	//snapshot of the registered functions, indexed like the names - later registrations do not change it
+	std::shared_ptr<const FunctionTable> Functions() const;
 
-	const std::vector<std::string>& GetBuiltInNames() const { return _builtinNames; };
+	bool IsBuiltIn(const std::string& name) const;
+	int BuiltInIdx(const std::string& name) const;
+	std::vector<std::string> GetBuiltInNames() const;
+	bool IsPure(const int idx) const;
+	//type tag (IObject::Type) of every result of the standard builtin, 0 when it varies or the name was registered again
+	std::size_t ReturnType(const int idx) const;
+	//leading arguments the standard builtin neither keeps nor returns, 0 when the name was registered again
+	std::size_t BorrowedArgs(const int idx) const;
+	//the standard len, an array index below its result is in bounds - false when the name was registered again
+	bool IsLength(const int idx) const;
 
 	//Built-in functions
 	IObject* Len(const ObjectFactory* factory, const std::vector<const IObject*>& args);
@@ -35,9 +41,47 @@ public:
 	IObject* Rest(const ObjectFactory* factory, const std::vector<const IObject*>& args);
 	IObject* Push(const ObjectFactory* factory, const std::vector<const IObject*>& args);
 	IObject* PrintLine(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Yield(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Wait(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//range(end), range(start, end) or range(start, end, step)
+	IObject* Range(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//typed arrays - intArray(x) and decimalArray(x) take an array, a range, a length or the other typed kind
+	IObject* IntArray(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* DecimalArray(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* ToArray(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Sum(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Min(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Max(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Dot(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Scale(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//sort(arr) orders numbers or strings natively, sort(arr, cmp) calls cmp(a, b) - true or a negative integer puts a first
+	IObject* Sort(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//callbacks run on the calling vm through RogueVM::Call
+	IObject* Map(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Filter(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Reduce(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* IndexOf(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Reverse(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//run the closure over the array on the vm's worker pool, the closure must not assign globals
+	IObject* PMap(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* PFilter(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//the closure has to be associative, chunks are folded in parallel and then folded together in order
+	IObject* PReduce(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	//tasks and channels - blocking calls park a spawned task and block the thread of any other vm
+	IObject* Spawn(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Await(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* MakeChannel(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Send(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Recv(const ObjectFactory* factory, const std::vector<const IObject*>& args);
+	IObject* Close(const ObjectFactory* factory, const std::vector<const IObject*>& args);
 
 private:
+	mutable std::mutex _lock;
 	std::vector<std::string> _builtinNames;
-	std::vector<std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)>> _builtins;
+	std::vector<bool> _pure;
+	std::vector<std::size_t> _returnTypes;
+	std::vector<std::size_t> _borrowedArgs;
+	std::vector<bool> _length;
+	std::shared_ptr<const FunctionTable> _builtins;
 	std::shared_ptr<ObjectFactory> _factory;
 };
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "StandardLib.h"
+
+struct CompilerOptions
+{
+	//replace calls to small, non-recursive, let-bound functions with their body
+	bool EnableInlining = true;
+	//max number of ast nodes in a function body that can be inlined
+	uint32_t InlineThreshold = 24;
+	//lift every unit to the mid-level ir and run the pass pipeline before emitting its bytecode
+	bool EnableIrPasses = true;
+	//check the ir after lifting and after every pass, a broken pass throws instead of emitting bad code
+	bool VerifyIr = false;
+	//keep the text form of the ir of every unit, see Compiler::IrDump
+	bool DumpIr = false;
+	//evaluate operators on literals and on lets that are never reassigned at compile time
+	bool EnableConstantFolding = true;
+	//drop unreachable code, branches on literal conditions, unused lets and unused pure values
+	bool EnableDeadCodeElimination = true;
+	//index arrays without the bounds check inside `while (j < len(arr))` loops that never store to j or arr before the index
+	bool EnableBoundsCheckElimination = true;
+	//compute operators and pure builtin calls whose operands a loop never changes once before the loop, instead of in its condition
+	bool EnableLoopInvariantCodeMotion = true;
+	//compute an expression a block repeats with the same operands once and load the stored result for the repeats
+	bool EnableCommonSubexpressionElimination = true;
+	//turn integer multiplies, and divides and remainders of values that are never negative, by powers of two into shifts and masks
+	bool EnableStrengthReduction = true;
+	//infer the types of values and variables, emit integer and string opcodes that skip the type dispatch where operands are proven
+	bool EnableTypeSpecialization = true;
+	//allocate array, hash and closure literals that never outlive their function's frame in a region released when it returns
+	bool EnableEscapeAnalysis = true;
+	//let locals of a function that are never live at the same time share a slot, so calls reserve smaller frames
+	bool EnableSlotReuse = true;
+	//rewrite the finished bytecode before it is linked, thread jumps to jumps, keep stored values that are loaded straight back
+	//on the stack and drop values that are pushed only to be popped
+	bool EnablePeephole = true;
+
+	static CompilerOptions Unoptimized()
+	{
+		CompilerOptions options;
+		options.EnableInlining = false;
+		options.EnableIrPasses = false;
+		options.EnableConstantFolding = false;
+		options.EnableDeadCodeElimination = false;
+		options.EnableBoundsCheckElimination = false;
+		options.EnableLoopInvariantCodeMotion = false;
+		options.EnableCommonSubexpressionElimination = false;
+		options.EnableStrengthReduction = false;
+		options.EnableTypeSpecialization = false;
+		options.EnableEscapeAnalysis = false;
+		options.EnableSlotReuse = false;
+		options.EnablePeephole = false;
+		return options;
+	}
+};
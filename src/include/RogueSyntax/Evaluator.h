@@ -42,6 +42,8 @@ public:
 	virtual void NodeEval(const NullLiteral* null) = 0;
 	virtual void NodeEval(const WhileStatement* whileExp) = 0;
 	virtual void NodeEval(const ForStatement* forExp) = 0;
+	virtual void NodeEval(const ForInStatement* forIn) = 0;
+	virtual void NodeEval(const YieldExpression* yield) = 0;
 	virtual void NodeEval(const ContinueStatement* cont) = 0;
 	virtual void NodeEval(const BreakStatement* brk) = 0;
 
@@ -64,11 +66,15 @@ protected:
 
 	const IObject* EvalInfixExpression(const uint32_t env, const RSToken& op, const IObject* left, const IObject* right) const;
 	const IObject* EvalIndexExpression(const uint32_t env, const RSToken& op, const IObject* operand, const IObject* index) const;
+	//for-in over an array or a range
+	size_t IterationCount(const IObject* iterable) const;
+	const IObject* IterationElement(const IObject* iterable, size_t idx) const;
 
 	const IObject* EvalNullInfixExpression(const uint32_t env, const RSToken& op, const IObject* const left, const IObject* const right) const;
 	const IObject* EvalIntegerInfixExpression(const uint32_t env, const RSToken& op, const IntegerObj* const left, const IntegerObj* const right) const;
 	const IObject* EvalBooleanInfixExpression(const uint32_t env, const RSToken& op, const BooleanObj* const left, const BooleanObj* const right) const;
 	const IObject* EvalDecimalInfixExpression(const uint32_t env, const RSToken& optor, const DecimalObj* const left, const DecimalObj* const right) const;
+	const IObject* EvalTypedArrayInfixExpression(const uint32_t env, const RSToken& optor, const IObject* const left, const IObject* const right) const;
 	const IObject* EvalStringInfixExpression(const uint32_t env, const RSToken& optor, const StringObj* const left, const StringObj* const right) const;
 
 	const IObject* EvalAsBoolean(const uint32_t env, const RSToken& context, const IObject* const obj) const;
@@ -0,0 +1,120 @@
+#pragma once
+#include "StandardLib.h"
+
+class RogueVM;
+class IObject;
+class ObjectStore;
+class ObjectFactory;
+class GreenTask;
+
+//instruction budget a task runs before it goes back on the pool queue
+#define TASK_SLICE_BUDGET 10000
+//tasks start small, the nursery and stacks grow when a script needs more
+#define TASK_NURSERY_SIZE (4 * 1024)
+#define CHANNEL_CAPACITY 16
+
+//every unfinished task started from one host vm, holds parked tasks that nothing else references
+//tasks read the host's globals and code so they must not outlive it, the host cancels the group when it is
+//destroyed or reset and waits until every task stopped at its next slice
+class TaskGroup
+{
+public:
+	void Add(const std::shared_ptr<GreenTask>& task);
+	void Remove(GreenTask* task);
+	void Cancel();
+	bool Cancelled() const { return _cancelled; };
+
+private:
+	std::atomic<bool> _cancelled = false;
+	std::mutex _lock;
+	std::unordered_map<GreenTask*, std::shared_ptr<GreenTask>> _live;
+};
+
+//a closure running on its own vm, run in slices on the shared work-stealing pool
+//a task that has to wait parks, whoever lets it continue wakes it and it goes back on the queue
+//tasks keep running when their handles are dropped
+class GreenTask : public std::enable_shared_from_this<GreenTask>
+{
+public:
+	enum class State
+	{
+		Queued,
+		Running,
+		Parked,
+		Done,
+	};
+
+	GreenTask(const std::shared_ptr<RogueVM>& vm, const std::shared_ptr<TaskGroup>& group);
+	~GreenTask();
+
+	void Schedule();
+	//a parked task goes back on the queue, a running one tries again after its slice
+	void Wake();
+
+	//true when the task finished, otherwise the waiter is woken once it does
+	//without a waiter the calling thread blocks until the task finished
+	bool Join(const std::shared_ptr<GreenTask>& waiter);
+
+	State GetState() const;
+	//valid once done, null when the task failed
+	const IObject* Result() const { return _result; };
+	const std::string& Error() const { return _error; };
+	//the result is a copy that lives here, whoever keeps the result has to keep the store alive
+	const std::shared_ptr<ObjectStore>& ResultStore() const { return _resultStore; };
+
+private:
+	static void RunSlice(const std::shared_ptr<GreenTask>& task);
+	void Finish(const IObject* result, const std::string& error);
+
+	std::shared_ptr<RogueVM> _vm;
+	std::shared_ptr<TaskGroup> _group;
+
+	mutable std::mutex _lock;
+	std::condition_variable _finished;
+	State _state = State::Queued;
+	bool _notified = false;
+	const IObject* _result = nullptr;
+	std::shared_ptr<ObjectStore> _resultStore;
+	std::string _error;
+	std::vector<std::weak_ptr<GreenTask>> _joiners;
+};
+
+//bounded fifo between vms on any threads
+//values are deep copied into the channel's own store on send so they do not depend on the sender's heap
+class Channel
+{
+public:
+	Channel(size_t capacity);
+	~Channel();
+
+	//true when the value was queued, otherwise the waiter is woken when there is room
+	//without a waiter the calling thread blocks until there is room, sending on a closed channel is an error
+	bool Send(const IObject* value, const std::shared_ptr<GreenTask>& waiter);
+	//true when a value was taken, null once the channel is closed and drained
+	//otherwise the waiter is woken when a value arrives, without a waiter the calling thread blocks
+	bool Receive(const IObject*& value, const std::shared_ptr<GreenTask>& waiter);
+	void Close();
+
+	size_t Capacity() const { return _capacity; };
+	size_t Count() const;
+	bool Closed() const;
+	//received values live here, a vm holding them keeps the store alive
+	const std::shared_ptr<ObjectStore>& Store() const { return _store; };
+
+	//copy of obj and everything it references, including closure functions, allocated with factory
+	static IObject* Transfer(const IObject* obj, const ObjectFactory* factory);
+
+private:
+	static void WakeAll(std::vector<std::weak_ptr<GreenTask>>& waiters);
+
+	size_t _capacity;
+	std::shared_ptr<ObjectStore> _store;
+	std::shared_ptr<ObjectFactory> _factory;
+
+	mutable std::mutex _lock;
+	std::condition_variable _changed;
+	std::deque<const IObject*> _buffer;
+	bool _closed = false;
+	std::vector<std::weak_ptr<GreenTask>> _senders;
+	std::vector<std::weak_ptr<GreenTask>> _receivers;
+};
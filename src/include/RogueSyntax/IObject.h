@@ -8,6 +8,8 @@
 class BuiltIn;
 class Environment;
 class ObjectFactory;
+class GreenTask;
+class Channel;
 
 class IObject: public IUnquielyIdentifiable
 {
@@ -193,6 +195,33 @@ public:
 	std::vector<const IObject*> Elements;
 };
 
+//homogeneous arrays stored as one contiguous buffer, the simd kernels work on it directly
+class IntArrayObj : public IAssignableObject
+{
+public:
+	IntArrayObj(const std::vector<int32_t>& values) : Values(values) { SetUniqueId(this); }
+	IntArrayObj(std::vector<int32_t>&& values) : Values(std::move(values)) { SetUniqueId(this); }
+	virtual ~IntArrayObj() = default;
+
+	std::string Inspect() const override;
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+	const IObject* Set(const IObject* key, const IObject* value) override;
+	std::vector<int32_t> Values;
+};
+
+class DecimalArrayObj : public IAssignableObject
+{
+public:
+	DecimalArrayObj(const std::vector<float>& values) : Values(values) { SetUniqueId(this); }
+	DecimalArrayObj(std::vector<float>&& values) : Values(std::move(values)) { SetUniqueId(this); }
+	virtual ~DecimalArrayObj() = default;
+
+	std::string Inspect() const override;
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+	const IObject* Set(const IObject* key, const IObject* value) override;
+	std::vector<float> Values;
+};
+
 struct HashKey
 {
 	HashKey(std::size_t type, const std::string& key) : Type(type), Key(std::hash<std::string>{}(key)) {}
@@ -297,6 +326,79 @@ public:
 	const IObject* Value;
 };
 
+//returned by a builtin to hand control back to the host, the vm resumes after the call
+//a blocked builtin could not finish yet, the vm resumes by calling it again with the same arguments
+class YieldObj : public IObject
+{
+public:
+	YieldObj(int ticks, bool blocked = false) : Ticks(ticks), Blocked(blocked) { SetUniqueId(this); }
+	virtual ~YieldObj() = default;
+
+	std::string Inspect() const override
+	{
+		return Blocked ? "blocked" : std::format("yield({})", Ticks);
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	int Ticks;
+	bool Blocked;
+};
+
+//builds the value of a finished host operation, called on the thread running the vm with the vm's factory
+typedef std::function<IObject* (const ObjectFactory* factory)> HostResult;
+
+//returned by a builtin that started an operation on the host, the vm suspends until the host resumes it
+class PendingObj : public IObject
+{
+public:
+	PendingObj(const std::shared_future<HostResult>& future) : Future(future) { SetUniqueId(this); }
+	virtual ~PendingObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "pending";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	std::shared_future<HostResult> Future;
+};
+
+//handle to a spawned task, copies refer to the same task
+class TaskObj : public IObject
+{
+public:
+	TaskObj(const std::shared_ptr<GreenTask>& task) : Task(task) { SetUniqueId(this); }
+	virtual ~TaskObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "task";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	std::shared_ptr<GreenTask> Task;
+};
+
+//handle to a channel, copies refer to the same channel
+class ChannelObj : public IObject
+{
+public:
+	ChannelObj(const std::shared_ptr<Channel>& channel) : Value(channel) { SetUniqueId(this); }
+	virtual ~ChannelObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "channel";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	std::shared_ptr<Channel> Value;
+};
+
 class ErrorObj : public IObject
 {
 public:
@@ -357,6 +459,7 @@ public:
 	virtual ~BuiltInObj() = default;
 
 	std::function<IObject*(const std::vector<const IObject*>& args)> Resolve(std::shared_ptr<BuiltIn> externals) const;
+	std::function<IObject*(const std::vector<const IObject*>& args)> Resolve(std::shared_ptr<BuiltIn> externals, const ObjectFactory* factory) const;
 
 	std::string Inspect() const override
 	{
@@ -372,7 +475,7 @@ public:
 class FunctionCompiledObj : public IObject
 {
 public:
-	FunctionCompiledObj(const RSInstructions& instructions, int numLocals, int numParameters) : FuncInstructions(instructions), NumLocals(numLocals), NumParameters(numParameters) { SetUniqueId(this); FuncOffset = 0;
+	FunctionCompiledObj(const RSInstructions& instructions, int numLocals, int numParameters) : FuncInstructions(instructions), NumLocals(numLocals), NumParameters(numParameters) { SetUniqueId(this); FuncOffset = 0; MaxStackDepth = 0;
 	}
 	virtual ~FunctionCompiledObj() = default;
 
@@ -387,6 +490,7 @@ public:
 	int NumLocals;
 	int NumParameters;
 	int FuncOffset;
+	int MaxStackDepth;
 };
 
 class ClosureObj : public IObject
@@ -405,3 +509,100 @@ public:
 	const FunctionCompiledObj* Function;
 	std::vector<const IObject*> Frees;
 };
+
+//suspended call of a fn*, holds the locals and operands of its frame between resumes
+class GeneratorObj : public IObject
+{
+public:
+	enum class State
+	{
+		Created,
+		Suspended,
+		Running,
+		Done,
+	};
+
+	GeneratorObj(const ClosureObj* closure, const std::vector<const IObject*>& slots, int ip) : Closure(closure), Slots(slots), Ip(ip), Status(State::Created) { SetUniqueId(this); }
+	virtual ~GeneratorObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "generator";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	const ClosureObj* Closure;
+	std::vector<const IObject*> Slots;
+	int Ip;
+	State Status;
+};
+
+//integers from Start up to but not including End, values are computed on demand
+class RangeObj : public IObject
+{
+public:
+	RangeObj(int start, int end, int step) : Start(start), End(end), Step(step) { SetUniqueId(this); }
+	virtual ~RangeObj() = default;
+
+	std::string Inspect() const override
+	{
+		return std::format("range({}, {}, {})", Start, End, Step);
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	size_t Count() const
+	{
+		auto span = static_cast<int64_t>(End) - Start;
+		if (Step > 0 ? span <= 0 : span >= 0)
+		{
+			return 0;
+		}
+		return static_cast<size_t>((span + Step + (Step > 0 ? -1 : 1)) / Step);
+	}
+	int At(size_t idx) const { return static_cast<int>(Start + static_cast<int64_t>(idx) * Step); }
+
+	int Start;
+	int End;
+	int Step;
+};
+
+//counter of a for-in loop over a range
+class RangeIteratorObj : public IObject
+{
+public:
+	RangeIteratorObj(int64_t next, int64_t end, int64_t step) : Next(next), End(end), Step(step) { SetUniqueId(this); }
+	virtual ~RangeIteratorObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "iterator";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	bool Done() const { return Step > 0 ? Next >= End : Next <= End; }
+
+	int64_t Next;
+	int64_t End;
+	int64_t Step;
+};
+
+//position of a for-in loop in an array
+class ArrayIteratorObj : public IObject
+{
+public:
+	ArrayIteratorObj(const ArrayObj* array, size_t next) : Array(array), Next(next) { SetUniqueId(this); }
+	virtual ~ArrayIteratorObj() = default;
+
+	std::string Inspect() const override
+	{
+		return "iterator";
+	}
+
+	virtual IObject* Clone(const ObjectFactory* factory) const override;
+
+	const ArrayObj* Array;
+	size_t Next;
+};
@@ -8,6 +8,7 @@
 #include <string>
 
 #define NO_ID UINT_MAX
+#define ID_BLOCK_SIZE 1024
 
 class ITypeTag
 {
@@ -61,8 +62,16 @@ private:
 	template <typename T>
 	std::size_t GetNextId(T* thisObj) noexcept
 	{
+		//each thread reserves a block of ids so threads creating objects do not fight over the shared counter
 		static std::atomic<std::size_t> s_nextId = 0;
-		return s_nextId++;
+		thread_local std::size_t t_nextId = 0;
+		thread_local std::size_t t_lastId = 0;
+		if (t_nextId == t_lastId)
+		{
+			t_nextId = s_nextId.fetch_add(ID_BLOCK_SIZE, std::memory_order_relaxed);
+			t_lastId = t_nextId + ID_BLOCK_SIZE;
+		}
+		return t_nextId++;
 	};
 };
 
@@ -4,13 +4,31 @@
 #include "Identifiable.h"
 #include "IObject.h"
 
+class Nursery;
+
 class ObjectStore
 {
 public:
 	ObjectStore();
 	~ObjectStore();
 
+	//a store whose objects are carved out of one arena and released together with the store
+	static std::shared_ptr<ObjectStore> NewRegion(size_t initialSize = 64 * 1024);
+
+	template <typename T, typename... Args>
+	T* Make(Args&&... args)
+	{
+		//vms sharing a store may promote into it from different threads
+		std::lock_guard<std::mutex> lock(_lock);
+		std::shared_ptr<T> obj = _arena != nullptr
+			? std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(_arena.get()), std::forward<Args>(args)...)
+			: std::make_shared<T>(std::forward<Args>(args)...);
+		_store.emplace_back(obj);
+		return obj.get();
+	}
+
 	void Add(const std::shared_ptr<IObject>& obj);
+	size_t Count() const { std::lock_guard<std::mutex> lock(_lock); return _store.size(); }
 	std::shared_ptr<ObjectFactory> Factory() { return std::make_shared<ObjectFactory>(this); }
 
 	//static references
@@ -22,23 +40,152 @@ public:
 	static std::shared_ptr<BreakObj> BREAK_OBJ;
 
 private:
+	//declared before the store so the objects are destroyed before their memory
+	std::unique_ptr<std::pmr::monotonic_buffer_resource> _arena;
 	std::vector<std::shared_ptr<IObject>> _store;
+	mutable std::mutex _lock;
+};
+
+struct NurseryStats
+{
+	size_t MinorCollections = 0;
+	size_t Allocated = 0;
+	size_t Promoted = 0;
+	size_t Reclaimed = 0;
+	size_t BytesPromoted = 0;
+	size_t RememberedSetSize = 0;
+};
+
+//bump pointer allocator for short lived objects
+//objects that survive a minor collection are copied (promoted) into the object store
+class Nursery
+{
+public:
+	using Forwarder = std::function<const IObject* (const IObject*)>;
+
+	Nursery(const std::shared_ptr<ObjectFactory>& tenured, size_t size);
+	~Nursery();
+
+	template <typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		void* memory = Allocate(sizeof(T), alignof(T));
+		auto obj = new (memory) T(std::forward<Args>(args)...);
+		_objects.push_back(obj);
+		_stats.Allocated++;
+		return obj;
+	}
+
+	bool Enabled() const { return _size > 0; }
+	bool Contains(const IObject* obj) const;
+	bool CollectionRequested() const { return _used >= _size && !_objects.empty(); }
+
+	size_t Size() const { return _size; }
+	void SetSize(size_t size);
+	const NurseryStats& Stats() const { return _stats; }
+
+	//record a container outside the nursery that now references an object inside it
+	void Remember(const IObject* container);
+
+	//roots must pass every reference they hold through the forwarder and store the result
+	void Collect(const std::function<void(const Forwarder& forward)>& roots);
+
+	//write barrier for container stores, uses the nursery active on this thread
+	static void WriteBarrier(const IObject* container, const IObject* value);
+	static Nursery* Active();
+	static void SetActive(Nursery* nursery);
+
+	static constexpr size_t DEFAULT_SIZE = 256 * 1024;
+
+private:
+	void* Allocate(size_t size, size_t alignment);
+	const IObject* Forward(const IObject* obj);
+	IObject* Promote(const IObject* obj);
+	void ForwardChildren(IObject* obj);
+
+	struct Chunk
+	{
+		std::unique_ptr<std::byte[]> Memory;
+		size_t Size;
+	};
+
+	std::vector<Chunk> _chunks;
+	size_t _chunk = 0;
+	size_t _offset = 0;
+	size_t _used = 0;
+	size_t _size;
+
+	std::vector<IObject*> _objects;
+	std::unordered_set<IObject*> _remembered;
+	std::unordered_map<const IObject*, IObject*> _forwarded;
+	std::vector<IObject*> _promoted;
+
+	std::shared_ptr<ObjectFactory> _tenured;
+	NurseryStats _stats;
+};
+
+//bump pointer allocator for objects the compiler proved never outlive the frame that allocates them
+//frames release it in stack order when they return, a full region leaves the allocation to the factory
+class ScratchRegion
+{
+public:
+	explicit ScratchRegion(size_t size = DEFAULT_SIZE);
+	~ScratchRegion();
+
+	//nullptr once the region is full
+	template <typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		void* memory = Allocate(sizeof(T), alignof(T));
+		if (memory == nullptr)
+		{
+			return nullptr;
+		}
+		auto obj = new (memory) T(std::forward<Args>(args)...);
+		_objects.push_back(obj);
+		return obj;
+	}
+
+	size_t Mark() const { return _offset; }
+	//destroys every object allocated since the mark
+	void Release(size_t mark);
+	//the object was allocated here and has been released since
+	bool Released(const IObject* obj) const;
+	//live objects, their references into the nursery are roots of a minor collection
+	const std::vector<IObject*>& Objects() const { return _objects; }
+
+	static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+
+private:
+	void* Allocate(size_t size, size_t alignment);
+
+	std::unique_ptr<std::byte[]> _memory;
+	size_t _size;
+	size_t _offset = 0;
+	std::vector<IObject*> _objects;
 };
 
 class ObjectFactory
 {
 public:
 	ObjectFactory(ObjectStore* store);
+	ObjectFactory(ObjectStore* store, Nursery* nursery);
 	~ObjectFactory();
 
+	//a factory over the same store that allocates into the given nursery
+	std::shared_ptr<ObjectFactory> WithNursery(Nursery* nursery) const { return std::make_shared<ObjectFactory>(_store, nursery); }
+
 	template <typename T, typename... Args>
-	T* New(Args... args) const
+	T* New(Args&&... args) const
 	{
 		static_assert(std::is_base_of<IObject, T>::value, "T must derive from IObject");
 
-		auto obj = std::make_shared<T>(args...);
-		_store->Add(obj);
-		return obj.get();
+		if (_nursery != nullptr && _nursery->Enabled())
+		{
+			return _nursery->New<T>(std::forward<Args>(args)...);
+		}
+
+		return _store->Make<T>(std::forward<Args>(args)...);
 	}
 
 	template <typename T>
@@ -51,4 +198,5 @@ public:
 
 private:
 	ObjectStore* _store;
+	Nursery* _nursery = nullptr;
 };
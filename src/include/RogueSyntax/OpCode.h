@@ -76,17 +76,37 @@ struct DebugSymbol
 	std::string SourceAst;
 };
 
+struct FunctionLayout
+{
+	size_t Offset; //absolute offset of the first instruction of the function body
+	uint32_t NumLocals;
+	uint32_t MaxStackDepth; //operand stack slots used above the locals
+};
+
 struct ObjectCode
 {
 	RSInstructions Instructions;
 	std::vector<Symbol> Symbols;
 	std::vector<DebugSymbol> DebugSymbols;
+	uint32_t NumGlobals = 0;
+	uint32_t MaxStackDepth = 0;
+	std::vector<FunctionLayout> Functions;
 };
 
 struct ByteCode
 {
 	RSInstructions Instructions;
 	std::vector<DebugSymbol> DebugSymbols;
+	uint32_t NumGlobals = 0;
+	uint32_t MaxStackDepth = 0;
+	//sorted by offset
+	std::vector<FunctionLayout> Functions;
+
+	const FunctionLayout* FindFunction(size_t offset) const
+	{
+		auto it = std::lower_bound(Functions.begin(), Functions.end(), offset, [](const FunctionLayout& fn, size_t off) { return fn.Offset < off; });
+		return it != Functions.end() && it->Offset == offset ? &(*it) : nullptr;
+	}
 };
 
 struct DissaemblyDetail
@@ -162,6 +182,25 @@ struct OpCode
 		OP_RETURN,
 		OP_RET_VAL,
 		OP_CUR_CLOSURE,
+		//iteration
+		OP_GENERATOR, //first instruction of a fn*, returns a generator holding the frame
+		OP_YIELD,
+		OP_GEN_RETURN,
+		OP_ITER,      //replaces the iterable with an iterator
+		OP_ITER_NEXT, //pushes the next value or pops the iterator and jumps once it is exhausted
+		OP_FOR_RANGE, //OP_ITER_NEXT for a loop over range(...), counts without going through the iterator dispatch
+		//typed - only emitted where the compiler has proven the operand types, no dispatch on them at runtime
+		OP_ADD_II,
+		OP_LT_II,
+		OP_CONCAT_SS,
+		//scratch - allocations the compiler has proven never outlive the frame, released when it returns
+		OP_ARRAY_SCRATCH,
+		OP_HASH_SCRATCH,
+		OP_CLOSURE_SCRATCH,
+		//unchecked - an array index the compiler has proven in bounds, other indexable types still check it
+		OP_INDEX_NOCHECK,
+		//peephole - a store the next instruction loaded straight back, the stored value stays on the stack
+		OP_SET_KEEP,
 	};
 
 	static const std::unordered_map<Constants, Definition> Definitions;
@@ -177,6 +216,8 @@ struct OpCode
 	static bool HasData(Constants opcode);
 	static std::vector<uint8_t> ReadData(std::tuple<Constants, std::vector<uint32_t>, size_t>, const RSInstructions& instructions);
 	static Constants GetOpcode(const RSInstructions& instructions, size_t offset);
+	//net change to the operand stack, every opcode pops its inputs before it pushes its result
+	static int StackEffect(Constants opcode, const std::vector<uint32_t>& operands);
 	static std::string PrintInstructions(const RSInstructions& instructions);
 	static std::string PrintInstructionsWithDebug(const ByteCode& code);
 
@@ -84,10 +84,12 @@ protected:
 	IExpression* ParseIndexExpression(const IExpression* left);
 	IExpression* ParseAssignExpression(const IExpression* left);
 	IExpression* ParseOpAssignExpression(const IExpression* left);
+	IExpression* ParseYieldExpression();
 
 	IStatement* ParseIfStatement();
 	IStatement* ParseWhileStatement();
 	IStatement* ParseForStatement();
+	IStatement* ParseForInStatement(const RSToken& token);
 
 	IStatement* ParseBlockStatement();
 	IStatement* ParseLetStatement();
@@ -122,4 +124,6 @@ private:
 	std::map<TokenType, InfixParseFn> _infixDispatch;
 
 	std::shared_ptr<AstNodeStore> _currentStore;
+	//one entry per function being parsed, yield is only a keyword directly inside a fn*
+	std::vector<bool> _generatorBodies;
 };
\ No newline at end of file
@@ -2,6 +2,30 @@
 
 #include <RogueSyntaxCore.h>
 
+class RogueSyntax;
+
+//objects allocated while the scope is alive live in a region that is released when it ends
+//anything the host wants to keep must be copied out with Keep, vms made in the scope must not outlive it
+class ExecutionScope
+{
+public:
+	ExecutionScope(RogueSyntax* syntax, const std::shared_ptr<ObjectStore>& region, const std::shared_ptr<ObjectStore>& previous);
+	ExecutionScope(ExecutionScope&& other) noexcept;
+	ExecutionScope(const ExecutionScope&) = delete;
+	ExecutionScope& operator=(const ExecutionScope&) = delete;
+	ExecutionScope& operator=(ExecutionScope&&) = delete;
+	~ExecutionScope();
+
+	//deep copy into the store that was active before the scope began
+	const IObject* Keep(const IObject* obj) const;
+	size_t ObjectCount() const { return _region->Count(); }
+
+private:
+	RogueSyntax* _syntax;
+	std::shared_ptr<ObjectStore> _region;
+	std::shared_ptr<ObjectStore> _previous;
+};
+
 //class that acts as the API
 class RogueSyntax
 {
@@ -12,14 +36,33 @@ public:
 	std::shared_ptr<Program> Parse(const std::string& input, const std::string& unit) const;
 	ObjectCode Compile(const std::string& input, const std::string& unit) const;
 	std::string Disassemble(const ByteCode& code, bool includeDebugSymbols) const;
+	//mid-level ir of every function in the input, before and after each compiler pass
+	std::string DumpIr(const std::string& input, const std::string& unit) const;
 	ByteCode Link(const ObjectCode& objectCode) const;
 	std::shared_ptr<RogueVM> MakeVM(ByteCode code) const;
+	std::shared_ptr<RogueVM> MakeVM(const std::shared_ptr<const ByteCode>& code) const;
+	//vm with its own object store, for running on a worker thread without touching the shared store
+	std::shared_ptr<RogueVM> MakeIsolatedVM(const std::shared_ptr<const ByteCode>& code) const;
+	std::shared_ptr<VmPool> MakeVmPool(size_t maxIdlePerProgram = 8) const;
+	std::shared_ptr<VmScheduler> MakeScheduler(const std::shared_ptr<const ByteCode>& code, const SchedulerOptions& options = SchedulerOptions()) const;
 	const IObject* QuickEval(EvaluatorType type, const std::string& input) const;
-	void RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func);
+	void RegisterBuiltIn(const std::string& name, std::function<IObject* (const ObjectFactory* factory, const std::vector<const IObject*>& args)> func, bool pure = false);
+
+	ExecutionScope BeginRun();
+	size_t ObjectCount() const { return _objectStore->Count(); }
+
+	void SetCompilerOptions(const CompilerOptions& options) { _compilerOptions = options; };
+	const CompilerOptions& GetCompilerOptions() const { return _compilerOptions; };
 
 private:
+	friend class ExecutionScope;
+	void EndRun(const std::shared_ptr<ObjectStore>& previous);
+
+	//throws with every parser error in the message
+	std::shared_ptr<Program> ParseOrThrow(const std::string& input, const std::string& unit) const;
 	std::shared_ptr<Evaluator> MakeEvaluator(EvaluatorType type) const;
 	std::shared_ptr<ObjectStore> _objectStore;
 	std::shared_ptr<BuiltIn> _builtIn;
+	CompilerOptions _compilerOptions;
 };
 
@@ -35,7 +35,13 @@
 #include "TypeCoercer.h"
 #include "Evaluator.h"
 #include "OpCode.h"
+#include "CompilerOptions.h"
 #include "VirtualMachine.h"
+#include "VmPool.h"
+#include "VmScheduler.h"
+#include "WorkStealingPool.h"
+#include "GreenTask.h"
+#include "SimdKernels.h"
 
 
 
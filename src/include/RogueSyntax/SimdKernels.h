@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel
+{
+	Scalar,
+	Sse41,
+	Avx2,
+};
+
+//elementwise operators of the typed arrays
+enum class VectorOp
+{
+	Add,
+	Sub,
+	Mul,
+	Div,
+};
+
+enum class CompareOp
+{
+	Eq,
+	Neq,
+	Lt,
+	Lte,
+	Gt,
+	Gte,
+};
+
+//every typed array kernel for one instruction set
+//integers wrap on overflow like the vm's integers, integer division has no vector instruction and stays scalar
+//b points to n values, or to a single value that is used for every element when scalar is set
+//comparisons write 1 where the comparison holds and 0 elsewhere
+struct SimdKernelTable
+{
+	int32_t (*SumInt)(const int32_t* a, size_t n);
+	float (*SumDecimal)(const float* a, size_t n);
+	//n must not be zero
+	int32_t (*MinInt)(const int32_t* a, size_t n);
+	int32_t (*MaxInt)(const int32_t* a, size_t n);
+	float (*MinDecimal)(const float* a, size_t n);
+	float (*MaxDecimal)(const float* a, size_t n);
+	int32_t (*DotInt)(const int32_t* a, const int32_t* b, size_t n);
+	float (*DotDecimal)(const float* a, const float* b, size_t n);
+	//integer division by zero is the caller's to reject
+	void (*ArithInt)(VectorOp op, const int32_t* a, const int32_t* b, bool scalar, int32_t* out, size_t n);
+	void (*ArithDecimal)(VectorOp op, const float* a, const float* b, bool scalar, float* out, size_t n);
+	void (*CompareInt)(CompareOp op, const int32_t* a, const int32_t* b, bool scalar, int32_t* out, size_t n);
+	void (*CompareDecimal)(CompareOp op, const float* a, const float* b, bool scalar, int32_t* out, size_t n);
+};
+
+//the widest kernels the cpu supports are picked on first use, the same binary runs on machines without avx2
+class SimdKernels
+{
+public:
+	static SimdLevel Detected();
+	static SimdLevel Active();
+	//levels above the detected one are clamped to it, lets tests and benchmarks compare the kernels
+	static void SetLevel(SimdLevel level);
+	static const SimdKernelTable& Table();
+};
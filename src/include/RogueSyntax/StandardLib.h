@@ -11,9 +11,13 @@
 #include <vector>
 #include <array>
 #include <stack>
+#include <deque>
 #include <memory>
+#include <memory_resource>
 #include <map>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <functional>
 #include <span>
 #include <ranges>
@@ -22,7 +26,12 @@
 #include <sstream>
 #include <format>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <future>
 #include <algorithm>
 #include <chrono>
+#include <optional>
 
 
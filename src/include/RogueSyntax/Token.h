@@ -124,6 +124,7 @@ struct TokenType
 	static const TokenType TOKEN_BREAK;
 	static const TokenType TOKEN_CONTINUE;
 	static const TokenType TOKEN_FOR;
+	static const TokenType TOKEN_IN;
 
 	// Comments
 	static const TokenType TOKEN_COMMENT;
@@ -2,9 +2,42 @@
 #include <StandardLib.h>
 #include <OpCode.h>
 
-#define STACK_SIZE 2048
-#define GLOBAL_SIZE std::numeric_limits<int16_t>::max()
-#define MAX_FRAMES 1024
+class GreenTask;
+class TaskGroup;
+
+#define STACK_SIZE 256
+#define MAX_STACK_SIZE (1 << 20)
+#define FRAME_SIZE 64
+#define MAX_FRAMES (1 << 16)
+
+struct VmLimits
+{
+	//slots reserved up front, the stacks grow on demand up to the max
+	size_t InitialStackSize = STACK_SIZE;
+	size_t MaxStackSize = MAX_STACK_SIZE;
+	size_t InitialFrames = FRAME_SIZE;
+	size_t MaxFrames = MAX_FRAMES;
+};
+
+//inputs smaller than this run the parallel builtins on the calling vm
+#define PARALLEL_THRESHOLD 1024
+
+//how often the clock is read when running against a deadline, in budget units
+#define DEADLINE_SLICE 1024
+
+enum class VmStatus
+{
+	Ready,
+	Running,
+	BudgetExhausted,
+	Yielded,
+	//a spawned task waiting on a channel or another task, the blocking call runs again when it resumes
+	Blocked,
+	//waiting on a host operation a builtin started, the host hands the result over with Resume
+	Suspended,
+	Completed,
+	Error,
+};
 
 struct StackValue
 {
@@ -57,23 +90,97 @@ public:
 	inline void SetBasePointer(int bp) { _basePointer = bp; };
 	inline const ClosureObj* Closure() const { return _fn; };
 	inline const ClosureObj* ClosureRef() const { return _fn; };
+	inline void SetClosure(const ClosureObj* fn) { _fn = fn; };
+	//where the scratch region stood when the frame was pushed, returning releases everything after it
+	inline size_t ScratchMark() const { return _scratchMark; };
+	inline void SetScratchMark(size_t mark) { _scratchMark = mark; };
 
 private:
 	mutable int _beforeIp;
 	int _ip;
 	const ClosureObj* _fn;
 	int _basePointer;
+	size_t _scratchMark = 0;
 };
 
 
+//threading model
+// - ByteCode is immutable once linked, share it between any number of vms on any threads through shared_ptr<const ByteCode>
+// - a vm is single threaded, run each vm on one thread at a time - vms never share mutable state with each other
+// - each vm allocates into its own nursery, survivors are promoted into the vm's object store which is locked
+//   vms made with NewIsolated own their object store so threads never contend on it
+// - BuiltIn registration is thread safe, a vm picks up the registered functions when a run starts
+// - the true/false/null singletons are immutable and shared by everything
+// - spawned tasks run on their own vms on the shared pool, values cross between vms only through channels and await
 class RogueVM
 {
 public:
 	RogueVM(const ByteCode& byteCode, const std::shared_ptr<ObjectFactory>& factory);
 	RogueVM(const ByteCode& byteCode, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory);
+	//vms running the same program can share one main closure instead of each copying the instructions
+	RogueVM(const std::shared_ptr<const ByteCode>& byteCode, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, const VmLimits& limits = VmLimits(), const ClosureObj* mainClosure = nullptr);
 	~RogueVM();
 
 	void Run();
+	//run until the program finishes or the budget runs out, a vm that ran out of budget continues where it stopped
+	//the budget is charged at loop back-edges with the loop body size and at calls with the function size,
+	//so it is an upper bound on the instructions executed and straight-line code is never checked
+	VmStatus RunFor(uint64_t maxInstructions);
+	VmStatus RunUntil(std::chrono::steady_clock::time_point deadline);
+	VmStatus Status() const { return _status; };
+	//ticks requested by the last yield or wait builtin
+	int WaitTicks() const { return _waitTicks; };
+	//the host operation a suspended vm waits on, an event loop polls it instead of blocking a thread per script
+	const std::shared_future<HostResult>& Pending() const { return _pending; };
+	bool PendingReady() const;
+	//completes the call the vm is suspended on with result, the next run continues after it
+	//result has to outlive the vm's next safe point, the same as a builtin result
+	void Resume(const IObject* result);
+	//resumes with the value the pending operation built, blocks until it finished and rethrows if it failed
+	void ResumePending();
+	//the vm running on this thread, lets builtins call back into the script
+	static RogueVM* Active();
+	//calls a closure or builtin from native code, re-entrant - the result is valid until the vm reaches its next safe point
+	//a callback runs to completion, budgets are not charged and yielding inside it is an error
+	const IObject* Call(const IObject* callable, const std::vector<const IObject*>& args);
+	bool IsTruthy(const IObject* obj);
+	//native code holding objects across Call roots them here, collections update the vector in place
+	void PushRoots(std::vector<const IObject*>* roots) { _roots.push_back(roots); };
+	void PopRoots() { _roots.pop_back(); };
+
+	//runs task over [0, count) in chunks on the shared pool, every chunk on a vm that shares this program
+	//inputs are tenured first so workers only ever see objects that do not move, read them from the vector the task gets
+	//outputs are concatenated in chunk order, chunks see the globals read-only and assigning one is an error
+	//counts below the parallel threshold run on this vm, combine then runs on this vm over the concatenated outputs
+	typedef std::function<void(RogueVM& vm, const std::vector<const IObject*>& inputs, size_t begin, size_t end, std::vector<const IObject*>& output)> ChunkTask;
+	typedef std::function<void(RogueVM& vm, const std::vector<const IObject*>& inputs, std::vector<const IObject*>& output)> CombineTask;
+	std::vector<const IObject*> ParallelChunks(std::vector<const IObject*> inputs, size_t count, const ChunkTask& task, const CombineTask& combine = nullptr);
+	void SetParallelThreshold(size_t threshold) { _parallelThreshold = threshold; };
+	size_t ParallelThreshold() const { return _parallelThreshold; };
+
+	//starts the closure on a new vm over the same program, the task sees the globals read-only
+	//globals and arguments are tenured first so the task never sees them move
+	std::shared_ptr<GreenTask> Spawn(const ClosureObj* closure, const std::vector<const IObject*>& args);
+	//the task this vm runs, null for a vm the host runs - blocking builtins block the thread instead of parking
+	std::shared_ptr<GreenTask> CurrentTask() const;
+	//stops every task started from this vm and the tasks they started, returns once they all stopped
+	void CancelTasks();
+	//keeps a store with objects handed over from another vm alive as long as this vm
+	void Adopt(const std::shared_ptr<ObjectStore>& store);
+
+	//a vm with a private object store that lives as long as the vm, objects it returns die with it
+	static std::shared_ptr<RogueVM> NewIsolated(const std::shared_ptr<const ByteCode>& byteCode, const std::shared_ptr<BuiltIn>& externals, const VmLimits& limits = VmLimits());
+	static const ClosureObj* MakeMainClosure(const ByteCode& byteCode, const std::shared_ptr<ObjectFactory>& factory);
+	//return to the state after construction so the vm can run its program again
+	void Reset();
+	const std::shared_ptr<const ByteCode>& Code() const { return _byteCode; };
+
+	//recursion and stack limits, lowering them below what is in use takes effect on the next growth
+	void SetLimits(const VmLimits& limits);
+	const VmLimits& Limits() const { return _limits; };
+	size_t StackCapacity() const { return _stack.size(); };
+	size_t FrameCapacity() const { return _frames.size(); };
+	size_t GlobalCapacity() const { return _globals.size(); };
 	void Set_RTI_ErrorCallback(const std::function<void(const RogueVm_RuntimeError&)>& onError);
 	void Set_RTI_BreakCallback(const std::function<void(const StackTrace&)>& onBreak);
 
@@ -81,6 +188,12 @@ public:
 	const IObject* LastPopped() const;
 	const Frame& CurrentFrame() const;
 
+	//nursery size in bytes, 0 allocates everything directly in the object store - change between runs
+	void SetNurserySize(size_t size);
+	size_t NurserySize() const;
+	const NurseryStats& GetNurseryStats() const;
+	void CollectNursery();
+
 protected:
 
 	void OnErrorInternal(const RogueVm_RuntimeError& error);
@@ -90,7 +203,22 @@ protected:
 	StackTrace GetRuntimeInfo() const;
 	std::string PrintStack() const;
 
-	void Execute();
+	VmStatus RunInternal();
+	//runs until the frame count drops to exitFrame or the main frame runs out of instructions
+	void Execute(int exitFrame = 0);
+
+	//isolated vm over the same program with a read-only view of the globals, for running chunks on a worker
+	std::shared_ptr<RogueVM> Fork(const ClosureObj* mainClosure) const;
+	//sets up a call to the closure as the only thing left to run
+	void Start(const ClosureObj* closure, const std::vector<const IObject*>& args);
+
+	//charge the budget at a back-edge or call, true when execution has to stop here
+	inline bool Checkpoint(int64_t cost)
+	{
+		_budget -= cost;
+		return _budget < 0 && BudgetExhausted();
+	}
+	bool BudgetExhausted();
 
 	//stack operations
 	void Push(const IObject* obj);
@@ -103,6 +231,21 @@ protected:
 
 	void PushFrame(Frame frame);
 	Frame PopFrame();
+	//drops the objects the returning frame allocated in the scratch region
+	void ReleaseScratch(const Frame& frame);
+
+	//a full scratch region leaves the object to the factory, it is reclaimed like any other
+	template <typename T, typename... Args>
+	T* NewScratch(Args&&... args)
+	{
+		if (auto* obj = _scratch.New<T>(args...))
+		{
+			return obj;
+		}
+		return _factory->New<T>(std::forward<Args>(args)...);
+	}
+
+	void EnsureStack(size_t required);
 
 	template<std::integral T>
 	T ReadOperand(uint8_t width)
@@ -133,6 +276,8 @@ protected:
 	void ExecuteArithmeticInfix(OpCode::Constants opcode);
 	void ExecuteIntegerArithmeticInfix(OpCode::Constants opcode, const IntegerObj* left, const IntegerObj* right);
 	void ExecuteDecimalArithmeticInfix(OpCode::Constants opcode, const DecimalObj* left, const DecimalObj* right);
+	void ExecuteTypedArrayArithmeticInfix(OpCode::Constants opcode, const IObject* left, const IObject* right);
+	void ExecuteTypedArrayComparisonInfix(OpCode::Constants opcode, const IObject* left, const IObject* right);
 	void ExecuteStringArithmeticInfix(OpCode::Constants opcode, const StringObj* left, const StringObj* right);
 	
 	void ExecuteComparisonInfix(OpCode::Constants opcode);
@@ -153,21 +298,47 @@ protected:
 	std::string MakeOpCodeError(const std::string& message, OpCode::Constants opcode);
 
 	void ExecuteGetInstruction(int idx);
-	void ExecuteSetInstruction(int idx);
+	//the stored copy of the value
+	const IObject* ExecuteSetInstruction(int idx);
+
+	void MinorCollection();
 
 private:
+	//declared first so it is released after everything that points into it
+	std::shared_ptr<ObjectStore> _heap;
+	//stores of finished workers, their results are referenced from this vm
+	std::vector<std::shared_ptr<ObjectStore>> _adopted;
 
 	std::function<void(const RogueVm_RuntimeError&)> _onError;
 	std::function<void(const StackTrace&)> _onBreak;
 
 	int _frameIndex = 0;
-	uint16_t _sp = 0;
+	int _sp = 0;
+	VmStatus _status = VmStatus::Ready;
+	int64_t _budget = 0;
+	int _waitTicks = 0;
+	std::shared_future<HostResult> _pending;
+	std::optional<std::chrono::steady_clock::time_point> _deadline;
+	VmLimits _limits;
+	std::unique_ptr<Nursery> _nursery;
 	std::shared_ptr<ObjectFactory> _factory;
+	ScratchRegion _scratch;
 	std::shared_ptr<BuiltIn> _externals;
+	std::shared_ptr<const BuiltIn::FunctionTable> _builtins;
 	TypeCoercer _coercer;
-	std::array<const IObject*, STACK_SIZE> _stack{0};
-	std::array<const IObject*, GLOBAL_SIZE> _globals{0};
+	std::vector<const IObject*> _stack;
+	std::vector<const IObject*> _globals;
+	int _globalsUsed = 0;
+	int _readOnlyGlobals = 0;
+	size_t _parallelThreshold = PARALLEL_THRESHOLD;
+	//native code holding results across callbacks
+	std::vector<std::vector<const IObject*>*> _roots;
+	//owned by the task, null unless this vm runs a spawned task
+	GreenTask* _task = nullptr;
+	//shared by every task started from the vm that created it, cancelled with it
+	std::shared_ptr<TaskGroup> _taskGroup;
+	bool _ownsTaskGroup = false;
 	const IObject* _outputRegister = nullptr;
-	std::array<Frame, MAX_FRAMES> _frames;
-	ByteCode _byteCode;
+	std::vector<Frame> _frames;
+	std::shared_ptr<const ByteCode> _byteCode;
 };
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include "StandardLib.h"
+#include "OpCode.h"
+
+class RogueVM;
+class BuiltIn;
+class ObjectFactory;
+
+//keeps warm vms per program so a hot path does not pay for vm construction on every run
+//acquire and release are thread safe, a vm itself must only be used by one thread at a time
+class VmPool
+{
+public:
+	VmPool(const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, size_t maxIdlePerProgram = 8);
+	~VmPool();
+
+	std::shared_ptr<RogueVM> Acquire(const std::shared_ptr<const ByteCode>& code);
+	//resets the vm and keeps it for the next acquire of the same program
+	void Release(const std::shared_ptr<RogueVM>& vm);
+
+	size_t IdleCount() const;
+	size_t IdleCount(const std::shared_ptr<const ByteCode>& code) const;
+
+private:
+	std::shared_ptr<BuiltIn> _externals;
+	std::shared_ptr<ObjectFactory> _factory;
+	size_t _maxIdlePerProgram;
+
+	mutable std::mutex _lock;
+	//keyed by program identity - the idle vms hold the bytecode alive
+	std::unordered_map<const ByteCode*, std::vector<std::shared_ptr<RogueVM>>> _idle;
+};
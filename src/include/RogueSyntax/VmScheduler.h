@@ -0,0 +1,84 @@
+#pragma once
+#include "StandardLib.h"
+#include "VirtualMachine.h"
+
+struct SchedulerOptions
+{
+	//instruction budget each task gets per turn, scaled by 1 + priority
+	uint64_t SliceBudget = 1000;
+	//small nurseries and stacks keep idle tasks cheap, both grow when a script needs more
+	size_t NurserySize = 4 * 1024;
+	VmLimits Limits{ 32, MAX_STACK_SIZE, 4, MAX_FRAMES };
+};
+
+enum class TaskState
+{
+	Runnable,
+	Sleeping,
+	//waiting on a host operation, resumed by the first tick after it finished
+	Suspended,
+	Completed,
+	Error,
+};
+
+struct TaskInfo
+{
+	TaskState State = TaskState::Runnable;
+	int Priority = 0;
+	uint64_t WakeTick = 0;
+	uint64_t Slices = 0;
+	std::chrono::nanoseconds Time{ 0 };
+	std::string Error;
+};
+
+//runs many vms over one program cooperatively on the calling thread
+//higher priorities run first each tick, tasks of equal priority take turns and pick up where the last tick stopped
+//tasks waiting on host operations cost nothing until the operation finished, one thread can drive many of them
+class VmScheduler
+{
+public:
+	typedef uint32_t TaskId;
+
+	VmScheduler(const std::shared_ptr<const ByteCode>& code, const std::shared_ptr<BuiltIn>& externals, const std::shared_ptr<ObjectFactory>& factory, const SchedulerOptions& options = SchedulerOptions());
+	~VmScheduler();
+
+	TaskId Spawn(int priority = 0);
+
+	//one frame - wakes sleepers and finished host operations then gives runnable tasks a turn each until the time slice is used up
+	//returns the number of turns that ran
+	size_t Tick(std::chrono::nanoseconds timeSlice);
+	size_t Tick();
+	size_t Tick(std::chrono::steady_clock::time_point deadline);
+
+	uint64_t CurrentTick() const { return _tick; };
+	size_t TaskCount() const { return _tasks.size(); };
+	size_t RunnableCount() const;
+	size_t SleepingCount() const { return _sleeping.size(); };
+	size_t SuspendedCount() const { return _suspended.size(); };
+	bool Done() const { return RunnableCount() == 0 && _sleeping.empty() && _suspended.empty(); };
+
+	const TaskInfo& Info(TaskId id) const { return _tasks[id].Info; };
+	const std::shared_ptr<RogueVM>& Vm(TaskId id) const { return _tasks[id].Vm; };
+
+private:
+	struct Task
+	{
+		std::shared_ptr<RogueVM> Vm;
+		TaskInfo Info;
+	};
+
+	void Wake();
+	void RunTurn(TaskId id, std::chrono::steady_clock::time_point& clock);
+
+	std::shared_ptr<const ByteCode> _code;
+	std::shared_ptr<BuiltIn> _externals;
+	std::shared_ptr<ObjectFactory> _factory;
+	SchedulerOptions _options;
+	const ClosureObj* _mainClosure;
+
+	std::vector<Task> _tasks;
+	std::map<int, std::deque<TaskId>, std::greater<int>> _runQueues;
+	std::multimap<uint64_t, TaskId> _sleeping;
+	std::vector<TaskId> _suspended;
+	uint64_t _tick = 0;
+};
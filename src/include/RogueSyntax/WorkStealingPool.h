@@ -0,0 +1,58 @@
+#pragma once
+#include "StandardLib.h"
+
+//persistent worker threads that split a job into chunks or run submitted work items
+//each participant owns a range of chunks and takes from its front, idle participants steal from the back of the others
+//submitted items go to the submitting worker's own queue (or a shared one from outside the pool), workers run their
+//own newest item first and steal the oldest from the others
+class WorkStealingPool
+{
+public:
+	WorkStealingPool(size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1);
+	~WorkStealingPool();
+
+	//process wide pool used by the parallel builtins
+	static WorkStealingPool& Shared();
+
+	size_t WorkerCount() const { return _threads.size(); };
+	//participants in a job, the calling thread plus every worker
+	size_t SlotCount() const { return _threads.size() + 1; };
+
+	//runs task(chunk, slot) for every chunk in [0, chunks) and blocks until all of them finished
+	//slot 0 is the calling thread, a slot only ever runs on one thread so per slot state needs no locking
+	//the first exception thrown by a task is rethrown here, chunks that did not start yet are skipped
+	void ParallelFor(size_t chunks, const std::function<void(size_t chunk, size_t slot)>& task);
+
+	//runs the item on a worker some time later, items must not throw or block waiting for other items
+	//items still queued when the pool is destroyed are dropped without running
+	void Submit(std::function<void()> item);
+	size_t QueuedCount() const { return _queued; };
+
+	//true on the pool's own worker threads
+	bool IsWorkerThread() const;
+	//runs queued items on the calling thread until done returns true
+	//a worker that waits on another item has to help, the item it waits on could be queued behind it
+	void HelpUntil(const std::function<bool()>& done);
+
+private:
+	struct Job;
+	struct Queue
+	{
+		std::mutex Lock;
+		std::deque<std::function<void()>> Items;
+	};
+
+	void WorkerLoop(size_t worker);
+	static void Work(Job& job, size_t slot);
+	static bool TakeChunk(Job& job, size_t slot, size_t& chunk);
+	bool TakeItem(size_t worker, std::function<void()>& item);
+
+	std::vector<std::thread> _threads;
+	//one per worker plus the shared queue for submissions from outside the pool at the end
+	std::vector<std::unique_ptr<Queue>> _queues;
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::deque<std::shared_ptr<Job>> _jobs;
+	std::atomic<size_t> _queued = 0;
+	bool _stopping = false;
+};